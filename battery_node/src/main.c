@@ -3,6 +3,7 @@
 #include <zephyr/drivers/can.h>
 #include "sensor_common.h"
 #include "can_ids.h"
+#include "signal_codec.h"
 
 #define INA219_ADDR 0x40
 #define INA219_CONFIG_REG 0x00
@@ -16,17 +17,16 @@ static void battery_thread(void *arg1, void *arg2, void *arg3)
 {
     uint8_t can_data[BATTERY_MSG_LEN];
     int16_t current_raw, voltage_raw;
-    float voltage, current;
+    struct sig_battery msg;
 
     while (1) {
         // Read voltage and current from INA219
         i2c_burst_read(i2c_dev, INA219_ADDR, INA219_VOLTAGE_REG, (uint8_t *)&voltage_raw, 2);
         i2c_burst_read(i2c_dev, INA219_ADDR, INA219_CURRENT_REG, (uint8_t *)&current_raw, 2);
 
-        voltage = voltage_raw * 0.00125f; // LSB = 1.25mV
-        current = current_raw * 0.0005f;  // LSB = 0.5mA
-
-        memcpy(can_data, &voltage, sizeof(float));
+        // LSB = 1.25mV, signal is in mV
+        msg.voltage = (uint16_t)(voltage_raw * 5 / 4);
+        sig_battery_pack(can_data, &msg);
         send_sensor_data(can_dev, CAN_ID_BATTERY, can_data, BATTERY_MSG_LEN);
 
         k_sleep(K_MSEC(1000));
@@ -3,6 +3,8 @@
 #include <zephyr/drivers/can.h>
 #include "sensor_common.h"
 #include "can_ids.h"
+#include "signal_codec.h"
+#include "can_time_sync.h"
 
 #define ADC_NODE DT_NODELABEL(adc0)
 #define ADC_CHANNEL 0
@@ -33,12 +35,13 @@ static void brake_thread(void *arg1, void *arg2, void *arg3) {
     while (1) {
         adc_sequence_init_dt(&sequence);
         adc_read(adc_dev, &sequence);
+        uint32_t sample_us = can_time_sync_now_us();
 
         uint8_t can_data[BRAKE_MSG_LEN];
-        can_data[0] = adc_raw >> 8;
-        can_data[1] = adc_raw & 0xFF;
-        
-        send_sensor_data(can_dev, CAN_ID_BRAKE, can_data, BRAKE_MSG_LEN);
+        struct sig_brake msg = { .pressure = adc_raw };
+        sig_brake_pack(can_data, &msg);
+
+        send_sensor_sample(can_dev, CAN_ID_BRAKE, can_data, BRAKE_MSG_LEN, sample_us);
         
         k_sleep(K_MSEC(50));  // 20Hz sampling rate
     }
@@ -54,6 +57,10 @@ void main(void) {
 
     adc_channel_setup(adc_dev, &channel_cfg);
 
+#ifdef CONFIG_CAN_TIME_SYNC
+    can_time_sync_client_init(can_dev);
+#endif
+
     k_thread_create(&brake_thread_data, brake_stack,
                    SENSOR_THREAD_STACK_SIZE,
                    brake_thread, NULL, NULL, NULL,
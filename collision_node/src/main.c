@@ -3,6 +3,7 @@
 #include <zephyr/drivers/can.h>
 #include "sensor_common.h"
 #include "can_ids.h"
+#include "signal_codec.h"
 
 #define TRIG_PIN 13
 #define ECHO_PIN 14
@@ -41,13 +42,12 @@ static uint32_t measure_distance(void)
 static void collision_thread(void *arg1, void *arg2, void *arg3)
 {
     uint8_t can_data[COLLISION_MSG_LEN];
-    uint16_t distance;
+    struct sig_collision msg;
 
     while (1) {
-        distance = measure_distance();
-        can_data[0] = distance >> 8;
-        can_data[1] = distance & 0xFF;
-        
+        msg.distance = measure_distance();
+        sig_collision_pack(can_data, &msg);
+
         send_sensor_data(can_dev, CAN_ID_COLLISION, can_data, COLLISION_MSG_LEN);
         
         k_sleep(K_MSEC(100));  // 10Hz sampling rate
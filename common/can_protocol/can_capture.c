@@ -0,0 +1,160 @@
+#include <zephyr/kernel.h>
+#include <zephyr/sys/byteorder.h>
+#include <string.h>
+#include "can_capture.h"
+
+#define REC_FIXED_LEN   3   // flags + delta
+#define GAP_REC_LEN     5   // flags + u32 delta
+
+void can_capture_block_start(struct can_capture_writer *w, uint8_t *buf, uint32_t base_us) {
+    memset(buf, 0, CAN_CAPTURE_BLOCK_SIZE);
+    sys_put_le32(base_us, buf);
+
+    w->block = buf;
+    w->used = CAN_CAPTURE_BLOCK_HDR_LEN;
+    w->frames = 0;
+    w->last_us = base_us;
+    sys_put_le16(w->used, &buf[4]);
+}
+
+int can_capture_block_add(struct can_capture_writer *w, const struct can_frame *frame,
+                          uint32_t ts_us) {
+    bool ide = (frame->flags & CAN_FRAME_IDE) != 0;
+    uint8_t len = can_dlc_to_bytes(frame->dlc);
+    uint16_t rec_len = REC_FIXED_LEN + (ide ? 4 : 2) + len;
+    uint32_t delta = ts_us - w->last_us;
+    uint16_t gap_len = delta > CAN_CAPTURE_MAX_DELTA_US ? GAP_REC_LEN : 0;
+    uint8_t *rec = &w->block[w->used];
+    uint8_t flags = frame->dlc & CAN_CAPTURE_DLC_MASK;
+
+    if (w->used + gap_len + rec_len > CAN_CAPTURE_BLOCK_SIZE) {
+        return -ENOSPC;
+    }
+
+    if (gap_len) {
+        rec[0] = CAN_CAPTURE_FLAG_GAP;
+        sys_put_le32(delta, &rec[1]);
+        rec += gap_len;
+        delta = 0;
+    }
+
+    if (ide) {
+        flags |= CAN_CAPTURE_FLAG_IDE;
+    }
+    if (frame->flags & CAN_FRAME_FDF) {
+        flags |= CAN_CAPTURE_FLAG_FDF;
+    }
+    if (frame->flags & CAN_FRAME_BRS) {
+        flags |= CAN_CAPTURE_FLAG_BRS;
+    }
+
+    rec[0] = flags;
+    sys_put_le16((uint16_t)delta, &rec[1]);
+    if (ide) {
+        sys_put_le32(frame->id, &rec[REC_FIXED_LEN]);
+    } else {
+        sys_put_le16((uint16_t)frame->id, &rec[REC_FIXED_LEN]);
+    }
+    memcpy(&rec[rec_len - len], frame->data, len);
+
+    w->used += gap_len + rec_len;
+    w->frames++;
+    w->last_us = ts_us;
+    sys_put_le16(w->used, &w->block[4]);
+
+    return 0;
+}
+
+void can_capture_write_header(uint8_t *hdr, uint16_t block_count, uint32_t lost_frames) {
+    memset(hdr, 0, CAN_CAPTURE_HDR_LEN);
+    memcpy(hdr, CAN_CAPTURE_MAGIC, sizeof(CAN_CAPTURE_MAGIC));
+    sys_put_le16(CAN_CAPTURE_BLOCK_SIZE, &hdr[8]);
+    sys_put_le16(block_count, &hdr[10]);
+    sys_put_le32(lost_frames, &hdr[12]);
+}
+
+int can_capture_parse_block(const uint8_t *block, can_capture_frame_cb_t cb, void *user_data) {
+    uint32_t ts_us = sys_get_le32(block);
+    uint16_t used = sys_get_le16(&block[4]);
+    uint16_t pos = CAN_CAPTURE_BLOCK_HDR_LEN;
+    struct can_frame frame;
+    int count = 0;
+
+    if (used < CAN_CAPTURE_BLOCK_HDR_LEN || used > CAN_CAPTURE_BLOCK_SIZE) {
+        return -EBADMSG;
+    }
+
+    while (pos < used) {
+        uint8_t flags = block[pos];
+        bool ide = (flags & CAN_CAPTURE_FLAG_IDE) != 0;
+        uint8_t id_len = ide ? 4 : 2;
+        uint8_t len;
+
+        if (flags == CAN_CAPTURE_FLAG_GAP) {
+            if (pos + GAP_REC_LEN > used) {
+                return -EBADMSG;
+            }
+            ts_us += sys_get_le32(&block[pos + 1]);
+            pos += GAP_REC_LEN;
+            continue;
+        }
+
+        memset(&frame, 0, sizeof(frame));
+        frame.dlc = flags & CAN_CAPTURE_DLC_MASK;
+        len = can_dlc_to_bytes(frame.dlc);
+
+        if (pos + REC_FIXED_LEN + id_len + len > used) {
+            return -EBADMSG;
+        }
+
+        ts_us += sys_get_le16(&block[pos + 1]);
+        if (ide) {
+            frame.id = sys_get_le32(&block[pos + REC_FIXED_LEN]) & CAN_EXT_ID_MASK;
+            frame.flags |= CAN_FRAME_IDE;
+        } else {
+            frame.id = sys_get_le16(&block[pos + REC_FIXED_LEN]) & CAN_STD_ID_MASK;
+        }
+        if (flags & CAN_CAPTURE_FLAG_FDF) {
+            frame.flags |= CAN_FRAME_FDF;
+        }
+        if (flags & CAN_CAPTURE_FLAG_BRS) {
+            frame.flags |= CAN_FRAME_BRS;
+        }
+        memcpy(frame.data, &block[pos + REC_FIXED_LEN + id_len], len);
+
+        cb(&frame, ts_us, user_data);
+        count++;
+        pos += REC_FIXED_LEN + id_len + len;
+    }
+
+    return count;
+}
+
+int can_capture_parse(const uint8_t *image, size_t len, can_capture_frame_cb_t cb,
+                      void *user_data) {
+    uint16_t block_size, block_count;
+    int total = 0;
+
+    if (len < CAN_CAPTURE_HDR_LEN ||
+        memcmp(image, CAN_CAPTURE_MAGIC, sizeof(CAN_CAPTURE_MAGIC)) != 0) {
+        return -EINVAL;
+    }
+
+    block_size = sys_get_le16(&image[8]);
+    block_count = sys_get_le16(&image[10]);
+    if (block_size != CAN_CAPTURE_BLOCK_SIZE ||
+        len < CAN_CAPTURE_HDR_LEN + (size_t)block_count * block_size) {
+        return -EBADMSG;
+    }
+
+    for (uint16_t i = 0; i < block_count; i++) {
+        int ret = can_capture_parse_block(&image[CAN_CAPTURE_HDR_LEN + i * block_size],
+                                          cb, user_data);
+        if (ret < 0) {
+            return ret;
+        }
+        total += ret;
+    }
+
+    return total;
+}
@@ -0,0 +1,60 @@
+#ifndef CAN_CAPTURE_H
+#define CAN_CAPTURE_H
+
+#include <zephyr/kernel.h>
+#include <zephyr/drivers/can.h>
+
+// Binary CAN capture, written by the VCU recorder and read by the replay
+// tool. All fields little-endian.
+//
+// Image:  [magic "CANCAP2\0"][block size u16][block count u16][lost u32]
+//         followed by the blocks, oldest first
+// Block:  [base_us u32][used u16] then records, unused tail zeroed
+// Record: [flags u8][delta_us u16][id u16 or u32 with IDE][payload]
+//         flags: IDE 0x80, FDF 0x40, BRS 0x20, DLC in the low nibble.
+//         delta_us is relative to the previous record, or to base_us
+//         for the first record of a block.
+// Gap:    [flags 0x10][delta_us u32], no frame. Written before a frame
+//         whose delta does not fit 16 bits, which then has delta 0.
+
+#define CAN_CAPTURE_MAGIC           "CANCAP2"
+#define CAN_CAPTURE_MAGIC_LEN       8
+#define CAN_CAPTURE_HDR_LEN         16
+#define CAN_CAPTURE_BLOCK_SIZE      512
+#define CAN_CAPTURE_BLOCK_HDR_LEN   6
+#define CAN_CAPTURE_MAX_DELTA_US    0xFFFF
+
+#define CAN_CAPTURE_FLAG_IDE        0x80
+#define CAN_CAPTURE_FLAG_FDF        0x40
+#define CAN_CAPTURE_FLAG_BRS        0x20
+#define CAN_CAPTURE_FLAG_GAP        0x10
+#define CAN_CAPTURE_DLC_MASK        0x0F
+
+struct can_capture_writer {
+    uint8_t *block;
+    uint16_t used;
+    uint16_t frames;
+    uint32_t last_us;
+};
+
+typedef void (*can_capture_frame_cb_t)(const struct can_frame *frame, uint32_t ts_us,
+                                       void *user_data);
+
+// Start a new block at buf (CAN_CAPTURE_BLOCK_SIZE bytes)
+void can_capture_block_start(struct can_capture_writer *w, uint8_t *buf, uint32_t base_us);
+
+// Append a frame, preceded by a gap record after a long pause. -ENOSPC
+// when the records do not fit, the caller then starts a new block.
+int can_capture_block_add(struct can_capture_writer *w, const struct can_frame *frame,
+                          uint32_t ts_us);
+
+void can_capture_write_header(uint8_t *hdr, uint16_t block_count, uint32_t lost_frames);
+
+// Walk all frames of one block, returns the frame count or -EBADMSG
+int can_capture_parse_block(const uint8_t *block, can_capture_frame_cb_t cb, void *user_data);
+
+// Walk a complete image, returns the frame count or a negative errno
+int can_capture_parse(const uint8_t *image, size_t len, can_capture_frame_cb_t cb,
+                      void *user_data);
+
+#endif /* CAN_CAPTURE_H */
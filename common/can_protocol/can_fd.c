@@ -20,7 +20,7 @@ int can_fd_send(const struct device *dev, const struct can_fd_frame *frame) {
     struct can_frame std_frame;
     
     std_frame.id = frame->id;
-    std_frame.dlc = frame->len;
+    std_frame.dlc = can_bytes_to_dlc(frame->len);
     std_frame.flags = CAN_FRAME_FDF | frame->flags;
     memcpy(std_frame.data, frame->data, frame->len);
     
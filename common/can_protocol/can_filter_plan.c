@@ -0,0 +1,240 @@
+#include <zephyr/kernel.h>
+#include <string.h>
+#include "can_filter_plan.h"
+
+static inline bool is_ext(const struct can_filter *f) {
+    return (f->flags & CAN_FILTER_IDE) != 0;
+}
+
+static inline uint32_t id_width_mask(const struct can_filter *f) {
+    return is_ext(f) ? CAN_EXT_ID_MASK : CAN_STD_ID_MASK;
+}
+
+// Number of IDs a pattern accepts
+static uint64_t pattern_size(const struct can_filter *f) {
+    uint32_t width = is_ext(f) ? 29 : 11;
+    uint32_t care = (uint32_t)__builtin_popcount(f->mask & id_width_mask(f));
+
+    return 1ULL << (width - care);
+}
+
+// True if every ID accepted by inner is also accepted by outer
+static bool pattern_covers(const struct can_filter *outer, const struct can_filter *inner) {
+    if (is_ext(outer) != is_ext(inner)) {
+        return false;
+    }
+    if ((outer->mask & ~inner->mask & id_width_mask(outer)) != 0) {
+        return false;
+    }
+    return ((outer->id ^ inner->id) & outer->mask) == 0;
+}
+
+static void pattern_merge(const struct can_filter *a, const struct can_filter *b,
+                          struct can_filter *out) {
+    out->mask = a->mask & b->mask & ~(a->id ^ b->id);
+    out->id = a->id & out->mask;
+    // Same IDE on both sides; the frame-type flags accept either's frames
+    out->flags = a->flags | b->flags;
+}
+
+static uint64_t pattern_leak(const struct can_filter_plan *plan, const struct can_filter *f) {
+    uint64_t wanted = 0;
+
+    for (int i = 0; i < plan->num_wanted; i++) {
+        if (pattern_covers(f, &plan->wanted[i])) {
+            wanted += pattern_size(&plan->wanted[i]);
+        }
+    }
+    return wanted < pattern_size(f) ? pattern_size(f) - wanted : 0;
+}
+
+static size_t group_count(const struct can_filter_plan *plan, bool ext) {
+    size_t count = 0;
+
+    for (int i = 0; i < plan->num_filters; i++) {
+        if (is_ext(&plan->filters[i]) == ext) {
+            count++;
+        }
+    }
+    return count;
+}
+
+// The pair of filters of one frame type whose merge adds the fewest
+// unwanted IDs. Returns UINT64_MAX if the group has fewer than two.
+static uint64_t best_merge(const struct can_filter_plan *plan, bool ext,
+                           int *best_i, int *best_j, struct can_filter *best) {
+    uint64_t best_cost = UINT64_MAX;
+
+    for (int i = 0; i < plan->num_filters; i++) {
+        if (is_ext(&plan->filters[i]) != ext) {
+            continue;
+        }
+        for (int j = i + 1; j < plan->num_filters; j++) {
+            struct can_filter merged;
+            uint64_t cost;
+
+            if (is_ext(&plan->filters[j]) != ext) {
+                continue;
+            }
+            pattern_merge(&plan->filters[i], &plan->filters[j], &merged);
+            cost = pattern_leak(plan, &merged);
+            if (cost < best_cost) {
+                best_cost = cost;
+                *best_i = i;
+                *best_j = j;
+                *best = merged;
+            }
+        }
+    }
+    return best_cost;
+}
+
+static void apply_merge(struct can_filter_plan *plan, int i, int j,
+                        const struct can_filter *merged) {
+    plan->filters[i] = *merged;
+    plan->filters[j] = plan->filters[--plan->num_filters];
+}
+
+// Greedily merge the cheapest pair of one frame type until the group fits
+// its own budget
+static int reduce_group(struct can_filter_plan *plan, bool ext, size_t budget) {
+    while (group_count(plan, ext) > budget) {
+        struct can_filter best;
+        int best_i, best_j;
+
+        if (budget == 0) {
+            return -ENOSPC;
+        }
+        best_merge(plan, ext, &best_i, &best_j, &best);
+        apply_merge(plan, best_i, best_j, &best);
+    }
+    return 0;
+}
+
+// Then merge the cheapest pair of either type until both fit the shared bank
+static int reduce_total(struct can_filter_plan *plan, size_t budget) {
+    while (plan->num_filters > budget) {
+        struct can_filter std_best, ext_best;
+        int std_i, std_j, ext_i, ext_j;
+        uint64_t std_cost = best_merge(plan, false, &std_i, &std_j, &std_best);
+        uint64_t ext_cost = best_merge(plan, true, &ext_i, &ext_j, &ext_best);
+
+        if (std_cost == UINT64_MAX && ext_cost == UINT64_MAX) {
+            return -ENOSPC;
+        }
+        if (std_cost <= ext_cost) {
+            apply_merge(plan, std_i, std_j, &std_best);
+        } else {
+            apply_merge(plan, ext_i, ext_j, &ext_best);
+        }
+    }
+    return 0;
+}
+
+int can_filter_plan_build(struct can_filter_plan *plan,
+                          const struct can_filter *wanted, size_t num_wanted,
+                          size_t max_std, size_t max_ext, size_t max_total) {
+    int ret;
+
+    if (num_wanted > CAN_FILTER_PLAN_MAX) {
+        return -EINVAL;
+    }
+
+    memset(plan, 0, sizeof(*plan));
+
+    // Drop patterns already covered by another one
+    for (size_t i = 0; i < num_wanted; i++) {
+        bool covered = false;
+
+        for (int j = 0; j < plan->num_wanted; j++) {
+            if (pattern_covers(&plan->wanted[j], &wanted[i])) {
+                covered = true;
+                break;
+            }
+        }
+        if (!covered) {
+            plan->wanted[plan->num_wanted++] = wanted[i];
+        }
+    }
+
+    memcpy(plan->filters, plan->wanted, plan->num_wanted * sizeof(struct can_filter));
+    plan->num_filters = plan->num_wanted;
+
+    ret = reduce_group(plan, false, max_std);
+    if (ret == 0) {
+        ret = reduce_group(plan, true, max_ext);
+    }
+    if (ret == 0) {
+        ret = reduce_total(plan, max_total);
+    }
+    if (ret < 0) {
+        return ret;
+    }
+
+    // Drop filters made redundant by a wider merged one
+    for (int i = 0; i < plan->num_filters; i++) {
+        for (int j = 0; j < plan->num_filters; j++) {
+            if (i != j && pattern_covers(&plan->filters[j], &plan->filters[i])) {
+                plan->filters[i--] = plan->filters[--plan->num_filters];
+                break;
+            }
+        }
+    }
+
+    for (int i = 0; i < plan->num_filters; i++) {
+        plan->leaked_ids += pattern_leak(plan, &plan->filters[i]);
+    }
+
+    return 0;
+}
+
+int can_filter_plan_install(const struct device *dev, struct can_filter_plan *plan,
+                            const struct can_filter *wanted, size_t num_wanted,
+                            can_rx_callback_t callback, void *user_data) {
+    int max_std = can_get_max_filters(dev, false);
+    int max_ext = can_get_max_filters(dev, true);
+    int ret;
+
+    if (max_std < 0 || max_ext < 0) {
+        return -EIO;
+    }
+
+    // The driver API does not tell whether both counts come from one bank,
+    // plan for the worst case where they do
+    ret = can_filter_plan_build(plan, wanted, num_wanted, max_std, max_ext,
+                                MAX(max_std, max_ext));
+    if (ret < 0) {
+        return ret;
+    }
+
+    for (int i = 0; i < plan->num_filters; i++) {
+        ret = can_add_rx_filter(dev, callback, user_data, &plan->filters[i]);
+        if (ret < 0) {
+            // Leave the controller as it was, not with part of the plan
+            while (--i >= 0) {
+                can_remove_rx_filter(dev, plan->filter_ids[i]);
+            }
+            return ret;
+        }
+        plan->filter_ids[i] = ret;
+    }
+
+    return 0;
+}
+
+bool can_filter_plan_check(struct can_filter_plan *plan, const struct can_frame *frame) {
+    bool ext = (frame->flags & CAN_FRAME_IDE) != 0;
+
+    plan->accepted_frames++;
+
+    for (int i = 0; i < plan->num_wanted; i++) {
+        const struct can_filter *w = &plan->wanted[i];
+
+        if (is_ext(w) == ext && ((frame->id ^ w->id) & w->mask) == 0) {
+            return true;
+        }
+    }
+
+    plan->leaked_frames++;
+    return false;
+}
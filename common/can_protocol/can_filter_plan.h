@@ -0,0 +1,36 @@
+#ifndef CAN_FILTER_PLAN_H
+#define CAN_FILTER_PLAN_H
+
+#include <zephyr/drivers/can.h>
+
+#define CAN_FILTER_PLAN_MAX 32
+
+// A set of wanted id/mask patterns folded into as few hardware filters
+// as the controller's filter bank allows.
+struct can_filter_plan {
+    struct can_filter wanted[CAN_FILTER_PLAN_MAX];
+    uint8_t num_wanted;
+    struct can_filter filters[CAN_FILTER_PLAN_MAX];
+    uint8_t num_filters;
+    int filter_ids[CAN_FILTER_PLAN_MAX];  // Returned by can_add_rx_filter() on install
+    uint64_t leaked_ids;      // IDs accepted by the filters but not wanted
+    uint32_t accepted_frames;
+    uint32_t leaked_frames;   // Frames that passed the filters but were not wanted
+};
+
+// Merge wanted patterns until they fit max_std standard and max_ext extended
+// filters, and max_total filters of both types together
+int can_filter_plan_build(struct can_filter_plan *plan,
+                          const struct can_filter *wanted, size_t num_wanted,
+                          size_t max_std, size_t max_ext, size_t max_total);
+
+// Query the controller's filter bank and install the plan. On error no
+// filter of the plan is left installed.
+int can_filter_plan_install(const struct device *dev, struct can_filter_plan *plan,
+                            const struct can_filter *wanted, size_t num_wanted,
+                            can_rx_callback_t callback, void *user_data);
+
+// Account a received frame, returns false if it leaked through the filters
+bool can_filter_plan_check(struct can_filter_plan *plan, const struct can_frame *frame);
+
+#endif /* CAN_FILTER_PLAN_H */
@@ -10,13 +10,39 @@
 #define CAN_ID_TPMS        0x56
 #define CAN_ID_SPEED       0x57
 
-// Message lengths
-#define TEMP_MSG_LEN      4
+// VCU time sync for sample timestamps, see can_time_sync.h
+#define CAN_ID_TIME_SYNC   0x50
+
+// ISO-TP diagnostic IDs
+#define CAN_ID_DIAG_FUNCTIONAL  0x7DF
+#define CAN_ID_DIAG_VCU_REQ     0x7E0
+#define CAN_ID_DIAG_VCU_RESP    0x7E8
+
+// Sensor node n (0-6) is addressed like an OBD ECU: request 0x7E1 + n,
+// response 0x7E9 + n
+#define CAN_DIAG_MAX_NODES           7
+#define CAN_ID_DIAG_NODE_REQ(n)      (CAN_ID_DIAG_VCU_REQ + 1 + (n))
+#define CAN_ID_DIAG_NODE_RESP(n)     (CAN_ID_DIAG_VCU_RESP + 1 + (n))
+#define CAN_ID_DIAG_RESP_MASK        0x7F8
+
+// Message lengths, signal layouts are defined in signals.sdb
+#define TEMP_MSG_LEN      2
 #define GPS_MSG_LEN       8
 #define COLLISION_MSG_LEN 2
-#define BATTERY_MSG_LEN   4
+#define BATTERY_MSG_LEN   2
 #define BRAKE_MSG_LEN     2
 #define TPMS_MSG_LEN      1
 #define SPEED_MSG_LEN     2
 
+// Sensor message list: X(name, id, len). Consumers expand this to build
+// per-ID tables, so a new node only needs an entry here.
+#define CAN_SENSOR_MSG_LIST(X) \
+    X(TEMP,      CAN_ID_TEMP,      TEMP_MSG_LEN)      \
+    X(GPS,       CAN_ID_GPS,       GPS_MSG_LEN)       \
+    X(COLLISION, CAN_ID_COLLISION, COLLISION_MSG_LEN) \
+    X(BATTERY,   CAN_ID_BATTERY,   BATTERY_MSG_LEN)   \
+    X(BRAKE,     CAN_ID_BRAKE,     BRAKE_MSG_LEN)     \
+    X(TPMS,      CAN_ID_TPMS,      TPMS_MSG_LEN)      \
+    X(SPEED,     CAN_ID_SPEED,     SPEED_MSG_LEN)
+
 #endif /* CAN_IDS_H */
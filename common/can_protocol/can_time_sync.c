@@ -0,0 +1,118 @@
+#include <zephyr/kernel.h>
+#include <string.h>
+#include "can_time_sync.h"
+#include "can_ids.h"
+
+// Master side
+static const struct device *master_dev;
+static struct can_frame sync_frame;
+static uint8_t sync_seq;
+static atomic_t last_tx_seq = ATOMIC_INIT(-1);
+static atomic_t last_tx_us;
+
+// Client side, written from the CAN RX callback
+static atomic_t clock_offset_us;
+static atomic_t last_sync_ms;
+static atomic_t synced;
+static uint8_t pending_seq;
+static uint32_t pending_rx_us;
+static bool pending_valid;
+
+static void sync_work_handler(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(sync_work, sync_work_handler);
+
+uint32_t can_time_local_us(void) {
+    // 64-bit cycle counter so the microsecond value wraps cleanly at 2^32
+    return (uint32_t)k_cyc_to_us_floor64(k_cycle_get_64());
+}
+
+uint32_t can_time_sync_now_us(void) {
+    return can_time_local_us() + (uint32_t)atomic_get(&clock_offset_us);
+}
+
+bool can_time_sync_is_synced(void) {
+    if (master_dev != NULL) {
+        return true;
+    }
+    return atomic_get(&synced) &&
+           k_uptime_get_32() - (uint32_t)atomic_get(&last_sync_ms) < CAN_TIME_SYNC_TIMEOUT_MS;
+}
+
+static void sync_tx_done(const struct device *dev, int error, void *user_data) {
+    // Same instant the clients timestamp the frame: end of frame on the bus
+    if (error == 0) {
+        atomic_set(&last_tx_us, can_time_local_us());
+        atomic_set(&last_tx_seq, (atomic_val_t)(uintptr_t)user_data);
+    }
+}
+
+static void sync_work_handler(struct k_work *work) {
+    atomic_val_t ref_seq = atomic_get(&last_tx_seq);
+
+    sync_seq++;
+    sync_frame.data[0] = sync_seq;
+    // A reference equal to seq never matches, clients skip the follow-up
+    sync_frame.data[1] = ref_seq < 0 ? sync_seq : (uint8_t)ref_seq;
+    sys_put_le32((uint32_t)atomic_get(&last_tx_us), &sync_frame.data[2]);
+
+    can_send(master_dev, &sync_frame, K_NO_WAIT, sync_tx_done, (void *)(uintptr_t)sync_seq);
+
+    k_work_schedule(&sync_work, K_MSEC(CAN_TIME_SYNC_PERIOD_MS));
+}
+
+int can_time_sync_master_start(const struct device *dev) {
+    if (!device_is_ready(dev)) {
+        return -ENODEV;
+    }
+
+    master_dev = dev;
+    memset(&sync_frame, 0, sizeof(sync_frame));
+    sync_frame.id = CAN_ID_TIME_SYNC;
+    sync_frame.dlc = CAN_TIME_SYNC_LEN;
+
+    k_work_schedule(&sync_work, K_NO_WAIT);
+    return 0;
+}
+
+void can_time_sync_client_rx(const struct can_frame *frame, uint32_t rx_local_us) {
+    uint8_t seq, ref_seq;
+
+    if (frame->dlc < CAN_TIME_SYNC_LEN) {
+        return;
+    }
+
+    seq = frame->data[0];
+    ref_seq = frame->data[1];
+
+    if (pending_valid && ref_seq == pending_seq) {
+        uint32_t ref_tx_us = sys_get_le32(&frame->data[2]);
+
+        atomic_set(&clock_offset_us, (atomic_val_t)(ref_tx_us - pending_rx_us));
+        atomic_set(&last_sync_ms, k_uptime_get_32());
+        atomic_set(&synced, 1);
+    }
+
+    pending_seq = seq;
+    pending_rx_us = rx_local_us;
+    pending_valid = true;
+}
+
+static void sync_rx_cb(const struct device *dev, struct can_frame *frame, void *user_data) {
+    can_time_sync_client_rx(frame, can_time_local_us());
+}
+
+int can_time_sync_client_init(const struct device *dev) {
+    const struct can_filter filter = {
+        .id = CAN_ID_TIME_SYNC,
+        .mask = CAN_STD_ID_MASK,
+        .flags = CAN_FILTER_DATA,
+    };
+    int ret;
+
+    if (!device_is_ready(dev)) {
+        return -ENODEV;
+    }
+
+    ret = can_add_rx_filter(dev, sync_rx_cb, NULL, &filter);
+    return ret < 0 ? ret : 0;
+}
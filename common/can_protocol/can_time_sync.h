@@ -0,0 +1,57 @@
+#ifndef CAN_TIME_SYNC_H
+#define CAN_TIME_SYNC_H
+
+#include <zephyr/kernel.h>
+#include <zephyr/drivers/can.h>
+#include <zephyr/sys/byteorder.h>
+
+// Time sync frame from the VCU: [seq, ref_seq, ref_tx_us (LE32)].
+// ref_tx_us is the master clock when frame ref_seq left the controller,
+// so each frame carries the follow-up for the previous one.
+#define CAN_TIME_SYNC_LEN           6
+#define CAN_TIME_SYNC_PERIOD_MS     1000
+#define CAN_TIME_SYNC_TIMEOUT_MS    (3 * CAN_TIME_SYNC_PERIOD_MS)
+
+// Optional sample timestamp appended after the signal payload, master
+// clock in microseconds (LE32)
+#define CAN_SAMPLE_TS_LEN           4
+
+// Local microsecond clock, wraps every ~71 minutes
+uint32_t can_time_local_us(void);
+
+// Master clock estimate, the local clock on the master
+uint32_t can_time_sync_now_us(void);
+
+// True while a recent offset from the master is available
+bool can_time_sync_is_synced(void);
+
+// VCU: send a sync frame every CAN_TIME_SYNC_PERIOD_MS
+int can_time_sync_master_start(const struct device *dev);
+
+// Nodes: install an RX filter for sync frames and track the master offset
+int can_time_sync_client_init(const struct device *dev);
+
+// Feed a received sync frame, rx_local_us is the local RX time
+void can_time_sync_client_rx(const struct can_frame *frame, uint32_t rx_local_us);
+
+// Append a sample timestamp if it fits, returns the new payload length
+static inline uint8_t can_sample_ts_append(uint8_t *data, uint8_t len, uint8_t max_len,
+                                           uint32_t sample_us) {
+    if (len + CAN_SAMPLE_TS_LEN > max_len) {
+        return len;
+    }
+    sys_put_le32(sample_us, &data[len]);
+    return len + CAN_SAMPLE_TS_LEN;
+}
+
+// Sample timestamp following a payload of payload_len bytes, if present
+static inline bool can_sample_ts_get(const uint8_t *data, uint8_t len, uint8_t payload_len,
+                                     uint32_t *sample_us) {
+    if (len < payload_len + CAN_SAMPLE_TS_LEN) {
+        return false;
+    }
+    *sample_us = sys_get_le32(&data[payload_len]);
+    return true;
+}
+
+#endif /* CAN_TIME_SYNC_H */
@@ -0,0 +1,266 @@
+#!/usr/bin/env python3
+"""Generate signal_codec.h from the signal database (signals.sdb).
+
+Every message gets a raw struct, straight-line pack/unpack functions built
+from shifts and masks only, per-signal scaling constants and conversion
+helpers, and a decode function returning physical values for the VCU.
+
+Usage: gen_signal_codec.py <signals.sdb> <signal_codec.h>
+"""
+
+import re
+import sys
+
+BO_RE = re.compile(r'^BO_\s+(\w+)\s+(\w+)\s*:\s*(\d+)\s+(\w+)$')
+SG_RE = re.compile(r'^SG_\s+(\w+)\s*:\s*(\d+)\|(\d+)@([01])([+-])\s+'
+                   r'\(([^,]+),([^)]+)\)\s+\[([^|]+)\|([^\]]+)\]\s+"([^"]*)"\s+(\w+)$')
+
+
+class Signal:
+    def __init__(self, m):
+        self.name = m.group(1)
+        self.start = int(m.group(2))
+        self.bits = int(m.group(3))
+        self.big_endian = m.group(4) == '0'
+        self.signed = m.group(5) == '-'
+        self.factor = float(m.group(6))
+        self.offset = float(m.group(7))
+        self.min = float(m.group(8))
+        self.max = float(m.group(9))
+        self.unit = m.group(10)
+        self.receiver = m.group(11)
+
+    @property
+    def ctype(self):
+        width = 8 if self.bits <= 8 else 16 if self.bits <= 16 else 32
+        return '%sint%d_t' % ('' if self.signed else 'u', width)
+
+    @property
+    def type_bits(self):
+        return int(re.search(r'\d+', self.ctype).group())
+
+    def positions(self):
+        """(byte, bit in byte, raw bit index) for every bit of the signal."""
+        pos = self.start
+        out = []
+        for k in range(self.bits):
+            if self.big_endian:
+                out.append((pos // 8, pos % 8, self.bits - 1 - k))
+                pos = (pos // 8 + 1) * 8 + 7 if pos % 8 == 0 else pos - 1
+            else:
+                out.append((pos // 8, pos % 8, k))
+                pos += 1
+        return out
+
+    def chunks(self):
+        """Contiguous pieces per byte: byte -> (low bit in byte, raw bit of it, width)."""
+        chunks = {}
+        for byte, bit, raw in self.positions():
+            lo, raw_lo, width = chunks.get(byte, (bit, raw, 0))
+            if bit < lo:
+                lo, raw_lo = bit, raw
+            chunks[byte] = (lo, raw_lo, width + 1)
+        return chunks
+
+
+class Message:
+    def __init__(self, m):
+        self.id = int(m.group(1), 0)
+        self.name = m.group(2)
+        self.length = int(m.group(3))
+        self.sender = m.group(4)
+        self.signals = []
+
+    @property
+    def lname(self):
+        return self.name.lower()
+
+
+def fail(path, lineno, msg):
+    sys.exit('%s:%d: %s' % (path, lineno, msg))
+
+
+def parse(path):
+    messages = []
+    with open(path) as f:
+        for lineno, line in enumerate(f, 1):
+            line = line.strip()
+            if not line or line.startswith('#'):
+                continue
+            m = BO_RE.match(line)
+            if m:
+                messages.append(Message(m))
+                continue
+            m = SG_RE.match(line)
+            if not m:
+                fail(path, lineno, 'syntax error')
+            if not messages:
+                fail(path, lineno, 'SG_ outside of a BO_')
+            sig = Signal(m)
+            if not 1 <= sig.bits <= 32:
+                fail(path, lineno, '%s: 1..32 bits supported' % sig.name)
+            msg = messages[-1]
+            used = set()
+            for other in msg.signals:
+                used.update((b, i) for b, i, _ in other.positions())
+            for byte, bit, _ in sig.positions():
+                if byte >= msg.length:
+                    fail(path, lineno, '%s does not fit %d bytes' % (sig.name, msg.length))
+                if (byte, bit) in used:
+                    fail(path, lineno, '%s overlaps another signal' % sig.name)
+            msg.signals.append(sig)
+    return messages
+
+
+def mask(width):
+    return '0x%X' % ((1 << width) - 1)
+
+
+def paren(expr):
+    """Parenthesize expr unless it already is a single bracketed term."""
+    depth = 0
+    for i, c in enumerate(expr):
+        depth += {'(': 1, ')': -1}.get(c, 0)
+        if depth == 0 and i < len(expr) - 1:
+            return '(%s)' % expr
+    return expr
+
+
+def c_float(value):
+    text = repr(float(value))
+    return text + 'f'
+
+
+def pack_byte(byte, msg):
+    terms = []
+    for sig in msg.signals:
+        chunk = sig.chunks().get(byte)
+        if chunk is None:
+            continue
+        lo, raw_lo, width = chunk
+        term = '(uint32_t)msg->%s' % sig.name
+        if raw_lo:
+            term = '(%s >> %d)' % (term, raw_lo)
+        if width < 8:
+            term = '(%s & %s)' % (term, mask(width))
+        if lo:
+            term = '(%s << %d)' % (term, lo)
+        terms.append(term)
+    if not terms:
+        return '0'
+    return '(uint8_t)%s' % paren(' | '.join(terms))
+
+
+def unpack_expr(sig):
+    terms = []
+    for byte, (lo, raw_lo, width) in sorted(sig.chunks().items()):
+        term = '(uint32_t)data[%d]' % byte
+        if lo:
+            term = '(%s >> %d)' % (term, lo)
+        if width < 8:
+            term = '(%s & %s)' % (term, mask(width))
+        if raw_lo:
+            term = '(%s << %d)' % (term, raw_lo)
+        terms.append(term)
+    expr = paren(' | '.join(terms))
+    if sig.signed and sig.bits != sig.type_bits:
+        shift = 32 - sig.bits
+        return '(%s)((int32_t)(%s << %d) >> %d)' % (sig.ctype, expr, shift, shift)
+    return '(%s)%s' % (sig.ctype, expr)
+
+
+def generate(messages, src):
+    out = []
+    w = out.append
+
+    w('/* Generated by gen_signal_codec.py from %s, do not edit */' % src)
+    w('#ifndef SIGNAL_CODEC_H')
+    w('#define SIGNAL_CODEC_H')
+    w('')
+    w('#include <stdint.h>')
+    w('#include <math.h>')
+    w('#include <zephyr/toolchain.h>')
+    w('#include "can_ids.h"')
+
+    for msg in messages:
+        up = 'SIG_' + msg.name
+        ln = 'sig_' + msg.lname
+        receivers = sorted({s.receiver for s in msg.signals})
+
+        w('')
+        w('// %s: 0x%03X, %d bytes, %s -> %s' %
+          (msg.name, msg.id, msg.length, msg.sender, ', '.join(receivers)))
+        w('#define %s_ID 0x%03X' % (up, msg.id))
+        w('#define %s_LEN %d' % (up, msg.length))
+        w('#define %s_NUM_SIGNALS %d' % (up, len(msg.signals)))
+        for sig in msg.signals:
+            su = '%s_%s' % (up, sig.name.upper())
+            w('#define %s_FACTOR %s' % (su, c_float(sig.factor)))
+            w('#define %s_OFFSET %s' % (su, c_float(sig.offset)))
+            w('#define %s_MIN %s' % (su, c_float(sig.min)))
+            w('#define %s_MAX %s' % (su, c_float(sig.max)))
+        w('')
+        w('BUILD_ASSERT(%s_ID == CAN_ID_%s, "signals.sdb: %s ID differs from can_ids.h");' %
+          (up, msg.name, msg.name))
+        w('BUILD_ASSERT(%s_LEN == %s_MSG_LEN, "signals.sdb: %s length differs from can_ids.h");' %
+          (up, msg.name, msg.name))
+
+        w('')
+        w('struct %s {' % ln)
+        for sig in msg.signals:
+            w('    %s %s;   // %g %s' % (sig.ctype, sig.name, sig.factor, sig.unit))
+        w('};')
+
+        w('')
+        w('static inline void %s_pack(uint8_t *data, const struct %s *msg) {' % (ln, ln))
+        for byte in range(msg.length):
+            w('    data[%d] = %s;' % (byte, pack_byte(byte, msg)))
+        w('}')
+
+        w('')
+        w('static inline void %s_unpack(const uint8_t *data, struct %s *msg) {' % (ln, ln))
+        for sig in msg.signals:
+            w('    msg->%s = %s;' % (sig.name, unpack_expr(sig)))
+        w('}')
+
+        for sig in msg.signals:
+            su = '%s_%s' % (up, sig.name.upper())
+            sl = '%s_%s' % (ln, sig.name)
+            w('')
+            w('static inline float %s_to_phys(%s raw) {' % (sl, sig.ctype))
+            w('    return (float)raw * %s_FACTOR + %s_OFFSET;' % (su, su))
+            w('}')
+            w('')
+            w('static inline %s %s_from_phys(float phys) {' % (sig.ctype, sl))
+            w('    phys = fminf(fmaxf(phys, %s_MIN), %s_MAX);' % (su, su))
+            w('    return (%s)lroundf((phys - %s_OFFSET) / %s_FACTOR);' % (sig.ctype, su, su))
+            w('}')
+
+        w('')
+        w('// Physical values in signal order, returns the number of values')
+        w('static inline uint8_t %s_decode(const uint8_t *data, float *values) {' % ln)
+        w('    struct %s msg;' % ln)
+        w('')
+        w('    %s_unpack(data, &msg);' % ln)
+        for i, sig in enumerate(msg.signals):
+            w('    values[%d] = %s_%s_to_phys(msg.%s);' % (i, ln, sig.name, sig.name))
+        w('    return %s_NUM_SIGNALS;' % up)
+        w('}')
+        w('#define %s_DECODE %s_decode' % (up, ln))
+
+    w('')
+    w('#endif /* SIGNAL_CODEC_H */')
+    return '\n'.join(out) + '\n'
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit(__doc__)
+    src, dst = sys.argv[1], sys.argv[2]
+    header = generate(parse(src), src.replace('\\', '/').split('/')[-1])
+    with open(dst, 'w') as f:
+        f.write(header)
+
+
+if __name__ == '__main__':
+    main()
@@ -1,170 +1,681 @@
+#include <zephyr/kernel.h>
+#include <zephyr/sys/byteorder.h>
+#include <string.h>
 #include "isotp.h"
 
 #define ISO_TP_TIMEOUT_MS 1000
-#define ISO_TP_BLOCK_SIZE 8
-#define ISO_TP_STM 10
 
-struct isotp_tx_ctx {
-    uint8_t seq_id;
-    const uint8_t *data;
-    size_t remaining;
-    size_t total_len;
-};
+#define ISOTP_SF_MAX_LEN  7     // Single frame in a frame of up to 8 bytes
+#define ISOTP_FF_HDR_LEN  2
+#define ISOTP_FF_ESC_LEN  6     // 0x10 0x00 and a 32-bit FF_DL
+
+// Frames longer than 8 bytes carry the length in an escape byte
+#define ISOTP_SF_ESC_MAX_LEN(dl) ((dl) - 2)
+
+// No flow control to send for the frame just received
+#define ISOTP_FC_NONE     0xFF
+
+// Sessions are driven by frame arrival, CAN TX confirmations and one
+// delayable work item per direction for timeouts and separation time.
+// Nothing blocks; user callbacks and can_send() run without the context
+// lock held.
+
+static void isotp_ignore_tx_done(const struct device *dev, int error, void *user_data) {
+}
+
+// Set the DLC for len bytes of payload. CAN FD lengths above 8 come in
+// steps, the gap is padded.
+static void isotp_frame_len(const struct isotp_ctx *ctx, struct can_frame *frame, uint8_t len) {
+    uint8_t dlc = can_bytes_to_dlc(len);
+
+    memset(&frame->data[len], ISOTP_PAD_BYTE, can_dlc_to_bytes(dlc) - len);
+    frame->dlc = dlc;
+    if (ctx->tx_dl > ISOTP_CLASSIC_DL) {
+        frame->flags |= CAN_FRAME_FDF | CAN_FRAME_BRS;
+    }
+}
+
+static int isotp_send_fc(struct isotp_ctx *ctx, uint8_t status, uint8_t bs, uint8_t stmin) {
+    struct can_frame fc = {
+        .id = ctx->tx_id,
+        .data = {ISOTP_PCI(ISOTP_FLOW_CONTROL) | status, bs, stmin}
+    };
+
+    isotp_frame_len(ctx, &fc, 3);
+    return can_send(ctx->can_dev, &fc, K_NO_WAIT, isotp_ignore_tx_done, NULL);
+}
+
+/* Receiver */
+
+// Caller holds ctx->lock
+static void rx_release_frags(struct isotp_ctx *ctx) {
+    if (ctx->rx.frags != NULL) {
+        net_buf_unref(ctx->rx.frags);
+        ctx->rx.frags = NULL;
+        ctx->rx.frag_tail = NULL;
+    }
+}
+
+// Caller holds ctx->lock. Prepares an empty buffer for a new message.
+static int rx_acquire_buf(struct isotp_ctx *ctx) {
+    ctx->rx.received = 0;
+    if (ctx->frag_pool != NULL) {
+        // Fragments are taken as the data arrives
+        rx_release_frags(ctx);
+        return 0;
+    }
+    if (ctx->buf_pool == NULL || ctx->buf != NULL) {
+        return 0;
+    }
+    return k_mem_slab_alloc(ctx->buf_pool, (void **)&ctx->buf, K_NO_WAIT);
+}
+
+// Caller holds ctx->lock
+static void rx_reset(struct isotp_ctx *ctx) {
+    ctx->rx.state = ISOTP_RX_IDLE;
+    rx_release_frags(ctx);
+    if (ctx->buf_pool != NULL && ctx->buf != NULL) {
+        k_mem_slab_free(ctx->buf_pool, ctx->buf);
+        ctx->buf = NULL;
+    }
+}
+
+// Caller holds ctx->lock. Appends to the message, -ENOMEM when the
+// fragment pool is empty.
+static int rx_store(struct isotp_ctx *ctx, const uint8_t *data, size_t len) {
+    if (ctx->frag_pool == NULL) {
+        memcpy(&ctx->buf[ctx->rx.received], data, len);
+        ctx->rx.received += len;
+        return 0;
+    }
+
+    while (len > 0) {
+        struct net_buf *tail = ctx->rx.frag_tail;
+        size_t n;
+
+        if (tail == NULL || net_buf_tailroom(tail) == 0) {
+            struct net_buf *frag = net_buf_alloc(ctx->frag_pool, K_NO_WAIT);
+
+            if (frag == NULL) {
+                return -ENOMEM;
+            }
+            if (tail == NULL) {
+                ctx->rx.frags = frag;
+            } else {
+                net_buf_frag_insert(tail, frag);
+            }
+            ctx->rx.frag_tail = frag;
+            tail = frag;
+        }
+
+        n = MIN(len, net_buf_tailroom(tail));
+        net_buf_add_mem(tail, data, n);
+        ctx->rx.received += n;
+        data += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static void rx_finish(struct isotp_ctx *ctx, int result) {
+    k_spinlock_key_t key;
+
+    k_work_cancel_delayable(&ctx->rx.timer);
+
+    if (result < 0) {
+        ctx->stats.rx_errors++;
+    } else {
+        ctx->stats.rx_done++;
+    }
+
+    if (ctx->rx_cb == NULL && ctx->rx_frags_cb == NULL) {
+        // Held until isotp_receive() picks it up
+        key = k_spin_lock(&ctx->lock);
+        ctx->rx.result = result;
+        if (result < 0) {
+            rx_reset(ctx);
+        } else {
+            ctx->rx.state = ISOTP_RX_DONE;
+        }
+        k_spin_unlock(&ctx->lock, key);
+        k_sem_give(&ctx->rx.done);
+        return;
+    }
+
+    if (ctx->frag_pool != NULL) {
+        ctx->rx_frags_cb(ctx, result < 0 ? NULL : ctx->rx.frags, result, ctx->rx_user_data);
+    } else {
+        ctx->rx_cb(ctx, ctx->buf, result, ctx->rx_user_data);
+    }
+
+    key = k_spin_lock(&ctx->lock);
+    rx_reset(ctx);
+    k_spin_unlock(&ctx->lock, key);
+}
+
+// Caller holds ctx->lock. Returns the message length when complete, 0 when
+// more frames follow or nothing changed, or a negative errno.
+static int rx_single(struct isotp_ctx *ctx, const uint8_t *data, uint8_t len) {
+    uint8_t sf_len = data[0] & 0x0F;
+    uint8_t offset = 1;
+
+    if (len > ISOTP_CLASSIC_DL) {
+        // SF_DL escape: 0x00 and the length in the second byte
+        if (sf_len != 0 || len < 2) {
+            return 0;
+        }
+        sf_len = data[1];
+        offset = 2;
+    }
+
+    if (sf_len == 0 || sf_len > len - offset) {
+        return 0;
+    }
+
+    if (sf_len > ctx->buf_size) {
+        ctx->stats.rx_overflow++;
+        return 0;
+    }
+
+    // A new message replaces one still being reassembled
+    if (rx_acquire_buf(ctx) != 0 || rx_store(ctx, &data[offset], sf_len) != 0) {
+        ctx->stats.rx_overflow++;
+        rx_reset(ctx);
+        return 0;
+    }
+
+    ctx->rx.state = ISOTP_RX_DONE;
+    return sf_len;
+}
+
+// Caller holds ctx->lock and sends the flow control set in fc once it is
+// released. Returns like rx_single().
+static int rx_first(struct isotp_ctx *ctx, const uint8_t *data, uint8_t len, uint8_t *fc) {
+    size_t total_len = ((data[0] & 0x0F) << 8) | data[1];
+    uint8_t offset = ISOTP_FF_HDR_LEN;
+
+    if (len < ISOTP_CLASSIC_DL || ctx->functional) {
+        return 0;
+    }
+
+    if (total_len == 0) {
+        // FF_DL escape for messages over 4095 bytes
+        total_len = sys_get_be32(&data[2]);
+        offset = ISOTP_FF_ESC_LEN;
+        if (total_len <= ISOTP_MAX_LEN) {
+            return 0;
+        }
+    } else if (total_len <= (len > ISOTP_CLASSIC_DL ? ISOTP_SF_ESC_MAX_LEN(len) :
+                                                      ISOTP_SF_MAX_LEN)) {
+        // Would have fit a single frame
+        return 0;
+    }
+
+    if (total_len > ctx->buf_size || rx_acquire_buf(ctx) != 0 ||
+        rx_store(ctx, &data[offset], len - offset) != 0) {
+        *fc = ISOTP_FC_OVFLW;
+        ctx->stats.rx_overflow++;
+        rx_reset(ctx);
+        return 0;
+    }
+
+    ctx->rx.total_len = total_len;
+    ctx->rx.dl = len;
+    ctx->rx.next_sn = 1;
+    ctx->rx.block_count = 0;
+    ctx->rx.state = ISOTP_RX_WAIT_CF;
+    *fc = ISOTP_FC_CTS;
+
+    k_work_reschedule(&ctx->rx.timer, K_MSEC(ISOTP_N_CR_MS));
+    return 0;
+}
+
+// Caller holds ctx->lock, as for rx_first()
+static int rx_consecutive(struct isotp_ctx *ctx, const uint8_t *data, uint8_t len,
+                          uint8_t *fc) {
+    size_t copy_len;
+
+    if (ctx->rx.state != ISOTP_RX_WAIT_CF) {
+        return 0;
+    }
+
+    if ((data[0] & 0x0F) != ctx->rx.next_sn) {
+        return -EILSEQ;
+    }
+
+    copy_len = MIN(MIN(ctx->rx.dl, len) - 1, ctx->rx.total_len - ctx->rx.received);
+    if (rx_store(ctx, &data[1], copy_len) != 0) {
+        // No flow control status for this mid-message, give up
+        ctx->stats.rx_overflow++;
+        return -ENOMEM;
+    }
+    ctx->rx.next_sn = (ctx->rx.next_sn + 1) & 0x0F;
+
+    if (ctx->rx.received == ctx->rx.total_len) {
+        ctx->rx.state = ISOTP_RX_DONE;
+        return ctx->rx.total_len;
+    }
+
+    if (ctx->rx_bs != 0 && ++ctx->rx.block_count == ctx->rx_bs) {
+        ctx->rx.block_count = 0;
+        *fc = ISOTP_FC_CTS;
+    }
+
+    k_work_reschedule(&ctx->rx.timer, K_MSEC(ISOTP_N_CR_MS));
+    return 0;
+}
+
+static void rx_timeout(struct k_work *work) {
+    struct k_work_delayable *dwork = k_work_delayable_from_work(work);
+    struct isotp_ctx *ctx = CONTAINER_OF(dwork, struct isotp_ctx, rx.timer);
+    k_spinlock_key_t key = k_spin_lock(&ctx->lock);
+    bool expired = ctx->rx.state == ISOTP_RX_WAIT_CF;
+
+    if (expired) {
+        // Keep other frames out while the callback sees the error
+        ctx->rx.state = ISOTP_RX_DONE;
+    }
+    k_spin_unlock(&ctx->lock, key);
+
+    if (expired) {
+        rx_finish(ctx, -ETIMEDOUT);
+    }
+}
+
+/* Sender */
+
+static void tx_finish(struct isotp_ctx *ctx, int result) {
+    isotp_tx_cb_t cb = ctx->tx.cb;
+    void *user_data = ctx->tx.user_data;
+    k_spinlock_key_t key;
+
+    k_work_cancel_delayable(&ctx->tx.timer);
+
+    key = k_spin_lock(&ctx->lock);
+    ctx->tx.state = ISOTP_TX_IDLE;
+    if (result < 0) {
+        ctx->stats.tx_errors++;
+    } else {
+        ctx->stats.tx_done++;
+    }
+    k_spin_unlock(&ctx->lock, key);
+
+    if (cb) {
+        cb(ctx, result, user_data);
+    }
+}
+
+static void tx_send_consecutive(struct isotp_ctx *ctx);
+
+static void tx_done(const struct device *dev, int error, void *user_data) {
+    struct isotp_ctx *ctx = user_data;
+    k_spinlock_key_t key = k_spin_lock(&ctx->lock);
+    bool finished = false;
+    bool send_now = false;
+
+    if (ctx->tx.state != ISOTP_TX_SENDING) {
+        k_spin_unlock(&ctx->lock, key);
+        return;
+    }
+
+    if (error != 0 || ctx->tx.sent == ctx->tx.len) {
+        finished = true;
+    } else if (ctx->tx.wait_fc) {
+        ctx->tx.state = ISOTP_TX_WAIT_FC;
+        k_work_reschedule(&ctx->tx.timer, K_MSEC(ISOTP_N_BS_MS));
+    } else if (ctx->tx.stmin_us == 0) {
+        send_now = true;
+    } else {
+        ctx->tx.state = ISOTP_TX_WAIT_STMIN;
+        k_work_reschedule(&ctx->tx.timer, K_USEC(ctx->tx.stmin_us));
+    }
+    k_spin_unlock(&ctx->lock, key);
+
+    if (finished) {
+        tx_finish(ctx, error);
+    } else if (send_now) {
+        tx_send_consecutive(ctx);
+    }
+}
+
+static void tx_flow_control(struct isotp_ctx *ctx, const uint8_t *data, uint8_t len) {
+    k_spinlock_key_t key = k_spin_lock(&ctx->lock);
+    int abort = 0;
+
+    if (ctx->tx.state == ISOTP_TX_IDLE || !ctx->tx.wait_fc || len < 3) {
+        k_spin_unlock(&ctx->lock, key);
+        return;
+    }
+
+    // The FC can overtake the confirmation of the frame that requested it,
+    // then tx_done() picks up the new state
+    switch (data[0] & 0x0F) {
+        case ISOTP_FC_CTS:
+            ctx->tx.wait_fc = false;
+            ctx->tx.wft_count = 0;
+            ctx->tx.bs = data[1];
+            ctx->tx.block_count = 0;
+            ctx->tx.stmin_us = isotp_stmin_to_us(data[2]);
+            if (ctx->tx.state == ISOTP_TX_WAIT_FC) {
+                ctx->tx.state = ISOTP_TX_WAIT_STMIN;
+                k_work_reschedule(&ctx->tx.timer, K_NO_WAIT);
+            }
+            break;
+        case ISOTP_FC_WAIT:
+            if (++ctx->tx.wft_count > ISOTP_N_WFT_MAX) {
+                abort = -ECONNABORTED;
+            } else if (ctx->tx.state == ISOTP_TX_WAIT_FC) {
+                k_work_reschedule(&ctx->tx.timer, K_MSEC(ISOTP_N_BS_MS));
+            }
+            break;
+        case ISOTP_FC_OVFLW:
+            abort = -EMSGSIZE;
+            break;
+        default:
+            abort = -EBADMSG;
+            break;
+    }
+
+    if (abort) {
+        // Late confirmations of the aborted transfer are ignored
+        ctx->tx.state = ISOTP_TX_IDLE;
+    }
+    k_spin_unlock(&ctx->lock, key);
+
+    if (abort) {
+        tx_finish(ctx, abort);
+    }
+}
+
+static void tx_send_consecutive(struct isotp_ctx *ctx) {
+    struct can_frame frame = {
+        .id = ctx->tx_id,
+    };
+    k_spinlock_key_t key = k_spin_lock(&ctx->lock);
+    size_t len = MIN((size_t)ctx->tx_dl - 1, ctx->tx.len - ctx->tx.sent);
+    int ret;
+
+    frame.data[0] = ISOTP_PCI(ISOTP_CONSECUTIVE) | ctx->tx.next_sn;
+    memcpy(&frame.data[1], &ctx->tx.data[ctx->tx.sent], len);
+    isotp_frame_len(ctx, &frame, len + 1);
+
+    ctx->tx.sent += len;
+    ctx->tx.next_sn = (ctx->tx.next_sn + 1) & 0x0F;
+    if (ctx->tx.bs != 0 && ++ctx->tx.block_count == ctx->tx.bs) {
+        // Block complete, the receiver sends the next FC
+        ctx->tx.block_count = 0;
+        ctx->tx.wait_fc = true;
+    }
+    ctx->tx.state = ISOTP_TX_SENDING;
+    k_work_reschedule(&ctx->tx.timer, K_MSEC(ISOTP_N_AS_MS));
+    k_spin_unlock(&ctx->lock, key);
+
+    ret = can_send(ctx->can_dev, &frame, K_NO_WAIT, tx_done, ctx);
+    if (ret == -EAGAIN) {
+        // TX mailboxes full, retry on the next tick
+        key = k_spin_lock(&ctx->lock);
+        ctx->tx.sent -= len;
+        ctx->tx.next_sn = (ctx->tx.next_sn - 1) & 0x0F;
+        if (ctx->tx.wait_fc) {
+            ctx->tx.wait_fc = false;
+            ctx->tx.block_count = ctx->tx.bs - 1;
+        } else if (ctx->tx.bs != 0) {
+            ctx->tx.block_count--;
+        }
+        ctx->tx.state = ISOTP_TX_WAIT_STMIN;
+        k_work_reschedule(&ctx->tx.timer, K_TICKS(1));
+        k_spin_unlock(&ctx->lock, key);
+    } else if (ret != 0) {
+        tx_finish(ctx, ret);
+    }
+}
+
+static void tx_timer(struct k_work *work) {
+    struct k_work_delayable *dwork = k_work_delayable_from_work(work);
+    struct isotp_ctx *ctx = CONTAINER_OF(dwork, struct isotp_ctx, tx.timer);
+    k_spinlock_key_t key = k_spin_lock(&ctx->lock);
+    enum isotp_tx_state state = ctx->tx.state;
+
+    k_spin_unlock(&ctx->lock, key);
+
+    switch (state) {
+        case ISOTP_TX_WAIT_STMIN:
+            tx_send_consecutive(ctx);
+            break;
+        case ISOTP_TX_SENDING:      // N_As
+        case ISOTP_TX_WAIT_FC:      // N_Bs
+            tx_finish(ctx, -ETIMEDOUT);
+            break;
+        default:
+            break;
+    }
+}
+
+/* Public API */
+
+static void isotp_can_rx(const struct device *dev, struct can_frame *frame, void *user_data) {
+    isotp_process_frame(user_data, frame);
+}
 
 int isotp_init(struct isotp_ctx *ctx) {
+    struct can_filter filter = {
+        .id = ctx->rx_id,
+        .mask = CAN_STD_ID_MASK,
+#ifdef CONFIG_CAN_FD_MODE
+        // The peer may send FD frames whatever our own tx_dl is
+        .flags = CAN_FILTER_DATA | CAN_FILTER_FDF
+#else
+        .flags = CAN_FILTER_DATA
+#endif
+    };
+
     if (!device_is_ready(ctx->can_dev)) {
         return -ENODEV;
     }
+
+    if (ctx->tx_dl == 0) {
+        ctx->tx_dl = ISOTP_CLASSIC_DL;
+    }
+    if (ctx->tx_dl < ISOTP_CLASSIC_DL || ctx->tx_dl > CAN_MAX_DLEN ||
+        can_dlc_to_bytes(can_bytes_to_dlc(ctx->tx_dl)) != ctx->tx_dl) {
+        return -EINVAL;
+    }
+
+    ctx->rx.state = ISOTP_RX_IDLE;
+    ctx->tx.state = ISOTP_TX_IDLE;
+    k_work_init_delayable(&ctx->rx.timer, rx_timeout);
+    k_work_init_delayable(&ctx->tx.timer, tx_timer);
+    k_sem_init(&ctx->rx.done, 0, 1);
+    k_sem_init(&ctx->tx.done, 0, 1);
+
+    if (ctx->manual_rx) {
+        ctx->filter_id = -1;
+        return 0;
+    }
+
+    ctx->filter_id = can_add_rx_filter(ctx->can_dev, isotp_can_rx, ctx, &filter);
+    return ctx->filter_id < 0 ? ctx->filter_id : 0;
+}
+
+int isotp_process_frame(struct isotp_ctx *ctx, const struct can_frame *frame) {
+    uint8_t len = can_dlc_to_bytes(frame->dlc);
+    uint8_t fc = ISOTP_FC_NONE;
+    k_spinlock_key_t key;
+    int result = 0;
+
+    if (frame->id != ctx->rx_id || (frame->flags & CAN_FRAME_IDE) || len < 1) {
+        return -EINVAL;
+    }
+
+    if (ISOTP_PCI_TYPE(frame->data[0]) == ISOTP_FLOW_CONTROL) {
+        tx_flow_control(ctx, frame->data, len);
+        return 0;
+    }
+
+    key = k_spin_lock(&ctx->lock);
+
+    // The previous message has not been consumed yet
+    if (ctx->rx.state == ISOTP_RX_DONE) {
+        k_spin_unlock(&ctx->lock, key);
+        return 0;
+    }
+
+    switch (ISOTP_PCI_TYPE(frame->data[0])) {
+        case ISOTP_SINGLE_FRAME:
+            result = rx_single(ctx, frame->data, len);
+            break;
+        case ISOTP_FIRST_FRAME:
+            result = rx_first(ctx, frame->data, len, &fc);
+            break;
+        case ISOTP_CONSECUTIVE:
+            result = rx_consecutive(ctx, frame->data, len, &fc);
+            break;
+        default:
+            break;
+    }
+
+    if (result < 0) {
+        // Keep other frames out while the callback sees the error
+        ctx->rx.state = ISOTP_RX_DONE;
+    }
+    k_spin_unlock(&ctx->lock, key);
+
+    if (fc == ISOTP_FC_OVFLW) {
+        isotp_send_fc(ctx, ISOTP_FC_OVFLW, 0, 0);
+    } else if (fc == ISOTP_FC_CTS &&
+               isotp_send_fc(ctx, ISOTP_FC_CTS, ctx->rx_bs, ctx->rx_stmin) != 0) {
+        // The sender would wait for a flow control that never comes
+        key = k_spin_lock(&ctx->lock);
+        ctx->rx.state = ISOTP_RX_DONE;
+        k_spin_unlock(&ctx->lock, key);
+        result = -EIO;
+    }
+
+    if (result != 0) {
+        rx_finish(ctx, result);
+    }
     return 0;
 }
 
-static void isotp_send_consecutive(const struct device *dev, struct isotp_tx_ctx *tx_ctx, uint32_t tx_id) {
+int isotp_send_async(struct isotp_ctx *ctx, const uint8_t *data, size_t len,
+                     isotp_tx_cb_t cb, void *user_data) {
     struct can_frame frame = {
-        .id = tx_id,
-        .dlc = 8,
+        .id = ctx->tx_id,
     };
-    
-    frame.data[0] = ISOTP_CONSECUTIVE | tx_ctx->seq_id;
-    size_t len = MIN(7, tx_ctx->remaining);
-    memcpy(&frame.data[1], tx_ctx->data, len);
-    
-    can_send(dev, &frame, ISO_TP_TIMEOUT_MS, NULL, NULL);
-    tx_ctx->data += len;
-    tx_ctx->remaining -= len;
-    tx_ctx->seq_id = (tx_ctx->seq_id + 1) & 0x0F;
-}
+    size_t sf_max = ctx->tx_dl > ISOTP_CLASSIC_DL ? ISOTP_SF_ESC_MAX_LEN(ctx->tx_dl) :
+                                                    ISOTP_SF_MAX_LEN;
+    k_spinlock_key_t key;
+    int ret;
 
-int isotp_send(struct isotp_ctx *ctx, const uint8_t *data, size_t len) {
-    struct isotp_tx_ctx tx_ctx = {
-        .seq_id = 0,
-        .data = data,
-        .remaining = len,
-        .total_len = len
-    };
+    if (len == 0 || (uint64_t)len > UINT32_MAX) {
+        return -EINVAL;
+    }
+
+    // Functional addressing has no flow control to segment with
+    if (ctx->functional && len > sf_max) {
+        return -EMSGSIZE;
+    }
+
+    key = k_spin_lock(&ctx->lock);
+    if (ctx->tx.state != ISOTP_TX_IDLE) {
+        k_spin_unlock(&ctx->lock, key);
+        return -EBUSY;
+    }
 
-    if (len <= 7) {
-        // Single frame
-        struct can_frame frame = {
-            .id = ctx->tx_id,
-            .dlc = len + 1,
-            .data[0] = ISOTP_SINGLE_FRAME | len
-        };
+    ctx->tx.data = data;
+    ctx->tx.len = len;
+    ctx->tx.cb = cb;
+    ctx->tx.user_data = user_data;
+    ctx->tx.next_sn = 1;
+
+    if (len <= ISOTP_SF_MAX_LEN) {
+        frame.data[0] = ISOTP_PCI(ISOTP_SINGLE_FRAME) | len;
         memcpy(&frame.data[1], data, len);
-        return can_send(ctx->can_dev, &frame, ISO_TP_TIMEOUT_MS, NULL, NULL);
+        isotp_frame_len(ctx, &frame, len + 1);
+        ctx->tx.sent = len;
+        ctx->tx.wait_fc = false;
+    } else if (len <= sf_max) {
+        frame.data[0] = ISOTP_PCI(ISOTP_SINGLE_FRAME);
+        frame.data[1] = len;
+        memcpy(&frame.data[2], data, len);
+        isotp_frame_len(ctx, &frame, len + 2);
+        ctx->tx.sent = len;
+        ctx->tx.wait_fc = false;
     } else {
-        // Multi frame transmission
-        struct can_frame frame = {
-            .id = ctx->tx_id,
-            .dlc = 8,
-            .data[0] = ISOTP_FIRST_FRAME | ((len >> 8) & 0x0F),
-            .data[1] = len & 0xFF
-        };
-        memcpy(&frame.data[2], data, 6);
-        can_send(ctx->can_dev, &frame, ISO_TP_TIMEOUT_MS, NULL, NULL);
-        
-        tx_ctx.data += 6;
-        tx_ctx.remaining -= 6;
-        
-        while (tx_ctx.remaining > 0) {
-            isotp_send_consecutive(ctx->can_dev, &tx_ctx, ctx->tx_id);
-            k_sleep(K_MSEC(ISO_TP_STM));
+        uint8_t offset = ISOTP_FF_HDR_LEN;
+
+        frame.data[0] = ISOTP_PCI(ISOTP_FIRST_FRAME);
+        if (len <= ISOTP_MAX_LEN) {
+            frame.data[0] |= len >> 8;
+            frame.data[1] = len & 0xFF;
+        } else {
+            frame.data[1] = 0;
+            sys_put_be32(len, &frame.data[2]);
+            offset = ISOTP_FF_ESC_LEN;
         }
-        return 0;
+        memcpy(&frame.data[offset], data, ctx->tx_dl - offset);
+        isotp_frame_len(ctx, &frame, ctx->tx_dl);
+        ctx->tx.sent = ctx->tx_dl - offset;
+        ctx->tx.wait_fc = true;
+        ctx->tx.wft_count = 0;
+    }
+
+    ctx->tx.state = ISOTP_TX_SENDING;
+    k_work_reschedule(&ctx->tx.timer, K_MSEC(ISOTP_N_AS_MS));
+    k_spin_unlock(&ctx->lock, key);
+
+    ret = can_send(ctx->can_dev, &frame, K_NO_WAIT, tx_done, ctx);
+    if (ret != 0) {
+        k_work_cancel_delayable(&ctx->tx.timer);
+        key = k_spin_lock(&ctx->lock);
+        ctx->tx.state = ISOTP_TX_IDLE;
+        k_spin_unlock(&ctx->lock, key);
+    }
+    return ret;
+}
+
+static void isotp_blocking_tx_done(struct isotp_ctx *ctx, int result, void *user_data) {
+    ctx->tx.result = result;
+    k_sem_give(&ctx->tx.done);
+}
+
+int isotp_send(struct isotp_ctx *ctx, const uint8_t *data, size_t len) {
+    int ret;
+
+    k_sem_reset(&ctx->tx.done);
+    ret = isotp_send_async(ctx, data, len, isotp_blocking_tx_done, NULL);
+    if (ret != 0) {
+        return ret;
     }
+
+    k_sem_take(&ctx->tx.done, K_FOREVER);
+    return ctx->tx.result;
 }
 
 int isotp_receive(struct isotp_ctx *ctx, uint8_t *dest, size_t len) {
-    struct can_frame frame;
-    size_t remaining = len;
-    uint32_t start_time = k_uptime_get_32();
-    
-    // Receive first frame with timeout validation
-    if (can_receive(ctx->can_dev, &frame, K_MSEC(ISO_TP_TIMEOUT_MS)) != 0) {
-        return -ETIMEDOUT;
-    }
-    
-    if ((frame.id & ctx->rx_id) != ctx->rx_id) {
-        return -EINVAL;  // Invalid ID
-    }
-    
-    uint8_t frame_type = frame.data[0] & 0xF0;
-    if (frame_type == ISOTP_SINGLE_FRAME) {
-        size_t recv_len = frame.data[0] & 0x0F;
-        if (recv_len == 0 || recv_len > 7) {
-            return -EMSGSIZE;  // Invalid length
-        }
-        if (recv_len > len) {
-            return -ENOSPC;  // Buffer too small
-        }
-        memcpy(dest, &frame.data[1], recv_len);
-        return recv_len;
-    } 
-    
-    if (frame_type == ISOTP_FIRST_FRAME) {
-        size_t total_len = ((frame.data[0] & 0x0F) << 8) | frame.data[1];
-        if (total_len > len || total_len < 8) {
-            return -EMSGSIZE;  // Invalid length
-        }
-        
-        // Copy initial data
-        memcpy(dest, &frame.data[2], 6);
-        dest += 6;
-        remaining = total_len - 6;
-        
-        // Send flow control with validation
-        struct can_frame fc = {
-            .id = ctx->tx_id,
-            .dlc = 3,
-            .data = {ISOTP_FLOW_CONTROL, ISO_TP_BLOCK_SIZE, ISO_TP_STM}
-        };
-        
-        int ret = can_send(ctx->can_dev, &fc, K_MSEC(100), NULL, NULL);
-        if (ret != 0) {
-            return ret;  // Flow control send failed
+    k_spinlock_key_t key;
+    int ret;
+
+    // Wait for a message to start, then for as long as it keeps arriving
+    while (k_sem_take(&ctx->rx.done, K_MSEC(ISO_TP_TIMEOUT_MS)) != 0) {
+        if (ctx->rx.state != ISOTP_RX_WAIT_CF) {
+            return -ETIMEDOUT;
         }
-        
-        // Receive consecutive frames with sequence validation
-        uint8_t expected_seq = 1;
-        while (remaining > 0) {
-            // Check overall timeout
-            if (k_uptime_get_32() - start_time > ISO_TP_TIMEOUT_MS) {
-                return -ETIMEDOUT;
-            }
-            
-            if (can_receive(ctx->can_dev, &frame, K_MSEC(ISO_TP_TIMEOUT_MS)) != 0) {
-                return -ETIMEDOUT;
-            }
-            
-            if ((frame.data[0] & 0xF0) != ISOTP_CONSECUTIVE) {
-                return -EINVAL;  // Invalid frame type
-            }
-            
-            uint8_t seq = frame.data[0] & 0x0F;
-            if (seq != expected_seq) {
-                return -EINVAL;  // Sequence mismatch
-            }
-            
-            size_t copy_len = MIN(7, remaining);
-            memcpy(dest, &frame.data[1], copy_len);
-            dest += copy_len;
-            remaining -= copy_len;
-            
-            expected_seq = (expected_seq + 1) & 0x0F;
-            
-            // Optional: Add flow control for large transfers
-            if (ISO_TP_BLOCK_SIZE > 0 && 
-                (expected_seq % ISO_TP_BLOCK_SIZE) == 0 && 
-                remaining > 0) {
-                fc.data[1] = MIN(ISO_TP_BLOCK_SIZE, (remaining + 6) / 7);
-                ret = can_send(ctx->can_dev, &fc, K_MSEC(100), NULL, NULL);
-                if (ret != 0) {
-                    return ret;
-                }
-            }
+    }
+
+    key = k_spin_lock(&ctx->lock);
+    ret = ctx->rx.result;
+    if (ret > 0) {
+        if ((size_t)ret > len) {
+            ret = -ENOSPC;
+        } else if (ctx->frag_pool != NULL) {
+            net_buf_linearize(dest, len, ctx->rx.frags, 0, ret);
+        } else {
+            memcpy(dest, ctx->buf, ret);
         }
-        
-        return total_len;
+        rx_reset(ctx);
     }
-    
-    return -EINVAL;  // Unknown frame type
+    k_spin_unlock(&ctx->lock, key);
+
+    return ret;
 }
@@ -1,23 +1,155 @@
 #ifndef ISOTP_H
 #define ISOTP_H
 
+#include <zephyr/kernel.h>
 #include <zephyr/drivers/can.h>
+#include <zephyr/net/buf.h>
 
-// ISO-TP frame types
+// ISO-TP frame types, upper nibble of the PCI byte
 #define ISOTP_SINGLE_FRAME    0x00
 #define ISOTP_FIRST_FRAME     0x01
 #define ISOTP_CONSECUTIVE     0x02
 #define ISOTP_FLOW_CONTROL    0x03
 
+#define ISOTP_PCI(type)       ((type) << 4)
+#define ISOTP_PCI_TYPE(byte)  ((byte) >> 4)
+
+// Flow control flow status
+#define ISOTP_FC_CTS          0x00
+#define ISOTP_FC_WAIT         0x01
+#define ISOTP_FC_OVFLW        0x02
+
+#define ISOTP_MAX_LEN         4095    // Longest message without the FF_DL escape
+#define ISOTP_PAD_BYTE        0xCC    // Fills CAN FD frames up to a valid length
+
+// Frame payload (TX_DL) of a context: 8 for classic CAN, or 12-64 for CAN
+// FD (needs CONFIG_CAN_FD_MODE)
+#define ISOTP_CLASSIC_DL      8
+
+// Network layer timeouts (ISO 15765-2)
+#define ISOTP_N_AS_MS         1000    // Frame transmission confirmation
+#define ISOTP_N_BS_MS         1000    // Sender waiting for flow control
+#define ISOTP_N_CR_MS         1000    // Receiver waiting for a consecutive frame
+#define ISOTP_N_WFT_MAX       10      // FC.WAIT frames accepted in a row
+
+// Separation time in us for an STmin byte: 0x00-0x7F ms, 0xF1-0xF9
+// 100-900 us. Reserved values mean the longest time (127 ms).
+static inline uint32_t isotp_stmin_to_us(uint8_t stmin) {
+    if (stmin <= 0x7F) {
+        return stmin * USEC_PER_MSEC;
+    }
+    if (stmin >= 0xF1 && stmin <= 0xF9) {
+        return (stmin - 0xF0) * 100;
+    }
+    return 0x7F * USEC_PER_MSEC;
+}
+
+struct isotp_ctx;
+
+// Reception finished. len is the message length or a negative errno, data
+// is only valid during the call. Runs in the context that delivered the
+// last frame (CAN RX callback or isotp_process_frame() caller) or on the
+// system work queue for timeouts.
+typedef void (*isotp_rx_cb_t)(struct isotp_ctx *ctx, const uint8_t *data, int len,
+                              void *user_data);
+
+// Reception into a fragment chain finished. frags holds len bytes in
+// order and is released after the call; take a reference with
+// net_buf_ref() to keep it. NULL when len is a negative errno.
+typedef void (*isotp_rx_frags_cb_t)(struct isotp_ctx *ctx, struct net_buf *frags, int len,
+                                    void *user_data);
+
+// Transmission finished with 0 or a negative errno
+typedef void (*isotp_tx_cb_t)(struct isotp_ctx *ctx, int result, void *user_data);
+
+enum isotp_rx_state {
+    ISOTP_RX_IDLE,
+    ISOTP_RX_WAIT_CF,
+    ISOTP_RX_DONE,          // Message in buf, not yet consumed
+};
+
+enum isotp_tx_state {
+    ISOTP_TX_IDLE,
+    ISOTP_TX_SENDING,       // Frame queued, waiting for confirmation (N_As)
+    ISOTP_TX_WAIT_FC,       // Waiting for flow control (N_Bs)
+    ISOTP_TX_WAIT_STMIN,    // Separation time before the next CF
+};
+
+struct isotp_stats {
+    uint32_t rx_done;
+    uint32_t rx_errors;
+    uint32_t rx_overflow;   // Too long for the buffer, or no pool buffer free
+    uint32_t tx_done;
+    uint32_t tx_errors;
+};
+
 struct isotp_ctx {
     const struct device *can_dev;
     uint32_t rx_id;
     uint32_t tx_id;
     uint8_t *buf;
     size_t buf_size;
+    struct k_mem_slab *buf_pool;    // Set: buf is taken per message from the pool
+    struct net_buf_pool *frag_pool; // Set: reassemble into fragments, buf_size is the limit
+    bool manual_rx;         // Frames are pushed with isotp_process_frame(), no RX filter
+    bool functional;        // tx_id/rx_id address a group: single frames only
+    uint8_t tx_dl;          // 0 means ISOTP_CLASSIC_DL
+    isotp_rx_cb_t rx_cb;    // Both NULL: messages are held for isotp_receive()
+    isotp_rx_frags_cb_t rx_frags_cb;    // Used instead of rx_cb with frag_pool
+    void *rx_user_data;
+    uint8_t rx_bs;          // Block size and STmin sent in our flow control,
+    uint8_t rx_stmin;       // 0 lets the sender run without pauses
+
+    struct isotp_stats stats;
+
+    // Internal state, set up by isotp_init()
+    struct k_spinlock lock;
+    int filter_id;
+    struct {
+        enum isotp_rx_state state;
+        size_t total_len;
+        size_t received;
+        uint8_t dl;             // RX_DL, taken from the first frame
+        struct net_buf *frags;
+        struct net_buf *frag_tail;
+        uint8_t next_sn;
+        uint8_t block_count;
+        int result;
+        struct k_work_delayable timer;
+        struct k_sem done;
+    } rx;
+    struct {
+        enum isotp_tx_state state;
+        const uint8_t *data;
+        size_t len;
+        size_t sent;
+        uint8_t next_sn;
+        bool wait_fc;
+        uint8_t bs;             // From the receiver's flow control
+        uint8_t block_count;
+        uint8_t wft_count;
+        uint32_t stmin_us;
+        int result;
+        isotp_tx_cb_t cb;
+        void *user_data;
+        struct k_work_delayable timer;
+        struct k_sem done;
+    } tx;
 };
 
 int isotp_init(struct isotp_ctx *ctx);
+
+// Feed a received frame, for contexts with manual_rx. Returns -EINVAL for
+// frames not addressed to this context.
+int isotp_process_frame(struct isotp_ctx *ctx, const struct can_frame *frame);
+
+// Start a transfer, data must stay valid until cb. Messages over
+// ISOTP_MAX_LEN use the 32-bit length escape. -EBUSY while a transfer is in
+// progress.
+int isotp_send_async(struct isotp_ctx *ctx, const uint8_t *data, size_t len,
+                     isotp_tx_cb_t cb, void *user_data);
+
+// Blocking wrappers, must not be called from the system work queue
 int isotp_send(struct isotp_ctx *ctx, const uint8_t *data, size_t len);
 int isotp_receive(struct isotp_ctx *ctx, uint8_t *data, size_t len);
 
@@ -0,0 +1,119 @@
+#include <zephyr/kernel.h>
+#include <string.h>
+#include "isotp_mux.h"
+
+static bool isotp_mux_id_valid(uint32_t id) {
+    return id >= ISOTP_MUX_ID_BASE && id < ISOTP_MUX_ID_BASE + ISOTP_MUX_ID_SPAN;
+}
+
+void isotp_mux_init(struct isotp_mux *mux, const struct device *can_dev,
+                    struct k_mem_slab *pool, size_t buf_size) {
+    memset(mux, 0, sizeof(*mux));
+    mux->can_dev = can_dev;
+    mux->pool = pool;
+    mux->buf_size = buf_size;
+}
+
+static int isotp_mux_add(struct isotp_mux *mux, struct isotp_ctx *ctx) {
+    int index = ctx - mux->channels;
+    int ret;
+
+    ctx->can_dev = mux->can_dev;
+    ctx->buf_size = mux->buf_size;
+    ctx->manual_rx = true;
+    ctx->tx_dl = mux->tx_dl;
+
+    ret = isotp_init(ctx);
+    if (ret != 0) {
+        return ret;
+    }
+
+    if (ctx->rx_id != 0) {
+        mux->by_rx_id[ctx->rx_id - ISOTP_MUX_ID_BASE] = index + 1;
+    }
+    mux->num_channels++;
+    return index;
+}
+
+// Returns the next free channel, or NULL with *err set
+static struct isotp_ctx *isotp_mux_reserve(struct isotp_mux *mux, uint32_t rx_id,
+                                           uint32_t tx_id, int *err) {
+    struct isotp_ctx *ctx;
+
+    if (mux->num_channels >= ISOTP_MUX_MAX_CHANNELS) {
+        *err = -ENOSPC;
+        return NULL;
+    }
+    if ((rx_id != 0 && !isotp_mux_id_valid(rx_id)) || tx_id > CAN_STD_ID_MASK) {
+        *err = -EINVAL;
+        return NULL;
+    }
+    if (rx_id != 0 && mux->by_rx_id[rx_id - ISOTP_MUX_ID_BASE] != 0) {
+        *err = -EEXIST;
+        return NULL;
+    }
+
+    ctx = &mux->channels[mux->num_channels];
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->rx_id = rx_id;
+    ctx->tx_id = tx_id;
+    return ctx;
+}
+
+int isotp_mux_open(struct isotp_mux *mux, uint32_t rx_id, uint32_t tx_id, bool functional,
+                   isotp_rx_cb_t cb, void *user_data) {
+    int err;
+    struct isotp_ctx *ctx = isotp_mux_reserve(mux, rx_id, tx_id, &err);
+
+    if (ctx == NULL) {
+        return err;
+    }
+
+    ctx->buf_pool = mux->pool;
+    ctx->functional = functional;
+    ctx->rx_cb = cb;
+    ctx->rx_user_data = user_data;
+    return isotp_mux_add(mux, ctx);
+}
+
+int isotp_mux_open_frags(struct isotp_mux *mux, uint32_t rx_id, uint32_t tx_id, bool functional,
+                         isotp_rx_frags_cb_t cb, void *user_data) {
+    int err;
+    struct isotp_ctx *ctx = isotp_mux_reserve(mux, rx_id, tx_id, &err);
+
+    if (ctx == NULL) {
+        return err;
+    }
+    if (mux->frag_pool == NULL) {
+        return -EINVAL;
+    }
+
+    ctx->frag_pool = mux->frag_pool;
+    ctx->functional = functional;
+    ctx->rx_frags_cb = cb;
+    ctx->rx_user_data = user_data;
+    return isotp_mux_add(mux, ctx);
+}
+
+struct isotp_ctx *isotp_mux_channel(struct isotp_mux *mux, int channel) {
+    if (channel < 0 || channel >= mux->num_channels) {
+        return NULL;
+    }
+    return &mux->channels[channel];
+}
+
+int isotp_mux_process_frame(struct isotp_mux *mux, const struct can_frame *frame) {
+    uint8_t slot;
+
+    if ((frame->flags & CAN_FRAME_IDE) || !isotp_mux_id_valid(frame->id)) {
+        return -ENOENT;
+    }
+
+    slot = mux->by_rx_id[frame->id - ISOTP_MUX_ID_BASE];
+    if (slot == 0) {
+        mux->unknown_ids++;
+        return -ENOENT;
+    }
+
+    return isotp_process_frame(&mux->channels[slot - 1], frame);
+}
@@ -0,0 +1,53 @@
+#ifndef ISOTP_MUX_H
+#define ISOTP_MUX_H
+
+#include <zephyr/kernel.h>
+#include <zephyr/drivers/can.h>
+#include "isotp.h"
+
+// Diagnostic IDs live in 0x700-0x7FF, which keeps the dispatch table small
+#define ISOTP_MUX_ID_BASE       0x700
+#define ISOTP_MUX_ID_SPAN       0x100
+
+#define ISOTP_MUX_MAX_CHANNELS  16
+
+// A table of ISO-TP channels, one per address pair, sharing one CAN
+// controller and a pool of receive buffers. Frames are dispatched to their
+// channel by a direct lookup on the CAN ID, so every peer can have a
+// session in progress at the same time. A buffer is only held while a
+// message is being reassembled or handed to the callback.
+struct isotp_mux {
+    const struct device *can_dev;
+    struct k_mem_slab *pool;
+    struct net_buf_pool *frag_pool;     // For isotp_mux_open_frags()
+    size_t buf_size;
+    uint8_t tx_dl;          // For channels opened afterwards, 0 = classic
+    struct isotp_ctx channels[ISOTP_MUX_MAX_CHANNELS];
+    uint8_t num_channels;
+    uint8_t by_rx_id[ISOTP_MUX_ID_SPAN];    // Channel index + 1, 0 = none
+    uint32_t unknown_ids;
+};
+
+// pool blocks must be at least buf_size bytes. pool may be NULL when all
+// channels are opened with isotp_mux_open_frags().
+void isotp_mux_init(struct isotp_mux *mux, const struct device *can_dev,
+                    struct k_mem_slab *pool, size_t buf_size);
+
+// Add a channel receiving on rx_id and sending on tx_id. rx_id 0 opens a
+// transmit-only channel. Functional channels carry single frames only.
+// Returns the channel index, -ENOSPC when the table is full, -EINVAL for
+// IDs outside the dispatch range or -EEXIST if rx_id is taken.
+int isotp_mux_open(struct isotp_mux *mux, uint32_t rx_id, uint32_t tx_id, bool functional,
+                   isotp_rx_cb_t cb, void *user_data);
+
+// Same for a channel that reassembles into fragments from mux->frag_pool,
+// messages of up to buf_size bytes
+int isotp_mux_open_frags(struct isotp_mux *mux, uint32_t rx_id, uint32_t tx_id, bool functional,
+                         isotp_rx_frags_cb_t cb, void *user_data);
+
+struct isotp_ctx *isotp_mux_channel(struct isotp_mux *mux, int channel);
+
+// Feed a received frame. Returns -ENOENT if no channel receives on its ID.
+int isotp_mux_process_frame(struct isotp_mux *mux, const struct can_frame *frame);
+
+#endif /* ISOTP_MUX_H */
@@ -1,206 +1,922 @@
 #include <zephyr/kernel.h>
+#include <zephyr/sys/byteorder.h>
 #include <string.h>
 #include "j1939.h"
 
 #define J1939_PF_MASK    0xFF0000
 #define J1939_PS_MASK    0x0000FF
 #define J1939_DP_MASK    0x010000
-#define MAX_PGN_HANDLERS 32
-#define TP_MAX_PACKETS   255
-#define TP_DATA_SIZE     7
-#define TP_TIMEOUT_MS    750
+#define J1939_PDU2_MIN_PF 0xF0
+#define TP_DATA_SIZE     J1939_TP_PACKET_SIZE
+#define TP_PAD_BYTE      0xFF
 
-struct pgn_handler {
+// Open addressing on the PGN, at most half full
+#define PGN_INDEX_BITS   6
+#define PGN_INDEX_SLOTS  BIT(PGN_INDEX_BITS)
+#define PGN_INDEX_MASK   (PGN_INDEX_SLOTS - 1)
+#define PGN_HASH(pgn)    (((uint32_t)(pgn) * 2654435761U) >> (32 - PGN_INDEX_BITS))
+
+BUILD_ASSERT(PGN_INDEX_SLOTS >= 2 * J1939_MAX_PGN_HANDLERS, "PGN index too small");
+
+// Handlers of a PGN, adjacent in pgn_dispatch
+struct pgn_slot {
     uint32_t pgn;
-    void (*handler)(struct j1939_ctx *, const uint8_t *, uint16_t);
+    uint8_t first;
+    uint8_t count;              // 0 for a free slot
 };
 
-static struct pgn_handler pgn_handlers[MAX_PGN_HANDLERS];
-static uint8_t num_handlers = 0;
+static struct j1939_pgn_handler pgn_handlers[J1939_MAX_PGN_HANDLERS];
+static uint8_t num_handlers;
+static struct pgn_slot pgn_index[PGN_INDEX_SLOTS];
+static const struct j1939_pgn_handler *pgn_dispatch[J1939_MAX_PGN_HANDLERS];
 
-// Transport Protocol buffers
-static uint8_t tp_buffer[1785]; // Max J1939-TP size
-static K_SEM_DEFINE(tp_sem, 0, 1);
+// Reassembly buffers of contexts without their own tp_pool
+K_MEM_SLAB_DEFINE_STATIC(j1939_tp_pool, J1939_TP_MAX_SIZE, J1939_TP_POOL_BUFFERS, 4);
 
 static uint32_t build_j1939_id(uint32_t pgn, uint8_t priority, uint8_t sa, uint8_t da) {
+    // PDU1 PGNs carry the destination address in the PS field
+    if (((pgn >> 8) & 0xFF) < J1939_PDU2_MIN_PF) {
+        pgn = (pgn & 0x3FF00) | da;
+    }
     return ((uint32_t)priority << 26) | (pgn << 8) | sa;
 }
 
+static void j1939_ignore_tx_done(const struct device *dev, int error, void *user_data) {
+}
+
+int j1939_send_frame_cb(struct j1939_ctx *ctx, uint32_t pgn, uint8_t priority, uint8_t da,
+                        const uint8_t *data, uint8_t len, can_tx_callback_t cb,
+                        void *user_data) {
+    struct can_frame frame = {
+        .id = build_j1939_id(pgn, priority, ctx->source_address, da),
+        .dlc = len,
+        .flags = CAN_FRAME_IDE
+    };
+
+    if (len > 8) {
+        return -EINVAL;
+    }
+    memcpy(frame.data, data, len);
+    return can_send(ctx->can_dev, &frame, K_NO_WAIT, cb, user_data);
+}
+
+// Queue without waiting for a mailbox or the confirmation
+int j1939_send_frame(struct j1939_ctx *ctx, uint32_t pgn, uint8_t priority, uint8_t da,
+                     const uint8_t *data, uint8_t len) {
+    return j1939_send_frame_cb(ctx, pgn, priority, da, data, len, j1939_ignore_tx_done, NULL);
+}
+
+static int static_handler_count(void) {
+    int count;
+
+    STRUCT_SECTION_COUNT(j1939_pgn_handler, &count);
+    return count;
+}
+
+// Slot of pgn, or the free slot where it goes
+static struct pgn_slot *pgn_index_slot(uint32_t pgn) {
+    uint32_t i = PGN_HASH(pgn);
+
+    while (pgn_index[i].count != 0 && pgn_index[i].pgn != pgn) {
+        i = (i + 1) & PGN_INDEX_MASK;
+    }
+    return &pgn_index[i];
+}
+
+static void pgn_index_add(const struct j1939_pgn_handler *h, bool place) {
+    struct pgn_slot *slot = pgn_index_slot(h->pgn);
+
+    if (place) {
+        // first counts up to the end of the PGN's range
+        pgn_dispatch[slot->first++] = h;
+    } else {
+        slot->pgn = h->pgn;
+        slot->count++;
+    }
+}
+
+// Group the static handlers, then the registered ones, by PGN. The first
+// pass counts the handlers per slot, the second places them.
+static void pgn_index_build(void) {
+    uint8_t next = 0;
+
+    memset(pgn_index, 0, sizeof(pgn_index));
+    for (int pass = 0; pass < 2; pass++) {
+        STRUCT_SECTION_FOREACH(j1939_pgn_handler, h) {
+            pgn_index_add(h, pass);
+        }
+        for (int i = 0; i < num_handlers; i++) {
+            pgn_index_add(&pgn_handlers[i], pass);
+        }
+
+        for (int i = 0; i < PGN_INDEX_SLOTS; i++) {
+            if (pass == 0) {
+                pgn_index[i].first = next;
+                next += pgn_index[i].count;
+            } else {
+                pgn_index[i].first -= pgn_index[i].count;
+            }
+        }
+    }
+}
+
+static void dispatch_pgn(struct j1939_ctx *ctx, uint32_t pgn, uint8_t sa, uint8_t da,
+                         const uint8_t *data, uint16_t len) {
+    const struct pgn_slot *slot = pgn_index_slot(pgn);
+    const struct j1939_pgn_handler *const *h = &pgn_dispatch[slot->first];
+    const struct j1939_pgn_handler *const *end = h + slot->count;
+
+    ctx->rx_sa = sa;
+    ctx->rx_da = da;
+    for (; h < end; h++) {
+        if ((*h)->sa == J1939_ADDR_GLOBAL || (*h)->sa == sa) {
+            (*h)->handler(ctx, data, len);
+        }
+    }
+}
+
+static void j1939_can_rx(const struct device *dev, struct can_frame *frame, void *user_data) {
+    j1939_process_message(user_data, frame);
+}
+
+static void bam_tx_timer(struct k_work *work);
+static void rx_timeout(struct k_work *work);
+static const struct j1939_cm_tx_ops tp_tx_ops;
+
 int j1939_init(struct j1939_ctx *ctx) {
     if (!device_is_ready(ctx->can_dev)) {
         return -ENODEV;
     }
-    
-    ctx->tp_in_progress = false;
-    memset(pgn_handlers, 0, sizeof(pgn_handlers));
-    
-    // Set up J1939 specific CAN filters
+    if (static_handler_count() + num_handlers > J1939_MAX_PGN_HANDLERS) {
+        return -ENOMEM;
+    }
+    pgn_index_build();
+
+    if (ctx->bam_interval_ms == 0) {
+        ctx->bam_interval_ms = J1939_BAM_INTERVAL_MIN_MS;
+    }
+    if (ctx->bam_interval_ms < J1939_BAM_INTERVAL_MIN_MS ||
+        ctx->bam_interval_ms > J1939_BAM_INTERVAL_MAX_MS) {
+        return -EINVAL;
+    }
+    ctx->bam_tx.active = false;
+    k_work_init_delayable(&ctx->bam_tx.timer, bam_tx_timer);
+    j1939_cm_tx_init(ctx, &ctx->tp_tx.cm, &tp_tx_ops);
+
+    if (ctx->tp_pool == NULL) {
+        ctx->tp_pool = &j1939_tp_pool;
+    }
+    for (int i = 0; i < J1939_TP_SESSIONS; i++) {
+        ctx->rx_sessions[i].ctx = ctx;
+        ctx->rx_sessions[i].active = false;
+        k_work_init_delayable(&ctx->rx_sessions[i].timer, rx_timeout);
+    }
+
+    ctx->addr_state = J1939_ADDR_FIXED;
+    ctx->filter_id = -1;
+    if (ctx->manual_rx) {
+        return 0;
+    }
+
+    // PDU1 to everyone, then to our address. PDU2 PGNs come through the
+    // application's filters.
     struct can_filter filter = {
-        .id = ctx->source_address,
-        .mask = 0xFF,
-        .flags = CAN_FILTER_IDE
+        .id = J1939_ADDR_GLOBAL << 8,
+        .mask = 0xFF00,
+        .flags = CAN_FILTER_IDE | CAN_FILTER_DATA
     };
-    
-    return can_add_rx_filter(ctx->can_dev, NULL, ctx, &filter);
+
+    int filter_id = can_add_rx_filter(ctx->can_dev, j1939_can_rx, ctx, &filter);
+    if (filter_id < 0) {
+        return filter_id;
+    }
+    return j1939_set_address(ctx, ctx->source_address);
 }
 
-int j1939_register_pgn_handler(uint32_t pgn, void (*handler)(struct j1939_ctx *, const uint8_t *, uint16_t)) {
-    if (num_handlers >= MAX_PGN_HANDLERS) {
+int j1939_set_address(struct j1939_ctx *ctx, uint8_t address) {
+    struct can_filter filter = {
+        .id = (uint32_t)address << 8,
+        .mask = 0xFF00,
+        .flags = CAN_FILTER_IDE | CAN_FILTER_DATA
+    };
+
+    ctx->source_address = address;
+    if (ctx->manual_rx) {
+        return 0;
+    }
+
+    if (ctx->filter_id >= 0) {
+        can_remove_rx_filter(ctx->can_dev, ctx->filter_id);
+        ctx->filter_id = -1;
+    }
+    if (address >= J1939_ADDR_NULL) {
+        return 0;
+    }
+
+    ctx->filter_id = can_add_rx_filter(ctx->can_dev, j1939_can_rx, ctx, &filter);
+    return ctx->filter_id < 0 ? ctx->filter_id : 0;
+}
+
+int j1939_register_pgn_handler_from(uint32_t pgn, uint8_t sa, j1939_pgn_handler_t handler) {
+    if (static_handler_count() + num_handlers >= J1939_MAX_PGN_HANDLERS) {
         return -ENOMEM;
     }
-    
+
     pgn_handlers[num_handlers].pgn = pgn;
+    pgn_handlers[num_handlers].sa = sa;
     pgn_handlers[num_handlers].handler = handler;
     num_handlers++;
-    
+    pgn_index_build();
+
     return 0;
 }
 
-static void handle_tp_rts(struct j1939_ctx *ctx, const struct can_frame *frame) {
-    if (ctx->tp_in_progress) {
-        // Already in a session, send abort
-        uint8_t abort_msg[8] = {TP_CM_Abort, 0x01, 0xFF, 0xFF};
-        j1939_send_pgn(ctx, J1939_PGN_TP_CM, abort_msg, 8);
-        return;
+int j1939_register_pgn_handler(uint32_t pgn, j1939_pgn_handler_t handler) {
+    return j1939_register_pgn_handler_from(pgn, J1939_ADDR_GLOBAL, handler);
+}
+
+// TP.CM to da with the PGN in bytes 5-7
+static int tp_send_cm(struct j1939_ctx *ctx, uint8_t da, uint8_t msg[8], uint32_t pgn) {
+    msg[5] = pgn & 0xFF;
+    msg[6] = (pgn >> 8) & 0xFF;
+    msg[7] = (pgn >> 16) & 0xFF;
+    return j1939_send_frame(ctx, J1939_PGN_TP_CM, J1939_PRIORITY_LOW, da, msg, 8);
+}
+
+static void tp_send_abort(struct j1939_ctx *ctx, uint8_t da, uint8_t reason, uint32_t pgn) {
+    uint8_t abort_msg[8] = {TP_CM_Abort, reason, 0xFF, 0xFF, 0xFF};
+
+    tp_send_cm(ctx, da, abort_msg, pgn);
+}
+
+/* Receive sessions */
+
+// Caller holds ctx->lock. Session for packets from sa to da, NULL if none.
+static struct j1939_rx_session *rx_find(struct j1939_ctx *ctx, uint8_t sa, uint8_t da) {
+    for (int i = 0; i < J1939_TP_SESSIONS; i++) {
+        struct j1939_rx_session *session = &ctx->rx_sessions[i];
+
+        if (session->active && session->sa == sa && session->da == da) {
+            return session;
+        }
     }
-    
+    return NULL;
+}
+
+// Caller holds ctx->lock. Free session with a pool buffer, NULL when the
+// table or the pool is exhausted.
+static struct j1939_rx_session *rx_open(struct j1939_ctx *ctx, uint8_t sa, uint8_t da,
+                                        uint32_t pgn, uint16_t size) {
+    for (int i = 0; i < J1939_TP_SESSIONS; i++) {
+        struct j1939_rx_session *session = &ctx->rx_sessions[i];
+
+        if (session->active) {
+            continue;
+        }
+        if (k_mem_slab_alloc(ctx->tp_pool, (void **)&session->data, K_NO_WAIT) != 0) {
+            return NULL;
+        }
+        session->active = true;
+        session->sa = sa;
+        session->da = da;
+        session->pgn = pgn;
+        session->total_size = size;
+        session->num_packets = DIV_ROUND_UP(size, TP_DATA_SIZE);
+        session->next_packet = 1;
+        return session;
+    }
+    return NULL;
+}
+
+// Caller holds ctx->lock
+static void rx_close(struct j1939_ctx *ctx, struct j1939_rx_session *session) {
+    k_work_cancel_delayable(&session->timer);
+    k_mem_slab_free(ctx->tp_pool, session->data);
+    session->data = NULL;
+    session->active = false;
+}
+
+// Caller holds ctx->lock. Opens the next window of at most session->window
+// packets, which must start within T2. The caller sends cts_msg with
+// tp_send_cm() once the lock is released, can_send() never runs under it.
+static void rx_open_window(struct j1939_rx_session *session, uint8_t cts_msg[8]) {
+    uint8_t remaining = session->num_packets - session->next_packet + 1;
+    uint8_t count = MIN(remaining, session->window);
+
+    cts_msg[0] = TP_CM_CTS;
+    cts_msg[1] = count;
+    cts_msg[2] = session->next_packet;
+    cts_msg[3] = 0xFF;
+    cts_msg[4] = 0xFF;
+    session->window_end = session->next_packet + count - 1;
+    k_work_reschedule(&session->timer, K_MSEC(J1939_TP_T2_MS));
+}
+
+static void rx_timeout(struct k_work *work) {
+    struct k_work_delayable *dwork = k_work_delayable_from_work(work);
+    struct j1939_rx_session *session = CONTAINER_OF(dwork, struct j1939_rx_session, timer);
+    struct j1939_ctx *ctx = session->ctx;
+    k_spinlock_key_t key = k_spin_lock(&ctx->lock);
+    bool abort = false;
+    uint8_t sa = session->sa;
+    uint32_t pgn = session->pgn;
+
+    if (session->active) {
+        // Broadcasts are dropped silently
+        abort = session->da != J1939_ADDR_GLOBAL;
+        ctx->stats.rx_timeouts++;
+        rx_close(ctx, session);
+    }
+    k_spin_unlock(&ctx->lock, key);
+
+    if (abort) {
+        tp_send_abort(ctx, sa, J1939_ABORT_TIMEOUT, pgn);
+    }
+}
+
+static void handle_tp_rts(struct j1939_ctx *ctx, uint8_t sa, const struct can_frame *frame) {
     uint16_t size = (frame->data[1] | (frame->data[2] << 8));
     uint8_t num_packets = frame->data[3];
+    uint8_t max_window = frame->data[4];
     uint32_t pgn = (frame->data[5] | (frame->data[6] << 8) | (frame->data[7] << 16));
+    k_spinlock_key_t key = k_spin_lock(&ctx->lock);
+    struct j1939_rx_session *session = rx_find(ctx, sa, ctx->source_address);
+    uint8_t cts_msg[8];
+
+    if (session != NULL && session->pgn != pgn) {
+        // One connection per sender, the running one continues
+        k_spin_unlock(&ctx->lock, key);
+        tp_send_abort(ctx, sa, J1939_ABORT_BUSY, pgn);
+        return;
+    }
+    if (session != NULL) {
+        // Restarted by the sender
+        ctx->stats.rx_aborted++;
+        rx_close(ctx, session);
+    }
     
     // Validate size and packet count
-    if (size > sizeof(tp_buffer) || size == 0 || 
-        num_packets == 0 || num_packets > TP_MAX_PACKETS ||
-        size != ((num_packets - 1) * 7 + (size % 7 ? size % 7 : 7))) {
-        uint8_t abort_msg[8] = {TP_CM_Abort, 0x02, 0xFF, 0xFF};
-        j1939_send_pgn(ctx, J1939_PGN_TP_CM, abort_msg, 8);
+    if (size <= 8 || size > J1939_TP_MAX_SIZE || max_window == 0 ||
+        num_packets != DIV_ROUND_UP(size, TP_DATA_SIZE)) {
+        k_spin_unlock(&ctx->lock, key);
+        tp_send_abort(ctx, sa, J1939_ABORT_RESOURCES, pgn);
         return;
     }
-    
-    // Start new TP session
-    ctx->tp_session.pgn = pgn;
-    ctx->tp_session.total_size = size;
-    ctx->tp_session.num_packets = num_packets;
-    ctx->tp_session.next_packet = 1;
-    ctx->tp_session.data = tp_buffer;
-    ctx->tp_session.start_time = k_uptime_get_32();
-    ctx->tp_in_progress = true;
-    
-    // Send CTS
-    uint8_t cts_msg[8] = {TP_CM_CTS, num_packets, 1, 0xFF, 0xFF};
-    cts_msg[5] = pgn & 0xFF;
-    cts_msg[6] = (pgn >> 8) & 0xFF;
-    cts_msg[7] = (pgn >> 16) & 0xFF;
-    
-    j1939_send_pgn(ctx, J1939_PGN_TP_CM, cts_msg, 8);
-}
 
-static void handle_tp_dt(struct j1939_ctx *ctx, const struct can_frame *frame) {
-    if (!ctx->tp_in_progress) {
+    session = rx_open(ctx, sa, ctx->source_address, pgn, size);
+    if (session == NULL) {
+        ctx->stats.rx_dropped++;
+        k_spin_unlock(&ctx->lock, key);
+        tp_send_abort(ctx, sa, J1939_ABORT_RESOURCES, pgn);
         return;
     }
-    
-    // Check session timeout
-    if (k_uptime_get_32() - ctx->tp_session.start_time > TP_TIMEOUT_MS) {
-        uint8_t abort_msg[8] = {TP_CM_Abort, 0x03, 0xFF, 0xFF};
-        j1939_send_pgn(ctx, J1939_PGN_TP_CM, abort_msg, 8);
-        ctx->tp_in_progress = false;
+
+    session->window = MIN(max_window, ctx->tp_rx_window ? ctx->tp_rx_window : 0xFF);
+    rx_open_window(session, cts_msg);
+    k_spin_unlock(&ctx->lock, key);
+
+    tp_send_cm(ctx, sa, cts_msg, pgn);
+}
+
+static void handle_bam(struct j1939_ctx *ctx, uint8_t sa, const struct can_frame *frame) {
+    uint16_t size = frame->data[1] | (frame->data[2] << 8);
+    uint8_t num_packets = frame->data[3];
+    uint32_t pgn = frame->data[5] | (frame->data[6] << 8) | (frame->data[7] << 16);
+    k_spinlock_key_t key;
+    struct j1939_rx_session *session;
+
+    // No abort for broadcasts, invalid announcements are ignored
+    if (size <= 8 || size > J1939_TP_MAX_SIZE ||
+        num_packets != DIV_ROUND_UP(size, TP_DATA_SIZE)) {
         return;
     }
-    
+
+    key = k_spin_lock(&ctx->lock);
+
+    // A new announcement replaces the unfinished one from the same source
+    session = rx_find(ctx, sa, J1939_ADDR_GLOBAL);
+    if (session != NULL) {
+        ctx->stats.rx_aborted++;
+        rx_close(ctx, session);
+    }
+
+    session = rx_open(ctx, sa, J1939_ADDR_GLOBAL, pgn, size);
+    if (session == NULL) {
+        ctx->stats.rx_dropped++;
+    } else {
+        k_work_reschedule(&session->timer, K_MSEC(J1939_TP_T1_MS));
+    }
+    k_spin_unlock(&ctx->lock, key);
+}
+
+static void handle_tp_dt(struct j1939_ctx *ctx, uint8_t sa, uint8_t da,
+                         const struct can_frame *frame) {
+    k_spinlock_key_t key = k_spin_lock(&ctx->lock);
+    struct j1939_rx_session *session = rx_find(ctx, sa, da);
     uint8_t seq = frame->data[0];
-    if (seq != ctx->tp_session.next_packet) {
-        // Sequence error
-        uint8_t abort_msg[8] = {TP_CM_Abort, 0x04, 0xFF, 0xFF};
-        j1939_send_pgn(ctx, J1939_PGN_TP_CM, abort_msg, 8);
-        ctx->tp_in_progress = false;
+    uint8_t cm_msg[8];
+    uint8_t num_packets;
+    uint16_t offset;
+    uint8_t *data;
+    uint32_t pgn;
+    uint16_t size;
+
+    if (session == NULL) {
+        k_spin_unlock(&ctx->lock, key);
         return;
     }
-    
-    uint16_t offset = (seq - 1) * 7;
-    uint8_t len = MIN(7, ctx->tp_session.total_size - offset);
-    
-    // Validate offset and length
-    if (offset + len > ctx->tp_session.total_size) {
-        uint8_t abort_msg[8] = {TP_CM_Abort, 0x05, 0xFF, 0xFF};
-        j1939_send_pgn(ctx, J1939_PGN_TP_CM, abort_msg, 8);
-        ctx->tp_in_progress = false;
+    pgn = session->pgn;
+
+    if (seq != session->next_packet ||
+        (da != J1939_ADDR_GLOBAL && seq > session->window_end)) {
+        ctx->stats.rx_aborted++;
+        rx_close(ctx, session);
+        k_spin_unlock(&ctx->lock, key);
+        if (da != J1939_ADDR_GLOBAL) {
+            tp_send_abort(ctx, sa, J1939_ABORT_BAD_SEQUENCE, pgn);
+        }
         return;
     }
-    
-    memcpy(ctx->tp_session.data + offset, &frame->data[1], len);
-    ctx->tp_session.next_packet++;
-    
-    // Check if transfer complete
-    if (ctx->tp_session.next_packet > ctx->tp_session.num_packets) {
-        // Validate total size
-        if (ctx->tp_session.total_size != offset + len) {
-            uint8_t abort_msg[8] = {TP_CM_Abort, 0x06, 0xFF, 0xFF};
-            j1939_send_pgn(ctx, J1939_PGN_TP_CM, abort_msg, 8);
-            ctx->tp_in_progress = false;
-            return;
+
+    offset = (seq - 1) * TP_DATA_SIZE;
+    memcpy(&session->data[offset], &frame->data[1],
+           MIN(TP_DATA_SIZE, session->total_size - offset));
+    session->next_packet++;
+
+    if (seq < session->num_packets) {
+        bool cts = da != J1939_ADDR_GLOBAL && seq == session->window_end;
+
+        if (cts) {
+            rx_open_window(session, cm_msg);
+        } else {
+            k_work_reschedule(&session->timer, K_MSEC(J1939_TP_T1_MS));
         }
-        
-        // Send End of Message ACK
-        uint8_t eom_msg[8] = {TP_CM_EndOfMsgAck, 
-                             ctx->tp_session.total_size & 0xFF,
-                             (ctx->tp_session.total_size >> 8) & 0xFF,
-                             ctx->tp_session.num_packets,
-                             0xFF};
-        eom_msg[5] = ctx->tp_session.pgn & 0xFF;
-        eom_msg[6] = (ctx->tp_session.pgn >> 8) & 0xFF;
-        eom_msg[7] = (ctx->tp_session.pgn >> 16) & 0xFF;
-        j1939_send_pgn(ctx, J1939_PGN_TP_CM, eom_msg, 8);
-        
-        // Process complete message
-        for (int i = 0; i < num_handlers; i++) {
-            if (pgn_handlers[i].pgn == ctx->tp_session.pgn) {
-                pgn_handlers[i].handler(ctx, ctx->tp_session.data, 
-                                      ctx->tp_session.total_size);
-                break;
-            }
+        k_spin_unlock(&ctx->lock, key);
+        if (cts) {
+            tp_send_cm(ctx, sa, cm_msg, pgn);
         }
-        
-        ctx->tp_in_progress = false;
-        k_sem_give(&tp_sem);
+        return;
     }
+
+    // The session is free again while the handler reads the buffer
+    k_work_cancel_delayable(&session->timer);
+    data = session->data;
+    size = session->total_size;
+    num_packets = session->num_packets;
+    session->data = NULL;
+    session->active = false;
+    ctx->stats.rx_done++;
+    k_spin_unlock(&ctx->lock, key);
+
+    if (da != J1939_ADDR_GLOBAL) {
+        uint8_t eom_msg[8] = {TP_CM_EndOfMsgAck, size & 0xFF, (size >> 8) & 0xFF, num_packets,
+                              0xFF};
+
+        tp_send_cm(ctx, sa, eom_msg, pgn);
+    }
+    dispatch_pgn(ctx, pgn, sa, da, data, size);
+    k_mem_slab_free(ctx->tp_pool, data);
 }
 
-int j1939_send_tp_data(struct j1939_ctx *ctx, uint32_t pgn, const uint8_t *data, uint16_t len) {
-    if (len <= 8) {
-        return j1939_send_pgn(ctx, pgn, data, len);
+// Abort from the sender of a transfer we receive
+static void handle_tp_rx_abort(struct j1939_ctx *ctx, uint8_t sa, const struct can_frame *frame) {
+    uint32_t pgn = frame->data[5] | (frame->data[6] << 8) | (frame->data[7] << 16);
+    k_spinlock_key_t key = k_spin_lock(&ctx->lock);
+    struct j1939_rx_session *session = rx_find(ctx, sa, ctx->source_address);
+
+    if (session != NULL && session->pgn == pgn) {
+        ctx->stats.rx_aborted++;
+        rx_close(ctx, session);
     }
-    
-    uint8_t num_packets = (len + 6) / 7;
-    
-    // Send RTS
+    k_spin_unlock(&ctx->lock, key);
+}
+
+
+/* Connection mode sender (RTS/CTS), shared with ETP */
+
+static void cm_tx_finish(struct j1939_cm_tx *tx, int result) {
+    struct j1939_ctx *ctx = tx->ctx;
+    j1939_tx_cb_t cb = tx->cb;
+    void *user_data = tx->user_data;
+    k_spinlock_key_t key;
+
+    k_work_cancel_delayable(&tx->timer);
+
+    key = k_spin_lock(&ctx->lock);
+    tx->state = J1939_TP_TX_IDLE;
+    if (result == -ETIMEDOUT) {
+        ctx->stats.tx_timeouts++;
+    } else if (result < 0) {
+        ctx->stats.tx_aborted++;
+    } else {
+        ctx->stats.tx_done++;
+    }
+    k_spin_unlock(&ctx->lock, key);
+
+    if (cb) {
+        cb(ctx, result, user_data);
+    }
+}
+
+void j1939_cm_tx_abort(struct j1939_cm_tx *tx, uint8_t reason, int result) {
+    tx->ops->send_abort(tx->ctx, tx->da, reason, tx->pgn);
+    cm_tx_finish(tx, result);
+}
+
+// Caller holds ctx->lock. Frames of the cleared window left to send.
+static bool cm_tx_window_open(const struct j1939_cm_tx *tx) {
+    return tx->send_dpo || tx->next_packet <= tx->window_end;
+}
+
+// Confirmation of a frame: next one of the window, or wait for the
+// receiver. A CTS or EOMA may have overtaken the confirmation.
+void j1939_cm_tx_done(const struct device *dev, int error, void *user_data) {
+    struct j1939_cm_tx *tx = user_data;
+    struct j1939_ctx *ctx = tx->ctx;
+    k_spinlock_key_t key = k_spin_lock(&ctx->lock);
+    bool send_now = false;
+
+    if (tx->state != J1939_TP_TX_SENDING) {
+        k_spin_unlock(&ctx->lock, key);
+        return;
+    }
+
+    if (error != 0) {
+        k_spin_unlock(&ctx->lock, key);
+        j1939_cm_tx_abort(tx, J1939_ABORT_RESOURCES, error);
+        return;
+    }
+
+    if (cm_tx_window_open(tx)) {
+        if (tx->ops->from_work_queue) {
+            tx->state = J1939_TP_TX_READY;
+            k_work_reschedule(&tx->timer, K_NO_WAIT);
+        } else {
+            send_now = true;
+        }
+    } else if (tx->next_packet > tx->num_packets) {
+        tx->state = J1939_TP_TX_WAIT_EOMA;
+        k_work_reschedule(&tx->timer, K_MSEC(J1939_TP_T3_MS));
+    } else {
+        tx->state = J1939_TP_TX_WAIT_CTS;
+        k_work_reschedule(&tx->timer, K_MSEC(J1939_TP_T3_MS));
+    }
+    k_spin_unlock(&ctx->lock, key);
+
+    if (send_now) {
+        tx->ops->send_next(ctx, tx);
+    }
+}
+
+uint32_t j1939_cm_tx_next(struct j1939_cm_tx *tx, bool *dpo, uint32_t *window_end) {
+    struct j1939_ctx *ctx = tx->ctx;
+    k_spinlock_key_t key = k_spin_lock(&ctx->lock);
+    uint32_t packet = tx->next_packet;
+
+    if (dpo != NULL) {
+        *dpo = tx->send_dpo;
+    }
+    if (window_end != NULL) {
+        *window_end = tx->window_end;
+    }
+    if (tx->send_dpo) {
+        tx->send_dpo = false;
+    } else {
+        tx->next_packet++;
+    }
+    tx->state = J1939_TP_TX_SENDING;
+    k_work_reschedule(&tx->timer, K_MSEC(J1939_TP_T3_MS));
+    k_spin_unlock(&ctx->lock, key);
+    return packet;
+}
+
+void j1939_cm_tx_send_failed(struct j1939_cm_tx *tx, bool dpo, int error) {
+    struct j1939_ctx *ctx = tx->ctx;
+    k_spinlock_key_t key;
+
+    if (error != -EAGAIN) {
+        cm_tx_finish(tx, error);
+        return;
+    }
+
+    // TX mailboxes full, retry on the next tick
+    key = k_spin_lock(&ctx->lock);
+    if (dpo) {
+        tx->send_dpo = true;
+    } else {
+        tx->next_packet--;
+    }
+    tx->state = J1939_TP_TX_READY;
+    k_work_reschedule(&tx->timer, K_TICKS(1));
+    k_spin_unlock(&ctx->lock, key);
+}
+
+void j1939_cm_tx_cts(struct j1939_cm_tx *tx, uint8_t sa, uint8_t count, uint32_t next,
+                     uint32_t pgn) {
+    struct j1939_ctx *ctx = tx->ctx;
+    k_spinlock_key_t key = k_spin_lock(&ctx->lock);
+    enum j1939_tp_tx_state state = tx->state;
+    uint8_t reason = 0;
+
+    if (state == J1939_TP_TX_IDLE || sa != tx->da || pgn != tx->pgn) {
+        k_spin_unlock(&ctx->lock, key);
+        return;
+    }
+
+    if (state == J1939_TP_TX_SENDING && cm_tx_window_open(tx)) {
+        // Only allowed once the window has been sent
+        reason = J1939_ABORT_CTS_WHILE_SENDING;
+    } else if (count == 0) {
+        // Hold: the receiver needs time, it sends another CTS within T4
+        tx->window_end = 0;
+        tx->state = J1939_TP_TX_WAIT_CTS;
+        k_work_reschedule(&tx->timer, K_MSEC(J1939_TP_T4_MS));
+    } else if (next == 0 || next > tx->num_packets) {
+        reason = J1939_ABORT_BAD_SEQUENCE;
+    } else {
+        // May ask for packets again, the window never runs past the end
+        tx->next_packet = next;
+        tx->window_end = MIN(next + count - 1, tx->num_packets);
+        tx->send_dpo = tx->ops->dpo;
+        if (state != J1939_TP_TX_SENDING) {
+            tx->state = J1939_TP_TX_READY;
+            k_work_reschedule(&tx->timer, K_NO_WAIT);
+        }
+    }
+
+    if (reason) {
+        // Late confirmations of the aborted transfer are ignored
+        tx->state = J1939_TP_TX_IDLE;
+    }
+    k_spin_unlock(&ctx->lock, key);
+
+    if (reason) {
+        j1939_cm_tx_abort(tx, reason, -ECONNABORTED);
+    }
+}
+
+void j1939_cm_tx_end(struct j1939_cm_tx *tx, uint8_t sa, uint32_t pgn, int result) {
+    struct j1939_ctx *ctx = tx->ctx;
+    k_spinlock_key_t key = k_spin_lock(&ctx->lock);
+    bool ours = tx->state != J1939_TP_TX_IDLE && sa == tx->da && pgn == tx->pgn;
+
+    if (ours) {
+        tx->state = J1939_TP_TX_IDLE;
+    }
+    k_spin_unlock(&ctx->lock, key);
+
+    if (ours) {
+        cm_tx_finish(tx, result);
+    }
+}
+
+static void cm_tx_timer(struct k_work *work) {
+    struct k_work_delayable *dwork = k_work_delayable_from_work(work);
+    struct j1939_cm_tx *tx = CONTAINER_OF(dwork, struct j1939_cm_tx, timer);
+    struct j1939_ctx *ctx = tx->ctx;
+    k_spinlock_key_t key = k_spin_lock(&ctx->lock);
+    enum j1939_tp_tx_state state = tx->state;
+
+    k_spin_unlock(&ctx->lock, key);
+
+    switch (state) {
+        case J1939_TP_TX_READY:
+            tx->ops->send_next(ctx, tx);
+            break;
+        case J1939_TP_TX_SENDING:       // No confirmation
+        case J1939_TP_TX_WAIT_CTS:      // T3, or T4 after a hold
+        case J1939_TP_TX_WAIT_EOMA:     // T3
+            j1939_cm_tx_abort(tx, J1939_ABORT_TIMEOUT, -ETIMEDOUT);
+            break;
+        default:
+            break;
+    }
+}
+
+void j1939_cm_tx_init(struct j1939_ctx *ctx, struct j1939_cm_tx *tx,
+                      const struct j1939_cm_tx_ops *ops) {
+    tx->ops = ops;
+    tx->ctx = ctx;
+    tx->state = J1939_TP_TX_IDLE;
+    k_work_init_delayable(&tx->timer, cm_tx_timer);
+}
+
+int j1939_cm_tx_start(struct j1939_cm_tx *tx, uint32_t pgn, uint8_t da, uint32_t num_packets,
+                      j1939_tx_cb_t cb, void *user_data) {
+    struct j1939_ctx *ctx = tx->ctx;
+    k_spinlock_key_t key = k_spin_lock(&ctx->lock);
+
+    if (tx->state != J1939_TP_TX_IDLE) {
+        k_spin_unlock(&ctx->lock, key);
+        return -EBUSY;
+    }
+
+    tx->pgn = pgn;
+    tx->da = da;
+    tx->num_packets = num_packets;
+    tx->next_packet = 1;
+    tx->window_end = 0;
+    tx->send_dpo = false;
+    tx->cb = cb;
+    tx->user_data = user_data;
+    tx->state = J1939_TP_TX_WAIT_CTS;
+    k_work_reschedule(&tx->timer, K_MSEC(J1939_TP_T3_MS));
+    k_spin_unlock(&ctx->lock, key);
+    return 0;
+}
+
+void j1939_cm_tx_cancel(struct j1939_cm_tx *tx) {
+    struct j1939_ctx *ctx = tx->ctx;
+    k_spinlock_key_t key;
+
+    k_work_cancel_delayable(&tx->timer);
+    key = k_spin_lock(&ctx->lock);
+    tx->state = J1939_TP_TX_IDLE;
+    k_spin_unlock(&ctx->lock, key);
+}
+
+// Packets are sent back to back, the next one from the TX confirmation of
+// the previous one
+static void tp_tx_send_packet(struct j1939_ctx *ctx, struct j1939_cm_tx *tx) {
+    struct can_frame frame = {
+        .id = build_j1939_id(J1939_PGN_TP_DT, J1939_PRIORITY_LOW, ctx->source_address, tx->da),
+        .dlc = 8,
+        .flags = CAN_FRAME_IDE
+    };
+    uint8_t seq = j1939_cm_tx_next(tx, NULL, NULL);
+    uint16_t offset = (seq - 1) * TP_DATA_SIZE;
+    uint8_t len = MIN(TP_DATA_SIZE, ctx->tp_tx.len - offset);
+    int ret;
+
+    frame.data[0] = seq;
+    memcpy(&frame.data[1], &ctx->tp_tx.data[offset], len);
+    memset(&frame.data[1 + len], TP_PAD_BYTE, TP_DATA_SIZE - len);
+
+    ret = can_send(ctx->can_dev, &frame, K_NO_WAIT, j1939_cm_tx_done, tx);
+    if (ret != 0) {
+        j1939_cm_tx_send_failed(tx, false, ret);
+    }
+}
+
+static const struct j1939_cm_tx_ops tp_tx_ops = {
+    .send_next = tp_tx_send_packet,
+    .send_abort = tp_send_abort,
+};
+
+int j1939_send_tp_async(struct j1939_ctx *ctx, uint32_t pgn, const uint8_t *data, uint16_t len,
+                        j1939_tx_cb_t cb, void *user_data) {
+    return j1939_send_tp_to_async(ctx, pgn, ctx->dest_address, data, len, cb, user_data);
+}
+
+int j1939_send_tp_to_async(struct j1939_ctx *ctx, uint32_t pgn, uint8_t da, const uint8_t *data,
+                           uint16_t len, j1939_tx_cb_t cb, void *user_data) {
+    uint8_t num_packets = DIV_ROUND_UP(len, TP_DATA_SIZE);
     uint8_t rts_msg[8] = {TP_CM_RTS, len & 0xFF, (len >> 8) & 0xFF, num_packets, 0xFF};
-    rts_msg[5] = pgn & 0xFF;
-    rts_msg[6] = (pgn >> 8) & 0xFF;
-    rts_msg[7] = (pgn >> 16) & 0xFF;
-    
-    int ret = j1939_send_pgn(ctx, J1939_PGN_TP_CM, rts_msg, 8);
-    if (ret < 0) {
+    int ret;
+
+    if (da == J1939_ADDR_GLOBAL) {
+        return j1939_send_bam_async(ctx, pgn, data, len, cb, user_data);
+    }
+    if (len <= 8 || len > J1939_TP_MAX_SIZE) {
+        return -EINVAL;
+    }
+    if (!j1939_address_usable(ctx)) {
+        return -EADDRNOTAVAIL;
+    }
+
+    ret = j1939_cm_tx_start(&ctx->tp_tx.cm, pgn, da, num_packets, cb, user_data);
+    if (ret != 0) {
         return ret;
     }
-    
-    // Send data packets
-    for (uint8_t i = 0; i < num_packets; i++) {
-        uint8_t packet[8];
-        packet[0] = i + 1;
-        uint8_t bytes = MIN(7, len - (i * 7));
-        memcpy(&packet[1], data + (i * 7), bytes);
-        
-        ret = j1939_send_pgn(ctx, J1939_PGN_TP_DT, packet, 8);
-        if (ret < 0) {
-            return ret;
-        }
-        k_sleep(K_MSEC(50)); // Spacing between packets
+    // No CTS can come before the RTS
+    ctx->tp_tx.data = data;
+    ctx->tp_tx.len = len;
+
+    ret = tp_send_cm(ctx, da, rts_msg, pgn);
+    if (ret != 0) {
+        j1939_cm_tx_cancel(&ctx->tp_tx.cm);
     }
-    
+    return ret;
+}
+
+/* Broadcast Announce Message */
+
+static void bam_tx_finish(struct j1939_ctx *ctx, int result) {
+    j1939_tx_cb_t cb = ctx->bam_tx.cb;
+    void *user_data = ctx->bam_tx.user_data;
+    k_spinlock_key_t key = k_spin_lock(&ctx->lock);
+
+    ctx->bam_tx.active = false;
+    if (result < 0) {
+        ctx->stats.tx_aborted++;
+    } else {
+        ctx->stats.tx_done++;
+    }
+    k_spin_unlock(&ctx->lock, key);
+
+    if (cb) {
+        cb(ctx, result, user_data);
+    }
+}
+
+// Sends one TP.DT per expiry, the sending thread is never held up
+static void bam_tx_timer(struct k_work *work) {
+    struct k_work_delayable *dwork = k_work_delayable_from_work(work);
+    struct j1939_ctx *ctx = CONTAINER_OF(dwork, struct j1939_ctx, bam_tx.timer);
+    uint8_t seq = ctx->bam_tx.next_packet;
+    uint16_t offset = (seq - 1) * TP_DATA_SIZE;
+    uint8_t len = MIN(TP_DATA_SIZE, ctx->bam_tx.len - offset);
+    uint8_t packet[8];
+    int ret;
+
+    if (!ctx->bam_tx.active) {
+        return;
+    }
+
+    packet[0] = seq;
+    memcpy(&packet[1], &ctx->bam_tx.data[offset], len);
+    memset(&packet[1 + len], TP_PAD_BYTE, TP_DATA_SIZE - len);
+
+    ret = j1939_send_frame(ctx, J1939_PGN_TP_DT, J1939_PRIORITY_LOW, J1939_ADDR_GLOBAL, packet, 8);
+    if (ret == -EAGAIN) {
+        // TX mailboxes full, retry on the next tick
+        k_work_reschedule(&ctx->bam_tx.timer, K_TICKS(1));
+        return;
+    }
+    if (ret != 0 || seq == ctx->bam_tx.num_packets) {
+        bam_tx_finish(ctx, ret);
+        return;
+    }
+
+    ctx->bam_tx.next_packet++;
+    k_work_reschedule(&ctx->bam_tx.timer, K_MSEC(ctx->bam_interval_ms));
+}
+
+int j1939_send_bam_async(struct j1939_ctx *ctx, uint32_t pgn, const uint8_t *data, uint16_t len,
+                         j1939_tx_cb_t cb, void *user_data) {
+    uint8_t num_packets = DIV_ROUND_UP(len, TP_DATA_SIZE);
+    uint8_t bam_msg[8] = {TP_CM_BAM, len & 0xFF, (len >> 8) & 0xFF, num_packets, 0xFF,
+                          pgn & 0xFF, (pgn >> 8) & 0xFF, (pgn >> 16) & 0xFF};
+    k_spinlock_key_t key;
+    int ret;
+
+    if (len <= 8 || len > J1939_TP_MAX_SIZE) {
+        return -EINVAL;
+    }
+    if (!j1939_address_usable(ctx)) {
+        return -EADDRNOTAVAIL;
+    }
+
+    key = k_spin_lock(&ctx->lock);
+    if (ctx->bam_tx.active) {
+        k_spin_unlock(&ctx->lock, key);
+        return -EBUSY;
+    }
+    ctx->bam_tx.active = true;
+    k_spin_unlock(&ctx->lock, key);
+
+    ctx->bam_tx.pgn = pgn;
+    ctx->bam_tx.data = data;
+    ctx->bam_tx.len = len;
+    ctx->bam_tx.num_packets = num_packets;
+    ctx->bam_tx.next_packet = 1;
+    ctx->bam_tx.cb = cb;
+    ctx->bam_tx.user_data = user_data;
+
+    ret = j1939_send_frame(ctx, J1939_PGN_TP_CM, J1939_PRIORITY_LOW, J1939_ADDR_GLOBAL, bam_msg, 8);
+    if (ret != 0) {
+        ctx->bam_tx.active = false;
+        return ret;
+    }
+
+    k_work_reschedule(&ctx->bam_tx.timer, K_MSEC(ctx->bam_interval_ms));
     return 0;
 }
 
+static void tp_blocking_tx_done(struct j1939_ctx *ctx, int result, void *user_data) {
+    struct k_sem *done = user_data;
+
+    ctx->tp_result = result;
+    k_sem_give(done);
+}
+
+int j1939_send_tp_data(struct j1939_ctx *ctx, uint32_t pgn, const uint8_t *data, uint16_t len) {
+    struct k_sem done;
+    int ret;
+
+    if (len <= 8) {
+        return j1939_send_pgn(ctx, pgn, data, len);
+    }
+
+    k_sem_init(&done, 0, 1);
+    ret = j1939_send_tp_async(ctx, pgn, data, len, tp_blocking_tx_done, &done);
+    if (ret != 0) {
+        return ret;
+    }
+    k_sem_take(&done, K_FOREVER);
+    return ctx->tp_result;
+}
+
 int j1939_send_pgn(struct j1939_ctx *ctx, uint32_t pgn, const uint8_t *data, uint8_t len) {
     struct can_frame frame = {
         .id = build_j1939_id(pgn, J1939_PRIORITY_MEDIUM, ctx->source_address, ctx->dest_address),
@@ -208,48 +924,62 @@ int j1939_send_pgn(struct j1939_ctx *ctx, uint32_t pgn, const uint8_t *data, uin
         .flags = CAN_FRAME_IDE
     };
     
+    if (!j1939_address_usable(ctx)) {
+        return -EADDRNOTAVAIL;
+    }
     memcpy(frame.data, data, len);
     return can_send(ctx->can_dev, &frame, K_MSEC(100), NULL, NULL);
 }
 
 void j1939_process_message(struct j1939_ctx *ctx, struct can_frame *frame) {
-    uint32_t pgn = (frame->id >> 8) & 0x1FFFF;
+    uint32_t pgn = (frame->id >> 8) & 0x3FFFF;
+    uint8_t sa = frame->id & 0xFF;
+    uint8_t da = J1939_ADDR_GLOBAL;
+
+    // PDU1: the PS field is the destination, not part of the PGN
+    if (((pgn >> 8) & 0xFF) < J1939_PDU2_MIN_PF) {
+        da = pgn & 0xFF;
+        pgn &= 0x3FF00;
+        if (da != ctx->source_address && da != J1939_ADDR_GLOBAL) {
+            return;
+        }
+    }
     
     // Handle Transport Protocol messages
     if (pgn == J1939_PGN_TP_CM) {
         uint8_t tp_cmd = frame->data[0];
         switch (tp_cmd) {
             case TP_CM_RTS:
-                handle_tp_rts(ctx, frame);
+                if (da != J1939_ADDR_GLOBAL) {
+                    handle_tp_rts(ctx, sa, frame);
+                }
                 break;
             case TP_CM_CTS:
-                // Implement if needed for multi-packet send
+                j1939_cm_tx_cts(&ctx->tp_tx.cm, sa, frame->data[1], frame->data[2],
+                                sys_get_le24(&frame->data[5]));
                 break;
             case TP_CM_EndOfMsgAck:
-                ctx->tp_in_progress = false;
-                k_sem_give(&tp_sem);
+                j1939_cm_tx_end(&ctx->tp_tx.cm, sa, sys_get_le24(&frame->data[5]), 0);
                 break;
             case TP_CM_BAM:
-                // Implement Broadcast Announce Message handling if needed
+                if (da == J1939_ADDR_GLOBAL) {
+                    handle_bam(ctx, sa, frame);
+                }
                 break;
             case TP_CM_Abort:
-                ctx->tp_in_progress = false;
-                k_sem_give(&tp_sem);
+                j1939_cm_tx_end(&ctx->tp_tx.cm, sa, sys_get_le24(&frame->data[5]),
+                                -ECONNABORTED);
+                handle_tp_rx_abort(ctx, sa, frame);
                 break;
         }
         return;
     }
     
     if (pgn == J1939_PGN_TP_DT) {
-        handle_tp_dt(ctx, frame);
+        handle_tp_dt(ctx, sa, da, frame);
         return;
     }
     
     // Handle standard PGNs
-    for (int i = 0; i < num_handlers; i++) {
-        if (pgn_handlers[i].pgn == pgn) {
-            pgn_handlers[i].handler(ctx, frame->data, frame->dlc);
-            break;
-        }
-    }
+    dispatch_pgn(ctx, pgn, sa, da, frame->data, frame->dlc);
 }
@@ -0,0 +1,15 @@
+# Links the J1939_PGN_HANDLER_DEFINE() handlers into the image, for every
+# application that builds j1939.c.
+#
+#   include(${CMAKE_CURRENT_SOURCE_DIR}/../common/can_protocol/j1939.cmake)
+
+zephyr_linker_sources(SECTIONS ${CMAKE_CURRENT_LIST_DIR}/j1939_handlers.ld)
+
+# Fault reporting of the error handler (CONFIG_J1939_DM) needs the DM1/DM2
+# broadcast and the Request responder
+if(CONFIG_J1939_DM)
+  target_sources(app PRIVATE
+    ${CMAKE_CURRENT_LIST_DIR}/j1939_dm.c
+    ${CMAKE_CURRENT_LIST_DIR}/j1939_request.c
+  )
+endif()
@@ -1,23 +1,35 @@
 #ifndef J1939_H
 #define J1939_H
 
+#include <zephyr/kernel.h>
 #include <zephyr/drivers/can.h>
+#include <zephyr/sys/iterable_sections.h>
 
 // Standard J1939 PGNs
-#define J1939_PGN_ENGINE_TEMP        0xFEE6  // Engine Temperature
+#define J1939_PGN_ENGINE_TEMP        0xFEEE  // Engine Temperature 1 (ET1)
 #define J1939_PGN_VEHICLE_SPEED      0xFEF1  // Vehicle Speed
 #define J1939_PGN_BRAKE_INFO         0xFE4E  // Brake Information
 #define J1939_PGN_TPMS               0xFE4F  // Tire Pressure Monitoring
 #define J1939_PGN_VEHICLE_POSITION   0xFEF3  // GPS Position Data
 #define J1939_PGN_VIN                0xFEEC  // Vehicle Identification
+#define J1939_PGN_COMPONENT_ID       0xFEEB  // Component Identification
 #define J1939_PGN_DIAGNOSTIC         0xFECA  // Diagnostic Message
+#define J1939_PGN_DM1                J1939_PGN_DIAGNOSTIC  // Active DTCs
+#define J1939_PGN_DM2                0xFECB  // Previously active DTCs
 #define J1939_PGN_BATTERY_STATUS     0xFEF4  // Battery Status
 #define J1939_PGN_COLLISION_WARN     0xFEC5  // Collision Warning
 #define J1939_PGN_FAULT_INFO         0xFECE  // Fault Information
 
+// Network management PGNs (J1939-81), PDU1
+#define J1939_PGN_REQUEST           0xEA00  // Request, 3 byte PGN
+#define J1939_PGN_ADDRESS_CLAIMED   0xEE00  // Address Claimed / Cannot Claim
+#define J1939_PGN_ACK               0xE800  // Acknowledgment
+
 // Transport Protocol PGNs
 #define J1939_PGN_TP_CM             0xEC00  // Transport Protocol - Connection Management
 #define J1939_PGN_TP_DT             0xEB00  // Transport Protocol - Data Transfer
+#define J1939_PGN_ETP_CM            0xC800  // Extended TP - Connection Management
+#define J1939_PGN_ETP_DT            0xC700  // Extended TP - Data Transfer
 
 // Transport Protocol commands
 #define TP_CM_RTS                   0x10    // Request to Send
@@ -26,31 +38,315 @@
 #define TP_CM_BAM                   0x20    // Broadcast Announce Message
 #define TP_CM_Abort                 0xFF    // Connection Abort
 
+// Acceptance filters on the PGN bits, ignoring priority and source address.
+// PDU1 PGNs additionally ignore the destination address in the PS field.
+#define J1939_PDU2_FILTER_MASK      0x03FFFF00
+#define J1939_PDU1_FILTER_MASK      0x03FF0000
+#define J1939_PGN_FILTER(_pgn, _mask) \
+    { .id = (uint32_t)(_pgn) << 8, .mask = (_mask), \
+      .flags = CAN_FILTER_IDE | CAN_FILTER_DATA }
+
 // J1939 priorities
 #define J1939_PRIORITY_HIGH         0x00
 #define J1939_PRIORITY_MEDIUM       0x03
+#define J1939_PRIORITY_DEFAULT      0x06    // Requests, address claims
 #define J1939_PRIORITY_LOW          0x07
 
+// Addresses
+#define J1939_ADDR_NULL             0xFE
+#define J1939_ADDR_GLOBAL           0xFF    // Broadcast, TP uses BAM
+#define J1939_ADDR_DYNAMIC_MIN      0x80    // Self-configurable addresses
+#define J1939_ADDR_DYNAMIC_MAX      0xF7
+
+// Addresses in the dynamic range are used once a claim stood this long
+#define J1939_ADDR_CLAIM_MS         250
+
+// Transport protocol (J1939-21)
+#define J1939_TP_PACKET_SIZE        7       // Payload bytes per TP.DT
+#define J1939_TP_MAX_SIZE           1785    // 255 packets
+#define J1939_TP_T1_MS              750     // Receiver waiting for the next TP.DT
+#define J1939_TP_T2_MS              1250    // Receiver waiting for data after a CTS
+#define J1939_TP_T3_MS              1250    // Sender waiting for a CTS or EOMA
+#define J1939_TP_T4_MS              1050    // Sender waiting for a CTS after a hold
+#define J1939_TP_TH_MS              500     // Receiver repeating a hold CTS
+
+// TP.Conn_Abort reasons
+#define J1939_ABORT_BUSY            1       // Already in a session
+#define J1939_ABORT_RESOURCES       2       // No buffer or invalid request
+#define J1939_ABORT_TIMEOUT         3
+#define J1939_ABORT_CTS_WHILE_SENDING 4
+#define J1939_ABORT_BAD_SEQUENCE    7
+#define J1939_ABORT_UNEXPECTED_DPO  9       // ETP only
+#define J1939_ABORT_BAD_DPO_OFFSET  10
+#define J1939_ABORT_DPO_PACKETS     12      // DPO for more packets than cleared
+
+// BAM packets are spaced 50-200 ms apart
+#define J1939_BAM_INTERVAL_MIN_MS   50
+#define J1939_BAM_INTERVAL_MAX_MS   200
+
+// Transfers a context receives at the same time, broadcasts and
+// connections, one per (source, destination) pair
+#define J1939_TP_SESSIONS           8
+
+// J1939_TP_MAX_SIZE buffers in the pool shared by contexts without their
+// own tp_pool, a session holds one until its message is handled
+#define J1939_TP_POOL_BUFFERS       4
+
+// PGN handlers, static and registered at run time together
+#define J1939_MAX_PGN_HANDLERS      32
+
+// PGNs a context answers Requests for (j1939_request.c)
+#define J1939_MAX_RESPONSES         8
+
+struct j1939_ctx;
+struct j1939_response;
+struct j1939_etp;
+
+// Called with a single frame or a reassembled message. The sender and
+// destination are in ctx->rx_sa and ctx->rx_da. Runs in the CAN RX
+// callback, usually an ISR, or wherever j1939_process_message() is called
+// with manual_rx: must not block. j1939_send_frame() and the async
+// transfers are fine, j1939_send_pgn() and j1939_send_tp_data() are not.
+typedef void (*j1939_pgn_handler_t)(struct j1939_ctx *ctx, const uint8_t *data, uint16_t len);
+
+// Handler for a PGN from one source address, or from any source with
+// J1939_ADDR_GLOBAL. Every matching handler of a PGN is called.
+struct j1939_pgn_handler {
+    uint32_t pgn;
+    uint8_t sa;
+    j1939_pgn_handler_t handler;
+};
+
+// Register a handler at build time, placed in a linker section that
+// j1939_init() indexes. Needs common/can_protocol/j1939.cmake in the build.
+#define J1939_PGN_HANDLER_DEFINE(name, _pgn, _sa, _handler)                  \
+    static const STRUCT_SECTION_ITERABLE(j1939_pgn_handler, name) = {        \
+        .pgn = (_pgn), .sa = (_sa), .handler = (_handler),                   \
+    }
+
+// Reception of a multi-packet message, BAM when da is global
+struct j1939_rx_session {
+    struct j1939_ctx *ctx;
+    bool active;
+    uint8_t sa;
+    uint8_t da;
+    uint32_t pgn;
+    uint16_t total_size;
+    uint8_t num_packets;
+    uint16_t next_packet;       // 256 once all 255 packets are in
+    uint8_t window;
+    uint8_t window_end;         // Last packet cleared by our CTS
+    uint8_t *data;              // From the context's tp_pool
+    struct k_work_delayable timer;  // T1 between packets, T2 after a CTS
+};
+
+// Transfer finished with 0 or a negative errno. Runs in the context that
+// ended the transfer: the CAN TX confirmation or RX callback (an ISR with
+// most drivers, see manual_rx) or the system work queue. Must not block;
+// hand longer work to a work item.
+typedef void (*j1939_tx_cb_t)(struct j1939_ctx *ctx, int result, void *user_data);
+
+enum j1939_tp_tx_state {
+    J1939_TP_TX_IDLE,
+    J1939_TP_TX_WAIT_CTS,       // RTS sent or window done (T3), or on hold (T4)
+    J1939_TP_TX_READY,          // Window open, next packet on the work queue
+    J1939_TP_TX_SENDING,        // Packet queued, waiting for confirmation
+    J1939_TP_TX_WAIT_EOMA,      // All packets sent (T3)
+};
+
+struct j1939_cm_tx;
+
+// What differs between the TP and ETP senders
+struct j1939_cm_tx_ops {
+    // Next frame of the cleared window: takes it with j1939_cm_tx_next()
+    // and queues it with j1939_cm_tx_done as the TX callback
+    void (*send_next)(struct j1939_ctx *ctx, struct j1939_cm_tx *tx);
+    // Connection abort to da
+    void (*send_abort)(struct j1939_ctx *ctx, uint8_t da, uint8_t reason, uint32_t pgn);
+    bool dpo;                   // Each window starts with a DPO (ETP)
+    bool from_work_queue;       // send_next never runs in a TX callback
+};
+
+// Sender side of RTS/CTS, shared by TP and ETP: the windows the receiver
+// clears, holds, the T3/T4 timeouts and the end of the transfer
+struct j1939_cm_tx {
+    const struct j1939_cm_tx_ops *ops;
+    struct j1939_ctx *ctx;
+    enum j1939_tp_tx_state state;
+    bool send_dpo;              // The cleared window starts with a DPO
+    uint32_t pgn;
+    uint8_t da;
+    uint32_t num_packets;
+    uint32_t next_packet;       // Counted from 1 over the whole transfer
+    uint32_t window_end;        // Last packet cleared by the receiver's CTS
+    j1939_tx_cb_t cb;
+    void *user_data;
+    struct k_work_delayable timer;
+};
+
+enum j1939_addr_state {
+    J1939_ADDR_FIXED,           // source_address used as is, no NAME
+    J1939_ADDR_CLAIMING,        // Claim sent, waiting J1939_ADDR_CLAIM_MS
+    J1939_ADDR_CLAIMED,
+    J1939_ADDR_CANNOT_CLAIM,    // Lost arbitration, no address left
+};
+
+// NAMEs of the nodes on the bus by claimed address
+struct j1939_addr_table {
+    uint64_t name[J1939_ADDR_NULL];
+    uint32_t claimed[DIV_ROUND_UP(J1939_ADDR_NULL, 32)];
+};
+
+// Multi-packet transfers, BAM and RTS/CTS, and Requests
+struct j1939_stats {
+    uint32_t rx_done;
+    uint32_t rx_aborted;        // Sequence error, abort or restart by the sender
+    uint32_t rx_timeouts;       // T1/T2
+    uint32_t rx_dropped;        // No session or buffer free
+    uint32_t tx_done;
+    uint32_t tx_aborted;        // Abort by either side, CAN error
+    uint32_t tx_timeouts;       // T3/T4
+    uint32_t requests_answered;
+    uint32_t requests_refused;  // NACK, or busy sending the response
+};
+
 struct j1939_ctx {
     const struct device *can_dev;
-    uint8_t source_address;
+    uint8_t source_address;     // Preferred address with a NAME, see j1939_claim_address()
     uint8_t dest_address;
+    uint64_t name;              // J1939-81 NAME, 0 for a fixed source_address
+    bool manual_rx;             // Frames are pushed with j1939_process_message(), no RX filter
+    uint16_t bam_interval_ms;   // TP.DT spacing of our broadcasts, 0 means the minimum
+    uint8_t tp_rx_window;       // Packets granted per CTS as receiver, 0 means no limit
+    struct k_mem_slab *tp_pool; // J1939_TP_MAX_SIZE blocks, NULL means the shared pool
+
+    struct j1939_stats stats;
+
+    // Addresses of the message being dispatched, valid in a PGN handler
+    uint8_t rx_sa;
+    uint8_t rx_da;
+
+    // Internal state, set up by j1939_init()
+    struct k_spinlock lock;
+    int filter_id;              // Frames to source_address
+    enum j1939_addr_state addr_state;
+    bool addr_claim_pending;    // New source_address to claim on the work queue
+    struct k_work_delayable addr_timer;
+    struct j1939_addr_table addr_table;
+    struct j1939_response *responses[J1939_MAX_RESPONSES];
+    uint8_t num_responses;
+    struct j1939_etp *etp;      // Set by j1939_etp_init()
+    struct j1939_rx_session rx_sessions[J1939_TP_SESSIONS];
     struct {
+        bool active;
         uint32_t pgn;
-        uint16_t total_size;
+        const uint8_t *data;
+        uint16_t len;
         uint8_t num_packets;
         uint8_t next_packet;
-        uint8_t *data;
-    } tp_session;
-    bool tp_in_progress;
+        j1939_tx_cb_t cb;
+        void *user_data;
+        struct k_work_delayable timer;
+    } bam_tx;
+    struct {
+        struct j1939_cm_tx cm;
+        const uint8_t *data;
+        uint16_t len;
+    } tp_tx;
+    int tp_result;
 };
 
 // Function prototypes
 int j1939_init(struct j1939_ctx *ctx);
+
+// Single frame with the context's priority and destination. Fails with
+// -EADDRNOTAVAIL while the context has no usable address.
 int j1939_send_pgn(struct j1939_ctx *ctx, uint32_t pgn, const uint8_t *data, uint8_t len);
+
+// Single frame to da, queued without waiting for a mailbox
+int j1939_send_frame(struct j1939_ctx *ctx, uint32_t pgn, uint8_t priority, uint8_t da,
+                     const uint8_t *data, uint8_t len);
+
+// The same with a TX confirmation callback, -EAGAIN when the mailboxes are full
+int j1939_send_frame_cb(struct j1939_ctx *ctx, uint32_t pgn, uint8_t priority, uint8_t da,
+                        const uint8_t *data, uint8_t len, can_tx_callback_t cb,
+                        void *user_data);
+
+// Change source_address and move the RX filter for frames to it. Not from
+// a CAN RX callback. J1939_ADDR_NULL leaves only broadcasts.
+int j1939_set_address(struct j1939_ctx *ctx, uint8_t address);
+
+static inline bool j1939_address_usable(const struct j1939_ctx *ctx) {
+    return ctx->addr_state == J1939_ADDR_FIXED || ctx->addr_state == J1939_ADDR_CLAIMED;
+}
+
+// PGN of a 29-bit ID, the PS byte of a PDU1 PGN is the destination
+static inline uint32_t j1939_id_to_pgn(uint32_t id) {
+    uint32_t pgn = (id >> 8) & 0x3FFFF;
+
+    return ((pgn >> 8) & 0xFF) < 0xF0 ? pgn & 0x3FF00 : pgn;
+}
+
+// Multi-packet transfer of 9 to J1939_TP_MAX_SIZE bytes to dest_address,
+// started with RTS and sent in the windows the receiver clears with CTS.
+// A global dest_address broadcasts with BAM. Returns once the RTS is out,
+// data must stay valid until cb. -EBUSY while a transfer is in progress.
+int j1939_send_tp_async(struct j1939_ctx *ctx, uint32_t pgn, const uint8_t *data, uint16_t len,
+                        j1939_tx_cb_t cb, void *user_data);
+
+// The same to da instead of dest_address
+int j1939_send_tp_to_async(struct j1939_ctx *ctx, uint32_t pgn, uint8_t da, const uint8_t *data,
+                           uint16_t len, j1939_tx_cb_t cb, void *user_data);
+
+// Blocking wrapper, must not be called from the system work queue
 int j1939_send_tp_data(struct j1939_ctx *ctx, uint32_t pgn, const uint8_t *data, uint16_t len);
+
+// Start a BAM broadcast of 9 to J1939_TP_MAX_SIZE bytes and return. The
+// packets are paced by a timer, data must stay valid until cb. -EBUSY while
+// a broadcast is in progress.
+int j1939_send_bam_async(struct j1939_ctx *ctx, uint32_t pgn, const uint8_t *data, uint16_t len,
+                         j1939_tx_cb_t cb, void *user_data);
+
 void j1939_process_message(struct j1939_ctx *ctx, struct can_frame *frame);
-int j1939_register_pgn_handler(uint32_t pgn, void (*handler)(struct j1939_ctx *, const uint8_t *, uint16_t));
+
+// Handlers registered at run time, after the static ones of the same PGN.
+// Register before frames arrive, the dispatch index is rebuilt each time.
+// -ENOMEM once J1939_MAX_PGN_HANDLERS are in use.
+int j1939_register_pgn_handler(uint32_t pgn, j1939_pgn_handler_t handler);
+int j1939_register_pgn_handler_from(uint32_t pgn, uint8_t sa, j1939_pgn_handler_t handler);
+
+// RTS/CTS sender for the transport protocols, j1939.c and j1939_etp.c.
+// The caller parses the TP.CM or ETP.CM frames, the rest is common.
+void j1939_cm_tx_init(struct j1939_ctx *ctx, struct j1939_cm_tx *tx,
+                      const struct j1939_cm_tx_ops *ops);
+
+// Reserve the sender and wait T3 for the first CTS. The caller sends the
+// RTS and calls j1939_cm_tx_cancel() if it cannot. -EBUSY while a
+// transfer is in progress.
+int j1939_cm_tx_start(struct j1939_cm_tx *tx, uint32_t pgn, uint8_t da, uint32_t num_packets,
+                      j1939_tx_cb_t cb, void *user_data);
+void j1939_cm_tx_cancel(struct j1939_cm_tx *tx);
+
+// In send_next: the packet number of the next frame, a DPO announcing the
+// window up to *window_end when *dpo. Either may be NULL.
+uint32_t j1939_cm_tx_next(struct j1939_cm_tx *tx, bool *dpo, uint32_t *window_end);
+
+// In send_next when the frame could not be queued: -EAGAIN retries on the
+// next tick, any other error ends the transfer
+void j1939_cm_tx_send_failed(struct j1939_cm_tx *tx, bool dpo, int error);
+
+// Ends the transfer with an abort to the receiver
+void j1939_cm_tx_abort(struct j1939_cm_tx *tx, uint8_t reason, int result);
+
+// TX callback of the frames send_next queues, user_data is the sender
+void j1939_cm_tx_done(const struct device *dev, int error, void *user_data);
+
+// CTS from sa, count 0 holds the transfer for up to T4
+void j1939_cm_tx_cts(struct j1939_cm_tx *tx, uint8_t sa, uint8_t count, uint32_t next,
+                     uint32_t pgn);
+
+// EOMA (result 0) or Abort from sa
+void j1939_cm_tx_end(struct j1939_cm_tx *tx, uint8_t sa, uint32_t pgn, int result);
 
 // Error codes
 #define J1939_ERR_TP_TIMEOUT       -1
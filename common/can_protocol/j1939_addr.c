@@ -0,0 +1,176 @@
+#include <zephyr/kernel.h>
+#include <zephyr/sys/byteorder.h>
+#include "j1939_addr.h"
+
+static bool table_claimed(const struct j1939_addr_table *table, uint8_t sa) {
+    return table->claimed[sa / 32] & BIT(sa % 32);
+}
+
+static void table_remove(struct j1939_addr_table *table, uint64_t name) {
+    for (int sa = 0; sa < J1939_ADDR_NULL; sa++) {
+        if (table_claimed(table, sa) && table->name[sa] == name) {
+            table->claimed[sa / 32] &= ~BIT(sa % 32);
+        }
+    }
+}
+
+// A NAME holds one address, its previous claim is dropped
+static void table_set(struct j1939_addr_table *table, uint8_t sa, uint64_t name) {
+    table_remove(table, name);
+    table->name[sa] = name;
+    table->claimed[sa / 32] |= BIT(sa % 32);
+}
+
+// Caller holds ctx->lock. Next unclaimed dynamic address after ours,
+// J1939_ADDR_NULL when all are taken.
+static uint8_t next_free_address(struct j1939_ctx *ctx) {
+    uint8_t address = ctx->source_address;
+
+    for (int i = 0; i <= J1939_ADDR_DYNAMIC_MAX - J1939_ADDR_DYNAMIC_MIN; i++) {
+        if (address < J1939_ADDR_DYNAMIC_MIN || address >= J1939_ADDR_DYNAMIC_MAX) {
+            address = J1939_ADDR_DYNAMIC_MIN;
+        } else {
+            address++;
+        }
+        if (!table_claimed(&ctx->addr_table, address)) {
+            return address;
+        }
+    }
+    return J1939_ADDR_NULL;
+}
+
+// Address Claimed from source_address, Cannot Claim from the null address
+static void send_claim(struct j1939_ctx *ctx) {
+    uint8_t data[8];
+
+    sys_put_le64(ctx->name, data);
+    j1939_send_frame(ctx, J1939_PGN_ADDRESS_CLAIMED, J1939_PRIORITY_DEFAULT, J1939_ADDR_GLOBAL,
+                     data, sizeof(data));
+}
+
+// Move to source_address and announce it. Addresses outside the dynamic
+// range are used at once, the others after J1939_ADDR_CLAIM_MS.
+static void addr_claim(struct j1939_ctx *ctx) {
+    uint8_t address = ctx->source_address;
+    k_spinlock_key_t key;
+
+    j1939_set_address(ctx, address);
+    send_claim(ctx);
+
+    key = k_spin_lock(&ctx->lock);
+    if (address == J1939_ADDR_NULL) {
+        ctx->addr_state = J1939_ADDR_CANNOT_CLAIM;
+    } else if (address < J1939_ADDR_DYNAMIC_MIN || address > J1939_ADDR_DYNAMIC_MAX) {
+        table_set(&ctx->addr_table, address, ctx->name);
+        ctx->addr_state = J1939_ADDR_CLAIMED;
+    } else {
+        table_set(&ctx->addr_table, address, ctx->name);
+        k_work_reschedule(&ctx->addr_timer, K_MSEC(J1939_ADDR_CLAIM_MS));
+    }
+    k_spin_unlock(&ctx->lock, key);
+}
+
+static void addr_timer(struct k_work *work) {
+    struct k_work_delayable *dwork = k_work_delayable_from_work(work);
+    struct j1939_ctx *ctx = CONTAINER_OF(dwork, struct j1939_ctx, addr_timer);
+    k_spinlock_key_t key = k_spin_lock(&ctx->lock);
+
+    // Lost arbitration, the RX path picked the next address
+    if (ctx->addr_claim_pending) {
+        ctx->addr_claim_pending = false;
+        k_spin_unlock(&ctx->lock, key);
+        addr_claim(ctx);
+        return;
+    }
+
+    // No contending claim within 250 ms
+    if (ctx->addr_state == J1939_ADDR_CLAIMING) {
+        ctx->addr_state = J1939_ADDR_CLAIMED;
+    }
+    k_spin_unlock(&ctx->lock, key);
+}
+
+int j1939_claim_address(struct j1939_ctx *ctx) {
+    if (ctx->name == 0 || ctx->source_address >= J1939_ADDR_NULL) {
+        return -EINVAL;
+    }
+
+    k_work_init_delayable(&ctx->addr_timer, addr_timer);
+    ctx->addr_claim_pending = false;
+    ctx->addr_state = J1939_ADDR_CLAIMING;
+    addr_claim(ctx);
+    return 0;
+}
+
+int j1939_addr_lookup(struct j1939_ctx *ctx, uint8_t sa, uint64_t *name) {
+    k_spinlock_key_t key;
+    int ret = 0;
+
+    if (sa >= J1939_ADDR_NULL) {
+        return -EINVAL;
+    }
+
+    key = k_spin_lock(&ctx->lock);
+    if (table_claimed(&ctx->addr_table, sa)) {
+        *name = ctx->addr_table.name[sa];
+    } else {
+        ret = -ENOENT;
+    }
+    k_spin_unlock(&ctx->lock, key);
+    return ret;
+}
+
+static void address_claimed(struct j1939_ctx *ctx, const uint8_t *data, uint16_t len) {
+    uint8_t sa = ctx->rx_sa;
+    bool defend = false;
+    k_spinlock_key_t key;
+    uint64_t name;
+
+    if (len < 8) {
+        return;
+    }
+    name = sys_get_le64(data);
+    if (ctx->name != 0 && name == ctx->name) {
+        return;     // Our own claim, looped back
+    }
+
+    key = k_spin_lock(&ctx->lock);
+    if (sa == J1939_ADDR_NULL) {
+        table_remove(&ctx->addr_table, name);
+    } else if (ctx->name == 0 || sa != ctx->source_address) {
+        table_set(&ctx->addr_table, sa, name);
+    } else if (ctx->name < name) {
+        defend = true;
+    } else {
+        // Lost our address. The new one is claimed from the work queue,
+        // which can move the RX filter.
+        table_set(&ctx->addr_table, sa, name);
+        if (ctx->name & J1939_NAME_ARBITRARY_ADDRESS) {
+            ctx->source_address = next_free_address(ctx);
+        } else {
+            ctx->source_address = J1939_ADDR_NULL;
+        }
+        ctx->addr_state = ctx->source_address == J1939_ADDR_NULL ?
+                          J1939_ADDR_CANNOT_CLAIM : J1939_ADDR_CLAIMING;
+        ctx->addr_claim_pending = true;
+        k_work_reschedule(&ctx->addr_timer, K_NO_WAIT);
+    }
+    k_spin_unlock(&ctx->lock, key);
+
+    if (defend) {
+        send_claim(ctx);
+    }
+}
+
+// Request for Address Claimed, to everyone or to us
+static void address_requested(struct j1939_ctx *ctx, const uint8_t *data, uint16_t len) {
+    if (len < 3 || sys_get_le24(data) != J1939_PGN_ADDRESS_CLAIMED || ctx->name == 0) {
+        return;
+    }
+    send_claim(ctx);
+}
+
+J1939_PGN_HANDLER_DEFINE(j1939_address_claimed, J1939_PGN_ADDRESS_CLAIMED, J1939_ADDR_GLOBAL,
+                         address_claimed);
+J1939_PGN_HANDLER_DEFINE(j1939_address_request, J1939_PGN_REQUEST, J1939_ADDR_GLOBAL,
+                         address_requested);
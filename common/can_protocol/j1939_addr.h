@@ -0,0 +1,31 @@
+#ifndef J1939_ADDR_H
+#define J1939_ADDR_H
+
+#include <zephyr/kernel.h>
+#include "j1939.h"
+
+// J1939-81 NAME. The lower value wins address arbitration.
+#define J1939_NAME_ARBITRARY_ADDRESS    BIT64(63)
+
+#define J1939_NAME(aac, industry_group, vs_instance, vehicle_system, function,      \
+                   function_instance, ecu_instance, manufacturer, identity)        \
+    (((uint64_t)(aac) << 63) | ((uint64_t)((industry_group) & 0x7) << 60) |        \
+     ((uint64_t)((vs_instance) & 0xF) << 56) |                                     \
+     ((uint64_t)((vehicle_system) & 0x7F) << 49) |                                 \
+     ((uint64_t)((function) & 0xFF) << 40) |                                       \
+     ((uint64_t)((function_instance) & 0x1F) << 35) |                              \
+     ((uint64_t)((ecu_instance) & 0x7) << 32) |                                    \
+     ((uint64_t)((manufacturer) & 0x7FF) << 21) | ((identity) & 0x1FFFFF))
+
+// Claim source_address as preferred address with ctx->name, once after
+// j1939_init(). A claim from a node with a lower NAME moves an arbitrary
+// address capable context to the next free address in
+// J1939_ADDR_DYNAMIC_MIN-J1939_ADDR_DYNAMIC_MAX, others send Cannot Claim
+// and stay silent. The RX filter follows the address. Sending fails with
+// -EADDRNOTAVAIL until the claim has stood.
+int j1939_claim_address(struct j1939_ctx *ctx);
+
+// NAME of the node that claimed sa, -ENOENT if none did
+int j1939_addr_lookup(struct j1939_ctx *ctx, uint8_t sa, uint64_t *name);
+
+#endif /* J1939_ADDR_H */
@@ -0,0 +1,272 @@
+#include <zephyr/kernel.h>
+#include <string.h>
+#include "j1939_dm.h"
+#include "j1939_request.h"
+
+#define DTC_SIZE        4
+#define DTC_KEY_SIZE    3       // SPN and FMI, the occurrence count follows
+#define DTC_OC_MAX      126     // 127 means not available
+#define DM_FLASH_NONE   0xFF
+#define DM_NUM_LAMPS    4
+
+// DTCs packed the way they are sent, updated in place on every change.
+// An empty list reads as one all-zero DTC, a frame is padded with 0xFF.
+struct dm_list {
+    uint8_t image[J1939_DM_IMAGE_SIZE];
+    uint8_t lamps[J1939_DM_MAX_DTCS];
+    uint8_t num_dtcs;
+};
+
+static struct dm_list dm1 = { .image = {0x00, DM_FLASH_NONE, 0, 0, 0, 0, 0xFF, 0xFF} };
+static struct dm_list dm2 = { .image = {0x00, DM_FLASH_NONE, 0, 0, 0, 0, 0xFF, 0xFF} };
+static uint8_t lamp_counts[DM_NUM_LAMPS];  // Active DTCs lighting each lamp
+static bool responses_stale;
+static struct k_spinlock dm_lock;
+
+// Broadcast, only touched on the system work queue
+static struct j1939_ctx *dm_ctx;
+static bool dm_running;
+static bool dm1_sending;
+static uint8_t dm1_tx[J1939_DM_IMAGE_SIZE];    // Read by the BAM in progress
+static struct k_work_delayable dm1_timer;
+static struct k_work_delayable refresh_work;  // Request responses
+
+J1939_RESPONSE_DEFINE(dm1_response, J1939_PGN_DM1, J1939_DM_IMAGE_SIZE);
+J1939_RESPONSE_DEFINE(dm2_response, J1939_PGN_DM2, J1939_DM_IMAGE_SIZE);
+
+static uint16_t list_len(const struct dm_list *list) {
+    return MAX(8, 2 + DTC_SIZE * list->num_dtcs);
+}
+
+static int list_find(const struct dm_list *list, const uint8_t *key) {
+    for (int i = 0; i < list->num_dtcs; i++) {
+        if (memcmp(&list->image[2 + DTC_SIZE * i], key, DTC_KEY_SIZE) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void list_pad(struct dm_list *list) {
+    if (list->num_dtcs == 0) {
+        memset(&list->image[2], 0, DTC_SIZE);
+    }
+    if (list->num_dtcs <= 1) {
+        list->image[6] = 0xFF;
+        list->image[7] = 0xFF;
+    }
+}
+
+static void list_add(struct dm_list *list, const uint8_t *key, uint8_t oc, uint8_t lamps) {
+    uint8_t *dtc = &list->image[2 + DTC_SIZE * list->num_dtcs];
+
+    memcpy(dtc, key, DTC_KEY_SIZE);
+    dtc[3] = oc;
+    list->lamps[list->num_dtcs++] = lamps;
+    list_pad(list);
+}
+
+// The last DTC takes the place of the removed one
+static void list_remove(struct dm_list *list, int index) {
+    int last = --list->num_dtcs;
+
+    memcpy(&list->image[2 + DTC_SIZE * index], &list->image[2 + DTC_SIZE * last], DTC_SIZE);
+    list->lamps[index] = list->lamps[last];
+    list_pad(list);
+}
+
+static void dm1_lamps_update(uint8_t lamps, int delta) {
+    uint8_t status = 0;
+
+    for (int i = 0; i < DM_NUM_LAMPS; i++) {
+        if (lamps & BIT(2 * i)) {
+            lamp_counts[i] += delta;
+        }
+        if (lamp_counts[i] > 0) {
+            status |= BIT(2 * i);
+        }
+    }
+    dm1.image[0] = status;
+}
+
+static void dtc_key(uint8_t key[DTC_KEY_SIZE], uint32_t spn, uint8_t fmi) {
+    key[0] = spn & 0xFF;
+    key[1] = (spn >> 8) & 0xFF;
+    key[2] = ((spn >> 16) & 0x07) << 5 | fmi;
+}
+
+// Caller holds dm_lock
+static void dm_changed(void) {
+    responses_stale = true;
+    if (dm_ctx != NULL) {
+        k_work_reschedule(&refresh_work, K_NO_WAIT);
+        k_work_reschedule(&dm1_timer, K_NO_WAIT);
+    }
+}
+
+static void dm1_sent(struct j1939_ctx *ctx, int result, void *user_data) {
+    dm1_sending = false;
+}
+
+// Copies the lists into the Request responses. Retried until both took
+// the new image, independent of the DM1 broadcast.
+static void refresh_work_handler(struct k_work *work) {
+    uint8_t image1[J1939_DM_IMAGE_SIZE];
+    uint8_t image2[J1939_DM_IMAGE_SIZE];
+    k_spinlock_key_t key = k_spin_lock(&dm_lock);
+    uint16_t len1 = list_len(&dm1);
+    uint16_t len2 = list_len(&dm2);
+
+    if (!responses_stale) {
+        k_spin_unlock(&dm_lock, key);
+        return;
+    }
+    memcpy(image1, dm1.image, len1);
+    memcpy(image2, dm2.image, len2);
+    responses_stale = false;
+    k_spin_unlock(&dm_lock, key);
+
+    if (j1939_response_update(dm_ctx, &dm1_response, image1, len1) != 0 ||
+        j1939_response_update(dm_ctx, &dm2_response, image2, len2) != 0) {
+        key = k_spin_lock(&dm_lock);
+        responses_stale = true;
+        k_spin_unlock(&dm_lock, key);
+        k_work_reschedule(&refresh_work, K_MSEC(J1939_BAM_INTERVAL_MIN_MS));
+    }
+}
+
+// Sends DM1 every second and right after a change. A DM1 that could not go
+// out, our BAM still in progress or no TX buffer, is retried shortly.
+static void dm1_timer_handler(struct k_work *work) {
+    uint8_t image[J1939_DM_IMAGE_SIZE];
+    k_spinlock_key_t key;
+    uint16_t len;
+    int ret;
+
+    if (!dm_running) {
+        return;
+    }
+
+    key = k_spin_lock(&dm_lock);
+    len = list_len(&dm1);
+    memcpy(image, dm1.image, len);
+    k_spin_unlock(&dm_lock, key);
+
+    if (len <= 8) {
+        ret = j1939_send_frame(dm_ctx, J1939_PGN_DM1, J1939_PRIORITY_DEFAULT,
+                               J1939_ADDR_GLOBAL, image, len);
+    } else if (dm1_sending) {
+        ret = -EBUSY;
+    } else {
+        memcpy(dm1_tx, image, len);
+        dm1_sending = true;
+        ret = j1939_send_bam_async(dm_ctx, J1939_PGN_DM1, dm1_tx, len, dm1_sent, NULL);
+        if (ret != 0) {
+            dm1_sending = false;
+        }
+    }
+
+    k_work_reschedule(&dm1_timer, K_MSEC(ret != 0 ? J1939_BAM_INTERVAL_MIN_MS :
+                                         J1939_DM1_INTERVAL_MS));
+}
+
+int j1939_dm_init(struct j1939_ctx *ctx) {
+    k_spinlock_key_t key;
+    int ret;
+
+    ret = j1939_response_register(ctx, &dm1_response);
+    if (ret == 0) {
+        ret = j1939_response_register(ctx, &dm2_response);
+    }
+    if (ret != 0) {
+        return ret;
+    }
+
+    k_work_init_delayable(&dm1_timer, dm1_timer_handler);
+    k_work_init_delayable(&refresh_work, refresh_work_handler);
+    dm_running = true;
+    key = k_spin_lock(&dm_lock);
+    dm_ctx = ctx;
+    dm_changed();
+    k_spin_unlock(&dm_lock, key);
+    return 0;
+}
+
+void j1939_dm_stop(void) {
+    dm_running = false;
+    k_work_cancel_delayable(&dm1_timer);
+}
+
+int j1939_dm_set(uint32_t spn, uint8_t fmi, uint8_t lamps) {
+    uint8_t key[DTC_KEY_SIZE];
+    k_spinlock_key_t lock_key;
+    uint8_t oc = 1;
+    int ret = 0;
+    int i;
+
+    if (spn > J1939_SPN_MAX || fmi > J1939_FMI_MAX) {
+        return -EINVAL;
+    }
+    dtc_key(key, spn, fmi);
+
+    lock_key = k_spin_lock(&dm_lock);
+    if (list_find(&dm1, key) >= 0) {
+        // Already active
+    } else if (dm1.num_dtcs >= J1939_DM_MAX_DTCS) {
+        ret = -ENOMEM;
+    } else {
+        i = list_find(&dm2, key);
+        if (i >= 0) {
+            oc = MIN(dm2.image[2 + DTC_SIZE * i + 3] + 1, DTC_OC_MAX);
+            list_remove(&dm2, i);
+        }
+        list_add(&dm1, key, oc, lamps);
+        dm1_lamps_update(lamps, 1);
+        dm_changed();
+    }
+    k_spin_unlock(&dm_lock, lock_key);
+    return ret;
+}
+
+int j1939_dm_clear(uint32_t spn, uint8_t fmi) {
+    uint8_t key[DTC_KEY_SIZE];
+    k_spinlock_key_t lock_key;
+    uint8_t lamps;
+    uint8_t oc;
+    int i;
+
+    if (spn > J1939_SPN_MAX || fmi > J1939_FMI_MAX) {
+        return -EINVAL;
+    }
+    dtc_key(key, spn, fmi);
+
+    lock_key = k_spin_lock(&dm_lock);
+    i = list_find(&dm1, key);
+    if (i < 0) {
+        k_spin_unlock(&dm_lock, lock_key);
+        return -ENOENT;
+    }
+
+    oc = dm1.image[2 + DTC_SIZE * i + 3];
+    lamps = dm1.lamps[i];
+    list_remove(&dm1, i);
+    dm1_lamps_update(lamps, -1);
+
+    // A full DM2 gives up one of its DTCs
+    if (dm2.num_dtcs >= J1939_DM_MAX_DTCS) {
+        list_remove(&dm2, 0);
+    }
+    list_add(&dm2, key, oc, lamps);
+    dm_changed();
+    k_spin_unlock(&dm_lock, lock_key);
+    return 0;
+}
+
+void j1939_dm_clear_previous(void) {
+    k_spinlock_key_t key = k_spin_lock(&dm_lock);
+
+    dm2.num_dtcs = 0;
+    list_pad(&dm2);
+    dm_changed();
+    k_spin_unlock(&dm_lock, key);
+}
@@ -0,0 +1,43 @@
+#ifndef J1939_DM_H
+#define J1939_DM_H
+
+#include <zephyr/kernel.h>
+#include "j1939.h"
+
+#define J1939_DM_MAX_DTCS           16      // Per list, active and previously active
+#define J1939_DM1_INTERVAL_MS       1000
+
+// Lamp status byte, on states of malfunction indicator, red stop, amber
+// warning and protect lamp
+#define J1939_LAMP_MIL              0x40
+#define J1939_LAMP_RED_STOP         0x10
+#define J1939_LAMP_AMBER            0x04
+#define J1939_LAMP_PROTECT          0x01
+
+#define J1939_SPN_MAX               0x7FFFF
+#define J1939_SPN_PROPRIETARY       520192  // Manufacturer assigned SPNs
+#define J1939_FMI_MAX               31
+
+// Lamps, flash byte, then 4 bytes per DTC
+#define J1939_DM_IMAGE_SIZE         (2 + 4 * J1939_DM_MAX_DTCS)
+
+// Broadcast DM1 from ctx every second and on every change, as a single
+// frame with up to one DTC and with BAM above. DM1 and DM2 are also
+// answered on Request, needs j1939_request.c.
+int j1939_dm_init(struct j1939_ctx *ctx);
+
+// Stop the broadcast, DTCs are still recorded
+void j1939_dm_stop(void);
+
+// Make a DTC active. One that was previously active moves back from DM2
+// with its occurrence count incremented. Can be called before
+// j1939_dm_init(). -ENOMEM when the active list is full.
+int j1939_dm_set(uint32_t spn, uint8_t fmi, uint8_t lamps);
+
+// Move an active DTC to DM2. -ENOENT if it was not active.
+int j1939_dm_clear(uint32_t spn, uint8_t fmi);
+
+// Forget the previously active DTCs (DM3)
+void j1939_dm_clear_previous(void);
+
+#endif /* J1939_DM_H */
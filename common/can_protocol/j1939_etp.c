@@ -0,0 +1,428 @@
+#include <zephyr/kernel.h>
+#include <zephyr/sys/byteorder.h>
+#include <string.h>
+#include "j1939_etp.h"
+
+#define ETP_DATA_SIZE   J1939_TP_PACKET_SIZE
+#define ETP_PAD_BYTE    0xFF
+
+// ETP.CM to da with the PGN in bytes 5-7
+static int etp_send_cm(struct j1939_ctx *ctx, uint8_t da, uint8_t msg[8], uint32_t pgn) {
+    sys_put_le24(pgn, &msg[5]);
+    return j1939_send_frame(ctx, J1939_PGN_ETP_CM, J1939_PRIORITY_LOW, da, msg, 8);
+}
+
+static void etp_send_abort(struct j1939_ctx *ctx, uint8_t da, uint8_t reason, uint32_t pgn) {
+    uint8_t abort_msg[8] = {ETP_CM_Abort, reason, 0xFF, 0xFF, 0xFF};
+
+    etp_send_cm(ctx, da, abort_msg, pgn);
+}
+
+/* Receiver */
+
+// Caller holds ctx->lock. The consumer is told outside of it.
+static void rx_end(struct j1939_etp *etp) {
+    k_work_cancel_delayable(&etp->rx.timer);
+    etp->rx.active = false;
+}
+
+static void rx_close(struct j1939_etp *etp, int result) {
+    if (etp->consumer != NULL && etp->consumer->close != NULL) {
+        etp->consumer->close(etp->ctx, result, etp->consumer->user_data);
+    }
+}
+
+// Caller holds ctx->lock and sends cts_msg once it is released. Clears the
+// next window, which the sender announces with a DPO within T2. While the
+// consumer holds the transfer it is a CTS for 0 packets instead, repeated
+// every Th until j1939_etp_resume().
+static void rx_open_window(struct j1939_etp *etp, uint8_t cts_msg[8]) {
+    uint32_t remaining = etp->rx.num_packets - etp->rx.next_packet + 1;
+    uint8_t count = MIN(remaining, etp->rx_window ? etp->rx_window : J1939_ETP_WINDOW_MAX);
+
+    etp->rx.holding = etp->rx.holds > 0;
+    if (etp->rx.holding) {
+        count = 0;
+    }
+    cts_msg[0] = ETP_CM_CTS;
+    cts_msg[1] = count;
+    sys_put_le24(etp->rx.next_packet, &cts_msg[2]);
+    etp->rx.window_end = etp->rx.next_packet + count - 1;
+    etp->rx.dpo_received = false;
+    k_work_reschedule(&etp->rx.timer,
+                      K_MSEC(etp->rx.holding ? J1939_TP_TH_MS : J1939_TP_T2_MS));
+}
+
+static void rx_timeout(struct k_work *work) {
+    struct k_work_delayable *dwork = k_work_delayable_from_work(work);
+    struct j1939_etp *etp = CONTAINER_OF(dwork, struct j1939_etp, rx.timer);
+    struct j1939_ctx *ctx = etp->ctx;
+    k_spinlock_key_t key = k_spin_lock(&ctx->lock);
+    bool timed_out = etp->rx.active && !etp->rx.holding;
+    bool hold = etp->rx.active && etp->rx.holding;
+    uint8_t sa = etp->rx.sa;
+    uint32_t pgn = etp->rx.pgn;
+    uint8_t cts_msg[8];
+
+    if (timed_out) {
+        ctx->stats.rx_timeouts++;
+        etp->rx.active = false;
+    } else if (hold) {
+        // Keeps the sender waiting, its T4 is longer than Th
+        rx_open_window(etp, cts_msg);
+    }
+    k_spin_unlock(&ctx->lock, key);
+
+    if (timed_out) {
+        etp_send_abort(ctx, sa, J1939_ABORT_TIMEOUT, pgn);
+        rx_close(etp, -ETIMEDOUT);
+    } else if (hold) {
+        etp_send_cm(ctx, sa, cts_msg, pgn);
+    }
+}
+
+static void handle_rts(struct j1939_ctx *ctx, struct j1939_etp *etp, const uint8_t *data) {
+    uint32_t size = sys_get_le32(&data[1]);
+    uint32_t pgn = sys_get_le24(&data[5]);
+    uint8_t sa = ctx->rx_sa;
+    k_spinlock_key_t key = k_spin_lock(&ctx->lock);
+    bool restarted = false;
+    uint8_t cts_msg[8];
+
+    if (etp->rx.active && etp->rx.sa != sa) {
+        // One transfer at a time, the running one continues
+        k_spin_unlock(&ctx->lock, key);
+        etp_send_abort(ctx, sa, J1939_ABORT_BUSY, pgn);
+        return;
+    }
+    if (etp->rx.active) {
+        // Restarted by the sender
+        ctx->stats.rx_aborted++;
+        rx_end(etp);
+        restarted = true;
+    }
+    k_spin_unlock(&ctx->lock, key);
+
+    if (restarted) {
+        rx_close(etp, -ECONNABORTED);
+    }
+
+    if (size < J1939_ETP_MIN_SIZE || size > J1939_ETP_MAX_SIZE) {
+        etp_send_abort(ctx, sa, J1939_ABORT_RESOURCES, pgn);
+        return;
+    }
+    if (etp->consumer == NULL || (etp->consumer->open != NULL &&
+        etp->consumer->open(ctx, pgn, size, etp->consumer->user_data) != 0)) {
+        key = k_spin_lock(&ctx->lock);
+        ctx->stats.rx_dropped++;
+        k_spin_unlock(&ctx->lock, key);
+        etp_send_abort(ctx, sa, J1939_ABORT_RESOURCES, pgn);
+        return;
+    }
+
+    key = k_spin_lock(&ctx->lock);
+    etp->rx.active = true;
+    etp->rx.sa = sa;
+    etp->rx.pgn = pgn;
+    etp->rx.size = size;
+    etp->rx.num_packets = DIV_ROUND_UP(size, ETP_DATA_SIZE);
+    etp->rx.next_packet = 1;
+    etp->rx.holds = 0;
+    rx_open_window(etp, cts_msg);
+    k_spin_unlock(&ctx->lock, key);
+
+    etp_send_cm(ctx, sa, cts_msg, pgn);
+}
+
+static void handle_dpo(struct j1939_ctx *ctx, struct j1939_etp *etp, const uint8_t *data) {
+    uint8_t count = data[1];
+    uint32_t offset = sys_get_le24(&data[2]);
+    uint32_t pgn = sys_get_le24(&data[5]);
+    k_spinlock_key_t key = k_spin_lock(&ctx->lock);
+    uint8_t reason = 0;
+
+    if (!etp->rx.active || etp->rx.sa != ctx->rx_sa || etp->rx.pgn != pgn) {
+        k_spin_unlock(&ctx->lock, key);
+        return;
+    }
+
+    if (etp->rx.dpo_received) {
+        reason = J1939_ABORT_UNEXPECTED_DPO;
+    } else if (offset + 1 != etp->rx.next_packet) {
+        reason = J1939_ABORT_BAD_DPO_OFFSET;
+    } else if (count == 0 || offset + count > etp->rx.window_end) {
+        reason = J1939_ABORT_DPO_PACKETS;
+    } else {
+        // The sender may use less of the window than we cleared
+        etp->rx.dpo_offset = offset;
+        etp->rx.dpo_received = true;
+        etp->rx.window_end = offset + count;
+        k_work_reschedule(&etp->rx.timer, K_MSEC(J1939_TP_T1_MS));
+    }
+
+    if (reason) {
+        ctx->stats.rx_aborted++;
+        rx_end(etp);
+    }
+    k_spin_unlock(&ctx->lock, key);
+
+    if (reason) {
+        etp_send_abort(ctx, ctx->rx_sa, reason, pgn);
+        rx_close(etp, -ECONNABORTED);
+    }
+}
+
+// Abort from the sender of the transfer we receive
+static void handle_rx_abort(struct j1939_ctx *ctx, struct j1939_etp *etp, const uint8_t *data) {
+    uint32_t pgn = sys_get_le24(&data[5]);
+    k_spinlock_key_t key = k_spin_lock(&ctx->lock);
+    bool ours = etp->rx.active && etp->rx.sa == ctx->rx_sa && etp->rx.pgn == pgn;
+
+    if (ours) {
+        ctx->stats.rx_aborted++;
+        rx_end(etp);
+    }
+    k_spin_unlock(&ctx->lock, key);
+
+    if (ours) {
+        rx_close(etp, -ECONNABORTED);
+    }
+}
+
+// The packet goes straight to the consumer. The next CTS only leaves once
+// the consumer has taken the last packet of the window, and is a hold
+// while the consumer has not caught up.
+static void etp_dt_received(struct j1939_ctx *ctx, const uint8_t *data, uint16_t len) {
+    struct j1939_etp *etp = ctx->etp;
+    uint8_t cts_msg[8];
+    bool window_done;
+    k_spinlock_key_t key;
+    uint32_t packet;
+    uint32_t offset;
+    uint32_t pgn;
+    uint8_t count;
+    int ret;
+
+    if (etp == NULL || len < 8 || ctx->rx_da == J1939_ADDR_GLOBAL) {
+        return;
+    }
+
+    key = k_spin_lock(&ctx->lock);
+    if (!etp->rx.active || etp->rx.sa != ctx->rx_sa) {
+        k_spin_unlock(&ctx->lock, key);
+        return;
+    }
+
+    packet = etp->rx.dpo_offset + data[0];
+    pgn = etp->rx.pgn;
+    if (!etp->rx.dpo_received || packet != etp->rx.next_packet || packet > etp->rx.window_end) {
+        ctx->stats.rx_aborted++;
+        rx_end(etp);
+        k_spin_unlock(&ctx->lock, key);
+        etp_send_abort(ctx, ctx->rx_sa, J1939_ABORT_BAD_SEQUENCE, pgn);
+        rx_close(etp, -ECONNABORTED);
+        return;
+    }
+
+    offset = (packet - 1) * ETP_DATA_SIZE;
+    count = MIN(ETP_DATA_SIZE, etp->rx.size - offset);
+    etp->rx.next_packet++;
+    k_work_reschedule(&etp->rx.timer, K_MSEC(J1939_TP_T1_MS));
+    k_spin_unlock(&ctx->lock, key);
+
+    ret = etp->consumer->data(ctx, offset, &data[1], count, etp->consumer->user_data);
+
+    key = k_spin_lock(&ctx->lock);
+    if (!etp->rx.active) {
+        // Timed out while the consumer had the packet
+        k_spin_unlock(&ctx->lock, key);
+        return;
+    }
+
+    if (ret < 0) {
+        ctx->stats.rx_aborted++;
+        rx_end(etp);
+        k_spin_unlock(&ctx->lock, key);
+        etp_send_abort(ctx, ctx->rx_sa, J1939_ABORT_RESOURCES, pgn);
+        rx_close(etp, ret);
+        return;
+    }
+    if (ret == J1939_ETP_HOLD) {
+        etp->rx.holds++;
+    }
+
+    if (packet == etp->rx.num_packets) {
+        uint8_t eom_msg[8] = {ETP_CM_EOMA};
+
+        sys_put_le32(etp->rx.size, &eom_msg[1]);
+        ctx->stats.rx_done++;
+        rx_end(etp);
+        k_spin_unlock(&ctx->lock, key);
+        etp_send_cm(ctx, ctx->rx_sa, eom_msg, pgn);
+        rx_close(etp, 0);
+        return;
+    }
+
+    window_done = packet == etp->rx.window_end;
+    if (window_done) {
+        rx_open_window(etp, cts_msg);
+    }
+    k_spin_unlock(&ctx->lock, key);
+
+    if (window_done) {
+        etp_send_cm(ctx, ctx->rx_sa, cts_msg, pgn);
+    }
+}
+
+int j1939_etp_resume(struct j1939_ctx *ctx) {
+    struct j1939_etp *etp = ctx->etp;
+    k_spinlock_key_t key;
+    uint8_t cts_msg[8];
+    bool send = false;
+    uint8_t sa;
+    uint32_t pgn;
+
+    if (etp == NULL) {
+        return -ENOTSUP;
+    }
+
+    key = k_spin_lock(&ctx->lock);
+    if (!etp->rx.active) {
+        k_spin_unlock(&ctx->lock, key);
+        return -ENOENT;
+    }
+    etp->rx.holds--;
+    if (etp->rx.holding && etp->rx.holds <= 0) {
+        // Held at the end of a window, clear the next one now
+        rx_open_window(etp, cts_msg);
+        send = true;
+    }
+    sa = etp->rx.sa;
+    pgn = etp->rx.pgn;
+    k_spin_unlock(&ctx->lock, key);
+
+    if (send) {
+        etp_send_cm(ctx, sa, cts_msg, pgn);
+    }
+    return 0;
+}
+
+/* Sender */
+
+// The DPO of a cleared window, or its next packet. Runs on the work queue,
+// where the producer may take its time, never in the TX callback.
+static void tx_send_next(struct j1939_ctx *ctx, struct j1939_cm_tx *cm) {
+    struct j1939_etp *etp = CONTAINER_OF(cm, struct j1939_etp, tx.cm);
+    uint8_t frame[8];
+    uint32_t window_end;
+    bool dpo;
+    uint32_t packet = j1939_cm_tx_next(cm, &dpo, &window_end);
+    int ret = 0;
+
+    if (dpo) {
+        etp->tx.dpo_offset = packet - 1;
+        frame[0] = ETP_CM_DPO;
+        frame[1] = window_end - packet + 1;
+        sys_put_le24(etp->tx.dpo_offset, &frame[2]);
+        sys_put_le24(cm->pgn, &frame[5]);
+    } else {
+        uint32_t offset = (packet - 1) * ETP_DATA_SIZE;
+        uint8_t len = MIN(ETP_DATA_SIZE, etp->tx.size - offset);
+
+        frame[0] = packet - etp->tx.dpo_offset;
+        memset(&frame[1 + len], ETP_PAD_BYTE, ETP_DATA_SIZE - len);
+        ret = etp->tx.read(ctx, offset, &frame[1], len, cm->user_data);
+    }
+    if (ret < 0) {
+        j1939_cm_tx_abort(cm, J1939_ABORT_RESOURCES, ret);
+        return;
+    }
+
+    ret = j1939_send_frame_cb(ctx, dpo ? J1939_PGN_ETP_CM : J1939_PGN_ETP_DT, J1939_PRIORITY_LOW,
+                              cm->da, frame, 8, j1939_cm_tx_done, cm);
+    if (ret != 0) {
+        j1939_cm_tx_send_failed(cm, dpo, ret);
+    }
+}
+
+static const struct j1939_cm_tx_ops etp_tx_ops = {
+    .send_next = tx_send_next,
+    .send_abort = etp_send_abort,
+    .dpo = true,
+    .from_work_queue = true,
+};
+
+// Connection mode only, there is no ETP broadcast
+static void etp_cm_received(struct j1939_ctx *ctx, const uint8_t *data, uint16_t len) {
+    struct j1939_etp *etp = ctx->etp;
+
+    if (etp == NULL || len < 8 || ctx->rx_da == J1939_ADDR_GLOBAL) {
+        return;
+    }
+
+    switch (data[0]) {
+        case ETP_CM_RTS:
+            handle_rts(ctx, etp, data);
+            break;
+        case ETP_CM_CTS:
+            j1939_cm_tx_cts(&etp->tx.cm, ctx->rx_sa, data[1], sys_get_le24(&data[2]),
+                            sys_get_le24(&data[5]));
+            break;
+        case ETP_CM_DPO:
+            handle_dpo(ctx, etp, data);
+            break;
+        case ETP_CM_EOMA:
+            j1939_cm_tx_end(&etp->tx.cm, ctx->rx_sa, sys_get_le24(&data[5]), 0);
+            break;
+        case ETP_CM_Abort:
+            j1939_cm_tx_end(&etp->tx.cm, ctx->rx_sa, sys_get_le24(&data[5]), -ECONNABORTED);
+            handle_rx_abort(ctx, etp, data);
+            break;
+    }
+}
+
+J1939_PGN_HANDLER_DEFINE(etp_cm_handler, J1939_PGN_ETP_CM, J1939_ADDR_GLOBAL, etp_cm_received);
+J1939_PGN_HANDLER_DEFINE(etp_dt_handler, J1939_PGN_ETP_DT, J1939_ADDR_GLOBAL, etp_dt_received);
+
+int j1939_etp_init(struct j1939_ctx *ctx, struct j1939_etp *etp) {
+    etp->ctx = ctx;
+    etp->rx.active = false;
+    k_work_init_delayable(&etp->rx.timer, rx_timeout);
+    j1939_cm_tx_init(ctx, &etp->tx.cm, &etp_tx_ops);
+    ctx->etp = etp;
+    return 0;
+}
+
+int j1939_etp_send_async(struct j1939_ctx *ctx, uint32_t pgn, uint8_t da, uint32_t size,
+                         j1939_etp_read_t read, j1939_tx_cb_t cb, void *user_data) {
+    struct j1939_etp *etp = ctx->etp;
+    uint8_t rts_msg[8] = {ETP_CM_RTS};
+    int ret;
+
+    if (etp == NULL) {
+        return -ENOTSUP;
+    }
+    if (da == J1939_ADDR_GLOBAL || size < J1939_ETP_MIN_SIZE || size > J1939_ETP_MAX_SIZE ||
+        read == NULL) {
+        return -EINVAL;
+    }
+    if (!j1939_address_usable(ctx)) {
+        return -EADDRNOTAVAIL;
+    }
+
+    ret = j1939_cm_tx_start(&etp->tx.cm, pgn, da, DIV_ROUND_UP(size, ETP_DATA_SIZE), cb,
+                            user_data);
+    if (ret != 0) {
+        return ret;
+    }
+    // No CTS can come before the RTS
+    etp->tx.size = size;
+    etp->tx.read = read;
+
+    sys_put_le32(size, &rts_msg[1]);
+    ret = etp_send_cm(ctx, da, rts_msg, pgn);
+    if (ret != 0) {
+        j1939_cm_tx_cancel(&etp->tx.cm);
+    }
+    return ret;
+}
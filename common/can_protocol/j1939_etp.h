@@ -0,0 +1,90 @@
+#ifndef J1939_ETP_H
+#define J1939_ETP_H
+
+#include <zephyr/kernel.h>
+#include "j1939.h"
+
+// Extended Transport Protocol commands
+#define ETP_CM_RTS                  0x14    // Request to Send, 32-bit size
+#define ETP_CM_CTS                  0x15    // Clear to Send, 24-bit packet number
+#define ETP_CM_DPO                  0x16    // Data Packet Offset
+#define ETP_CM_EOMA                 0x17    // End of Message Acknowledgement
+#define ETP_CM_Abort                0xFF
+
+// Above what TP carries, up to 2^24 - 1 packets of 7 bytes
+#define J1939_ETP_MIN_SIZE          (J1939_TP_MAX_SIZE + 1)
+#define J1939_ETP_MAX_PACKETS       0xFFFFFF
+#define J1939_ETP_MAX_SIZE          (J1939_ETP_MAX_PACKETS * J1939_TP_PACKET_SIZE)
+#define J1939_ETP_WINDOW_MAX        255     // Packets per CTS and DPO
+
+// Returned by data: the packet is taken, but the transfer holds at the end
+// of the window until j1939_etp_resume()
+#define J1939_ETP_HOLD              1
+
+// Receiver of ETP transfers. Nothing is buffered, the consumer gets each
+// packet as it arrives, in order. The callbacks run on the CAN RX path
+// (close also on the system work queue after a timeout) and must not block.
+// Only data is required.
+struct j1939_etp_consumer {
+    // RTS from ctx->rx_sa, 0 accepts the transfer
+    int (*open)(struct j1939_ctx *ctx, uint32_t pgn, uint32_t size, void *user_data);
+    // Bytes at offset, negative aborts the transfer. A consumer that hands
+    // the bytes to a thread returns J1939_ETP_HOLD when that thread falls
+    // behind, instead of blocking the RX path.
+    int (*data)(struct j1939_ctx *ctx, uint32_t offset, const uint8_t *data, uint8_t len,
+                void *user_data);
+    // 0 once every byte is in, negative errno on abort or timeout
+    void (*close)(struct j1939_ctx *ctx, int result, void *user_data);
+    void *user_data;
+};
+
+// Supplies len bytes at offset for the next packet, on the system work
+// queue. Negative aborts the transfer.
+typedef int (*j1939_etp_read_t)(struct j1939_ctx *ctx, uint32_t offset, uint8_t *buf,
+                                uint8_t len, void *user_data);
+
+// ETP state of a context, one transfer in each direction at a time
+struct j1939_etp {
+    const struct j1939_etp_consumer *consumer;  // NULL refuses every RTS
+    uint8_t rx_window;          // Packets granted per CTS, 0 means 255
+
+    // Internal state, set up by j1939_etp_init()
+    struct j1939_ctx *ctx;
+    struct {
+        bool active;
+        uint8_t sa;
+        uint32_t pgn;
+        uint32_t size;
+        uint32_t num_packets;
+        uint32_t next_packet;   // Counted from 1 over the whole transfer
+        uint32_t window_end;    // Last packet cleared by our CTS
+        uint32_t dpo_offset;    // Sequence numbers of the window count from it
+        bool dpo_received;
+        int holds;              // J1939_ETP_HOLD returns not resumed yet
+        bool holding;           // Hold CTS sent, repeated every Th
+        struct k_work_delayable timer;  // T1 between packets, T2 after a CTS
+    } rx;
+    struct {
+        struct j1939_cm_tx cm;  // Windows and timeouts, shared with TP
+        uint32_t size;
+        uint32_t dpo_offset;
+        j1939_etp_read_t read;
+    } tx;
+};
+
+// Add ETP (PGNs 0xC800/0xC700) to a context after j1939_init()
+int j1939_etp_init(struct j1939_ctx *ctx, struct j1939_etp *etp);
+
+// Send J1939_ETP_MIN_SIZE to J1939_ETP_MAX_SIZE bytes of pgn to da and
+// return once the RTS is out. Each window the receiver clears is
+// announced with a DPO and sent back to back, a packet per TX
+// confirmation, reading the data from read as it goes. cb reports the
+// outcome. -EBUSY while a transfer is in progress.
+int j1939_etp_send_async(struct j1939_ctx *ctx, uint32_t pgn, uint8_t da, uint32_t size,
+                         j1939_etp_read_t read, j1939_tx_cb_t cb, void *user_data);
+
+// Once per J1939_ETP_HOLD, from any thread. A transfer held at the end of a
+// window continues with the next CTS. -ENOENT without a transfer.
+int j1939_etp_resume(struct j1939_ctx *ctx);
+
+#endif /* J1939_ETP_H */
@@ -0,0 +1,144 @@
+#include <zephyr/kernel.h>
+#include <zephyr/sys/byteorder.h>
+#include <string.h>
+#include "j1939_request.h"
+
+// Caller holds ctx->lock. A handful of PGNs, a scan is cheaper than an index.
+static struct j1939_response *response_find(struct j1939_ctx *ctx, uint32_t pgn) {
+    for (int i = 0; i < ctx->num_responses; i++) {
+        if (ctx->responses[i]->pgn == pgn) {
+            return ctx->responses[i];
+        }
+    }
+    return NULL;
+}
+
+int j1939_response_register(struct j1939_ctx *ctx, struct j1939_response *resp) {
+    k_spinlock_key_t key = k_spin_lock(&ctx->lock);
+    int ret = 0;
+
+    if (response_find(ctx, resp->pgn) != NULL) {
+        ret = -EEXIST;
+    } else if (ctx->num_responses >= J1939_MAX_RESPONSES) {
+        ret = -ENOMEM;
+    } else {
+        resp->sending = false;
+        resp->pending_len = 0;
+        ctx->responses[ctx->num_responses++] = resp;
+    }
+    k_spin_unlock(&ctx->lock, key);
+    return ret;
+}
+
+int j1939_response_update(struct j1939_ctx *ctx, struct j1939_response *resp,
+                          const uint8_t *data, uint16_t len) {
+    k_spinlock_key_t key;
+
+    if (len == 0 || len > resp->size || len > J1939_TP_MAX_SIZE) {
+        return -EINVAL;
+    }
+
+    key = k_spin_lock(&ctx->lock);
+    if (resp->sending) {
+        memcpy(resp->pending, data, len);
+        resp->pending_len = len;
+    } else {
+        memcpy(resp->buf, data, len);
+        resp->len = len;
+    }
+    k_spin_unlock(&ctx->lock, key);
+    return 0;
+}
+
+int j1939_request_pgn(struct j1939_ctx *ctx, uint32_t pgn, uint8_t da) {
+    uint8_t data[3];
+
+    sys_put_le24(pgn, data);
+    return j1939_send_frame(ctx, J1939_PGN_REQUEST, J1939_PRIORITY_DEFAULT, da, data,
+                            sizeof(data));
+}
+
+int j1939_send_ack(struct j1939_ctx *ctx, uint8_t control, uint32_t pgn, uint8_t address) {
+    uint8_t data[8] = {control, 0xFF, 0xFF, 0xFF, address};
+
+    sys_put_le24(pgn, &data[5]);
+    return j1939_send_frame(ctx, J1939_PGN_ACK, J1939_PRIORITY_DEFAULT, J1939_ADDR_GLOBAL, data,
+                            sizeof(data));
+}
+
+static void response_sent(struct j1939_ctx *ctx, int result, void *user_data) {
+    struct j1939_response *resp = user_data;
+    k_spinlock_key_t key = k_spin_lock(&ctx->lock);
+
+    // The next Request gets the data that changed during the transfer
+    if (resp->pending_len != 0) {
+        memcpy(resp->buf, resp->pending, resp->pending_len);
+        resp->len = resp->pending_len;
+        resp->pending_len = 0;
+    }
+    resp->sending = false;
+    k_spin_unlock(&ctx->lock, key);
+}
+
+// Only requests to our address are acknowledged, never global ones
+static void request_refused(struct j1939_ctx *ctx, uint8_t control, uint32_t pgn, bool to_us) {
+    ctx->stats.requests_refused++;
+    if (to_us) {
+        j1939_send_ack(ctx, control, pgn, ctx->rx_sa);
+    }
+}
+
+static void request_received(struct j1939_ctx *ctx, const uint8_t *data, uint16_t len) {
+    bool to_us = ctx->rx_da != J1939_ADDR_GLOBAL;
+    uint8_t da = to_us ? ctx->rx_sa : J1939_ADDR_GLOBAL;
+    uint8_t frame[8];
+    struct j1939_response *resp;
+    k_spinlock_key_t key;
+    uint32_t pgn;
+    uint16_t resp_len;
+    int ret;
+
+    // Address claims are answered by j1939_addr.c
+    if (len < 3 || !j1939_address_usable(ctx) || ctx->rx_sa == J1939_ADDR_NULL) {
+        return;
+    }
+    pgn = sys_get_le24(data);
+    if (pgn == J1939_PGN_ADDRESS_CLAIMED) {
+        return;
+    }
+
+    key = k_spin_lock(&ctx->lock);
+    resp = response_find(ctx, pgn);
+    resp_len = resp != NULL ? resp->len : 0;
+    if (resp_len == 0) {
+        k_spin_unlock(&ctx->lock, key);
+        request_refused(ctx, J1939_ACK_NEGATIVE, pgn, to_us);
+        return;
+    }
+
+    if (resp_len <= sizeof(frame)) {
+        memcpy(frame, resp->buf, resp_len);
+        k_spin_unlock(&ctx->lock, key);
+        ret = j1939_send_frame(ctx, pgn, J1939_PRIORITY_DEFAULT, da, frame, resp_len);
+    } else if (resp->sending) {
+        k_spin_unlock(&ctx->lock, key);
+        ret = -EBUSY;
+    } else {
+        // buf stays untouched until response_sent()
+        resp->sending = true;
+        k_spin_unlock(&ctx->lock, key);
+        ret = j1939_send_tp_to_async(ctx, pgn, da, resp->buf, resp_len, response_sent, resp);
+        if (ret != 0) {
+            response_sent(ctx, ret, resp);
+        }
+    }
+
+    if (ret != 0) {
+        request_refused(ctx, J1939_ACK_CANNOT_RESPOND, pgn, to_us);
+    } else {
+        ctx->stats.requests_answered++;
+    }
+}
+
+J1939_PGN_HANDLER_DEFINE(j1939_request_responder, J1939_PGN_REQUEST, J1939_ADDR_GLOBAL,
+                         request_received);
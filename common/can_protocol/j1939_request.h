@@ -0,0 +1,50 @@
+#ifndef J1939_REQUEST_H
+#define J1939_REQUEST_H
+
+#include <zephyr/kernel.h>
+#include "j1939.h"
+
+// Acknowledgment control byte
+#define J1939_ACK_POSITIVE          0
+#define J1939_ACK_NEGATIVE          1
+#define J1939_ACK_ACCESS_DENIED     2
+#define J1939_ACK_CANNOT_RESPOND    3
+
+// Response to Requests for a PGN, encoded ahead of time. Requests are
+// answered from buf on the CAN RX path: a single frame up to 8 bytes,
+// otherwise BAM to a global request and RTS/CTS to the requester.
+struct j1939_response {
+    uint32_t pgn;
+    uint8_t *buf;
+    uint8_t *pending;           // Update that arrived while sending from buf
+    uint16_t size;
+    uint16_t len;               // 0 until the first j1939_response_update()
+    uint16_t pending_len;       // 0 when there is no pending update
+    bool sending;               // Multi-packet transfer from buf in progress
+};
+
+#define J1939_RESPONSE_DEFINE(_name, _pgn, _size)                           \
+    static uint8_t _name##_buf[_size];                                      \
+    static uint8_t _name##_pending[_size];                                  \
+    static struct j1939_response _name = {                                  \
+        .pgn = (_pgn), .buf = _name##_buf, .pending = _name##_pending,      \
+        .size = (_size),                                                    \
+    }
+
+// Answer Requests for resp->pgn. -EEXIST if the PGN has a response
+// already, -ENOMEM once J1939_MAX_RESPONSES are registered.
+int j1939_response_register(struct j1939_ctx *ctx, struct j1939_response *resp);
+
+// Replace the response when its source data changes. While a multi-packet
+// response is on the bus the update is held in resp->pending and replaces
+// buf when the transfer ends, a later update overwrites it.
+int j1939_response_update(struct j1939_ctx *ctx, struct j1939_response *resp,
+                          const uint8_t *data, uint16_t len);
+
+// Request pgn from da, or from every node with J1939_ADDR_GLOBAL
+int j1939_request_pgn(struct j1939_ctx *ctx, uint32_t pgn, uint8_t da);
+
+// Acknowledgment of pgn to the node at address, sent to everyone
+int j1939_send_ack(struct j1939_ctx *ctx, uint8_t control, uint32_t pgn, uint8_t address);
+
+#endif /* J1939_REQUEST_H */
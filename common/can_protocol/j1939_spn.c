@@ -0,0 +1,81 @@
+#include <zephyr/kernel.h>
+#include <zephyr/sys/byteorder.h>
+#include <math.h>
+#include <string.h>
+#include "j1939_spn.h"
+
+#define SPN_TABLE(name, _pgn, type, ...)                                        \
+    static const struct j1939_spn name##_spns[] = { __VA_ARGS__ };              \
+    BUILD_ASSERT(sizeof(type) == ARRAY_SIZE(name##_spns) * sizeof(float),       \
+                 #type " does not match its SPN table");                         \
+    const struct j1939_pgn_spns j1939_spns_##name = {                           \
+        .pgn = (_pgn), .num_spns = ARRAY_SIZE(name##_spns), .spns = name##_spns, \
+    }
+
+SPN_TABLE(et1, J1939_PGN_ENGINE_TEMP, struct j1939_et1,
+    J1939_SPN(0,  8,  1.0f,     -40.0f),
+    J1939_SPN(8,  8,  1.0f,     -40.0f),
+    J1939_SPN(16, 16, 0.03125f, -273.0f),
+    J1939_SPN(32, 16, 0.03125f, -273.0f),
+    J1939_SPN(48, 8,  1.0f,     -40.0f),
+    J1939_SPN(56, 8,  0.4f,     0.0f),
+);
+
+SPN_TABLE(ccvs, J1939_PGN_VEHICLE_SPEED, struct j1939_ccvs,
+    J1939_SPN(2,  2,  1.0f,           0.0f),
+    J1939_SPN(8,  16, 1.0f / 256.0f,  0.0f),
+    J1939_SPN(24, 2,  1.0f,           0.0f),
+    J1939_SPN(28, 2,  1.0f,           0.0f),
+    J1939_SPN(30, 2,  1.0f,           0.0f),
+    J1939_SPN(40, 8,  1.0f,           0.0f),
+);
+
+SPN_TABLE(vp, J1939_PGN_VEHICLE_POSITION, struct j1939_vp,
+    J1939_SPN(0,  32, 1e-7f, -210.0f),
+    J1939_SPN(32, 32, 1e-7f, -210.0f),
+);
+
+static const struct j1939_pgn_spns *const spn_tables[] = {
+    &j1939_spns_et1,
+    &j1939_spns_ccvs,
+    &j1939_spns_vp,
+};
+
+const struct j1939_pgn_spns *j1939_spn_table(uint32_t pgn) {
+    for (int i = 0; i < ARRAY_SIZE(spn_tables); i++) {
+        if (spn_tables[i]->pgn == pgn) {
+            return spn_tables[i];
+        }
+    }
+    return NULL;
+}
+
+// The whole frame is one little-endian word, every parameter is a shift,
+// a mask and two compares, without a branch on its position or size
+void j1939_spn_decode(const struct j1939_pgn_spns *table, const uint8_t *data, uint16_t len,
+                      void *values, struct j1939_spn_status *status) {
+    uint8_t frame[J1939_SPN_PGN_LEN];
+    float *out = values;
+    uint32_t valid = 0;
+    uint32_t error = 0;
+    uint64_t word;
+
+    memset(frame, 0xFF, sizeof(frame));
+    memcpy(frame, data, MIN(len, sizeof(frame)));
+    word = sys_get_le64(frame);
+
+    for (int i = 0; i < table->num_spns; i++) {
+        const struct j1939_spn *spn = &table->spns[i];
+        uint32_t raw = (uint32_t)(word >> spn->start) & spn->mask;
+        bool ok = raw <= spn->valid_max;
+
+        valid |= (uint32_t)ok << i;
+        error |= (uint32_t)(raw - spn->error_min <= spn->error_max - spn->error_min) << i;
+        out[i] = ok ? (float)raw * spn->resolution + spn->offset : NAN;
+    }
+
+    if (status != NULL) {
+        status->valid = valid;
+        status->error = error;
+    }
+}
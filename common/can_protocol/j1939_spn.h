@@ -0,0 +1,97 @@
+#ifndef J1939_SPN_H
+#define J1939_SPN_H
+
+#include <zephyr/kernel.h>
+#include "j1939.h"
+
+#define J1939_SPN_MAX_PER_PGN   32      // One status bit each
+#define J1939_SPN_PGN_LEN       8       // Single frame PGNs only
+
+// Where a parameter sits in the PGN and how it scales. Bits are numbered
+// from the LSB of byte 1, so byte n bit b (both from 1) is at
+// (n - 1) * 8 + b - 1. Raw values above valid_max are reserved, an error
+// indicator (error_min to error_max) or not available (J1939-71).
+struct j1939_spn {
+    uint8_t start;
+    uint8_t bits;
+    uint32_t mask;
+    uint32_t valid_max;
+    uint32_t error_min;
+    uint32_t error_max;
+    float resolution;
+    float offset;
+};
+
+// Limits for 2-32 bits: 8 bits and more end in 0xFB-0xFD reserved,
+// 0xFE error, 0xFF not available in the top byte. Shorter fields keep
+// the two highest values for error and not available.
+#define J1939_SPN_TOP(bits, top, small)                                     \
+    ((bits) >= 8 ? (uint32_t)(((uint64_t)(top) << (bits)) >> 8)            \
+                 : (uint32_t)(BIT64(bits) - 1) - (small))
+
+#define J1939_SPN(_start, _bits, _resolution, _offset) {                    \
+        .start = (_start),                                                  \
+        .bits = (_bits),                                                    \
+        .mask = (uint32_t)(BIT64(_bits) - 1),                               \
+        .valid_max = J1939_SPN_TOP(_bits, 0xFB, 1) - 1,                     \
+        .error_min = J1939_SPN_TOP(_bits, 0xFE, 1),                         \
+        .error_max = J1939_SPN_TOP(_bits, 0xFF, 0) - 1,                     \
+        .resolution = (_resolution),                                        \
+        .offset = (_offset),                                                \
+    }
+
+// The parameters of one PGN, in the field order of its values struct
+struct j1939_pgn_spns {
+    uint32_t pgn;
+    uint8_t num_spns;
+    const struct j1939_spn *spns;
+};
+
+// Bit i describes table entry i, the i-th float of the values struct
+struct j1939_spn_status {
+    uint32_t valid;
+    uint32_t error;
+};
+
+#define J1939_SPN_BIT(type, field)  BIT(offsetof(type, field) / sizeof(float))
+
+// Engine Temperature 1 (ET1, PGN 65262)
+struct j1939_et1 {
+    float coolant_temp;             // SPN 110, degC
+    float fuel_temp;                // SPN 174, degC
+    float oil_temp;                 // SPN 175, degC
+    float turbo_oil_temp;           // SPN 176, degC
+    float intercooler_temp;         // SPN 52, degC
+    float intercooler_opening;      // SPN 1134, %
+};
+
+// Cruise Control/Vehicle Speed (CCVS, PGN 65265). Switches are 0 off, 1 on.
+struct j1939_ccvs {
+    float parking_brake;            // SPN 70
+    float wheel_speed;              // SPN 84, km/h
+    float cruise_active;            // SPN 595
+    float brake_switch;             // SPN 597
+    float clutch_switch;            // SPN 598
+    float cruise_set_speed;         // SPN 86, km/h
+};
+
+// Vehicle Position (VP, PGN 65267)
+struct j1939_vp {
+    float latitude;                 // SPN 584, deg
+    float longitude;                // SPN 585, deg
+};
+
+extern const struct j1939_pgn_spns j1939_spns_et1;
+extern const struct j1939_pgn_spns j1939_spns_ccvs;
+extern const struct j1939_pgn_spns j1939_spns_vp;
+
+// Table of a PGN, NULL for PGNs without one
+const struct j1939_pgn_spns *j1939_spn_table(uint32_t pgn);
+
+// Decode every parameter of a PGN in one pass into values, a struct of
+// floats in table order. Parameters that are not valid read NAN. Bytes
+// beyond len count as not available. status may be NULL.
+void j1939_spn_decode(const struct j1939_pgn_spns *table, const uint8_t *data, uint16_t len,
+                      void *values, struct j1939_spn_status *status);
+
+#endif /* J1939_SPN_H */
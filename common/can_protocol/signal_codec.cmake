@@ -0,0 +1,23 @@
+# Generates signal_codec.h from signals.sdb at build time.
+#
+#   include(${CMAKE_CURRENT_SOURCE_DIR}/../common/can_protocol/signal_codec.cmake)
+#   signal_codec_generate(app)
+
+set(SIGNAL_CODEC_DB  ${CMAKE_CURRENT_LIST_DIR}/signals.sdb)
+set(SIGNAL_CODEC_GEN ${CMAKE_CURRENT_LIST_DIR}/gen_signal_codec.py)
+
+function(signal_codec_generate target)
+    set(out_dir ${CMAKE_CURRENT_BINARY_DIR}/generated)
+    set(out_file ${out_dir}/signal_codec.h)
+
+    file(MAKE_DIRECTORY ${out_dir})
+    add_custom_command(
+        OUTPUT ${out_file}
+        COMMAND ${PYTHON_EXECUTABLE} ${SIGNAL_CODEC_GEN} ${SIGNAL_CODEC_DB} ${out_file}
+        DEPENDS ${SIGNAL_CODEC_DB} ${SIGNAL_CODEC_GEN}
+        COMMENT "Generating signal_codec.h from signals.sdb"
+    )
+    add_custom_target(${target}_signal_codec DEPENDS ${out_file})
+    add_dependencies(${target} ${target}_signal_codec)
+    target_include_directories(${target} PRIVATE ${out_dir})
+endfunction()
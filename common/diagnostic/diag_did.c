@@ -0,0 +1,58 @@
+#include <zephyr/kernel.h>
+#include <string.h>
+#include "diag_service.h"
+
+// Latest value of each DID the application publishes
+static struct {
+    uint16_t did;
+    uint16_t len;
+    uint8_t data[DIAG_DID_MAX_LEN];
+} did_records[DIAG_DID_MAX_COUNT];
+static uint8_t num_did_records;
+static K_MUTEX_DEFINE(did_lock);
+
+int update_diagnostic_data(uint16_t did, const void *data, uint16_t len) {
+    int i;
+
+    if (len > DIAG_DID_MAX_LEN) {
+        return -EMSGSIZE;
+    }
+
+    k_mutex_lock(&did_lock, K_FOREVER);
+    for (i = 0; i < num_did_records; i++) {
+        if (did_records[i].did == did) {
+            break;
+        }
+    }
+    if (i == num_did_records) {
+        if (num_did_records == DIAG_DID_MAX_COUNT) {
+            k_mutex_unlock(&did_lock);
+            return -ENOMEM;
+        }
+        did_records[num_did_records++].did = did;
+    }
+    memcpy(did_records[i].data, data, len);
+    did_records[i].len = len;
+    k_mutex_unlock(&did_lock);
+    return 0;
+}
+
+int diag_service_read_did(uint16_t did, uint8_t *buf, size_t size) {
+    int ret = -ENOENT;
+
+    k_mutex_lock(&did_lock, K_FOREVER);
+    for (int i = 0; i < num_did_records; i++) {
+        if (did_records[i].did != did) {
+            continue;
+        }
+        if (did_records[i].len > size) {
+            ret = -ENOSPC;
+        } else {
+            memcpy(buf, did_records[i].data, did_records[i].len);
+            ret = did_records[i].len;
+        }
+        break;
+    }
+    k_mutex_unlock(&did_lock);
+    return ret;
+}
@@ -1,5 +1,6 @@
 #include <zephyr/kernel.h>
 #include <zephyr/crypto/crypto.h>
+#include <zephyr/sys/byteorder.h>
 #include <string.h>
 #include "diag_service.h"
 #include "secure_storage.h"
@@ -10,8 +11,8 @@ LOG_MODULE_REGISTER(diag_service, CONFIG_DIAGNOSTIC_LOG_LEVEL);
 
 #define MAX_SECURITY_ATTEMPTS 3
 #define SECURITY_LOCKOUT_TIME_MS 10000
-#define MAX_TRANSFER_SIZE 4096
 #define MAX_PERIODIC_DIDS 16
+#define S3_SERVER_TIMEOUT_MS 5000   // ISO 14229-2 S3Server
 
 struct diag_context {
     uint8_t current_session;
@@ -29,15 +30,70 @@ struct diag_context {
 };
 
 static struct diag_context diag_ctx;
-static uint8_t transfer_buffer[MAX_TRANSFER_SIZE];
+
+// Download in progress, written through download_ops as blocks arrive
+static const struct diag_download_ops *download_ops;
+static bool transfer_active;
 static uint32_t transfer_size;
 static uint32_t transfer_offset;
+static uint8_t transfer_seq;        // Expected block sequence counter
+
+// Falls back to the default session when the tester goes quiet
+static uint32_t last_request_ms;
+static void s3_timeout_handler(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(s3_timer, s3_timeout_handler);
 
 void diagnostic_service_init(void) {
     memset(&diag_ctx, 0, sizeof(diag_ctx));
     diag_ctx.current_session = DIAG_SESSION_DEFAULT;
     diag_ctx.dtc_settings_enabled = true;
-    memset(transfer_buffer, 0, sizeof(transfer_buffer));
+    transfer_active = false;
+    k_work_cancel_delayable(&s3_timer);
+}
+
+void diag_service_set_download_ops(const struct diag_download_ops *ops) {
+    download_ops = ops;
+}
+
+// Drop an unfinished download so the next RequestDownload can start over.
+// Caller holds context_lock.
+static void transfer_abort(void) {
+    if (!transfer_active) {
+        return;
+    }
+    transfer_active = false;
+    LOG_WRN("Download aborted at %u of %u bytes", transfer_offset, transfer_size);
+    if (download_ops->abort != NULL) {
+        download_ops->abort();
+    }
+}
+
+// Caller holds context_lock
+static void enter_session(uint8_t session_type) {
+    diag_ctx.current_session = session_type;
+    diag_ctx.security_level = 0; // Reset security on session change
+    transfer_abort();
+}
+
+static void s3_timeout_handler(struct k_work *work) {
+    k_mutex_lock(&diag_ctx.context_lock, K_FOREVER);
+    // A request that raced with the timer restarted it
+    if (diag_ctx.current_session != DIAG_SESSION_DEFAULT &&
+        k_uptime_get_32() - last_request_ms >= S3_SERVER_TIMEOUT_MS) {
+        LOG_INF("S3 timeout, back to the default session");
+        enter_session(DIAG_SESSION_DEFAULT);
+    }
+    k_mutex_unlock(&diag_ctx.context_lock);
+}
+
+// Caller holds context_lock
+static void s3_restart(void) {
+    last_request_ms = k_uptime_get_32();
+    if (diag_ctx.current_session != DIAG_SESSION_DEFAULT) {
+        k_work_reschedule(&s3_timer, K_MSEC(S3_SERVER_TIMEOUT_MS));
+    } else {
+        k_work_cancel_delayable(&s3_timer);
+    }
 }
 
 static int validate_session_transition(uint8_t new_session) {
@@ -71,8 +127,7 @@ int start_diagnostic_session(uint8_t session_type) {
     }
     
     k_mutex_lock(&diag_ctx.context_lock, K_FOREVER);
-    diag_ctx.current_session = session_type;
-    diag_ctx.security_level = 0; // Reset security on session change
+    enter_session(session_type);
     k_mutex_unlock(&diag_ctx.context_lock);
     
     return DIAG_RESP_OK;
@@ -134,6 +189,8 @@ int verify_security_access(uint8_t level, uint32_t key) {
 }
 
 static int handle_routine_start(uint16_t routine_id, const uint8_t *data, uint16_t len) {
+    int ret;
+
     k_mutex_lock(&diag_ctx.context_lock, K_FOREVER);
     
     if (diag_ctx.active_routine.status != 0) {
@@ -143,6 +200,7 @@ static int handle_routine_start(uint16_t routine_id, const uint8_t *data, uint16
     
     diag_ctx.active_routine.routine_id = routine_id;
     diag_ctx.active_routine.status = 1;
+    len = MIN(len, sizeof(diag_ctx.active_routine.data));
     memcpy(diag_ctx.active_routine.data, data, len);
     diag_ctx.active_routine.data_len = len;
     
@@ -151,16 +209,32 @@ static int handle_routine_start(uint16_t routine_id, const uint8_t *data, uint16
     // Start specific routine
     switch (routine_id) {
         case ROUTINE_SELF_TEST:
-            return execute_self_test();
+            ret = execute_self_test();
+            break;
         case ROUTINE_SENSOR_CALIBRATION:
-            return execute_sensor_calibration();
+            ret = execute_sensor_calibration();
+            break;
         case ROUTINE_MEMORY_CHECK:
-            return execute_memory_check();
+            ret = execute_memory_check();
+            break;
         case ROUTINE_SECURITY_CHECK:
-            return execute_security_check();
+            ret = execute_security_check();
+            break;
+#ifdef CONFIG_CAN_RECORDER
+        case ROUTINE_CAN_RECORDER:
+            ret = execute_can_recorder(data, len);
+            break;
+#endif
         default:
-            return DIAG_RESP_SUBFUNC_NA;
+            ret = DIAG_RESP_SUBFUNC_NA;
+            break;
+    }
+
+    // A routine that did not start must not block the next one
+    if (ret != DIAG_RESP_OK) {
+        diag_service_routine_update(routine_id, false, NULL, 0);
     }
+    return ret;
 }
 
 int execute_routine(uint16_t routine_id, uint8_t control_type, const uint8_t *data, uint16_t len) {
@@ -179,14 +253,12 @@ int execute_routine(uint16_t routine_id, uint8_t control_type, const uint8_t *da
             return DIAG_RESP_OK;
             
         case ROUTINE_RESULT:
+            // The transport reads the record with diag_service_routine_result()
             k_mutex_lock(&diag_ctx.context_lock, K_FOREVER);
             if (diag_ctx.active_routine.routine_id != routine_id) {
                 k_mutex_unlock(&diag_ctx.context_lock);
                 return DIAG_RESP_CONDITIONS_NA;
             }
-            // Return routine results
-            memcpy((void *)data, diag_ctx.active_routine.data, 
-                   diag_ctx.active_routine.data_len);
             k_mutex_unlock(&diag_ctx.context_lock);
             return DIAG_RESP_OK;
             
@@ -195,6 +267,32 @@ int execute_routine(uint16_t routine_id, uint8_t control_type, const uint8_t *da
     }
 }
 
+void diag_service_routine_update(uint16_t routine_id, bool running,
+                                 const uint8_t *record, uint16_t len) {
+    k_mutex_lock(&diag_ctx.context_lock, K_FOREVER);
+    if (diag_ctx.active_routine.routine_id == routine_id) {
+        len = MIN(len, sizeof(diag_ctx.active_routine.data));
+        if (len > 0) {
+            memcpy(diag_ctx.active_routine.data, record, len);
+        }
+        diag_ctx.active_routine.data_len = len;
+        diag_ctx.active_routine.status = running ? 1 : 0;
+    }
+    k_mutex_unlock(&diag_ctx.context_lock);
+}
+
+int diag_service_routine_result(uint16_t routine_id, uint8_t *buf, size_t size) {
+    int ret = -ENOENT;
+
+    k_mutex_lock(&diag_ctx.context_lock, K_FOREVER);
+    if (diag_ctx.active_routine.routine_id == routine_id) {
+        ret = MIN(diag_ctx.active_routine.data_len, size);
+        memcpy(buf, diag_ctx.active_routine.data, ret);
+    }
+    k_mutex_unlock(&diag_ctx.context_lock);
+    return ret;
+}
+
 int control_dtc_settings(uint8_t dtc_setting) {
     k_mutex_lock(&diag_ctx.context_lock, K_FOREVER);
     diag_ctx.dtc_settings_enabled = dtc_setting != 0;
@@ -226,9 +324,191 @@ int control_communication(uint8_t control_type, uint8_t comm_type) {
     return DIAG_RESP_OK;
 }
 
-int process_diagnostic_request(uint8_t service_id, const uint8_t *data, uint16_t len) {
+// Download services need SecurityAccess at the programming level, which a
+// session change locks again
+static bool download_unlocked(void) {
+    return diag_ctx.security_level == SEC_LEVEL_UNLOCK_PROG;
+}
+
+// [data format][address and length format][address][size], big-endian
+static int handle_request_download(const uint8_t *data, uint16_t len) {
+    uint8_t addr_len;
+    uint8_t size_len;
+    uint32_t address;
+    uint32_t size;
+
+    if (len < 2) {
+        return DIAG_RESP_INCORRECT_LENGTH;
+    }
+
+    addr_len = data[1] & 0x0F;
+    size_len = data[1] >> 4;
+    if (len != 2 + addr_len + size_len) {
+        return DIAG_RESP_INCORRECT_LENGTH;
+    }
+    // No compression or encryption, 32-bit addresses and sizes
+    if (data[0] != 0x00 || addr_len == 0 || addr_len > 4 || size_len == 0 || size_len > 4) {
+        return DIAG_RESP_OUT_OF_RANGE;
+    }
+    if (!download_unlocked()) {
+        return DIAG_RESP_SECURITY_DENIED;
+    }
+
+    if (download_ops == NULL) {
+        return DIAG_RESP_UPLOAD_DOWNLOAD_NA;
+    }
+    if (transfer_active) {
+        return DIAG_RESP_CONDITIONS_NA;
+    }
+
+    address = 0;
+    for (int i = 0; i < addr_len; i++) {
+        address = (address << 8) | data[2 + i];
+    }
+    size = 0;
+    for (int i = 0; i < size_len; i++) {
+        size = (size << 8) | data[2 + addr_len + i];
+    }
+
+    if (download_ops->begin(address, size) != 0) {
+        return DIAG_RESP_UPLOAD_DOWNLOAD_NA;
+    }
+
+    transfer_active = true;
+    transfer_size = size;
+    transfer_offset = 0;
+    transfer_seq = 1;
+    return DIAG_RESP_OK;
+}
+
+// Returns DIAG_RESP_OK to write the block, 1 for a repeated block that is
+// acknowledged without writing, or a response code
+static int transfer_check_block(uint8_t seq, size_t data_len) {
+    if (!download_unlocked()) {
+        return DIAG_RESP_SECURITY_DENIED;
+    }
+    if (!transfer_active) {
+        return DIAG_RESP_REQUEST_SEQ_ERR;
+    }
+    if (seq == (uint8_t)(transfer_seq - 1) && transfer_offset > 0) {
+        // Tester repeated the last block after a lost response
+        return 1;
+    }
+    if (seq != transfer_seq) {
+        return DIAG_RESP_WRONG_BLOCK_SEQ;
+    }
+    if (data_len > transfer_size - transfer_offset) {
+        return DIAG_RESP_TRANSFER_SUSPENDED;
+    }
+    return DIAG_RESP_OK;
+}
+
+static int transfer_write(const uint8_t *data, size_t len) {
+    if (download_ops->write(transfer_offset, data, len) != 0) {
+        transfer_active = false;
+        return DIAG_RESP_TRANSFER_SUSPENDED;
+    }
+    transfer_offset += len;
+    return DIAG_RESP_OK;
+}
+
+// [block sequence counter][data]
+static int handle_transfer_data(const uint8_t *data, uint16_t len) {
     int ret;
-    
+
+    if (len < 2) {
+        return DIAG_RESP_INCORRECT_LENGTH;
+    }
+
+    ret = transfer_check_block(data[0], len - 1);
+    if (ret != DIAG_RESP_OK) {
+        return ret == 1 ? DIAG_RESP_OK : ret;
+    }
+
+    ret = transfer_write(&data[1], len - 1);
+    if (ret == DIAG_RESP_OK) {
+        transfer_seq++;
+    }
+    return ret;
+}
+
+// Same as handle_transfer_data() for [SID][counter][data] in fragments,
+// each fragment is written where it lies
+static int handle_transfer_data_frags(const struct net_buf *frags, size_t len) {
+    size_t skip = 2;
+    uint8_t seq;
+    int ret;
+
+    if (len < 3) {
+        return DIAG_RESP_INCORRECT_LENGTH;
+    }
+
+    net_buf_linearize(&seq, 1, frags, 1, 1);
+    ret = transfer_check_block(seq, len - 2);
+    if (ret != DIAG_RESP_OK) {
+        return ret == 1 ? DIAG_RESP_OK : ret;
+    }
+
+    for (const struct net_buf *frag = frags; frag != NULL; frag = frag->frags) {
+        size_t offset = MIN(skip, frag->len);
+
+        skip -= offset;
+        if (frag->len > offset) {
+            ret = transfer_write(&frag->data[offset], frag->len - offset);
+            if (ret != DIAG_RESP_OK) {
+                return ret;
+            }
+        }
+    }
+
+    transfer_seq++;
+    return DIAG_RESP_OK;
+}
+
+static int handle_transfer_exit(void) {
+    if (!download_unlocked()) {
+        return DIAG_RESP_SECURITY_DENIED;
+    }
+    if (!transfer_active || transfer_offset != transfer_size) {
+        return DIAG_RESP_REQUEST_SEQ_ERR;
+    }
+
+    transfer_active = false;
+    if (download_ops->finish(transfer_size) != 0) {
+        return DIAG_RESP_GEN_REJECT;
+    }
+    return DIAG_RESP_OK;
+}
+
+int process_diagnostic_request_frags(const struct net_buf *frags, size_t len) {
+    uint8_t request[DIAG_REQUEST_MAX_LEN];
+    int ret;
+
+    if (len < 1) {
+        return DIAG_RESP_INCORRECT_LENGTH;
+    }
+
+    // Download data goes to the sink without an intermediate copy
+    if (frags->data[0] == UDS_TRANSFER_DATA) {
+        k_mutex_lock(&diag_ctx.context_lock, K_FOREVER);
+        if (!validate_service_in_session(UDS_TRANSFER_DATA, diag_ctx.current_session)) {
+            ret = DIAG_RESP_SERVICE_NA;
+        } else {
+            ret = handle_transfer_data_frags(frags, len);
+        }
+        s3_restart();
+        k_mutex_unlock(&diag_ctx.context_lock);
+        return ret;
+    }
+
+    if (len > sizeof(request)) {
+        return DIAG_RESP_INCORRECT_LENGTH;
+    }
+    net_buf_linearize(request, sizeof(request), frags, 0, len);
+    return process_diagnostic_request(request[0], &request[1], len - 1);
+}
+
+static int dispatch_request(uint8_t service_id, const uint8_t *data, uint16_t len) {
     // Validate session requirements
     if (!validate_service_in_session(service_id, diag_ctx.current_session)) {
         return DIAG_RESP_SERVICE_NA;
@@ -281,6 +561,18 @@ int process_diagnostic_request(uint8_t service_id, const uint8_t *data, uint16_t
     }
 }
 
+// Requests are handled under context_lock so the S3 timer cannot switch
+// the session or abort the download in the middle of one
+int process_diagnostic_request(uint8_t service_id, const uint8_t *data, uint16_t len) {
+    int ret;
+
+    k_mutex_lock(&diag_ctx.context_lock, K_FOREVER);
+    ret = dispatch_request(service_id, data, len);
+    s3_restart();
+    k_mutex_unlock(&diag_ctx.context_lock);
+    return ret;
+}
+
 const char *get_diag_error_string(uint8_t response_code) {
     switch (response_code) {
         case DIAG_RESP_OK:
@@ -2,6 +2,7 @@
 #define DIAG_SERVICE_H
 
 #include <zephyr/kernel.h>
+#include <zephyr/net/buf.h>
 
 // UDS Service IDs
 #define UDS_DIAGNOSTIC_SESSION_CONTROL  0x10
@@ -45,6 +46,7 @@
 #define ROUTINE_ERASE_MEMORY         0x0500
 #define ROUTINE_CHECK_PROG_DEP       0x0600
 #define ROUTINE_SYSTEM_MONITOR       0x0700
+#define ROUTINE_CAN_RECORDER         0x0800
 
 // Routine Control Types
 #define ROUTINE_START                0x01
@@ -60,10 +62,21 @@
 #define DIAG_RESP_BUSY              0x21
 #define DIAG_RESP_CONDITIONS_NA     0x22
 #define DIAG_RESP_REQUEST_SEQ_ERR   0x24
+#define DIAG_RESP_OUT_OF_RANGE      0x31
 #define DIAG_RESP_SECURITY_DENIED   0x33
 #define DIAG_RESP_INVALID_KEY       0x35
 #define DIAG_RESP_TOO_MANY_ATT      0x36
 #define DIAG_RESP_REQUIRED_TIME_NA  0x37
+#define DIAG_RESP_UPLOAD_DOWNLOAD_NA 0x70
+#define DIAG_RESP_TRANSFER_SUSPENDED 0x71
+#define DIAG_RESP_WRONG_BLOCK_SEQ   0x73
+
+// Application DIDs update_diagnostic_data() keeps, and the longest value
+#define DIAG_DID_MAX_COUNT          16
+#define DIAG_DID_MAX_LEN            128
+
+// Longest request other than TransferData, see process_diagnostic_request_frags()
+#define DIAG_REQUEST_MAX_LEN        256
 
 // Communication Control Types
 #define COMM_ENABLE_RX_TX           0x00
@@ -89,6 +102,18 @@ struct security_seed_params {
     uint32_t timestamp;
 };
 
+// Destination of RequestDownload / TransferData, e.g. a flash writer.
+// write() gets the data at its offset from the download start, straight
+// from the transport's receive fragments. abort() (optional) drops the
+// partial data when a session change or the S3 timeout ends the download
+// before RequestTransferExit.
+struct diag_download_ops {
+    int (*begin)(uint32_t address, uint32_t size);
+    int (*write)(uint32_t offset, const uint8_t *data, size_t len);
+    int (*finish)(uint32_t size);
+    void (*abort)(void);
+};
+
 struct routine_status {
     uint16_t routine_id;
     uint8_t status;
@@ -100,12 +125,33 @@ struct routine_status {
 // Function Prototypes
 void diagnostic_service_init(void);
 int process_diagnostic_request(uint8_t service_id, const uint8_t *data, uint16_t len);
-void update_diagnostic_data(uint16_t did, const void *data, uint16_t len);
+// Request of len bytes (service ID first) in a fragment chain. TransferData
+// is passed to the download sink fragment by fragment, other requests are
+// copied into a DIAG_REQUEST_MAX_LEN buffer.
+int process_diagnostic_request_frags(const struct net_buf *frags, size_t len);
+void diag_service_set_download_ops(const struct diag_download_ops *ops);
+// Store the latest value of an application DID, replacing the previous one.
+// Returns -EMSGSIZE if len exceeds DIAG_DID_MAX_LEN or -ENOMEM if all
+// DIAG_DID_MAX_COUNT records hold other DIDs. Kept in diag_did.c.
+int update_diagnostic_data(uint16_t did, const void *data, uint16_t len);
+// Copy the stored value of did, returns its length, -ENOENT if it was never
+// stored or -ENOSPC if size is too small
+int diag_service_read_did(uint16_t did, uint8_t *buf, size_t size);
 int start_diagnostic_session(uint8_t session_type);
 int verify_security_access(uint8_t level, uint32_t key);
 int execute_routine(uint16_t routine_id, uint8_t control_type, const uint8_t *data, uint16_t len);
+// Set the status record returned by requestRoutineResults of the routine
+// started last. A routine that is no longer running can be started again.
+void diag_service_routine_update(uint16_t routine_id, bool running,
+                                 const uint8_t *record, uint16_t len);
+// Copy the status record of routine_id, returns its length or -ENOENT if
+// it is not the routine started last
+int diag_service_routine_result(uint16_t routine_id, uint8_t *buf, size_t size);
 int control_dtc_settings(uint8_t dtc_setting);
 int control_communication(uint8_t control_type, uint8_t comm_type);
 const char *get_diag_error_string(uint8_t response_code);
 
+// Routine handlers provided by the application, with CONFIG_CAN_RECORDER
+int execute_can_recorder(const uint8_t *data, uint16_t len);
+
 #endif /* DIAG_SERVICE_H */
@@ -4,6 +4,10 @@
 #include "task_monitor.h"
 #include <zephyr/logging/log.h>
 
+#ifdef CONFIG_J1939_DM
+#include "j1939_dm.h"
+#endif
+
 LOG_MODULE_REGISTER(error_handler, CONFIG_ERROR_HANDLER_LOG_LEVEL);
 
 #define MAX_RETRIES 3
@@ -12,6 +16,42 @@ LOG_MODULE_REGISTER(error_handler, CONFIG_ERROR_HANDLER_LOG_LEVEL);
 static uint32_t error_counts[ERROR_TYPE_MAX];
 static K_MUTEX_DEFINE(error_mutex);
 
+#ifdef CONFIG_J1939_DM
+// Faults as J1939 DTCs, SPNs from the manufacturer range unless a standard
+// one fits. Errors that end in the safe state light the red stop lamp.
+static const struct {
+    uint32_t error_code;
+    uint32_t spn;
+    uint8_t fmi;
+    uint8_t lamps;
+} dtc_map[] = {
+    { ERROR_SENSOR_TIMEOUT,         J1939_SPN_PROPRIETARY + 0, 9,  J1939_LAMP_AMBER },
+    { ERROR_CAN_BUS_OFF,            639,                       14, J1939_LAMP_AMBER },
+    { ERROR_MQTT_DISCONNECT,        J1939_SPN_PROPRIETARY + 1, 19, 0 },
+    { ERROR_BLE_FAIL,               J1939_SPN_PROPRIETARY + 2, 12, 0 },
+    { ERROR_SECURE_BOOT,            J1939_SPN_PROPRIETARY + 3, 12, J1939_LAMP_RED_STOP },
+    { ERROR_CONTROL_FLOW_VIOLATION, J1939_SPN_PROPRIETARY + 16, 12, J1939_LAMP_RED_STOP },
+    { ERROR_STACK_OVERFLOW_WARNING, J1939_SPN_PROPRIETARY + 17, 14, J1939_LAMP_AMBER },
+    { ERROR_REDUNDANCY_MISMATCH,    J1939_SPN_PROPRIETARY + 18, 2,  J1939_LAMP_RED_STOP },
+    { ERROR_TIMING_VIOLATION,       J1939_SPN_PROPRIETARY + 19, 8,  J1939_LAMP_AMBER },
+    { ERROR_MEMORY_CORRUPTION,      J1939_SPN_PROPRIETARY + 20, 12, J1939_LAMP_RED_STOP },
+};
+
+void error_report_dtc(uint32_t error_code, bool active) {
+    for (int i = 0; i < ARRAY_SIZE(dtc_map); i++) {
+        if (dtc_map[i].error_code != error_code) {
+            continue;
+        }
+        if (active) {
+            j1939_dm_set(dtc_map[i].spn, dtc_map[i].fmi, dtc_map[i].lamps);
+        } else {
+            j1939_dm_clear(dtc_map[i].spn, dtc_map[i].fmi);
+        }
+        return;
+    }
+}
+#endif
+
 void error_handler_init(void) {
     k_mutex_lock(&error_mutex, K_FOREVER);
     memset(error_counts, 0, sizeof(error_counts));
@@ -36,7 +76,8 @@ static void reset_error_count(uint32_t error_type) {
 
 void handle_error(uint32_t error_type) {
     LOG_ERR("Error detected: %d", error_type);
-    
+    error_report_dtc(error_type, true);
+
     if (!should_attempt_recovery(error_type)) {
         LOG_ERR("Max retries exceeded for error type %d", error_type);
         enter_safe_state();
@@ -79,6 +120,7 @@ void handle_error(uint32_t error_type) {
     
     if (recovered) {
         reset_error_count(error_type);
+        error_report_dtc(error_type, false);
         LOG_INF("Successfully recovered from error %d", error_type);
     } else {
         LOG_ERR("Recovery failed for error %d", error_type);
@@ -210,7 +252,8 @@ void notify_error_recovery(uint32_t error_type) {
     k_mutex_lock(&error_mutex, K_FOREVER);
     error_counts[error_type] = 0;
     k_mutex_unlock(&error_mutex);
-    
+    error_report_dtc(error_type, false);
+
     LOG_INF("Error %d recovery confirmed", error_type);
 }
 
@@ -40,4 +40,11 @@ void watchdog_feed(void);
 void handle_safety_error(uint32_t error_code, error_class_t class);
 void log_safety_violation(const char *description, uint32_t data);
 
+// Mirror a fault into the J1939 DM1 (active) / DM2 (previously active) lists
+#ifdef CONFIG_J1939_DM
+void error_report_dtc(uint32_t error_code, bool active);
+#else
+static inline void error_report_dtc(uint32_t error_code, bool active) {}
+#endif
+
 #endif /* ERROR_HANDLER_H */
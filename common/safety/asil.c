@@ -127,6 +127,8 @@ void safety_monitor_task(void) {
 }
 
 recovery_result_t attempt_recovery(uint32_t error_type) {
+    error_report_dtc(error_type, true);
+
     if (safety_ctx.recovery_attempts >= MAX_RECOVERY_ATTEMPTS) {
         k_mutex_lock(&safety_ctx.stats_mutex, K_FOREVER);
         safety_ctx.stats.failed_recoveries++;
@@ -152,6 +154,7 @@ recovery_result_t attempt_recovery(uint32_t error_type) {
         k_mutex_unlock(&safety_ctx.stats_mutex);
         safety_ctx.recovery_attempts = 0;
         safety_ctx.current_state = SAFETY_STATE_NORMAL;
+        error_report_dtc(error_type, false);
     }
     
     return result;
@@ -1,52 +1,169 @@
 #include "can_auth.h"
-#include <mbedtls/cmac.h>
+#include <string.h>
 #include <mbedtls/aes.h>
 
-#define MAC_LENGTH 8
-static const uint8_t auth_key[16] = {0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF,
-                                    0xFE, 0xDC, 0xBA, 0x98, 0x76, 0x54, 0x32, 0x10};
+#define CMAC_BLOCK  16
+#define CMAC_RB     0x87    // Subkey constant for 128-bit blocks (RFC 4493)
+
+#define CLASSIC_MAX_DLC 8
+
+static const uint8_t auth_key[CAN_AUTH_KEY_LEN] = {0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF,
+                                                   0xFE, 0xDC, 0xBA, 0x98, 0x76, 0x54, 0x32, 0x10};
+
+// Everything that depends on the key only. A frame costs the AES blocks of
+// its CMAC and nothing else: no cipher setup, key expansion or subkeys.
+struct cmac_key {
+    mbedtls_aes_context aes;
+    uint8_t k1[CMAC_BLOCK];
+    uint8_t k2[CMAC_BLOCK];
+    bool valid;
+};
+
+static struct cmac_key keys[CAN_AUTH_KEY_SLOTS];
+
+// out = in << 1, xor Rb if the top bit fell off
+static void cmac_subkey(uint8_t out[CMAC_BLOCK], const uint8_t in[CMAC_BLOCK]) {
+    uint8_t carry = in[0] >> 7;
+
+    for (int i = 0; i < CMAC_BLOCK - 1; i++) {
+        out[i] = (in[i] << 1) | (in[i + 1] >> 7);
+    }
+    out[CMAC_BLOCK - 1] = (in[CMAC_BLOCK - 1] << 1) ^ (carry * CMAC_RB);
+}
+
+int can_auth_set_key(int slot, const uint8_t key[CAN_AUTH_KEY_LEN]) {
+    struct cmac_key *k;
+    uint8_t l[CMAC_BLOCK] = {0};
+
+    if (slot < 0 || slot >= CAN_AUTH_KEY_SLOTS) {
+        return -EINVAL;
+    }
+    k = &keys[slot];
+
+    if (k->valid) {
+        mbedtls_aes_free(&k->aes);
+        k->valid = false;
+    }
+    mbedtls_aes_init(&k->aes);
+    if (mbedtls_aes_setkey_enc(&k->aes, key, CAN_AUTH_KEY_LEN * 8) != 0 ||
+        mbedtls_aes_crypt_ecb(&k->aes, MBEDTLS_AES_ENCRYPT, l, l) != 0) {
+        mbedtls_aes_free(&k->aes);
+        return -EINVAL;
+    }
+
+    cmac_subkey(k->k1, l);
+    cmac_subkey(k->k2, k->k1);
+    memset(l, 0, sizeof(l));
+    k->valid = true;
+    return 0;
+}
+
+int can_auth_init(void) {
+    return can_auth_set_key(0, auth_key);
+}
+
+// CMAC over the CAN ID followed by len data bytes, the state is a single
+// block on the stack
+static int cmac_frame(struct cmac_key *k, const struct can_frame *frame, size_t len,
+                      uint8_t mac[CMAC_BLOCK]) {
+    uint8_t msg[sizeof(frame->id) + sizeof(frame->data)];
+    size_t offset = 0;
+    const uint8_t *subkey;
+
+    memcpy(msg, &frame->id, sizeof(frame->id));
+    memcpy(&msg[sizeof(frame->id)], frame->data, len);
+    len += sizeof(frame->id);
+    memset(mac, 0, CMAC_BLOCK);
+
+    for (; len - offset > CMAC_BLOCK; offset += CMAC_BLOCK) {
+        for (int i = 0; i < CMAC_BLOCK; i++) {
+            mac[i] ^= msg[offset + i];
+        }
+        if (mbedtls_aes_crypt_ecb(&k->aes, MBEDTLS_AES_ENCRYPT, mac, mac) != 0) {
+            return -EIO;
+        }
+    }
+
+    // Last block: complete with K1, padded with 10..0 with K2
+    subkey = (len - offset == CMAC_BLOCK) ? k->k1 : k->k2;
+    for (int i = 0; i < CMAC_BLOCK; i++) {
+        uint8_t b = offset + i < len ? msg[offset + i] : (offset + i == len ? 0x80 : 0x00);
+
+        mac[i] ^= b ^ subkey[i];
+    }
+    return mbedtls_aes_crypt_ecb(&k->aes, MBEDTLS_AES_ENCRYPT, mac, mac) != 0 ? -EIO : 0;
+}
+
+static struct cmac_key *slot_key(int slot) {
+    if (slot < 0 || slot >= CAN_AUTH_KEY_SLOTS || !keys[slot].valid) {
+        return NULL;
+    }
+    return &keys[slot];
+}
+
+int can_auth_sign(int slot, struct can_frame *frame) {
+    struct cmac_key *k = slot_key(slot);
+    uint8_t len = can_dlc_to_bytes(frame->dlc);
+    uint8_t dlc = can_bytes_to_dlc(len + CAN_AUTH_MAC_LEN);
+    uint8_t padded = can_dlc_to_bytes(dlc) - CAN_AUTH_MAC_LEN;
+    uint8_t mac[CMAC_BLOCK];
+    int ret;
+
+    if (k == NULL) {
+        return -ENOKEY;
+    }
+    if (len + CAN_AUTH_MAC_LEN > sizeof(frame->data)) {
+        return -EINVAL;
+    }
+
+    // Pad up to the next valid length, the MAC takes the last 8 bytes
+    memset(&frame->data[len], CAN_AUTH_PAD_BYTE, padded - len);
 
-int authenticate_can_message(struct can_frame *frame) {
-    mbedtls_cipher_context_t ctx;
-    unsigned char mac[16];
-    
-    // Calculate CMAC over CAN ID and data
-    mbedtls_cipher_init(&ctx);
-    mbedtls_cipher_setup(&ctx, mbedtls_cipher_info_from_type(MBEDTLS_CIPHER_AES_128_ECB));
-    mbedtls_cipher_cmac_starts(&ctx, auth_key, 128);
-    
     // Include CAN ID in MAC calculation
-    mbedtls_cipher_cmac_update(&ctx, (uint8_t*)&frame->id, sizeof(frame->id));
-    mbedtls_cipher_cmac_update(&ctx, frame->data, frame->dlc);
-    mbedtls_cipher_cmac_finish(&ctx, mac);
-    
-    // Append truncated MAC to CAN frame
-    memcpy(&frame->data[frame->dlc], mac, MAC_LENGTH);
-    frame->dlc += MAC_LENGTH;
-    
-    mbedtls_cipher_free(&ctx);
+    ret = cmac_frame(k, frame, padded, mac);
+    if (ret != 0) {
+        return ret;
+    }
+
+    memcpy(&frame->data[padded], mac, CAN_AUTH_MAC_LEN);
+    frame->dlc = dlc;
+    if (dlc > CLASSIC_MAX_DLC) {
+        frame->flags |= CAN_FRAME_FDF;
+    }
     return 0;
 }
 
+int can_auth_verify(int slot, struct can_frame *frame) {
+    struct cmac_key *k = slot_key(slot);
+    uint8_t len = can_dlc_to_bytes(frame->dlc);
+    uint8_t mac[CMAC_BLOCK];
+    uint8_t diff = 0;
+    int ret;
+
+    if (k == NULL) {
+        return -ENOKEY;
+    }
+    if (len < CAN_AUTH_MAC_LEN) {
+        return -EINVAL;
+    }
+
+    len -= CAN_AUTH_MAC_LEN;
+    ret = cmac_frame(k, frame, len, mac);
+    if (ret != 0) {
+        return ret;
+    }
+
+    // Constant time, a mismatch must not tell how many bytes were right
+    for (int i = 0; i < CAN_AUTH_MAC_LEN; i++) {
+        diff |= mac[i] ^ frame->data[len + i];
+    }
+    return diff == 0 ? len : -EBADMSG;
+}
+
+int authenticate_can_message(struct can_frame *frame) {
+    return can_auth_sign(0, frame);
+}
+
 int verify_can_message(struct can_frame *frame) {
-    mbedtls_cipher_context_t ctx;
-    unsigned char mac[16];
-    unsigned char received_mac[MAC_LENGTH];
-    
-    // Extract received MAC
-    frame->dlc -= MAC_LENGTH;
-    memcpy(received_mac, &frame->data[frame->dlc], MAC_LENGTH);
-    
-    // Calculate expected MAC
-    mbedtls_cipher_init(&ctx);
-    mbedtls_cipher_setup(&ctx, mbedtls_cipher_info_from_type(MBEDTLS_CIPHER_AES_128_ECB));
-    mbedtls_cipher_cmac_starts(&ctx, auth_key, 128);
-    mbedtls_cipher_cmac_update(&ctx, (uint8_t*)&frame->id, sizeof(frame->id));
-    mbedtls_cipher_cmac_update(&ctx, frame->data, frame->dlc);
-    mbedtls_cipher_cmac_finish(&ctx, mac);
-    
-    mbedtls_cipher_free(&ctx);
-    
-    // Compare MACs
-    return memcmp(mac, received_mac, MAC_LENGTH) == 0 ? 0 : -1;
+    return can_auth_verify(0, frame);
 }
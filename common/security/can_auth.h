@@ -3,7 +3,27 @@
 
 #include <zephyr/drivers/can.h>
 
-// CMAC based authentication
+#define CAN_AUTH_KEY_LEN    16      // AES-128
+#define CAN_AUTH_KEY_SLOTS  4
+#define CAN_AUTH_MAC_LEN    8       // Truncated CMAC in the last bytes of the frame
+#define CAN_AUTH_PAD_BYTE   0x00    // Between data and MAC, up to a valid DLC
+
+// Expands a key into a slot once: AES round keys and the CMAC subkeys.
+// Not safe against sign/verify on the same slot running concurrently.
+int can_auth_set_key(int slot, const uint8_t key[CAN_AUTH_KEY_LEN]);
+
+// Loads the built-in key into slot 0
+int can_auth_init(void);
+
+// CMAC over CAN ID and data. Sign pads the data up to the next valid DLC
+// that has room for the MAC, puts the MAC last and makes the frame an FD
+// frame when it outgrows 8 bytes. Verify leaves the frame as it is and
+// returns the number of bytes before the MAC, data and padding, or
+// -EBADMSG on mismatch. Both return -ENOKEY for an empty slot.
+int can_auth_sign(int slot, struct can_frame *frame);
+int can_auth_verify(int slot, struct can_frame *frame);
+
+// CMAC based authentication with the key in slot 0
 int authenticate_can_message(struct can_frame *frame);
 int verify_can_message(struct can_frame *frame);
 
@@ -0,0 +1,250 @@
+#include <zephyr/kernel.h>
+#include <string.h>
+#include "can_tx_queue.h"
+
+enum tx_slot_state {
+    TX_SLOT_FREE = 0,
+    TX_SLOT_PENDING,
+    TX_SLOT_INFLIGHT
+};
+
+struct tx_slot {
+    const struct device *dev;
+    struct can_frame frame;
+    can_tx_prio_t prio;
+    enum tx_slot_state state;
+    uint32_t enqueue_cycles;
+    struct can_tx_id_stats *stats;
+};
+
+static struct tx_slot tx_slots[CAN_TX_QUEUE_SLOTS];
+static struct can_tx_id_stats tx_stats[CAN_TX_MAX_IDS];
+static uint8_t num_tx_ids;
+static uint8_t num_inflight;
+static struct k_spinlock tx_lock;
+
+static void tx_work_handler(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(tx_work, tx_work_handler);
+
+static struct can_tx_id_stats *find_or_create_stats(uint32_t id) {
+    for (int i = 0; i < num_tx_ids; i++) {
+        if (tx_stats[i].id == id) {
+            return &tx_stats[i];
+        }
+    }
+    if (num_tx_ids < CAN_TX_MAX_IDS) {
+        tx_stats[num_tx_ids].id = id;
+        return &tx_stats[num_tx_ids++];
+    }
+    return NULL;
+}
+
+// Pending slot for id, or a free slot, or the lowest priority pending
+// slot if it is less important than prio.
+static struct tx_slot *find_slot(uint32_t id, can_tx_prio_t prio, bool *coalesce) {
+    struct tx_slot *free_slot = NULL;
+    struct tx_slot *victim = NULL;
+
+    *coalesce = false;
+
+    for (int i = 0; i < CAN_TX_QUEUE_SLOTS; i++) {
+        struct tx_slot *slot = &tx_slots[i];
+
+        if (slot->state == TX_SLOT_PENDING && slot->frame.id == id) {
+            *coalesce = true;
+            return slot;
+        }
+        if (slot->state == TX_SLOT_FREE && free_slot == NULL) {
+            free_slot = slot;
+        }
+        if (slot->state == TX_SLOT_PENDING && slot->prio > prio &&
+            (victim == NULL || slot->prio > victim->prio)) {
+            victim = slot;
+        }
+    }
+
+    if (free_slot) {
+        return free_slot;
+    }
+    if (victim) {
+        if (victim->stats) {
+            victim->stats->dropped++;
+        }
+        victim->state = TX_SLOT_FREE;
+    }
+    return victim;
+}
+
+int can_tx_queue_send_frame(const struct device *dev, const struct can_frame *frame,
+                            can_tx_prio_t prio) {
+    struct can_tx_id_stats *stats;
+    struct tx_slot *slot;
+    bool coalesce;
+
+    if (prio >= CAN_TX_PRIO_COUNT) {
+        return -EINVAL;
+    }
+
+    k_spinlock_key_t key = k_spin_lock(&tx_lock);
+
+    stats = find_or_create_stats(frame->id);
+    slot = find_slot(frame->id, prio, &coalesce);
+    if (slot == NULL) {
+        if (stats) {
+            stats->dropped++;
+        }
+        k_spin_unlock(&tx_lock, key);
+        return -ENOBUFS;
+    }
+
+    slot->dev = dev;
+    memcpy(&slot->frame, frame, sizeof(struct can_frame));
+    slot->prio = prio;
+    if (!coalesce) {
+        // A newer sample keeps its slot's place in line, otherwise an ID
+        // updated faster than it drains would never be sent
+        slot->state = TX_SLOT_PENDING;
+        slot->enqueue_cycles = k_cycle_get_32();
+    }
+    slot->stats = stats;
+
+    if (stats) {
+        stats->queued++;
+        if (coalesce) {
+            stats->coalesced++;
+        }
+    }
+
+    k_spin_unlock(&tx_lock, key);
+
+    k_work_schedule(&tx_work, K_NO_WAIT);
+    return 0;
+}
+
+int can_tx_queue_send(const struct device *dev, uint32_t id,
+                      const uint8_t *data, uint8_t len, can_tx_prio_t prio) {
+    struct can_frame frame = {
+        .id = id,
+        .dlc = can_bytes_to_dlc(len),
+    };
+
+    if (len > CAN_MAX_DLEN) {
+        return -EINVAL;
+    }
+
+    memcpy(frame.data, data, len);
+    return can_tx_queue_send_frame(dev, &frame, prio);
+}
+
+static void tx_done_cb(const struct device *dev, int error, void *user_data) {
+    struct tx_slot *slot = user_data;
+    uint32_t latency_us = k_cyc_to_us_floor32(k_cycle_get_32() - slot->enqueue_cycles);
+
+    k_spinlock_key_t key = k_spin_lock(&tx_lock);
+
+    if (slot->stats) {
+        if (error == 0) {
+            slot->stats->sent++;
+            slot->stats->latency_last_us = latency_us;
+            slot->stats->latency_sum_us += latency_us;
+            if (latency_us > slot->stats->latency_max_us) {
+                slot->stats->latency_max_us = latency_us;
+            }
+        } else {
+            slot->stats->errors++;
+        }
+    }
+
+    slot->state = TX_SLOT_FREE;
+    num_inflight--;
+
+    k_spin_unlock(&tx_lock, key);
+
+    k_work_schedule(&tx_work, K_NO_WAIT);
+}
+
+static struct tx_slot *next_pending(void) {
+    struct tx_slot *best = NULL;
+
+    for (int i = 0; i < CAN_TX_QUEUE_SLOTS; i++) {
+        struct tx_slot *slot = &tx_slots[i];
+
+        if (slot->state != TX_SLOT_PENDING) {
+            continue;
+        }
+        if (best == NULL || slot->prio < best->prio ||
+            (slot->prio == best->prio &&
+             (int32_t)(slot->enqueue_cycles - best->enqueue_cycles) < 0)) {
+            best = slot;
+        }
+    }
+    return best;
+}
+
+static void tx_work_handler(struct k_work *work) {
+    while (1) {
+        k_spinlock_key_t key = k_spin_lock(&tx_lock);
+        struct tx_slot *slot = NULL;
+
+        if (num_inflight < CAN_TX_MAX_INFLIGHT) {
+            slot = next_pending();
+        }
+        if (slot == NULL) {
+            k_spin_unlock(&tx_lock, key);
+            return;
+        }
+
+        slot->state = TX_SLOT_INFLIGHT;
+        num_inflight++;
+        k_spin_unlock(&tx_lock, key);
+
+        int ret = can_send(slot->dev, &slot->frame, K_NO_WAIT, tx_done_cb, slot);
+        if (ret == 0) {
+            continue;
+        }
+
+        key = k_spin_lock(&tx_lock);
+        num_inflight--;
+        if (ret == -EAGAIN) {
+            // Controller mailboxes are full, try again shortly
+            slot->state = TX_SLOT_PENDING;
+            k_spin_unlock(&tx_lock, key);
+            k_work_schedule(&tx_work, K_MSEC(CAN_TX_RETRY_DELAY_MS));
+            return;
+        }
+        if (slot->stats) {
+            slot->stats->errors++;
+        }
+        slot->state = TX_SLOT_FREE;
+        k_spin_unlock(&tx_lock, key);
+    }
+}
+
+int can_tx_queue_get_stats(uint32_t id, struct can_tx_id_stats *stats) {
+    int ret = -ENOENT;
+    k_spinlock_key_t key = k_spin_lock(&tx_lock);
+
+    for (int i = 0; i < num_tx_ids; i++) {
+        if (tx_stats[i].id == id) {
+            memcpy(stats, &tx_stats[i], sizeof(*stats));
+            ret = 0;
+            break;
+        }
+    }
+
+    k_spin_unlock(&tx_lock, key);
+    return ret;
+}
+
+void can_tx_queue_reset_stats(void) {
+    k_spinlock_key_t key = k_spin_lock(&tx_lock);
+
+    for (int i = 0; i < num_tx_ids; i++) {
+        uint32_t id = tx_stats[i].id;
+
+        memset(&tx_stats[i], 0, sizeof(tx_stats[i]));
+        tx_stats[i].id = id;
+    }
+
+    k_spin_unlock(&tx_lock, key);
+}
@@ -0,0 +1,44 @@
+#ifndef CAN_TX_QUEUE_H
+#define CAN_TX_QUEUE_H
+
+#include <zephyr/kernel.h>
+#include <zephyr/drivers/can.h>
+
+#define CAN_TX_QUEUE_SLOTS      16
+#define CAN_TX_MAX_IDS          8
+#define CAN_TX_MAX_INFLIGHT     2
+#define CAN_TX_RETRY_DELAY_MS   1
+
+// Lower value is sent first
+typedef enum {
+    CAN_TX_PRIO_HIGH = 0,
+    CAN_TX_PRIO_NORMAL,
+    CAN_TX_PRIO_LOW,
+    CAN_TX_PRIO_COUNT
+} can_tx_prio_t;
+
+struct can_tx_id_stats {
+    uint32_t id;
+    uint32_t queued;
+    uint32_t sent;
+    uint32_t coalesced;     // Pending samples replaced by a newer one
+    uint32_t dropped;       // Queue full or evicted by higher priority
+    uint32_t errors;        // Completed with a driver error
+    uint32_t latency_last_us;
+    uint32_t latency_max_us;
+    uint64_t latency_sum_us;
+};
+
+// Queue a frame without blocking. A pending frame with the same ID is
+// replaced by the newer sample, which is sent in the old one's place.
+int can_tx_queue_send(const struct device *dev, uint32_t id,
+                      const uint8_t *data, uint8_t len, can_tx_prio_t prio);
+
+// Same as can_tx_queue_send() for a prepared frame, e.g. a CAN FD frame
+int can_tx_queue_send_frame(const struct device *dev, const struct can_frame *frame,
+                            can_tx_prio_t prio);
+
+int can_tx_queue_get_stats(uint32_t id, struct can_tx_id_stats *stats);
+void can_tx_queue_reset_stats(void);
+
+#endif /* CAN_TX_QUEUE_H */
@@ -1,4 +1,7 @@
 #include "sensor_common.h"
+#include "can_tx_queue.h"
+#include "can_ids.h"
+#include "can_time_sync.h"
 
 node_error_t sensor_init(const struct device *dev) {
     if (!device_is_ready(dev)) {
@@ -7,13 +10,41 @@ node_error_t sensor_init(const struct device *dev) {
     return NODE_SUCCESS;
 }
 
+static can_tx_prio_t tx_priority_for_id(uint32_t id) {
+    switch (id) {
+        case CAN_ID_BRAKE:
+        case CAN_ID_COLLISION:
+        case CAN_ID_SPEED:
+            return CAN_TX_PRIO_HIGH;
+        case CAN_ID_TPMS:
+        case CAN_ID_TEMP:
+            return CAN_TX_PRIO_LOW;
+        default:
+            return CAN_TX_PRIO_NORMAL;
+    }
+}
+
 int send_sensor_data(const struct device *can_dev, uint32_t id, 
                     const uint8_t *data, uint8_t len) {
-    struct can_frame frame = {
-        .id = id,
-        .dlc = len,
-    };
-    memcpy(frame.data, data, len);
-    
-    return can_send(can_dev, &frame, K_MSEC(100), NULL, NULL);
+    return send_sensor_sample(can_dev, id, data, len, can_time_sync_now_us());
+}
+
+int send_sensor_sample(const struct device *can_dev, uint32_t id,
+                       const uint8_t *data, uint8_t len, uint32_t sample_us) {
+    can_tx_prio_t prio = tx_priority_for_id(id);
+    uint8_t payload[CAN_MAX_DLEN];
+
+    if (len > CAN_MAX_DLEN) {
+        return -EINVAL;
+    }
+
+    // Timestamp in VCU time after the signals when it fits the frame
+    if (IS_ENABLED(CONFIG_CAN_TIME_SYNC) && can_time_sync_is_synced()) {
+        memcpy(payload, data, len);
+        len = can_sample_ts_append(payload, len, CAN_MAX_DLEN, sample_us);
+        data = payload;
+    }
+
+    // Queued and sent from the TX work item, never blocks the sampling thread
+    return can_tx_queue_send(can_dev, id, data, len, prio);
 }
@@ -22,8 +22,14 @@ typedef enum {
 // Common sensor initialization function
 node_error_t sensor_init(const struct device *dev);
 
-// Common CAN transmission function
+// Common CAN transmission function, queues the frame without blocking
 int send_sensor_data(const struct device *can_dev, uint32_t id, 
                     const uint8_t *data, uint8_t len);
 
+// Same as send_sensor_data() with the time the sample was taken, from
+// can_time_sync_now_us(). With CONFIG_CAN_TIME_SYNC the timestamp is
+// appended to the payload once the node is synced to the VCU.
+int send_sensor_sample(const struct device *can_dev, uint32_t id,
+                       const uint8_t *data, uint8_t len, uint32_t sample_us);
+
 #endif /* SENSOR_COMMON_H */
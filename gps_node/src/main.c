@@ -3,6 +3,7 @@
 #include <zephyr/drivers/can.h>
 #include "sensor_common.h"
 #include "can_ids.h"
+#include "signal_codec.h"
 
 #define GPS_UART_NODE DT_ALIAS(uart_gps)
 #define GPS_BUFFER_SIZE 256
@@ -24,8 +25,11 @@ static void uart_cb(const struct device *dev, void *user_data)
                 parse_gps_data(rx_buf, pos, &lat, &lon);
                 
                 uint8_t can_data[GPS_MSG_LEN];
-                memcpy(can_data, &lat, sizeof(float));
-                memcpy(can_data + sizeof(float), &lon, sizeof(float));
+                struct sig_gps msg = {
+                    .latitude = sig_gps_latitude_from_phys(lat),
+                    .longitude = sig_gps_longitude_from_phys(lon),
+                };
+                sig_gps_pack(can_data, &msg);
                 send_sensor_data(can_dev, CAN_ID_GPS, can_data, GPS_MSG_LEN);
             }
             pos = 0;
@@ -3,6 +3,7 @@
 #include <zephyr/drivers/can.h>
 #include "sensor_common.h"
 #include "can_ids.h"
+#include "signal_codec.h"
 
 #define HALL_SENSOR_PIN 5
 #define WHEEL_CIRCUMFERENCE 2.0f  // meters
@@ -22,7 +23,7 @@ static void hall_sensor_callback(const struct device *dev,
 
 static void speed_thread(void *arg1, void *arg2, void *arg3) {
     uint8_t can_data[SPEED_MSG_LEN];
-    uint16_t speed_kmh;
+    struct sig_speed msg;
     uint32_t last_count = 0;
     uint64_t last_time = k_uptime_get();
 
@@ -38,9 +39,8 @@ static void speed_thread(void *arg1, void *arg2, void *arg3) {
             float distance = rotations * WHEEL_CIRCUMFERENCE;
             float speed = (distance / time_diff) * 3.6f;  // Convert m/s to km/h
             
-            speed_kmh = (uint16_t)speed;
-            can_data[0] = speed_kmh >> 8;
-            can_data[1] = speed_kmh & 0xFF;
+            msg.speed = sig_speed_speed_from_phys(speed);
+            sig_speed_pack(can_data, &msg);
             
             send_sensor_data(can_dev, CAN_ID_SPEED, can_data, SPEED_MSG_LEN);
         }
@@ -3,6 +3,7 @@
 #include <zephyr/drivers/gpio.h>
 #include "sensor_common.h"
 #include "can_ids.h"
+#include "signal_codec.h"
 
 #define DS18B20_PIN 5  // GPIO pin for 1-Wire
 
@@ -12,16 +13,16 @@ static const struct device *can_dev;
 void temperature_thread(void *arg1, void *arg2, void *arg3) {
     struct sensor_value temp;
     uint8_t data[TEMP_MSG_LEN];
-    float temperature;
+    struct sig_temp msg;
 
     while (1) {
         // Read temperature from DS18B20
         if (sensor_sample_fetch(temp_dev) == 0) {
             sensor_channel_get(temp_dev, SENSOR_CHAN_AMBIENT_TEMP, &temp);
             
-            // Convert to float for CAN transmission
-            temperature = sensor_value_to_double(&temp);
-            memcpy(data, &temperature, sizeof(float));
+            // 0.01 degC steps, val2 is in millionths of a degree
+            msg.temperature = (int16_t)(temp.val1 * 100 + temp.val2 / 10000);
+            sig_temp_pack(data, &msg);
 
             // Send over CAN
             send_sensor_data(can_dev, CAN_ID_TEMP, data, TEMP_MSG_LEN);
@@ -0,0 +1,117 @@
+#include <zephyr/ztest.h>
+#include <zephyr/drivers/can.h>
+#include <string.h>
+#include "can_auth.h"
+
+#define TEST_SLOT   1
+
+// RFC 4493 example key and message, split into CAN ID and data so the MAC
+// covers exactly the message of the RFC
+static const uint8_t rfc_key[CAN_AUTH_KEY_LEN] = {
+    0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+    0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c,
+};
+
+static const uint8_t rfc_msg[40] = {
+    0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96, 0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93,
+    0x17, 0x2a, 0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c, 0x9e, 0xb7, 0x6f, 0xac,
+    0x45, 0xaf, 0x8e, 0x51, 0x30, 0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4, 0x11,
+};
+
+// ID from the first 4 message bytes, then len data bytes as a valid DLC
+static void rfc_frame(struct can_frame *frame, uint8_t dlc) {
+    memset(frame, 0, sizeof(*frame));
+    memcpy(&frame->id, rfc_msg, sizeof(frame->id));
+    memcpy(frame->data, &rfc_msg[sizeof(frame->id)], can_dlc_to_bytes(dlc));
+    frame->dlc = dlc;
+    frame->flags = dlc > 8 ? CAN_FRAME_FDF : 0;
+}
+
+static void *auth_setup(void) {
+    zassert_equal(can_auth_init(), 0, "Built-in key rejected");
+    zassert_equal(can_auth_set_key(TEST_SLOT, rfc_key), 0, "Key rejected");
+    return NULL;
+}
+
+ZTEST_SUITE(can_auth_tests, NULL, auth_setup, NULL, NULL, NULL);
+
+ZTEST(can_auth_tests, test_rfc4493_vectors)
+{
+    // Example 2: 12 data bytes, the MAC completes a 20 byte frame
+    static const uint8_t mac16[CAN_AUTH_MAC_LEN] = {0x07, 0x0a, 0x16, 0xb4, 0x6b, 0x4d, 0x41, 0x44};
+    // 32 data bytes and 8 pad bytes, example 3 key and message
+    static const uint8_t mac44[CAN_AUTH_MAC_LEN] = {0x75, 0x29, 0xe3, 0xff, 0x43, 0x44, 0x0e, 0x14};
+    static const uint8_t pad[8] = {0};
+    struct can_frame frame;
+
+    rfc_frame(&frame, can_bytes_to_dlc(12));
+    zassert_equal(can_auth_sign(TEST_SLOT, &frame), 0, "Sign failed");
+    zassert_equal(can_dlc_to_bytes(frame.dlc), 20, "MAC not appended");
+    zassert_mem_equal(&frame.data[12], mac16, CAN_AUTH_MAC_LEN, "Wrong MAC, complete block");
+
+    rfc_frame(&frame, can_bytes_to_dlc(32));
+    zassert_equal(can_auth_sign(TEST_SLOT, &frame), 0, "Sign failed");
+    zassert_equal(can_dlc_to_bytes(frame.dlc), 48, "Not padded to a valid length");
+    zassert_mem_equal(&frame.data[32], pad, sizeof(pad), "Wrong padding");
+    zassert_mem_equal(&frame.data[40], mac44, CAN_AUTH_MAC_LEN, "Wrong MAC, padded block");
+    zassert_equal(can_auth_verify(TEST_SLOT, &frame), 40, "Padded frame rejected");
+}
+
+ZTEST(can_auth_tests, test_classic_frame)
+{
+    struct can_frame frame = {
+        .id = 0x123,
+        .dlc = 8,
+        .data = {0x10, 0x20, 0x30, 0x40, 0x50, 0x60, 0x70, 0x80},
+    };
+    struct can_frame copy;
+
+    // 8 data bytes and the MAC only fit an FD frame of 16 bytes
+    zassert_equal(authenticate_can_message(&frame), 0, "Sign failed");
+    zassert_equal(frame.dlc, can_bytes_to_dlc(16), "Wrong DLC");
+    zassert_true(frame.flags & CAN_FRAME_FDF, "Not an FD frame");
+    copy = frame;
+    zassert_equal(verify_can_message(&copy), 8, "Own MAC rejected");
+    zassert_equal(copy.dlc, frame.dlc, "Frame changed");
+
+    copy = frame;
+    copy.id ^= 1;
+    zassert_equal(verify_can_message(&copy), -EBADMSG, "Other ID accepted");
+
+    copy = frame;
+    copy.data[0] ^= 0x80;
+    zassert_equal(verify_can_message(&copy), -EBADMSG, "Changed data accepted");
+
+    copy = frame;
+    zassert_equal(can_auth_verify(TEST_SLOT, &copy), -EBADMSG, "Other key accepted");
+}
+
+ZTEST(can_auth_tests, test_short_frame)
+{
+    struct can_frame frame = {
+        .id = 0x124,
+        .dlc = 3,
+        .data = {0x01, 0x02, 0x03},
+    };
+
+    // 3 + 8 bytes round up to 12, one pad byte before the MAC
+    zassert_equal(authenticate_can_message(&frame), 0, "Sign failed");
+    zassert_equal(can_dlc_to_bytes(frame.dlc), 12, "Not padded to a valid length");
+    zassert_equal(frame.data[3], CAN_AUTH_PAD_BYTE, "Wrong padding");
+    zassert_equal(verify_can_message(&frame), 4, "Own MAC rejected");
+}
+
+ZTEST(can_auth_tests, test_invalid)
+{
+    struct can_frame frame = { .dlc = 4 };
+
+    zassert_equal(can_auth_sign(CAN_AUTH_KEY_SLOTS - 1, &frame), -ENOKEY, "Empty slot used");
+    zassert_equal(can_auth_sign(CAN_AUTH_KEY_SLOTS, &frame), -ENOKEY, "Slot out of range");
+    zassert_equal(can_auth_set_key(-1, rfc_key), -EINVAL, "Slot out of range");
+
+    frame.dlc = can_bytes_to_dlc(64);
+    frame.flags = CAN_FRAME_FDF;
+    zassert_equal(authenticate_can_message(&frame), -EINVAL, "No room for the MAC");
+    frame.dlc = CAN_AUTH_MAC_LEN - 1;
+    zassert_equal(verify_can_message(&frame), -EINVAL, "Frame without MAC accepted");
+}
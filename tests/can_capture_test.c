@@ -0,0 +1,113 @@
+#include <zephyr/ztest.h>
+#include <string.h>
+#include "can_capture.h"
+
+#define TEST_BLOCKS 4
+
+static uint8_t image[CAN_CAPTURE_HDR_LEN + TEST_BLOCKS * CAN_CAPTURE_BLOCK_SIZE];
+
+struct parse_result {
+    uint32_t count;
+    struct can_frame frames[8];
+    uint32_t ts[8];
+};
+
+static void collect_frame(const struct can_frame *frame, uint32_t ts_us, void *user_data) {
+    struct parse_result *res = user_data;
+
+    if (res->count < ARRAY_SIZE(res->frames)) {
+        res->frames[res->count] = *frame;
+        res->ts[res->count] = ts_us;
+    }
+    res->count++;
+}
+
+ZTEST_SUITE(can_capture_tests, NULL, NULL, NULL, NULL, NULL);
+
+ZTEST(can_capture_tests, test_round_trip)
+{
+    struct can_capture_writer w;
+    struct parse_result res = {0};
+    struct can_frame std = { .id = 0x51, .dlc = 2, .data = {0x12, 0x34} };
+    struct can_frame ext = { .id = 0x18FEF100, .dlc = 8, .flags = CAN_FRAME_IDE,
+                             .data = {1, 2, 3, 4, 5, 6, 7, 8} };
+    struct can_frame fd = { .id = 0x300, .dlc = can_bytes_to_dlc(20),
+                            .flags = CAN_FRAME_FDF | CAN_FRAME_BRS };
+
+    memset(fd.data, 0xA5, 20);
+
+    can_capture_block_start(&w, &image[CAN_CAPTURE_HDR_LEN], 1000000);
+    zassert_equal(can_capture_block_add(&w, &std, 1000100), 0, "Add failed");
+    zassert_equal(can_capture_block_add(&w, &ext, 1000350), 0, "Add failed");
+    zassert_equal(can_capture_block_add(&w, &fd, 1000400), 0, "Add failed");
+    can_capture_write_header(image, 1, 0);
+
+    zassert_equal(can_capture_parse(image, CAN_CAPTURE_HDR_LEN + CAN_CAPTURE_BLOCK_SIZE,
+                                    collect_frame, &res), 3, "Unexpected frame count");
+
+    zassert_equal(res.frames[0].id, 0x51, "ID mismatch");
+    zassert_equal(res.ts[0], 1000100, "Timestamp mismatch");
+    zassert_mem_equal(res.frames[0].data, std.data, 2, "Payload mismatch");
+
+    zassert_equal(res.frames[1].id, 0x18FEF100, "Extended ID mismatch");
+    zassert_true(res.frames[1].flags & CAN_FRAME_IDE, "IDE flag lost");
+    zassert_equal(res.ts[1], 1000350, "Timestamp mismatch");
+
+    zassert_equal(res.frames[2].flags, CAN_FRAME_FDF | CAN_FRAME_BRS, "FD flags lost");
+    zassert_equal(can_dlc_to_bytes(res.frames[2].dlc), 20, "FD length mismatch");
+    zassert_mem_equal(res.frames[2].data, fd.data, 20, "FD payload mismatch");
+}
+
+ZTEST(can_capture_tests, test_block_full)
+{
+    struct can_capture_writer w;
+    struct can_frame frame = { .id = 0x55, .dlc = 8 };
+    uint8_t block[CAN_CAPTURE_BLOCK_SIZE];
+    int added = 0;
+
+    can_capture_block_start(&w, block, 0);
+
+    while (can_capture_block_add(&w, &frame, added) == 0) {
+        added++;
+    }
+
+    // 6 byte block header, 13 bytes per classic 8 byte frame
+    zassert_equal(added, (CAN_CAPTURE_BLOCK_SIZE - CAN_CAPTURE_BLOCK_HDR_LEN) / 13,
+                  "Unexpected frames per block");
+    zassert_equal(can_capture_parse_block(block, collect_frame, &(struct parse_result){0}),
+                  added, "Parse count mismatch");
+}
+
+// A pause beyond the 16 bit delta costs a gap record, not a new block
+ZTEST(can_capture_tests, test_long_gap)
+{
+    struct can_capture_writer w;
+    struct parse_result res = {0};
+    struct can_frame frame = { .id = 0x55, .dlc = 2 };
+    uint8_t block[CAN_CAPTURE_BLOCK_SIZE];
+    uint16_t used;
+
+    can_capture_block_start(&w, block, 1000);
+    zassert_equal(can_capture_block_add(&w, &frame, 1000), 0, "Add failed");
+    used = w.used;
+    zassert_equal(can_capture_block_add(&w, &frame, 1000 + 3000000), 0, "Gap not recorded");
+    zassert_equal(w.used - used, 5 + 7, "Expected a gap and a frame record");
+    zassert_equal(can_capture_block_add(&w, &frame, 1000 + 3000010), 0, "Add failed");
+
+    zassert_equal(can_capture_parse_block(block, collect_frame, &res), 3, "Parse count mismatch");
+    zassert_equal(res.ts[1], 1000 + 3000000, "Timestamp after gap mismatch");
+    zassert_equal(res.ts[2], 1000 + 3000010, "Timestamp mismatch");
+}
+
+ZTEST(can_capture_tests, test_bad_image)
+{
+    struct parse_result res = {0};
+
+    can_capture_write_header(image, TEST_BLOCKS, 0);
+    zassert_equal(can_capture_parse(image, CAN_CAPTURE_HDR_LEN, collect_frame, &res), -EBADMSG,
+                  "Truncated image accepted");
+
+    image[0] = 'X';
+    zassert_equal(can_capture_parse(image, sizeof(image), collect_frame, &res), -EINVAL,
+                  "Bad magic accepted");
+}
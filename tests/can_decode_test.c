@@ -0,0 +1,179 @@
+#include <zephyr/ztest.h>
+#include <string.h>
+#include "can_decode.h"
+#include "mqtt_handler.h"
+#include "v2x_handler.h"
+#include "telemetry_policy.h"
+#include "signal_codec.h"
+#include "j1939.h"
+
+// ET1 from source address 0x00 at priority 6
+#define TEST_ET1_ID     ((6 << 26) | (J1939_PGN_ENGINE_TEMP << 8) | 0x00)
+
+// Output of the decoder, recorded instead of going to MQTT and BLE
+static const char *published_topic;
+static float published[2];
+static int num_published;
+static uint8_t v2v_type;
+static uint16_t v2v_len;
+static int num_v2v;
+
+void publish_sensor_data(const char *topic, float value) {
+    published_topic = topic;
+    published[0] = value;
+    num_published++;
+}
+
+void publish_gps_data(const char *topic, float lat, float lon) {
+    published_topic = topic;
+    published[0] = lat;
+    published[1] = lon;
+    num_published++;
+}
+
+int broadcast_v2v_data(uint8_t type, const uint8_t *data, uint16_t len) {
+    v2v_type = type;
+    v2v_len = len;
+    num_v2v++;
+    return 0;
+}
+
+static struct can_frame speed_frame(uint16_t kmh, uint8_t dlc) {
+    struct sig_speed msg = { .speed = kmh };
+    struct can_frame frame = {
+        .id = CAN_ID_SPEED,
+        .dlc = dlc,
+    };
+
+    sig_speed_pack(frame.data, &msg);
+    return frame;
+}
+
+static void can_decode_before(void *fixture) {
+    signal_cache_init();
+    telemetry_policy_init();
+    published_topic = NULL;
+    num_published = 0;
+    num_v2v = 0;
+}
+
+ZTEST_SUITE(can_decode_tests, NULL, NULL, can_decode_before, NULL, NULL);
+
+ZTEST(can_decode_tests, test_lookup_by_id)
+{
+#define CHECK_LOOKUP(name, _id, _len)                                           \
+    zassert_not_null(can_decode_lookup(_id), #name " not found");               \
+    zassert_equal(can_decode_lookup(_id)->id, (_id), #name " wrong entry");     \
+    zassert_equal(can_decode_lookup(_id)->len, (_len), #name " wrong length");
+    CAN_SENSOR_MSG_LIST(CHECK_LOOKUP)
+#undef CHECK_LOOKUP
+
+    // Inside the table without a decoder, and either side of it
+    zassert_is_null(can_decode_lookup(CAN_ID_TIME_SYNC), "Time sync decoded");
+    zassert_is_null(can_decode_lookup(CAN_DECODE_ID_BASE - 1), "ID below the table");
+    zassert_is_null(can_decode_lookup(CAN_DECODE_ID_BASE + CAN_DECODE_ID_SPAN),
+                    "ID above the table");
+}
+
+ZTEST(can_decode_tests, test_dispatch_speed)
+{
+    struct can_frame frame = speed_frame(72, SPEED_MSG_LEN);
+    struct signal_sample sample;
+
+    zassert_equal(can_decode_dispatch(&frame, 0), 0, "Dispatch failed");
+
+    zassert_equal(signal_cache_read(SIGNAL_VEHICLE_SPEED, &sample), 0, "Not cached");
+    zassert_within(sample.value, 72.0f, 0.001f, "Cached speed");
+    zassert_equal(num_published, 1, "Not published");
+    zassert_equal(strcmp(published_topic, TOPIC_SPEED), 0, "Wrong topic");
+    zassert_within(published[0], 72.0f, 0.001f, "Published speed");
+    zassert_equal(num_v2v, 1, "Not forwarded");
+    zassert_equal(v2v_type, V2V_SPEED_DATA, "Wrong V2V type");
+}
+
+ZTEST(can_decode_tests, test_dispatch_gps)
+{
+    struct sig_gps msg = {
+        .latitude = sig_gps_latitude_from_phys(48.1351f),
+        .longitude = sig_gps_longitude_from_phys(11.582f),
+    };
+    struct can_frame frame = {
+        .id = CAN_ID_GPS,
+        .dlc = GPS_MSG_LEN,
+    };
+    struct vehicle_location location;
+
+    sig_gps_pack(frame.data, &msg);
+    zassert_equal(can_decode_dispatch(&frame, 0), 0, "Dispatch failed");
+
+    location = get_current_location();
+    zassert_within(location.latitude, 48.1351f, 0.0001f, "Cached latitude");
+    zassert_within(location.longitude, 11.582f, 0.0001f, "Cached longitude");
+    zassert_equal(strcmp(published_topic, TOPIC_GPS), 0, "Wrong topic");
+    zassert_within(published[1], 11.582f, 0.0001f, "Published longitude");
+}
+
+ZTEST(can_decode_tests, test_frame_length)
+{
+    struct can_decode_stats before, after;
+    struct can_frame frame = speed_frame(72, SPEED_MSG_LEN - 1);
+    struct signal_sample sample;
+
+    can_decode_get_stats(&before);
+    zassert_equal(can_decode_dispatch(&frame, 0), -EMSGSIZE, "Short frame decoded");
+    can_decode_get_stats(&after);
+    zassert_equal(after.bad_length, before.bad_length + 1, "Not counted");
+    zassert_equal(signal_cache_read(SIGNAL_VEHICLE_SPEED, &sample), -ENODATA, "Cached");
+    zassert_equal(num_published, 0, "Published");
+
+    // Longer frames carry the sample timestamp, V2V gets the signals only
+    frame = speed_frame(72, SPEED_MSG_LEN + 4);
+    zassert_equal(can_decode_dispatch(&frame, 0), 0, "Long frame rejected");
+    zassert_equal(v2v_len, SPEED_MSG_LEN, "Timestamp forwarded");
+}
+
+ZTEST(can_decode_tests, test_unknown_id)
+{
+    struct can_decode_stats before, after;
+    struct can_frame frame = {
+        .id = 0x7FF,
+        .dlc = 8,
+    };
+
+    can_decode_get_stats(&before);
+    zassert_equal(can_decode_dispatch(&frame, 0), -ENOENT, "Unknown ID decoded");
+
+    // Extended IDs go by PGN, not by the dense table
+    frame.id = CAN_ID_SPEED;
+    frame.flags = CAN_FRAME_IDE;
+    zassert_equal(can_decode_dispatch(&frame, 0), -ENOENT, "Extended ID in dense table");
+
+    can_decode_get_stats(&after);
+    zassert_equal(after.unknown_id, before.unknown_id + 2, "Not counted");
+    zassert_equal(num_published, 0, "Published");
+}
+
+ZTEST(can_decode_tests, test_j1939_pgn)
+{
+    // 50 degC coolant, everything else not available
+    struct can_frame frame = {
+        .id = TEST_ET1_ID,
+        .flags = CAN_FRAME_IDE,
+        .dlc = 8,
+        .data = {0x5A, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF},
+    };
+    struct signal_sample sample;
+
+    zassert_equal(can_decode_dispatch(&frame, 0), 0, "Dispatch failed");
+    zassert_equal(signal_cache_read(SIGNAL_TEMPERATURE, &sample), 0, "Not cached");
+    zassert_within(sample.value, 50.0f, 0.001f, "Cached temperature");
+    zassert_equal(strcmp(published_topic, TOPIC_TEMPERATURE), 0, "Wrong topic");
+    zassert_equal(num_v2v, 0, "J1939 value forwarded");
+
+    // Not available updates nothing
+    frame.data[0] = 0xFF;
+    signal_cache_init();
+    zassert_equal(can_decode_dispatch(&frame, 0), 0, "Dispatch failed");
+    zassert_equal(signal_cache_read(SIGNAL_TEMPERATURE, &sample), -ENODATA, "Cached");
+    zassert_equal(num_published, 1, "Published");
+}
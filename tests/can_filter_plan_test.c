@@ -0,0 +1,78 @@
+#include <zephyr/ztest.h>
+#include "can_filter_plan.h"
+#include "can_ids.h"
+#include "j1939.h"
+
+#define SENSOR_FILTER(n, i, l) { .id = (i), .mask = CAN_STD_ID_MASK, .flags = CAN_FILTER_DATA },
+
+static const struct can_filter sensor_ids[] = {
+    CAN_SENSOR_MSG_LIST(SENSOR_FILTER)
+};
+
+static struct can_filter_plan plan;
+
+ZTEST_SUITE(can_filter_plan_tests, NULL, NULL, NULL, NULL, NULL);
+
+// Enough filters: every ID gets an exact match and nothing leaks
+ZTEST(can_filter_plan_tests, test_exact_fit)
+{
+    int ret = can_filter_plan_build(&plan, sensor_ids, ARRAY_SIZE(sensor_ids), 8, 0, 8);
+    zassert_equal(ret, 0, "Plan build failed");
+    zassert_equal(plan.num_filters, ARRAY_SIZE(sensor_ids), "Unexpected filter count");
+    zassert_equal(plan.leaked_ids, 0, "Exact plan should not leak");
+}
+
+// Sensor IDs 0x51-0x57 fold into 0x50/0x7F8, accepting only 0x50 as extra
+ZTEST(can_filter_plan_tests, test_single_filter)
+{
+    int ret = can_filter_plan_build(&plan, sensor_ids, ARRAY_SIZE(sensor_ids), 1, 0, 1);
+    zassert_equal(ret, 0, "Plan build failed");
+    zassert_equal(plan.num_filters, 1, "Plan should use one filter");
+    zassert_equal(plan.filters[0].id, 0x50, "Unexpected merged ID");
+    zassert_equal(plan.filters[0].mask, 0x7F8, "Unexpected merged mask");
+    zassert_equal(plan.leaked_ids, 1, "Only 0x50 should leak");
+    zassert_true(plan.filters[0].flags & CAN_FILTER_DATA, "Merged filter must accept data frames");
+}
+
+// Standard and extended filters from one bank of 4: both types must fit
+// together, not 8 each
+ZTEST(can_filter_plan_tests, test_shared_bank)
+{
+    struct can_filter mixed[ARRAY_SIZE(sensor_ids) + 2];
+    size_t num_std = 0;
+    int ret;
+
+    memcpy(mixed, sensor_ids, sizeof(sensor_ids));
+    mixed[ARRAY_SIZE(sensor_ids)] = (struct can_filter)
+        J1939_PGN_FILTER(J1939_PGN_ENGINE_TEMP, J1939_PDU2_FILTER_MASK);
+    mixed[ARRAY_SIZE(sensor_ids) + 1] = (struct can_filter)
+        J1939_PGN_FILTER(J1939_PGN_VEHICLE_SPEED, J1939_PDU2_FILTER_MASK);
+
+    ret = can_filter_plan_build(&plan, mixed, ARRAY_SIZE(mixed), 4, 4, 4);
+    zassert_equal(ret, 0, "Plan build failed");
+    zassert_true(plan.num_filters <= 4, "Plan exceeds the shared bank");
+    for (int i = 0; i < plan.num_filters; i++) {
+        if ((plan.filters[i].flags & CAN_FILTER_IDE) == 0) {
+            num_std++;
+        }
+    }
+    zassert_true(num_std > 0 && num_std < plan.num_filters, "A frame type was dropped");
+}
+
+ZTEST(can_filter_plan_tests, test_no_filter_bank)
+{
+    int ret = can_filter_plan_build(&plan, sensor_ids, ARRAY_SIZE(sensor_ids), 0, 0, 0);
+    zassert_equal(ret, -ENOSPC, "Missing filter bank not detected");
+}
+
+ZTEST(can_filter_plan_tests, test_leak_accounting)
+{
+    struct can_frame frame = { .id = CAN_ID_BRAKE, .dlc = BRAKE_MSG_LEN };
+
+    can_filter_plan_build(&plan, sensor_ids, ARRAY_SIZE(sensor_ids), 1, 0, 1);
+
+    zassert_true(can_filter_plan_check(&plan, &frame), "Wanted frame rejected");
+    frame.id = 0x50;
+    zassert_false(can_filter_plan_check(&plan, &frame), "Leaked frame accepted");
+    zassert_equal(plan.leaked_frames, 1, "Leaked frame not counted");
+}
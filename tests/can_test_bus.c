@@ -0,0 +1,32 @@
+#include <zephyr/ztest.h>
+#include "can_test_bus.h"
+
+#define TEST_BUS_FILTERS    4
+
+static const struct device *const bus_dev = DEVICE_DT_GET(DT_CHOSEN(zephyr_canbus));
+static int filter_ids[TEST_BUS_FILTERS];
+static int num_filters;
+
+const struct device *test_can_bus_start(can_mode_t mode) {
+    zassert_true(device_is_ready(bus_dev), "CAN device not ready");
+    can_stop(bus_dev);      // Other suites may have started it
+    zassert_equal(can_set_mode(bus_dev, mode), 0, "Mode 0x%x failed", mode);
+    zassert_equal(can_start(bus_dev), 0, "CAN start failed");
+    return bus_dev;
+}
+
+void test_can_bus_add_filter(const struct can_filter *filter, can_rx_callback_t cb,
+                             void *user_data) {
+    int filter_id;
+
+    zassert_true(num_filters < TEST_BUS_FILTERS, "Too many bus filters");
+    filter_id = can_add_rx_filter(bus_dev, cb, user_data, filter);
+    zassert_true(filter_id >= 0, "Bus filter failed: %d", filter_id);
+    filter_ids[num_filters++] = filter_id;
+}
+
+void test_can_bus_teardown(void *fixture) {
+    while (num_filters > 0) {
+        can_remove_rx_filter(bus_dev, filter_ids[--num_filters]);
+    }
+}
@@ -0,0 +1,21 @@
+#ifndef CAN_TEST_BUS_H
+#define CAN_TEST_BUS_H
+
+#include <zephyr/drivers/can.h>
+
+// The loopback controller shared by the CAN suites. A suite starts it in
+// its setup and adds its bus filters here, test_can_bus_teardown() removes
+// them again so the next suite's frames never reach this suite's callbacks.
+
+// Restarts the controller in mode, CAN_MODE_LOOPBACK with or without
+// CAN_MODE_FD, and returns it
+const struct device *test_can_bus_start(can_mode_t mode);
+
+// Filter removed by test_can_bus_teardown()
+void test_can_bus_add_filter(const struct can_filter *filter, can_rx_callback_t cb,
+                             void *user_data);
+
+// ZTEST_SUITE() teardown, or called from the suite's own
+void test_can_bus_teardown(void *fixture);
+
+#endif /* CAN_TEST_BUS_H */
@@ -0,0 +1,115 @@
+#include <zephyr/ztest.h>
+#include <zephyr/drivers/can.h>
+#include "can_tx_queue.h"
+#include "can_test_bus.h"
+
+#define TEST_ID(n)          (0x6A0 + (n))
+#define TEST_MAX_FRAMES     8
+
+static const struct device *bus;
+static struct can_frame frames[TEST_MAX_FRAMES];
+static int num_frames;
+static K_SEM_DEFINE(frame_sem, 0, TEST_MAX_FRAMES);
+
+static void capture_rx(const struct device *dev, struct can_frame *frame, void *user_data) {
+    if (num_frames < TEST_MAX_FRAMES) {
+        frames[num_frames++] = *frame;
+        k_sem_give(&frame_sem);
+    }
+}
+
+static void queue(int n, uint8_t value, can_tx_prio_t prio) {
+    zassert_equal(can_tx_queue_send(bus, TEST_ID(n), &value, 1, prio), 0, "Queue failed");
+    // Distinct enqueue times, simulated time stands still while code runs
+    k_busy_wait(10);
+}
+
+// Waits for count frames, then checks nothing else follows
+static void expect_frames(int count) {
+    for (int i = 0; i < count; i++) {
+        zassert_equal(k_sem_take(&frame_sem, K_MSEC(100)), 0, "Frame %d of %d missing", i,
+                      count);
+    }
+    zassert_not_equal(k_sem_take(&frame_sem, K_MSEC(20)), 0, "Extra frame sent");
+}
+
+static void expect_frame(int index, int n, uint8_t value) {
+    zassert_equal(frames[index].id, TEST_ID(n), "Frame %d has ID 0x%x", index,
+                  frames[index].id);
+    zassert_equal(frames[index].data[0], value, "Frame %d has value %u", index,
+                  frames[index].data[0]);
+}
+
+static void *can_tx_queue_setup(void) {
+    struct can_filter filter = {
+        .id = TEST_ID(0),
+        .mask = 0x7F0,
+        .flags = CAN_FILTER_DATA
+    };
+
+    bus = test_can_bus_start(CAN_MODE_LOOPBACK);
+    test_can_bus_add_filter(&filter, capture_rx, NULL);
+    return NULL;
+}
+
+static void can_tx_queue_before(void *fixture) {
+    num_frames = 0;
+    k_sem_reset(&frame_sem);
+    can_tx_queue_reset_stats();
+}
+
+ZTEST_SUITE(can_tx_queue_tests, NULL, can_tx_queue_setup, can_tx_queue_before, NULL,
+            test_can_bus_teardown);
+
+ZTEST(can_tx_queue_tests, test_priority_order)
+{
+    // Queued with the work queue held off, so the order is the queue's
+    k_sched_lock();
+    queue(0, 1, CAN_TX_PRIO_LOW);
+    queue(1, 2, CAN_TX_PRIO_NORMAL);
+    queue(2, 3, CAN_TX_PRIO_HIGH);
+    queue(3, 4, CAN_TX_PRIO_NORMAL);
+    queue(4, 5, CAN_TX_PRIO_HIGH);
+    k_sched_unlock();
+
+    // By priority, oldest first within one
+    expect_frames(5);
+    expect_frame(0, 2, 3);
+    expect_frame(1, 4, 5);
+    expect_frame(2, 1, 2);
+    expect_frame(3, 3, 4);
+    expect_frame(4, 0, 1);
+}
+
+ZTEST(can_tx_queue_tests, test_coalescing)
+{
+    struct can_tx_id_stats stats;
+
+    k_sched_lock();
+    queue(0, 1, CAN_TX_PRIO_NORMAL);
+    queue(1, 2, CAN_TX_PRIO_NORMAL);
+    queue(0, 3, CAN_TX_PRIO_NORMAL);
+    queue(0, 4, CAN_TX_PRIO_NORMAL);
+    k_sched_unlock();
+
+    // Only the newest sample of ID 0, still sent ahead of ID 1
+    expect_frames(2);
+    expect_frame(0, 0, 4);
+    expect_frame(1, 1, 2);
+
+    zassert_equal(can_tx_queue_get_stats(TEST_ID(0), &stats), 0, "No stats");
+    zassert_equal(stats.queued, 3, "Queued count");
+    zassert_equal(stats.coalesced, 2, "Coalesced count");
+    zassert_equal(stats.sent, 1, "Sent count");
+}
+
+ZTEST(can_tx_queue_tests, test_invalid)
+{
+    uint8_t data[CAN_MAX_DLEN + 1] = {0};
+
+    zassert_equal(can_tx_queue_send(bus, TEST_ID(0), data, sizeof(data), CAN_TX_PRIO_LOW),
+                  -EINVAL, "Oversized frame queued");
+    zassert_equal(can_tx_queue_send(bus, TEST_ID(0), data, 1, CAN_TX_PRIO_COUNT), -EINVAL,
+                  "Invalid priority queued");
+    expect_frames(0);
+}
@@ -0,0 +1,40 @@
+#include <zephyr/ztest.h>
+#include "diag_service.h"
+
+ZTEST_SUITE(diag_did_tests, NULL, NULL, NULL, NULL, NULL);
+
+// DIDs published by the application keep their latest value. Records are
+// never freed, so the limits are checked in the same test once the normal
+// cases are done.
+ZTEST(diag_did_tests, test_update_diagnostic_data)
+{
+    static uint8_t value[DIAG_DID_MAX_LEN + 1];
+    uint8_t first[4] = {1, 2, 3, 4};
+    uint8_t second[2] = {5, 6};
+    uint8_t buf[8];
+    uint16_t did;
+
+    zassert_equal(diag_service_read_did(0xFD00, buf, sizeof(buf)), -ENOENT,
+                  "Unknown DID found");
+
+    zassert_equal(update_diagnostic_data(0xFD00, first, sizeof(first)), 0, "Store failed");
+    zassert_equal(update_diagnostic_data(0xFD00, second, sizeof(second)), 0, "Update failed");
+    zassert_equal(diag_service_read_did(0xFD00, buf, sizeof(buf)), sizeof(second),
+                  "Update not stored");
+    zassert_mem_equal(buf, second, sizeof(second), "Stale DID value");
+    zassert_equal(diag_service_read_did(0xFD00, buf, 1), -ENOSPC, "Short buffer not detected");
+
+    zassert_equal(update_diagnostic_data(0xFE00, value, sizeof(value)), -EMSGSIZE,
+                  "Oversized value accepted");
+    zassert_equal(diag_service_read_did(0xFE00, value, sizeof(value)), -ENOENT,
+                  "Oversized value stored");
+
+    // 0xFD00 holds one record, the rest fill up
+    for (did = 0xFE01; did < 0xFE00 + DIAG_DID_MAX_COUNT; did++) {
+        zassert_equal(update_diagnostic_data(did, value, DIAG_DID_MAX_LEN), 0,
+                      "Store failed before it was full");
+    }
+    zassert_equal(update_diagnostic_data(did, value, 1), -ENOMEM, "Full store accepted");
+    zassert_equal(update_diagnostic_data(0xFD00, first, sizeof(first)), 0,
+                  "Update in a full store failed");
+}
@@ -0,0 +1,150 @@
+#include <zephyr/ztest.h>
+#include <zephyr/drivers/can.h>
+#include <zephyr/sys/byteorder.h>
+#include <string.h>
+#include "isotp.h"
+#include "can_test_bus.h"
+
+#define TEST_REQ_ID     0x7E0
+#define TEST_RESP_ID    0x7E8
+#define TEST_MAX_LEN    10000
+#define TEST_CAPTURE    4
+
+static uint8_t msg[TEST_MAX_LEN];
+static uint8_t server_buf[TEST_MAX_LEN];
+static uint8_t received[TEST_MAX_LEN];
+static int rx_result;
+static K_SEM_DEFINE(rx_done, 0, 1);
+
+// First and last frames of the request, as seen on the bus
+static struct can_frame captured[TEST_CAPTURE];
+static int num_captured;
+static struct can_frame last_frame;
+
+static void server_rx(struct isotp_ctx *ctx, const uint8_t *data, int len, void *user_data) {
+    rx_result = len;
+    if (len > 0) {
+        memcpy(received, data, len);
+    }
+    k_sem_give(&rx_done);
+}
+
+static void capture_rx(const struct device *dev, struct can_frame *frame, void *user_data) {
+    if (num_captured < TEST_CAPTURE) {
+        captured[num_captured++] = *frame;
+    }
+    last_frame = *frame;
+}
+
+static struct isotp_ctx client = {
+    .rx_id = TEST_RESP_ID,
+    .tx_id = TEST_REQ_ID,
+    .tx_dl = 64,
+};
+
+static struct isotp_ctx server = {
+    .rx_id = TEST_REQ_ID,
+    .tx_id = TEST_RESP_ID,
+    .buf = server_buf,
+    .buf_size = sizeof(server_buf),
+    .rx_cb = server_rx,
+    .tx_dl = 64,
+};
+
+static void *fd_setup(void) {
+    const struct device *dev = test_can_bus_start(CAN_MODE_LOOPBACK | CAN_MODE_FD);
+    struct can_filter filter = {
+        .id = TEST_REQ_ID,
+        .mask = CAN_STD_ID_MASK,
+        .flags = CAN_FILTER_DATA | CAN_FILTER_FDF
+    };
+
+    for (int i = 0; i < sizeof(msg); i++) {
+        msg[i] = i * 13 + (i >> 8);
+    }
+
+    client.can_dev = dev;
+    server.can_dev = dev;
+    zassert_equal(isotp_init(&client), 0, "Client init failed");
+    zassert_equal(isotp_init(&server), 0, "Server init failed");
+    test_can_bus_add_filter(&filter, capture_rx, NULL);
+    return NULL;
+}
+
+static void fd_before(void *fixture) {
+    num_captured = 0;
+    rx_result = 0;
+    k_sem_reset(&rx_done);
+    memset(received, 0, sizeof(received));
+}
+
+static void transfer(size_t len) {
+    zassert_equal(isotp_send(&client, msg, len), 0, "Send of %u bytes failed", len);
+    zassert_equal(k_sem_take(&rx_done, K_SECONDS(5)), 0, "Nothing received");
+    zassert_equal(rx_result, len, "Length mismatch");
+    zassert_mem_equal(received, msg, len, "Payload mismatch");
+}
+
+ZTEST_SUITE(isotp_fd_tests, NULL, fd_setup, fd_before, NULL, test_can_bus_teardown);
+
+ZTEST(isotp_fd_tests, test_single_frame_escape)
+{
+    transfer(40);
+
+    // 0x00, SF_DL, 40 bytes, padded up to the 48 byte DLC
+    zassert_equal(num_captured, 1, "Not a single frame");
+    zassert_true(captured[0].flags & CAN_FRAME_FDF, "Not an FD frame");
+    zassert_equal(can_dlc_to_bytes(captured[0].dlc), 48, "Unexpected DLC");
+    zassert_equal(captured[0].data[0], 0x00, "No SF_DL escape");
+    zassert_equal(captured[0].data[1], 40, "Wrong SF_DL");
+    zassert_equal(captured[0].data[47], ISOTP_PAD_BYTE, "Not padded");
+}
+
+ZTEST(isotp_fd_tests, test_short_single_frame)
+{
+    transfer(5);
+
+    // Up to 7 bytes keep the classic PCI in the shortest frame
+    zassert_equal(captured[0].dlc, 6, "Frame not optimized");
+    zassert_equal(captured[0].data[0], 0x05, "Wrong PCI");
+}
+
+ZTEST(isotp_fd_tests, test_segmented)
+{
+    transfer(4095);
+
+    // 62 bytes in the first frame, 63 per consecutive frame
+    zassert_equal(can_dlc_to_bytes(captured[0].dlc), 64, "First frame not full");
+    zassert_equal(captured[0].data[0], 0x1F, "Wrong FF_DL");
+    zassert_equal(captured[0].data[1], 0xFF, "Wrong FF_DL");
+    zassert_equal(can_dlc_to_bytes(captured[1].dlc), 64, "Consecutive frame not full");
+    zassert_mem_equal(&captured[1].data[1], &msg[62], 63, "Consecutive frame payload");
+
+    // 4095 - 62 - 63 * 64 = 1 byte left for the last frame
+    zassert_equal(last_frame.dlc, 2, "Last frame not optimized");
+}
+
+ZTEST(isotp_fd_tests, test_length_escape)
+{
+    transfer(TEST_MAX_LEN);
+
+    zassert_equal(captured[0].data[0], 0x10, "Wrong PCI");
+    zassert_equal(captured[0].data[1], 0x00, "No FF_DL escape");
+    zassert_equal(sys_get_be32(&captured[0].data[2]), TEST_MAX_LEN, "Wrong FF_DL");
+    zassert_mem_equal(&captured[0].data[6], msg, 58, "First frame payload");
+
+    // 10000 - 58 - 63 * 157 = 51 bytes, plus PCI, padded to 64
+    zassert_equal(can_dlc_to_bytes(last_frame.dlc), 64, "Last frame not padded");
+    zassert_equal(last_frame.data[52], ISOTP_PAD_BYTE, "Not padded");
+}
+
+ZTEST(isotp_fd_tests, test_invalid_tx_dl)
+{
+    struct isotp_ctx ctx = {
+        .can_dev = client.can_dev,
+        .manual_rx = true,
+        .tx_dl = 13,
+    };
+
+    zassert_equal(isotp_init(&ctx), -EINVAL, "TX_DL 13 accepted");
+}
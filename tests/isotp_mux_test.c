@@ -0,0 +1,323 @@
+#include <zephyr/ztest.h>
+#include <zephyr/drivers/can.h>
+#include <string.h>
+#include "isotp_mux.h"
+#include "can_test_bus.h"
+
+#define TEST_PEERS      5
+#define TEST_POOL       4
+#define TEST_BUF_SIZE   512
+#define TEST_MAX_FRAMES 80
+#define TEST_ID(peer)   (0x7E9 + (peer))
+#define TEST_FRAG_SIZE  32
+#define TEST_FRAGS      24
+
+K_MEM_SLAB_DEFINE_STATIC(test_pool, TEST_BUF_SIZE, TEST_POOL, 4);
+NET_BUF_POOL_FIXED_DEFINE(test_frag_pool, TEST_FRAGS, TEST_FRAG_SIZE, 0, NULL);
+
+static struct isotp_mux mux;
+static struct isotp_mux frag_mux;
+
+struct peer {
+    struct can_frame frames[TEST_MAX_FRAMES];
+    int num_frames;
+    int next_frame;
+    uint8_t msg[TEST_BUF_SIZE];
+    int msg_len;
+    int result;
+    int completed;
+    int num_frags;
+    uint8_t received[TEST_BUF_SIZE];
+};
+
+static struct peer peers[TEST_PEERS];
+
+static void peer_rx(struct isotp_ctx *ctx, const uint8_t *data, int len, void *user_data) {
+    struct peer *p = user_data;
+
+    p->result = len;
+    p->completed++;
+    if (len > 0) {
+        memcpy(p->received, data, len);
+    }
+}
+
+static void peer_rx_frags(struct isotp_ctx *ctx, struct net_buf *frags, int len,
+                          void *user_data) {
+    struct peer *p = user_data;
+
+    p->result = len;
+    p->completed++;
+    if (len > 0) {
+        net_buf_linearize(p->received, sizeof(p->received), frags, 0, len);
+        for (struct net_buf *frag = frags; frag != NULL; frag = frag->frags) {
+            p->num_frags++;
+        }
+    }
+}
+
+// Fragments left in the pool
+static int frags_free(void) {
+    struct net_buf *taken[TEST_FRAGS];
+    int n = 0;
+
+    while (n < TEST_FRAGS && (taken[n] = net_buf_alloc(&test_frag_pool, K_NO_WAIT)) != NULL) {
+        n++;
+    }
+    for (int i = 0; i < n; i++) {
+        net_buf_unref(taken[i]);
+    }
+    return n;
+}
+
+// Segment a message the way a sender with BS 0 / STmin 0 puts it on the bus
+static void peer_prepare(int index, int len, uint8_t seed) {
+    struct peer *p = &peers[index];
+    int offset = 6;
+    uint8_t sn = 1;
+
+    memset(p, 0, sizeof(*p));
+    p->msg_len = len;
+    for (int i = 0; i < len; i++) {
+        p->msg[i] = seed + i * 7;
+    }
+
+    p->frames[0].id = TEST_ID(index);
+    p->frames[0].dlc = 8;
+    p->frames[0].data[0] = ISOTP_PCI(ISOTP_FIRST_FRAME) | (len >> 8);
+    p->frames[0].data[1] = len & 0xFF;
+    memcpy(&p->frames[0].data[2], p->msg, 6);
+    p->num_frames = 1;
+
+    while (offset < len) {
+        struct can_frame *cf = &p->frames[p->num_frames++];
+        int n = MIN(7, len - offset);
+
+        cf->id = TEST_ID(index);
+        cf->dlc = n + 1;
+        cf->data[0] = ISOTP_PCI(ISOTP_CONSECUTIVE) | sn;
+        memcpy(&cf->data[1], &p->msg[offset], n);
+        offset += n;
+        sn = (sn + 1) & 0x0F;
+    }
+}
+
+static void peer_feed_mux(struct isotp_mux *m, int index) {
+    struct peer *p = &peers[index];
+
+    zassert_equal(isotp_mux_process_frame(m, &p->frames[p->next_frame++]), 0,
+                  "Frame not dispatched");
+}
+
+static void peer_feed(int index) {
+    peer_feed_mux(&mux, index);
+}
+
+static void *mux_setup(void) {
+    return (void *)test_can_bus_start(CAN_MODE_LOOPBACK | CAN_MODE_FD);
+}
+
+static void mux_before(void *fixture) {
+    isotp_mux_init(&mux, fixture, &test_pool, TEST_BUF_SIZE);
+    for (int i = 0; i < TEST_PEERS; i++) {
+        zassert_equal(isotp_mux_open(&mux, TEST_ID(i), TEST_ID(i) - 8, false, peer_rx, &peers[i]),
+                      i, "Open failed");
+    }
+
+    isotp_mux_init(&frag_mux, fixture, NULL, TEST_BUF_SIZE);
+    frag_mux.frag_pool = &test_frag_pool;
+    for (int i = 0; i < TEST_PEERS; i++) {
+        zassert_equal(isotp_mux_open_frags(&frag_mux, TEST_ID(i), TEST_ID(i) - 8, false,
+                                           peer_rx_frags, &peers[i]),
+                      i, "Open failed");
+    }
+}
+
+ZTEST_SUITE(isotp_mux_tests, NULL, mux_setup, mux_before, NULL, NULL);
+
+ZTEST(isotp_mux_tests, test_interleaved_peers)
+{
+    bool pending = true;
+
+    for (int i = 0; i < TEST_POOL; i++) {
+        peer_prepare(i, 40 + i * 97, i * 16);
+    }
+
+    // One frame per peer in turn, every session is open at the same time
+    while (pending) {
+        pending = false;
+        for (int i = 0; i < TEST_POOL; i++) {
+            if (peers[i].next_frame < peers[i].num_frames) {
+                peer_feed(i);
+                pending = true;
+            }
+        }
+    }
+
+    for (int i = 0; i < TEST_POOL; i++) {
+        zassert_equal(peers[i].completed, 1, "Peer %d not completed", i);
+        zassert_equal(peers[i].result, peers[i].msg_len, "Peer %d length", i);
+        zassert_mem_equal(peers[i].received, peers[i].msg, peers[i].msg_len,
+                          "Peer %d payload", i);
+    }
+    zassert_equal(k_mem_slab_num_free_get(&test_pool), TEST_POOL, "Buffer leaked");
+}
+
+ZTEST(isotp_mux_tests, test_pool_exhausted)
+{
+    for (int i = 0; i < TEST_PEERS; i++) {
+        peer_prepare(i, 30, i);
+        peer_feed(i);
+    }
+
+    // The fifth session found no buffer and was refused with FC.OVFLW
+    zassert_equal(mux.channels[TEST_PEERS - 1].stats.rx_overflow, 1, "No overflow");
+    zassert_equal(k_mem_slab_num_free_get(&test_pool), 0, "Pool not in use");
+
+    for (int i = 0; i < TEST_POOL; i++) {
+        while (peers[i].next_frame < peers[i].num_frames) {
+            peer_feed(i);
+        }
+        zassert_equal(peers[i].result, 30, "Peer %d failed", i);
+    }
+
+    // Buffers are back, the refused peer can retry
+    peer_prepare(TEST_PEERS - 1, 30, 0x55);
+    while (peers[TEST_PEERS - 1].next_frame < peers[TEST_PEERS - 1].num_frames) {
+        peer_feed(TEST_PEERS - 1);
+    }
+    zassert_equal(peers[TEST_PEERS - 1].result, 30, "Retry failed");
+    zassert_equal(k_mem_slab_num_free_get(&test_pool), TEST_POOL, "Buffer leaked");
+}
+
+ZTEST(isotp_mux_tests, test_sequence_error_isolated)
+{
+    peer_prepare(0, 50, 1);
+    peer_prepare(1, 50, 2);
+
+    peer_feed(0);
+    peer_feed(1);
+    peer_feed(0);
+    peer_feed(1);
+
+    // Peer 0 loses a consecutive frame
+    peers[0].next_frame++;
+    peer_feed(0);
+    zassert_equal(peers[0].result, -EILSEQ, "Sequence error not reported");
+
+    while (peers[1].next_frame < peers[1].num_frames) {
+        peer_feed(1);
+    }
+    zassert_equal(peers[1].result, 50, "Other peer affected");
+    zassert_mem_equal(peers[1].received, peers[1].msg, 50, "Payload mismatch");
+    zassert_equal(k_mem_slab_num_free_get(&test_pool), TEST_POOL, "Buffer leaked");
+}
+
+ZTEST(isotp_mux_tests, test_unknown_id)
+{
+    struct can_frame frame = {
+        .id = 0x7D0,
+        .dlc = 2,
+        .data = {ISOTP_PCI(ISOTP_SINGLE_FRAME) | 1, 0x3E},
+    };
+
+    zassert_equal(isotp_mux_process_frame(&mux, &frame), -ENOENT, "Unknown ID accepted");
+    zassert_equal(mux.unknown_ids, 1, "Not counted");
+
+    frame.id = 0x123;
+    zassert_equal(isotp_mux_process_frame(&mux, &frame), -ENOENT, "Out of range ID accepted");
+    zassert_equal(isotp_mux_open(&mux, TEST_ID(0), 0x7E0, false, NULL, NULL), -EEXIST,
+                  "Duplicate rx ID accepted");
+}
+
+ZTEST(isotp_mux_tests, test_random_interleaving)
+{
+    uint32_t seed = 12345;
+
+    for (int round = 0; round < 50; round++) {
+        int remaining = 0;
+
+        for (int i = 0; i < TEST_POOL; i++) {
+            seed = seed * 1103515245 + 12345;
+            peer_prepare(i, 8 + (seed >> 16) % (TEST_BUF_SIZE - 8), round + i);
+            remaining += peers[i].num_frames;
+        }
+
+        while (remaining > 0) {
+            int i;
+
+            seed = seed * 1103515245 + 12345;
+            i = (seed >> 16) % TEST_POOL;
+            if (peers[i].next_frame < peers[i].num_frames) {
+                peer_feed(i);
+                remaining--;
+            }
+        }
+
+        for (int i = 0; i < TEST_POOL; i++) {
+            zassert_equal(peers[i].result, peers[i].msg_len, "Round %d peer %d", round, i);
+            zassert_mem_equal(peers[i].received, peers[i].msg, peers[i].msg_len,
+                              "Round %d peer %d payload", round, i);
+        }
+    }
+    zassert_equal(k_mem_slab_num_free_get(&test_pool), TEST_POOL, "Buffer leaked");
+}
+
+ZTEST(isotp_mux_tests, test_frags_interleaved)
+{
+    static const int lens[] = {200, 150, 100};
+    bool pending = true;
+
+    for (int i = 0; i < ARRAY_SIZE(lens); i++) {
+        peer_prepare(i, lens[i], i * 3);
+    }
+
+    while (pending) {
+        pending = false;
+        for (int i = 0; i < ARRAY_SIZE(lens); i++) {
+            if (peers[i].next_frame < peers[i].num_frames) {
+                peer_feed_mux(&frag_mux, i);
+                pending = true;
+            }
+        }
+    }
+
+    for (int i = 0; i < ARRAY_SIZE(lens); i++) {
+        zassert_equal(peers[i].result, lens[i], "Peer %d length", i);
+        zassert_equal(peers[i].num_frags, DIV_ROUND_UP(lens[i], TEST_FRAG_SIZE),
+                      "Peer %d not packed into full fragments", i);
+        zassert_mem_equal(peers[i].received, peers[i].msg, lens[i], "Peer %d payload", i);
+    }
+    zassert_equal(frags_free(), TEST_FRAGS, "Fragment leaked");
+}
+
+ZTEST(isotp_mux_tests, test_frags_exhausted)
+{
+    int failed = -1;
+
+    // Two messages of 16 fragments each from a pool of 24
+    peer_prepare(0, 500, 1);
+    peer_prepare(1, 500, 2);
+
+    while (peers[0].next_frame < peers[0].num_frames ||
+           peers[1].next_frame < peers[1].num_frames) {
+        for (int i = 0; i < 2; i++) {
+            if (peers[i].next_frame < peers[i].num_frames) {
+                peer_feed_mux(&frag_mux, i);
+            }
+        }
+    }
+
+    // The first session to find the pool empty is dropped and frees its
+    // fragments, the other one completes
+    for (int i = 0; i < 2; i++) {
+        if (peers[i].result == -ENOMEM) {
+            failed = i;
+        }
+    }
+    zassert_true(failed >= 0, "No session ran out of fragments");
+    zassert_equal(frag_mux.channels[failed].stats.rx_overflow, 1, "Not counted");
+    zassert_equal(peers[!failed].result, 500, "Other session failed");
+    zassert_mem_equal(peers[!failed].received, peers[!failed].msg, 500, "Payload mismatch");
+    zassert_equal(frags_free(), TEST_FRAGS, "Fragment leaked");
+}
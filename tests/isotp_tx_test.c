@@ -0,0 +1,268 @@
+#include <zephyr/ztest.h>
+#include <zephyr/drivers/can.h>
+#include <string.h>
+#include "isotp.h"
+#include "can_test_bus.h"
+
+#define TEST_TX_ID      0x7A0   // Sender frames, captured by the test
+#define TEST_FC_ID      0x7A8   // Flow control written by the test
+#define TEST_FILLER_ID  0x7AF   // Frames nobody receives, to fill the TX queue
+#define TEST_MSG_LEN    48      // First frame with 6 bytes, then 6 consecutive frames
+#define TEST_NUM_CF     6
+#define TEST_MAX_FRAMES 16
+
+static uint8_t msg[TEST_MSG_LEN];
+static struct can_frame frames[TEST_MAX_FRAMES];
+static uint32_t frame_cycles[TEST_MAX_FRAMES];
+static int num_frames;
+static K_SEM_DEFINE(frame_sem, 0, TEST_MAX_FRAMES);
+
+static int tx_result;
+static K_SEM_DEFINE(tx_sem, 0, 1);
+
+static const struct device *bus;
+
+static struct isotp_ctx sender = {
+    .rx_id = TEST_FC_ID,
+    .tx_id = TEST_TX_ID,
+};
+
+static void capture_rx(const struct device *dev, struct can_frame *frame, void *user_data) {
+    if (num_frames < TEST_MAX_FRAMES) {
+        frame_cycles[num_frames] = k_cycle_get_32();
+        frames[num_frames++] = *frame;
+        k_sem_give(&frame_sem);
+    }
+}
+
+static void sender_done(struct isotp_ctx *ctx, int result, void *user_data) {
+    tx_result = result;
+    k_sem_give(&tx_sem);
+}
+
+static void filler_done(const struct device *dev, int error, void *user_data) {
+}
+
+static void fc_frame(struct can_frame *frame, uint8_t status, uint8_t bs, uint8_t stmin) {
+    *frame = (struct can_frame){
+        .id = TEST_FC_ID,
+        .dlc = 3,
+        .data = {ISOTP_PCI(ISOTP_FLOW_CONTROL) | status, bs, stmin},
+    };
+}
+
+static void send_fc(uint8_t status, uint8_t bs, uint8_t stmin) {
+    struct can_frame frame;
+
+    fc_frame(&frame, status, bs, stmin);
+    zassert_equal(can_send(bus, &frame, K_MSEC(100), NULL, NULL), 0, "FC not sent");
+}
+
+static void expect_frames(int count) {
+    for (int i = 0; i < count; i++) {
+        zassert_equal(k_sem_take(&frame_sem, K_MSEC(200)), 0, "Frame %d of %d missing", i,
+                      count);
+    }
+}
+
+// The sender holds back until the next flow control
+static void expect_pause(void) {
+    zassert_not_equal(k_sem_take(&frame_sem, K_MSEC(50)), 0, "Frame sent without FC");
+}
+
+static void expect_result(int result) {
+    zassert_equal(k_sem_take(&tx_sem, K_MSEC(ISOTP_N_BS_MS * 2)), 0, "Transfer not finished");
+    zassert_equal(tx_result, result, "Result %d, expected %d", tx_result, result);
+}
+
+// Starts a transfer and waits for its first frame, the sender then waits
+// for flow control
+static void start_transfer(void) {
+    zassert_equal(isotp_send_async(&sender, msg, sizeof(msg), sender_done, NULL), 0,
+                  "Send failed");
+    expect_frames(1);
+    zassert_equal(frames[0].data[0], ISOTP_PCI(ISOTP_FIRST_FRAME), "Not a first frame");
+    zassert_equal(frames[0].data[1], TEST_MSG_LEN, "Wrong FF_DL");
+}
+
+// Consecutive frames carry the message in order behind the first frame
+static void check_consecutive(void) {
+    zassert_equal(num_frames, 1 + TEST_NUM_CF, "%d frames captured", num_frames);
+    for (int i = 1; i <= TEST_NUM_CF; i++) {
+        zassert_equal(frames[i].data[0], ISOTP_PCI(ISOTP_CONSECUTIVE) | i, "Wrong SN in %d", i);
+        zassert_mem_equal(&frames[i].data[1], &msg[6 + (i - 1) * 7], 7, "Payload of %d", i);
+    }
+}
+
+static uint32_t gap_us(int index) {
+    return k_cyc_to_us_floor32(frame_cycles[index] - frame_cycles[index - 1]);
+}
+
+static void *isotp_tx_setup(void) {
+    struct can_filter filter = {
+        .id = TEST_TX_ID,
+        .mask = CAN_STD_ID_MASK,
+        .flags = CAN_FILTER_DATA
+    };
+
+    for (int i = 0; i < sizeof(msg); i++) {
+        msg[i] = i * 7 + 1;
+    }
+
+    bus = test_can_bus_start(CAN_MODE_LOOPBACK);
+    sender.can_dev = bus;
+    zassert_equal(isotp_init(&sender), 0, "Sender init failed");
+    test_can_bus_add_filter(&filter, capture_rx, NULL);
+    return NULL;
+}
+
+static void isotp_tx_before(void *fixture) {
+    num_frames = 0;
+    tx_result = 1;
+    k_sem_reset(&frame_sem);
+    k_sem_reset(&tx_sem);
+}
+
+ZTEST_SUITE(isotp_tx_tests, NULL, isotp_tx_setup, isotp_tx_before, NULL,
+            test_can_bus_teardown);
+
+ZTEST(isotp_tx_tests, test_block_size)
+{
+    start_transfer();
+
+    // BS 2: two consecutive frames per flow control
+    for (int block = 0; block < TEST_NUM_CF / 2; block++) {
+        send_fc(ISOTP_FC_CTS, 2, 0);
+        expect_frames(2);
+        if (block < TEST_NUM_CF / 2 - 1) {
+            expect_pause();
+        }
+    }
+
+    expect_result(0);
+    check_consecutive();
+}
+
+ZTEST(isotp_tx_tests, test_stmin_ms)
+{
+    start_transfer();
+    send_fc(ISOTP_FC_CTS, 0, 20);
+    expect_frames(TEST_NUM_CF);
+    expect_result(0);
+    check_consecutive();
+
+    for (int i = 2; i <= TEST_NUM_CF; i++) {
+        zassert_true(gap_us(i) >= 20 * USEC_PER_MSEC, "CF %d after %u us", i, gap_us(i));
+    }
+}
+
+ZTEST(isotp_tx_tests, test_stmin_us)
+{
+    zassert_equal(isotp_stmin_to_us(0xF1), 100, "0xF1 is 100 us");
+    zassert_equal(isotp_stmin_to_us(0xF9), 900, "0xF9 is 900 us");
+    zassert_equal(isotp_stmin_to_us(0x80), 127 * USEC_PER_MSEC, "Reserved not 127 ms");
+    zassert_equal(isotp_stmin_to_us(0xFA), 127 * USEC_PER_MSEC, "Reserved not 127 ms");
+
+    start_transfer();
+    send_fc(ISOTP_FC_CTS, 0, 0xF5);
+    expect_frames(TEST_NUM_CF);
+    expect_result(0);
+    check_consecutive();
+
+    for (int i = 2; i <= TEST_NUM_CF; i++) {
+        zassert_true(gap_us(i) >= 500, "CF %d after %u us", i, gap_us(i));
+    }
+}
+
+ZTEST(isotp_tx_tests, test_wait_frames)
+{
+    start_transfer();
+
+    // Each FC.WAIT restarts N_Bs, the two waits outlast a single N_Bs
+    k_msleep(ISOTP_N_BS_MS * 3 / 5);
+    send_fc(ISOTP_FC_WAIT, 0, 0);
+    k_msleep(ISOTP_N_BS_MS * 3 / 5);
+    for (int i = 1; i < ISOTP_N_WFT_MAX; i++) {
+        send_fc(ISOTP_FC_WAIT, 0, 0);
+    }
+    expect_pause();
+
+    send_fc(ISOTP_FC_CTS, 0, 0);
+    expect_frames(TEST_NUM_CF);
+    expect_result(0);
+    check_consecutive();
+}
+
+ZTEST(isotp_tx_tests, test_wait_limit)
+{
+    start_transfer();
+
+    for (int i = 0; i < ISOTP_N_WFT_MAX; i++) {
+        send_fc(ISOTP_FC_WAIT, 0, 0);
+    }
+    zassert_not_equal(k_sem_take(&tx_sem, K_MSEC(50)), 0, "Aborted within N_WFTmax");
+
+    send_fc(ISOTP_FC_WAIT, 0, 0);
+    expect_result(-ECONNABORTED);
+    expect_pause();
+}
+
+ZTEST(isotp_tx_tests, test_overflow)
+{
+    start_transfer();
+    send_fc(ISOTP_FC_OVFLW, 0, 0);
+    expect_result(-EMSGSIZE);
+    expect_pause();
+}
+
+ZTEST(isotp_tx_tests, test_invalid_flow_status)
+{
+    start_transfer();
+    send_fc(0x05, 0, 0);
+    expect_result(-EBADMSG);
+    expect_pause();
+}
+
+ZTEST(isotp_tx_tests, test_n_bs_timeout)
+{
+    start_transfer();
+
+    zassert_not_equal(k_sem_take(&tx_sem, K_MSEC(ISOTP_N_BS_MS - 200)), 0,
+                      "Timed out before N_Bs");
+    expect_result(-ETIMEDOUT);
+    zassert_equal(num_frames, 1, "Frames sent without FC");
+}
+
+ZTEST(isotp_tx_tests, test_tx_queue_full)
+{
+    struct can_frame filler = {
+        .id = TEST_FILLER_ID,
+        .dlc = 0,
+    };
+    struct can_frame fc;
+    int ret = 0;
+
+    start_transfer();
+    k_msleep(10);       // First frame confirmed, the sender waits in N_Bs
+
+    // With the scheduler locked the loopback thread cannot drain its queue,
+    // so the first consecutive frame of the block is refused with -EAGAIN.
+    // The sender rolls it back and retries it on the next tick.
+    k_sched_lock();
+    for (int i = 0; i < 64 && ret == 0; i++) {
+        ret = can_send(bus, &filler, K_NO_WAIT, filler_done, NULL);
+    }
+    fc_frame(&fc, ISOTP_FC_CTS, 2, 0);
+    isotp_process_frame(&sender, &fc);
+    k_sched_unlock();
+    zassert_equal(ret, -EAGAIN, "TX queue not filled");
+
+    // The retried frame still counts as the first of the block
+    expect_frames(2);
+    expect_pause();
+
+    send_fc(ISOTP_FC_CTS, 0, 0);
+    expect_frames(TEST_NUM_CF - 2);
+    expect_result(0);
+    check_consecutive();
+}
@@ -0,0 +1,174 @@
+#include <zephyr/ztest.h>
+#include <zephyr/drivers/can.h>
+#include <zephyr/sys/byteorder.h>
+#include <string.h>
+#include "j1939_addr.h"
+#include "can_test_bus.h"
+
+#define TEST_ADDR           0x80
+#define TEST_NAME           J1939_NAME(1, 0, 0, 0, 130, 0, 0, 0x123, 0x1000)
+#define TEST_NAME_WINNER    (TEST_NAME - 1)
+#define TEST_NAME_LOSER     (TEST_NAME + 1)
+#define TEST_MAX_FRAMES     16
+
+// The node gets its frames through its own RX filters, not manual_rx
+K_MEM_SLAB_DEFINE_STATIC(addr_test_pool, J1939_TP_MAX_SIZE, 1, 4);
+
+static struct j1939_ctx node = {
+    .source_address = TEST_ADDR,
+    .dest_address = J1939_ADDR_GLOBAL,
+    .name = TEST_NAME,
+    .tp_pool = &addr_test_pool,
+};
+
+static const struct device *can_dev;
+static struct can_frame claims[TEST_MAX_FRAMES];
+static int num_claims;
+
+static void capture_claims(const struct device *dev, struct can_frame *frame, void *user_data) {
+    if (num_claims < TEST_MAX_FRAMES) {
+        claims[num_claims++] = *frame;
+    }
+}
+
+// Address Claimed frames seen from sa with the node's NAME
+static int claims_from(uint8_t sa) {
+    int n = 0;
+
+    for (int i = 0; i < num_claims; i++) {
+        if ((claims[i].id & 0xFF) == sa && sys_get_le64(claims[i].data) == node.name) {
+            n++;
+        }
+    }
+    return n;
+}
+
+static void peer_send(uint32_t pgn, uint8_t sa, const uint8_t *data, uint8_t len) {
+    struct can_frame frame = {
+        .id = (J1939_PRIORITY_DEFAULT << 26) | (pgn << 8) | sa,
+        .dlc = len,
+        .flags = CAN_FRAME_IDE,
+    };
+
+    memcpy(frame.data, data, len);
+    zassert_equal(can_send(can_dev, &frame, K_FOREVER, NULL, NULL), 0, "Send failed");
+    k_sleep(K_MSEC(5));
+}
+
+static void peer_claim(uint8_t sa, uint64_t name) {
+    uint8_t data[8];
+
+    sys_put_le64(name, data);
+    peer_send(J1939_PGN_ADDRESS_CLAIMED | J1939_ADDR_GLOBAL, sa, data, sizeof(data));
+}
+
+static void *addr_setup(void) {
+    struct can_filter filter = {
+        .id = J1939_PGN_ADDRESS_CLAIMED << 8,
+        .mask = J1939_PDU1_FILTER_MASK,
+        .flags = CAN_FILTER_IDE | CAN_FILTER_DATA,
+    };
+
+    can_dev = test_can_bus_start(CAN_MODE_LOOPBACK);
+
+    node.can_dev = can_dev;
+    zassert_equal(j1939_init(&node), 0, "Init failed");
+    test_can_bus_add_filter(&filter, capture_claims, NULL);
+    return NULL;
+}
+
+static void addr_before(void *fixture) {
+    if (node.addr_state != J1939_ADDR_FIXED) {
+        k_work_cancel_delayable(&node.addr_timer);
+    }
+    memset(&node.addr_table, 0, sizeof(node.addr_table));
+    node.name = TEST_NAME;
+    node.source_address = TEST_ADDR;
+    zassert_equal(j1939_claim_address(&node), 0, "Claim failed");
+    k_sleep(K_MSEC(5));
+    num_claims = 0;
+}
+
+ZTEST_SUITE(j1939_addr_tests, NULL, addr_setup, addr_before, NULL, test_can_bus_teardown);
+
+ZTEST(j1939_addr_tests, test_claim_uncontested)
+{
+    uint8_t data[8] = {0};
+    uint64_t name;
+
+    zassert_equal(node.addr_state, J1939_ADDR_CLAIMING, "Not claiming");
+    zassert_equal(j1939_send_pgn(&node, J1939_PGN_VEHICLE_SPEED, data, 8), -EADDRNOTAVAIL,
+                  "Sent before the claim stood");
+
+    k_sleep(K_MSEC(J1939_ADDR_CLAIM_MS));
+    zassert_equal(node.addr_state, J1939_ADDR_CLAIMED, "Claim did not stand");
+    zassert_equal(j1939_addr_lookup(&node, TEST_ADDR, &name), 0, "Own claim not recorded");
+    zassert_equal(name, TEST_NAME, "Wrong NAME");
+}
+
+ZTEST(j1939_addr_tests, test_claim_defended)
+{
+    uint64_t name;
+
+    peer_claim(TEST_ADDR, TEST_NAME_LOSER);
+
+    zassert_equal(claims_from(TEST_ADDR), 1, "Claim not repeated");
+    zassert_equal(node.source_address, TEST_ADDR, "Address given up");
+    zassert_equal(j1939_addr_lookup(&node, TEST_ADDR, &name), 0, "Entry lost");
+    zassert_equal(name, TEST_NAME, "Loser recorded");
+}
+
+ZTEST(j1939_addr_tests, test_claim_lost)
+{
+    uint8_t request[3];
+    uint64_t name;
+
+    peer_claim(TEST_ADDR, TEST_NAME_WINNER);
+
+    // Moved to the next dynamic address and claimed it
+    zassert_equal(node.source_address, TEST_ADDR + 1, "Not moved");
+    zassert_equal(node.addr_state, J1939_ADDR_CLAIMING, "New address not claimed");
+    zassert_equal(claims_from(TEST_ADDR + 1), 1, "No claim for the new address");
+    zassert_equal(j1939_addr_lookup(&node, TEST_ADDR, &name), 0, "Winner not recorded");
+    zassert_equal(name, TEST_NAME_WINNER, "Wrong NAME");
+
+    // The RX filter moved along: requests to the old address go unanswered
+    num_claims = 0;
+    sys_put_le24(J1939_PGN_ADDRESS_CLAIMED, request);
+    peer_send(J1939_PGN_REQUEST | TEST_ADDR, 0x30, request, sizeof(request));
+    zassert_equal(claims_from(TEST_ADDR + 1), 0, "Old address still received");
+    peer_send(J1939_PGN_REQUEST | (TEST_ADDR + 1), 0x30, request, sizeof(request));
+    zassert_equal(claims_from(TEST_ADDR + 1), 1, "Request not answered");
+}
+
+ZTEST(j1939_addr_tests, test_cannot_claim)
+{
+    uint8_t data[8] = {0};
+
+    // Without the arbitrary address bit the node has nowhere to go
+    k_work_cancel_delayable(&node.addr_timer);
+    node.name = TEST_NAME & ~J1939_NAME_ARBITRARY_ADDRESS;
+    zassert_equal(j1939_claim_address(&node), 0, "Claim failed");
+    k_sleep(K_MSEC(5));
+    num_claims = 0;
+
+    peer_claim(TEST_ADDR, TEST_NAME_WINNER & ~J1939_NAME_ARBITRARY_ADDRESS);
+    zassert_equal(node.addr_state, J1939_ADDR_CANNOT_CLAIM, "Still claiming");
+    zassert_equal(claims_from(J1939_ADDR_NULL), 1, "No Cannot Claim sent");
+    zassert_equal(j1939_send_pgn(&node, J1939_PGN_VEHICLE_SPEED, data, 8), -EADDRNOTAVAIL,
+                  "Sent without an address");
+}
+
+ZTEST(j1939_addr_tests, test_table_follows_names)
+{
+    uint64_t name;
+
+    peer_claim(0x90, TEST_NAME_LOSER);
+    peer_claim(0x91, TEST_NAME_LOSER);
+    zassert_equal(j1939_addr_lookup(&node, 0x90, &name), -ENOENT, "Old address kept");
+    zassert_equal(j1939_addr_lookup(&node, 0x91, &name), 0, "New address missing");
+    zassert_equal(name, TEST_NAME_LOSER, "Wrong NAME");
+
+    peer_claim(J1939_ADDR_NULL, TEST_NAME_LOSER);
+    zassert_equal(j1939_addr_lookup(&node, 0x91, &name), -ENOENT, "Cannot Claim ignored");
+}
@@ -0,0 +1,214 @@
+#include <zephyr/ztest.h>
+#include <zephyr/drivers/can.h>
+#include <string.h>
+#include "j1939_dm.h"
+#include "j1939_request.h"
+#include "can_test_bus.h"
+
+#define TEST_SA_NODE    0x50
+#define TEST_SA_TESTER  0xF9
+#define TEST_SPN_A      (J1939_SPN_PROPRIETARY + 100)
+#define TEST_SPN_B      639
+#define TEST_MAX_FRAMES 32
+
+static struct j1939_ctx node = {
+    .source_address = TEST_SA_NODE,
+    .dest_address = J1939_ADDR_GLOBAL,
+    .manual_rx = true,
+};
+
+static struct j1939_ctx tester = {
+    .source_address = TEST_SA_TESTER,
+    .dest_address = J1939_ADDR_GLOBAL,
+    .manual_rx = true,
+};
+
+static struct can_frame frames[TEST_MAX_FRAMES];
+static int num_frames;
+static uint8_t dm1_received[J1939_DM_IMAGE_SIZE];
+static uint16_t dm1_len;
+static K_SEM_DEFINE(dm1_bam_done, 0, 1);
+
+static void dm1_rx(struct j1939_ctx *ctx, const uint8_t *data, uint16_t len) {
+    if (ctx == &tester && len > 8) {
+        memcpy(dm1_received, data, len);
+        dm1_len = len;
+        k_sem_give(&dm1_bam_done);
+    }
+}
+
+static void bus_rx(const struct device *dev, struct can_frame *frame, void *user_data) {
+    uint8_t sa = frame->id & 0xFF;
+
+    if (sa != TEST_SA_NODE && sa != TEST_SA_TESTER) {
+        return;
+    }
+    if (num_frames < TEST_MAX_FRAMES) {
+        frames[num_frames++] = *frame;
+    }
+    j1939_process_message(&node, frame);
+    j1939_process_message(&tester, frame);
+}
+
+// Last single frame DM1 or DM2 sent by the node
+static const struct can_frame *last_frame(uint32_t pgn) {
+    for (int i = num_frames - 1; i >= 0; i--) {
+        if ((frames[i].id & 0xFF) == TEST_SA_NODE && ((frames[i].id >> 8) & 0xFFFF) == pgn) {
+            return &frames[i];
+        }
+    }
+    return NULL;
+}
+
+static void dtc_expect(const uint8_t *dtc, uint32_t spn, uint8_t fmi, uint8_t oc) {
+    zassert_equal(dtc[0], spn & 0xFF, "Wrong SPN");
+    zassert_equal(dtc[1], (spn >> 8) & 0xFF, "Wrong SPN");
+    zassert_equal(dtc[2], ((spn >> 16) << 5) | fmi, "Wrong SPN high bits or FMI");
+    zassert_equal(dtc[3], oc, "Wrong occurrence count");
+}
+
+static void *dm_setup(void) {
+    const struct device *dev = test_can_bus_start(CAN_MODE_LOOPBACK);
+    struct can_filter filter = { .id = 0, .mask = 0, .flags = CAN_FILTER_IDE | CAN_FILTER_DATA };
+
+    node.can_dev = dev;
+    tester.can_dev = dev;
+    zassert_equal(j1939_init(&node), 0, "Node init failed");
+    zassert_equal(j1939_init(&tester), 0, "Tester init failed");
+    zassert_equal(j1939_register_pgn_handler(J1939_PGN_DM1, dm1_rx), 0, "Register failed");
+    test_can_bus_add_filter(&filter, bus_rx, NULL);
+
+    zassert_equal(j1939_dm_init(&node), 0, "DM init failed");
+    return NULL;
+}
+
+static void dm_before(void *fixture) {
+    num_frames = 0;
+    dm1_len = 0;
+    k_sem_reset(&dm1_bam_done);
+}
+
+static void dm_after(void *fixture) {
+    j1939_dm_clear(TEST_SPN_A, 3);
+    j1939_dm_clear(TEST_SPN_B, 14);
+    j1939_dm_clear_previous();
+    k_sleep(K_MSEC(5));
+}
+
+static void dm_teardown(void *fixture) {
+    // Keep the 1 Hz broadcast off the bus of the following suites
+    j1939_dm_stop();
+    test_can_bus_teardown(fixture);
+}
+
+ZTEST_SUITE(j1939_dm_tests, NULL, dm_setup, dm_before, dm_after, dm_teardown);
+
+ZTEST(j1939_dm_tests, test_periodic_empty_dm1)
+{
+    static const uint8_t empty[8] = {0x00, 0xFF, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF};
+    const struct can_frame *frame;
+
+    k_sleep(K_MSEC(J1939_DM1_INTERVAL_MS + 100));
+
+    frame = last_frame(J1939_PGN_DM1);
+    zassert_not_null(frame, "No DM1 within a second");
+    zassert_equal(frame->id >> 26, J1939_PRIORITY_DEFAULT, "Wrong priority");
+    zassert_equal(frame->dlc, 8, "Not a full frame");
+    zassert_mem_equal(frame->data, empty, sizeof(empty), "No DTC not encoded as zeros");
+}
+
+ZTEST(j1939_dm_tests, test_change_sent_immediately)
+{
+    const struct can_frame *frame;
+
+    zassert_equal(j1939_dm_set(TEST_SPN_A, 3, J1939_LAMP_AMBER), 0, "Set failed");
+    k_sleep(K_MSEC(5));
+
+    frame = last_frame(J1939_PGN_DM1);
+    zassert_not_null(frame, "DM1 not sent on change");
+    zassert_equal(frame->data[0], J1939_LAMP_AMBER, "Lamp not on");
+    dtc_expect(&frame->data[2], TEST_SPN_A, 3, 1);
+    zassert_equal(frame->data[6], 0xFF, "Not padded");
+
+    num_frames = 0;
+    zassert_equal(j1939_dm_clear(TEST_SPN_A, 3), 0, "Clear failed");
+    zassert_equal(j1939_dm_clear(TEST_SPN_A, 3), -ENOENT, "Cleared twice");
+    k_sleep(K_MSEC(5));
+
+    frame = last_frame(J1939_PGN_DM1);
+    zassert_not_null(frame, "DM1 not sent on clear");
+    zassert_equal(frame->data[0], 0x00, "Lamp still on");
+    zassert_equal(frame->data[2], 0x00, "DTC still active");
+}
+
+ZTEST(j1939_dm_tests, test_multiple_dtcs_bam)
+{
+    zassert_equal(j1939_dm_set(TEST_SPN_A, 3, J1939_LAMP_AMBER), 0, "Set failed");
+    zassert_equal(j1939_dm_set(TEST_SPN_B, 14, J1939_LAMP_RED_STOP), 0, "Set failed");
+    zassert_equal(j1939_dm_set(TEST_SPN_B, 14, J1939_LAMP_RED_STOP), 0, "Set again failed");
+    zassert_equal(j1939_dm_set(J1939_SPN_MAX + 1, 0, 0), -EINVAL, "Invalid SPN accepted");
+
+    // Two DTCs need 10 bytes
+    zassert_equal(k_sem_take(&dm1_bam_done, K_SECONDS(1)), 0, "No BAM");
+    zassert_equal(dm1_len, 10, "Wrong length");
+    zassert_equal(dm1_received[0], J1939_LAMP_AMBER | J1939_LAMP_RED_STOP, "Wrong lamps");
+    dtc_expect(&dm1_received[2], TEST_SPN_A, 3, 1);
+    dtc_expect(&dm1_received[6], TEST_SPN_B, 14, 1);
+}
+
+ZTEST(j1939_dm_tests, test_dm2_on_request)
+{
+    const struct can_frame *frame;
+
+    // Active twice, the occurrence count carries over
+    for (int i = 0; i < 2; i++) {
+        zassert_equal(j1939_dm_set(TEST_SPN_A, 3, J1939_LAMP_AMBER), 0, "Set failed");
+        zassert_equal(j1939_dm_clear(TEST_SPN_A, 3), 0, "Clear failed");
+    }
+    k_sleep(K_MSEC(5));
+
+    num_frames = 0;
+    zassert_equal(j1939_request_pgn(&tester, J1939_PGN_DM2, TEST_SA_NODE), 0, "Request failed");
+    k_sleep(K_MSEC(5));
+    frame = last_frame(J1939_PGN_DM2);
+    zassert_not_null(frame, "DM2 not answered");
+    dtc_expect(&frame->data[2], TEST_SPN_A, 3, 2);
+
+    j1939_dm_clear_previous();
+    k_sleep(K_MSEC(5));
+    num_frames = 0;
+    zassert_equal(j1939_request_pgn(&tester, J1939_PGN_DM2, TEST_SA_NODE), 0, "Request failed");
+    k_sleep(K_MSEC(5));
+    frame = last_frame(J1939_PGN_DM2);
+    zassert_not_null(frame, "DM2 not answered");
+    zassert_equal(frame->data[2], 0x00, "Previous DTCs not cleared");
+}
+
+ZTEST(j1939_dm_tests, test_dm1_cadence_during_response)
+{
+    int dm1_frames = 0;
+
+    // Two previously active DTCs make DM2 a BAM of two packets
+    zassert_equal(j1939_dm_set(TEST_SPN_A, 3, J1939_LAMP_AMBER), 0, "Set failed");
+    zassert_equal(j1939_dm_set(TEST_SPN_B, 14, J1939_LAMP_AMBER), 0, "Set failed");
+    zassert_equal(j1939_dm_clear(TEST_SPN_A, 3), 0, "Clear failed");
+    zassert_equal(j1939_dm_clear(TEST_SPN_B, 14), 0, "Clear failed");
+    k_sleep(K_MSEC(5));
+
+    // A change while the DM2 response is on the bus
+    zassert_equal(j1939_request_pgn(&tester, J1939_PGN_DM2, J1939_ADDR_GLOBAL), 0,
+                  "Request failed");
+    k_sleep(K_MSEC(5));
+    num_frames = 0;
+    zassert_equal(j1939_dm_set(TEST_SPN_A, 3, J1939_LAMP_AMBER), 0, "Set failed");
+    k_sleep(K_MSEC(J1939_DM1_INTERVAL_MS / 2));
+
+    // Only the DM1 for the change, no retries until the response is done
+    for (int i = 0; i < num_frames; i++) {
+        if ((frames[i].id & 0xFF) == TEST_SA_NODE &&
+            ((frames[i].id >> 8) & 0xFFFF) == J1939_PGN_DM1) {
+            dm1_frames++;
+        }
+    }
+    zassert_equal(dm1_frames, 1, "DM1 sent %d times", dm1_frames);
+}
@@ -0,0 +1,258 @@
+#include <zephyr/ztest.h>
+#include <zephyr/drivers/can.h>
+#include <zephyr/sys/byteorder.h>
+#include <string.h>
+#include "j1939_etp.h"
+#include "can_test_bus.h"
+
+#define TEST_SA_SENDER      0x60
+#define TEST_SA_RECEIVER    0x61
+#define TEST_SA_FAKE        0x62    // Frames injected by the test
+#define TEST_PGN            0xEF00  // Proprietary A
+#define TEST_PGN_REFUSED    0xEF01
+#define TEST_SIZE           10000
+#define TEST_WINDOW         16
+
+static uint8_t pattern(uint32_t offset) {
+    return (offset * 7) ^ (offset >> 8);
+}
+
+// Receiver side: checks every byte against the pattern, nothing is stored
+static uint32_t rx_bytes;
+static uint32_t rx_fail_at;
+static uint32_t rx_hold_at;
+static int rx_errors;
+static int rx_result;
+static int num_dpo;
+static int num_holds;
+static struct can_frame last_abort;
+static K_SEM_DEFINE(rx_closed, 0, 1);
+
+static int consumer_open(struct j1939_ctx *ctx, uint32_t pgn, uint32_t size, void *user_data) {
+    return pgn == TEST_PGN_REFUSED ? -ENOMEM : 0;
+}
+
+static int consumer_data(struct j1939_ctx *ctx, uint32_t offset, const uint8_t *data,
+                         uint8_t len, void *user_data) {
+    if (offset != rx_bytes) {
+        rx_errors++;
+    }
+    for (int i = 0; i < len; i++) {
+        if (data[i] != pattern(offset + i)) {
+            rx_errors++;
+        }
+    }
+    rx_bytes += len;
+    if (rx_bytes > rx_fail_at) {
+        return -EIO;
+    }
+    return offset == rx_hold_at ? J1939_ETP_HOLD : 0;
+}
+
+static void consumer_close(struct j1939_ctx *ctx, int result, void *user_data) {
+    rx_result = result;
+    k_sem_give(&rx_closed);
+}
+
+static const struct j1939_etp_consumer consumer = {
+    .open = consumer_open,
+    .data = consumer_data,
+    .close = consumer_close,
+};
+
+// Sender side: bytes are generated on demand
+static int tx_result;
+static K_SEM_DEFINE(tx_done, 0, 1);
+
+static int producer_read(struct j1939_ctx *ctx, uint32_t offset, uint8_t *buf, uint8_t len,
+                         void *user_data) {
+    for (int i = 0; i < len; i++) {
+        buf[i] = pattern(offset + i);
+    }
+    return 0;
+}
+
+static void sender_done(struct j1939_ctx *ctx, int result, void *user_data) {
+    tx_result = result;
+    k_sem_give(&tx_done);
+}
+
+static struct j1939_ctx sender = {
+    .source_address = TEST_SA_SENDER,
+    .dest_address = TEST_SA_RECEIVER,
+    .manual_rx = true,
+};
+
+static struct j1939_ctx receiver = {
+    .source_address = TEST_SA_RECEIVER,
+    .dest_address = J1939_ADDR_GLOBAL,
+    .manual_rx = true,
+};
+
+static struct j1939_etp sender_etp;
+static struct j1939_etp receiver_etp = {
+    .consumer = &consumer,
+    .rx_window = TEST_WINDOW,
+};
+
+static void bus_rx(const struct device *dev, struct can_frame *frame, void *user_data) {
+    uint8_t sa = frame->id & 0xFF;
+    uint32_t pgn = j1939_id_to_pgn(frame->id);
+
+    if (sa != TEST_SA_SENDER && sa != TEST_SA_RECEIVER) {
+        return;
+    }
+    if (pgn == J1939_PGN_ETP_CM && frame->data[0] == ETP_CM_DPO) {
+        num_dpo++;
+    }
+    if (pgn == J1939_PGN_ETP_CM && frame->data[0] == ETP_CM_CTS && frame->data[1] == 0) {
+        num_holds++;
+    }
+    if (pgn == J1939_PGN_ETP_CM && frame->data[0] == ETP_CM_Abort) {
+        last_abort = *frame;
+    }
+    j1939_process_message(&sender, frame);
+    j1939_process_message(&receiver, frame);
+}
+
+// ETP.CM from the fake sender to the receiver
+static void inject_cm(const uint8_t data[8]) {
+    struct can_frame frame = {
+        .id = (J1939_PRIORITY_LOW << 26) | ((J1939_PGN_ETP_CM | TEST_SA_RECEIVER) << 8) |
+              TEST_SA_FAKE,
+        .dlc = 8,
+        .flags = CAN_FRAME_IDE,
+    };
+
+    memcpy(frame.data, data, 8);
+    j1939_process_message(&receiver, &frame);
+}
+
+static void *etp_setup(void) {
+    const struct device *dev = test_can_bus_start(CAN_MODE_LOOPBACK);
+    struct can_filter filter = { .id = 0, .mask = 0, .flags = CAN_FILTER_IDE | CAN_FILTER_DATA };
+
+    sender.can_dev = dev;
+    receiver.can_dev = dev;
+    zassert_equal(j1939_init(&sender), 0, "Sender init failed");
+    zassert_equal(j1939_init(&receiver), 0, "Receiver init failed");
+    zassert_equal(j1939_etp_init(&sender, &sender_etp), 0, "Sender ETP init failed");
+    zassert_equal(j1939_etp_init(&receiver, &receiver_etp), 0, "Receiver ETP init failed");
+    test_can_bus_add_filter(&filter, bus_rx, NULL);
+    return NULL;
+}
+
+static void etp_before(void *fixture) {
+    rx_bytes = 0;
+    rx_fail_at = UINT32_MAX;
+    rx_hold_at = UINT32_MAX;
+    rx_errors = 0;
+    rx_result = 1;
+    tx_result = 1;
+    num_dpo = 0;
+    num_holds = 0;
+    memset(&last_abort, 0, sizeof(last_abort));
+    memset(&sender.stats, 0, sizeof(sender.stats));
+    memset(&receiver.stats, 0, sizeof(receiver.stats));
+    k_sem_reset(&rx_closed);
+    k_sem_reset(&tx_done);
+}
+
+ZTEST_SUITE(j1939_etp_tests, NULL, etp_setup, etp_before, NULL, test_can_bus_teardown);
+
+ZTEST(j1939_etp_tests, test_streamed_transfer)
+{
+    zassert_equal(j1939_etp_send_async(&sender, TEST_PGN, TEST_SA_RECEIVER, TEST_SIZE,
+                                       producer_read, sender_done, NULL), 0, "Send failed");
+    zassert_equal(k_sem_take(&tx_done, K_SECONDS(5)), 0, "Sender not done");
+    zassert_equal(tx_result, 0, "Transfer failed: %d", tx_result);
+    zassert_equal(k_sem_take(&rx_closed, K_SECONDS(1)), 0, "Receiver not closed");
+    zassert_equal(rx_result, 0, "Receiver failed");
+
+    zassert_equal(rx_bytes, TEST_SIZE, "Wrong length");
+    zassert_equal(rx_errors, 0, "Data out of order or corrupted");
+    zassert_equal(num_dpo, DIV_ROUND_UP(DIV_ROUND_UP(TEST_SIZE, 7), TEST_WINDOW),
+                  "One DPO per window expected");
+    zassert_equal(sender.stats.tx_done, 1, "Not counted");
+    zassert_equal(receiver.stats.rx_done, 1, "Not counted");
+}
+
+ZTEST(j1939_etp_tests, test_refused_by_consumer)
+{
+    zassert_equal(j1939_etp_send_async(&sender, TEST_PGN_REFUSED, TEST_SA_RECEIVER, TEST_SIZE,
+                                       producer_read, sender_done, NULL), 0, "Send failed");
+    zassert_equal(k_sem_take(&tx_done, K_SECONDS(1)), 0, "Sender not done");
+    zassert_equal(tx_result, -ECONNABORTED, "Refusal not reported");
+    zassert_equal(last_abort.data[1], J1939_ABORT_RESOURCES, "Wrong abort reason");
+    zassert_equal(receiver.stats.rx_dropped, 1, "Not counted");
+}
+
+ZTEST(j1939_etp_tests, test_consumer_abort)
+{
+    rx_fail_at = 700;
+
+    zassert_equal(j1939_etp_send_async(&sender, TEST_PGN, TEST_SA_RECEIVER, TEST_SIZE,
+                                       producer_read, sender_done, NULL), 0, "Send failed");
+    zassert_equal(k_sem_take(&rx_closed, K_SECONDS(1)), 0, "Receiver not closed");
+    zassert_equal(rx_result, -EIO, "Consumer error not reported");
+    zassert_equal(k_sem_take(&tx_done, K_SECONDS(1)), 0, "Sender not done");
+    zassert_equal(tx_result, -ECONNABORTED, "Sender not aborted");
+}
+
+ZTEST(j1939_etp_tests, test_consumer_hold)
+{
+    rx_hold_at = 0;
+
+    zassert_equal(j1939_etp_send_async(&sender, TEST_PGN, TEST_SA_RECEIVER, TEST_SIZE,
+                                       producer_read, sender_done, NULL), 0, "Send failed");
+
+    // Held after the first window, past the sender's T4
+    k_sleep(K_MSEC(J1939_TP_T4_MS + J1939_TP_TH_MS));
+    zassert_equal(rx_bytes, TEST_WINDOW * 7, "Not held at the end of the window");
+    zassert_true(num_holds >= 3, "Hold not repeated");
+    zassert_equal(k_sem_take(&tx_done, K_NO_WAIT), -EBUSY, "Sender gave up");
+
+    zassert_equal(j1939_etp_resume(&receiver), 0, "Resume failed");
+    zassert_equal(k_sem_take(&tx_done, K_SECONDS(5)), 0, "Sender not done");
+    zassert_equal(tx_result, 0, "Transfer failed: %d", tx_result);
+    zassert_equal(rx_bytes, TEST_SIZE, "Wrong length");
+    zassert_equal(rx_errors, 0, "Data out of order or corrupted");
+    zassert_equal(j1939_etp_resume(&receiver), -ENOENT, "Resumed without a transfer");
+}
+
+ZTEST(j1939_etp_tests, test_bad_dpo_offset)
+{
+    uint8_t rts[8] = {ETP_CM_RTS};
+    uint8_t dpo[8] = {ETP_CM_DPO, 4};
+
+    sys_put_le32(TEST_SIZE, &rts[1]);
+    sys_put_le24(TEST_PGN, &rts[5]);
+    inject_cm(rts);
+    k_sleep(K_MSEC(5));
+    zassert_true(receiver_etp.rx.active, "RTS not accepted");
+
+    // The first window starts at packet 1, an offset of 5 skips data
+    sys_put_le24(5, &dpo[2]);
+    sys_put_le24(TEST_PGN, &dpo[5]);
+    inject_cm(dpo);
+    k_sleep(K_MSEC(5));
+
+    zassert_false(receiver_etp.rx.active, "Session still open");
+    zassert_equal(last_abort.data[1], J1939_ABORT_BAD_DPO_OFFSET, "Wrong abort reason");
+    zassert_equal(rx_result, -ECONNABORTED, "Consumer not told");
+}
+
+ZTEST(j1939_etp_tests, test_invalid_send)
+{
+    struct j1939_ctx plain = { .source_address = 0x63, .manual_rx = true };
+
+    zassert_equal(j1939_etp_send_async(&sender, TEST_PGN, TEST_SA_RECEIVER, J1939_TP_MAX_SIZE,
+                                       producer_read, NULL, NULL), -EINVAL,
+                  "TP sized transfer accepted");
+    zassert_equal(j1939_etp_send_async(&sender, TEST_PGN, J1939_ADDR_GLOBAL, TEST_SIZE,
+                                       producer_read, NULL, NULL), -EINVAL,
+                  "Broadcast accepted");
+    zassert_equal(j1939_etp_send_async(&plain, TEST_PGN, TEST_SA_RECEIVER, TEST_SIZE,
+                                       producer_read, NULL, NULL), -ENOTSUP,
+                  "Context without ETP accepted");
+}
@@ -0,0 +1,188 @@
+#include <zephyr/ztest.h>
+#include <zephyr/drivers/can.h>
+#include <zephyr/sys/byteorder.h>
+#include <string.h>
+#include "j1939_request.h"
+#include "can_test_bus.h"
+
+#define TEST_SA_SERVER  0x30
+#define TEST_SA_CLIENT  0x40
+#define TEST_PGN_NONE   0xFEFE
+#define TEST_MAX_FRAMES 16
+
+static const uint8_t vin[] = "1FUJGLDR5CLBP8834*";
+static const uint8_t vin_new[] = "1FUJGLDR5CLBP8835*";
+static const uint8_t speed[8] = {0xFF, 0x00, 0x32, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+
+J1939_RESPONSE_DEFINE(vin_response, J1939_PGN_VIN, 32);
+J1939_RESPONSE_DEFINE(speed_response, J1939_PGN_VEHICLE_SPEED, 8);
+J1939_RESPONSE_DEFINE(empty_response, J1939_PGN_COMPONENT_ID, 32);
+
+static struct j1939_ctx server = {
+    .source_address = TEST_SA_SERVER,
+    .dest_address = J1939_ADDR_GLOBAL,
+    .manual_rx = true,
+};
+
+static struct j1939_ctx client = {
+    .source_address = TEST_SA_CLIENT,
+    .dest_address = J1939_ADDR_GLOBAL,
+    .manual_rx = true,
+};
+
+static struct can_frame frames[TEST_MAX_FRAMES];
+static int num_frames;
+static uint8_t vin_received[sizeof(vin)];
+static int vin_count;
+static K_SEM_DEFINE(vin_done, 0, 1);
+
+static void vin_rx(struct j1939_ctx *ctx, const uint8_t *data, uint16_t len) {
+    if (ctx == &client && len == sizeof(vin)) {
+        memcpy(vin_received, data, len);
+        vin_count++;
+        k_sem_give(&vin_done);
+    }
+}
+
+// Both nodes see every frame, requests and responses are recorded
+static void bus_rx(const struct device *dev, struct can_frame *frame, void *user_data) {
+    uint8_t sa = frame->id & 0xFF;
+
+    if (sa != TEST_SA_SERVER && sa != TEST_SA_CLIENT) {
+        return;
+    }
+    if (num_frames < TEST_MAX_FRAMES) {
+        frames[num_frames++] = *frame;
+    }
+    j1939_process_message(&server, frame);
+    j1939_process_message(&client, frame);
+}
+
+static uint32_t frame_pgn(const struct can_frame *frame) {
+    uint32_t pgn = (frame->id >> 8) & 0x3FFFF;
+
+    return ((pgn >> 8) & 0xFF) < 0xF0 ? pgn & 0x3FF00 : pgn;
+}
+
+static void *request_setup(void) {
+    const struct device *dev = test_can_bus_start(CAN_MODE_LOOPBACK);
+    struct can_filter filter = { .id = 0, .mask = 0, .flags = CAN_FILTER_IDE | CAN_FILTER_DATA };
+
+    server.can_dev = dev;
+    client.can_dev = dev;
+    zassert_equal(j1939_init(&server), 0, "Server init failed");
+    zassert_equal(j1939_init(&client), 0, "Client init failed");
+    zassert_equal(j1939_register_pgn_handler(J1939_PGN_VIN, vin_rx), 0, "Register failed");
+
+    zassert_equal(j1939_response_register(&server, &vin_response), 0, "VIN not registered");
+    zassert_equal(j1939_response_register(&server, &speed_response), 0, "Speed not registered");
+    zassert_equal(j1939_response_register(&server, &empty_response), 0, "CI not registered");
+    zassert_equal(j1939_response_register(&server, &speed_response), -EEXIST, "Registered twice");
+    zassert_equal(j1939_response_update(&server, &vin_response, vin, sizeof(vin)), 0,
+                  "VIN update failed");
+    zassert_equal(j1939_response_update(&server, &speed_response, speed, sizeof(speed)), 0,
+                  "Speed update failed");
+
+    test_can_bus_add_filter(&filter, bus_rx, NULL);
+    return NULL;
+}
+
+static void request_before(void *fixture) {
+    num_frames = 0;
+    vin_count = 0;
+    memset(&server.stats, 0, sizeof(server.stats));
+    k_sem_reset(&vin_done);
+}
+
+ZTEST_SUITE(j1939_request_tests, NULL, request_setup, request_before, NULL,
+            test_can_bus_teardown);
+
+ZTEST(j1939_request_tests, test_single_frame_response)
+{
+    zassert_equal(j1939_request_pgn(&client, J1939_PGN_VEHICLE_SPEED, TEST_SA_SERVER), 0,
+                  "Request failed");
+    k_sleep(K_MSEC(5));
+
+    // Answered straight from the RX path, the next frame on the bus
+    zassert_equal(num_frames, 2, "Expected request and response");
+    zassert_equal(frame_pgn(&frames[1]), J1939_PGN_VEHICLE_SPEED, "Not the response");
+    zassert_equal(frames[1].id & 0xFF, TEST_SA_SERVER, "Wrong sender");
+    zassert_equal(frames[1].id >> 26, J1939_PRIORITY_DEFAULT, "Wrong priority");
+    zassert_mem_equal(frames[1].data, speed, sizeof(speed), "Wrong data");
+    zassert_equal(server.stats.requests_answered, 1, "Not counted");
+}
+
+ZTEST(j1939_request_tests, test_global_request_bam)
+{
+    zassert_equal(j1939_request_pgn(&client, J1939_PGN_VIN, J1939_ADDR_GLOBAL), 0,
+                  "Request failed");
+    zassert_equal(k_sem_take(&vin_done, K_SECONDS(1)), 0, "VIN not received");
+    zassert_mem_equal(vin_received, vin, sizeof(vin), "Wrong VIN");
+
+    zassert_equal(frame_pgn(&frames[1]), J1939_PGN_TP_CM, "No TP");
+    zassert_equal(frames[1].data[0], TP_CM_BAM, "Global request not answered with BAM");
+}
+
+ZTEST(j1939_request_tests, test_directed_request_rts)
+{
+    zassert_equal(j1939_request_pgn(&client, J1939_PGN_VIN, TEST_SA_SERVER), 0,
+                  "Request failed");
+    zassert_equal(k_sem_take(&vin_done, K_SECONDS(1)), 0, "VIN not received");
+    zassert_mem_equal(vin_received, vin, sizeof(vin), "Wrong VIN");
+
+    zassert_equal(frames[1].data[0], TP_CM_RTS, "Not sent to the requester");
+    zassert_equal((frames[1].id >> 8) & 0xFF, TEST_SA_CLIENT, "RTS to the wrong node");
+    k_sleep(K_MSEC(5));
+    zassert_equal(server.stats.tx_done, 1, "Transfer not completed");
+}
+
+ZTEST(j1939_request_tests, test_update_while_sending)
+{
+    zassert_equal(j1939_request_pgn(&client, J1939_PGN_VIN, J1939_ADDR_GLOBAL), 0,
+                  "Request failed");
+    k_sleep(K_MSEC(5));
+
+    // The broadcast reads the buffer for the next 100 ms, the update waits
+    zassert_equal(j1939_response_update(&server, &vin_response, vin_new, sizeof(vin_new)), 0,
+                  "Update refused during the transfer");
+    zassert_equal(k_sem_take(&vin_done, K_SECONDS(1)), 0, "VIN not received");
+    zassert_mem_equal(vin_received, vin, sizeof(vin), "Buffer changed under the transfer");
+    k_sleep(K_MSEC(5));
+
+    zassert_equal(j1939_request_pgn(&client, J1939_PGN_VIN, J1939_ADDR_GLOBAL), 0,
+                  "Request failed");
+    zassert_equal(k_sem_take(&vin_done, K_SECONDS(1)), 0, "VIN not received");
+    zassert_mem_equal(vin_received, vin_new, sizeof(vin_new), "Update lost");
+    k_sleep(K_MSEC(5));
+    zassert_equal(j1939_response_update(&server, &vin_response, vin, sizeof(vin)), 0,
+                  "Restore failed");
+}
+
+ZTEST(j1939_request_tests, test_unsupported_nack)
+{
+    zassert_equal(j1939_request_pgn(&client, TEST_PGN_NONE, TEST_SA_SERVER), 0,
+                  "Request failed");
+    k_sleep(K_MSEC(5));
+    zassert_equal(j1939_request_pgn(&client, J1939_PGN_COMPONENT_ID, TEST_SA_SERVER), 0,
+                  "Request failed");
+    k_sleep(K_MSEC(5));
+
+    // NACK to everyone, naming the requester and the PGN
+    zassert_equal(num_frames, 4, "Expected two NACKs");
+    zassert_equal(frame_pgn(&frames[1]), J1939_PGN_ACK, "No acknowledgment");
+    zassert_equal((frames[1].id >> 8) & 0xFF, J1939_ADDR_GLOBAL, "Not sent to everyone");
+    zassert_equal(frames[1].data[0], J1939_ACK_NEGATIVE, "Not negative");
+    zassert_equal(frames[1].data[4], TEST_SA_CLIENT, "Wrong address");
+    zassert_equal(sys_get_le24(&frames[1].data[5]), TEST_PGN_NONE, "Wrong PGN");
+
+    // Registered, but without data yet
+    zassert_equal(sys_get_le24(&frames[3].data[5]), J1939_PGN_COMPONENT_ID, "Wrong PGN");
+    zassert_equal(server.stats.requests_refused, 2, "Not counted");
+
+    // Global requests are never acknowledged
+    num_frames = 0;
+    zassert_equal(j1939_request_pgn(&client, TEST_PGN_NONE, J1939_ADDR_GLOBAL), 0,
+                  "Request failed");
+    k_sleep(K_MSEC(5));
+    zassert_equal(num_frames, 1, "Global request acknowledged");
+}
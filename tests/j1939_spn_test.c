@@ -0,0 +1,82 @@
+#include <zephyr/ztest.h>
+#include <math.h>
+#include "j1939_spn.h"
+
+ZTEST_SUITE(j1939_spn_tests, NULL, NULL, NULL, NULL, NULL);
+
+ZTEST(j1939_spn_tests, test_et1_indicators)
+{
+    // 50 degC, not available, 72 degC, error, reserved, 100 %
+    static const uint8_t data[8] = {0x5A, 0xFF, 0x20, 0x2B, 0x10, 0xFE, 0xFB, 0xFA};
+    struct j1939_spn_status status;
+    struct j1939_et1 et1;
+
+    j1939_spn_decode(&j1939_spns_et1, data, sizeof(data), &et1, &status);
+
+    zassert_within(et1.coolant_temp, 50.0f, 0.001f, "Wrong coolant temperature");
+    zassert_within(et1.oil_temp, 72.0f, 0.001f, "Wrong oil temperature");
+    zassert_within(et1.intercooler_opening, 100.0f, 0.001f, "Wrong opening");
+    zassert_true(isnan(et1.fuel_temp), "Not available read as a value");
+    zassert_true(isnan(et1.turbo_oil_temp), "Error read as a value");
+    zassert_true(isnan(et1.intercooler_temp), "Reserved read as a value");
+
+    zassert_equal(status.valid, J1939_SPN_BIT(struct j1939_et1, coolant_temp) |
+                                J1939_SPN_BIT(struct j1939_et1, oil_temp) |
+                                J1939_SPN_BIT(struct j1939_et1, intercooler_opening),
+                  "Wrong valid mask");
+    zassert_equal(status.error, J1939_SPN_BIT(struct j1939_et1, turbo_oil_temp),
+                  "Only the turbo oil temperature reports an error");
+}
+
+ZTEST(j1939_spn_tests, test_ccvs_bit_fields)
+{
+    // Parking brake on, 25 km/h, cruise off, brake on, clutch error, set 80 km/h
+    static const uint8_t data[8] = {0xF7, 0x00, 0x19, 0x9C, 0xFF, 0x50, 0xFF, 0xFF};
+    struct j1939_spn_status status;
+    struct j1939_ccvs ccvs;
+
+    j1939_spn_decode(&j1939_spns_ccvs, data, sizeof(data), &ccvs, &status);
+
+    zassert_equal(ccvs.parking_brake, 1.0f, "Parking brake not on");
+    zassert_within(ccvs.wheel_speed, 25.0f, 0.001f, "Wrong speed");
+    zassert_equal(ccvs.cruise_active, 0.0f, "Cruise control not off");
+    zassert_equal(ccvs.brake_switch, 1.0f, "Brake switch not on");
+    zassert_true(isnan(ccvs.clutch_switch), "2-bit error read as a value");
+    zassert_equal(ccvs.cruise_set_speed, 80.0f, "Wrong set speed");
+    zassert_equal(status.error, J1939_SPN_BIT(struct j1939_ccvs, clutch_switch),
+                  "2-bit error not reported");
+}
+
+ZTEST(j1939_spn_tests, test_vp_short_frame)
+{
+    // 48.5 deg N, 11.25 deg E
+    static const uint8_t data[8] = {0x40, 0xF8, 0x13, 0x9A, 0x20, 0x12, 0xE0, 0x83};
+    struct j1939_spn_status status;
+    struct j1939_vp vp;
+
+    j1939_spn_decode(&j1939_spns_vp, data, sizeof(data), &vp, &status);
+    zassert_within(vp.latitude, 48.5f, 0.0001f, "Wrong latitude");
+    zassert_within(vp.longitude, 11.25f, 0.0001f, "Wrong longitude");
+    zassert_equal(status.valid, 0x3, "Position not valid");
+
+    // Missing bytes are not available
+    j1939_spn_decode(&j1939_spns_vp, data, 4, &vp, &status);
+    zassert_within(vp.latitude, 48.5f, 0.0001f, "Wrong latitude");
+    zassert_true(isnan(vp.longitude), "Missing longitude read as a value");
+    zassert_equal(status.valid, J1939_SPN_BIT(struct j1939_vp, latitude), "Wrong valid mask");
+    zassert_equal(status.error, 0, "Not available read as an error");
+}
+
+ZTEST(j1939_spn_tests, test_table_lookup)
+{
+    const struct j1939_spn wide = J1939_SPN(0, 32, 1.0f, 0.0f);
+
+    zassert_equal_ptr(j1939_spn_table(J1939_PGN_VEHICLE_SPEED), &j1939_spns_ccvs,
+                      "CCVS table not found");
+    zassert_is_null(j1939_spn_table(J1939_PGN_VIN), "Table for an undecoded PGN");
+
+    zassert_equal(wide.mask, 0xFFFFFFFF, "Wrong 32-bit mask");
+    zassert_equal(wide.valid_max, 0xFAFFFFFF, "Wrong 32-bit valid range");
+    zassert_equal(wide.error_min, 0xFE000000, "Wrong 32-bit error range");
+    zassert_equal(wide.error_max, 0xFEFFFFFF, "Wrong 32-bit error range");
+}
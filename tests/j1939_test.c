@@ -0,0 +1,470 @@
+#include <zephyr/ztest.h>
+#include <zephyr/drivers/can.h>
+#include <string.h>
+#include "j1939.h"
+#include "can_test_bus.h"
+
+#define TEST_SA_TX      0x21
+#define TEST_SA_RX      0x17
+#define TEST_PGN_A      0xFECA      // DM1
+#define TEST_PGN_B      0xFECB      // DM2
+#define TEST_PGN_C      0xFEF1      // CCVS
+#define TEST_PGN_REQ    0xEA00      // Request, PDU1
+#define TEST_SA_PEER    0x60        // Receiver played by the test
+#define TEST_MAX_FRAMES 300
+
+struct captured_frame {
+    struct can_frame frame;
+    uint32_t time;
+};
+
+static struct captured_frame captured[TEST_MAX_FRAMES];
+static int num_captured;
+static bool route;          // Deliver bus frames to both contexts
+
+struct received {
+    uint8_t data[J1939_TP_MAX_SIZE];
+    uint16_t len;
+    int count;
+};
+
+static struct received received_a;
+static struct received received_b;
+static uint8_t dispatched[8];       // Handlers of TEST_PGN_C in call order
+static int num_dispatched;
+static uint8_t last_sa;
+static uint8_t last_da;
+static uint8_t msg[J1939_TP_MAX_SIZE];
+
+static int tx_result;
+static K_SEM_DEFINE(tx_done, 0, 1);
+
+static struct j1939_ctx sender = {
+    .source_address = TEST_SA_TX,
+    .dest_address = J1939_ADDR_GLOBAL,
+    .manual_rx = true,
+};
+
+static struct j1939_ctx receiver = {
+    .source_address = TEST_SA_RX,
+    .dest_address = J1939_ADDR_GLOBAL,
+    .manual_rx = true,
+};
+
+static void store(struct received *r, const uint8_t *data, uint16_t len) {
+    memcpy(r->data, data, len);
+    r->len = len;
+    r->count++;
+}
+
+static void handler_a(struct j1939_ctx *ctx, const uint8_t *data, uint16_t len) {
+    store(&received_a, data, len);
+}
+
+static void handler_b(struct j1939_ctx *ctx, const uint8_t *data, uint16_t len) {
+    store(&received_b, data, len);
+}
+
+static void record(uint8_t tag, struct j1939_ctx *ctx) {
+    if (num_dispatched < ARRAY_SIZE(dispatched)) {
+        dispatched[num_dispatched++] = tag;
+    }
+    last_sa = ctx->rx_sa;
+    last_da = ctx->rx_da;
+}
+
+static void handler_static(struct j1939_ctx *ctx, const uint8_t *data, uint16_t len) {
+    record('s', ctx);
+}
+
+static void handler_any(struct j1939_ctx *ctx, const uint8_t *data, uint16_t len) {
+    record('a', ctx);
+}
+
+static void handler_peer(struct j1939_ctx *ctx, const uint8_t *data, uint16_t len) {
+    record('p', ctx);
+}
+
+J1939_PGN_HANDLER_DEFINE(test_static_handler, TEST_PGN_C, J1939_ADDR_GLOBAL, handler_static);
+J1939_PGN_HANDLER_DEFINE(test_request_handler, TEST_PGN_REQ, J1939_ADDR_GLOBAL, handler_static);
+
+static void capture_rx(const struct device *dev, struct can_frame *frame, void *user_data) {
+    if (num_captured < TEST_MAX_FRAMES) {
+        captured[num_captured].frame = *frame;
+        captured[num_captured].time = k_uptime_get_32();
+        num_captured++;
+    }
+    if (route) {
+        j1939_process_message(&sender, frame);
+        j1939_process_message(&receiver, frame);
+    }
+}
+
+static void tx_sent(struct j1939_ctx *ctx, int result, void *user_data) {
+    tx_result = result;
+    k_sem_give(&tx_done);
+}
+
+static struct can_frame tp_frame(uint32_t pgn, uint8_t sa, uint8_t da, const uint8_t *data) {
+    struct can_frame frame = {
+        .id = (J1939_PRIORITY_LOW << 26) | ((pgn | da) << 8) | sa,
+        .dlc = 8,
+        .flags = CAN_FRAME_IDE,
+    };
+
+    memcpy(frame.data, data, 8);
+    return frame;
+}
+
+static struct can_frame bam_frame(uint32_t pgn, uint8_t sa, const uint8_t *data) {
+    return tp_frame(pgn, sa, J1939_ADDR_GLOBAL, data);
+}
+
+// TP.CM from the test peer to the sender
+static void peer_cm(uint8_t cmd, uint8_t b1, uint8_t b2, uint32_t pgn) {
+    uint8_t cm[8] = {cmd, b1, b2, 0xFF, 0xFF, pgn & 0xFF, (pgn >> 8) & 0xFF, pgn >> 16};
+    struct can_frame frame = tp_frame(J1939_PGN_TP_CM, TEST_SA_PEER, TEST_SA_TX, cm);
+
+    j1939_process_message(&sender, &frame);
+}
+
+static int count_frames(uint32_t pgn, uint8_t first_byte) {
+    int n = 0;
+
+    for (int i = 0; i < num_captured; i++) {
+        if (((captured[i].frame.id >> 8) & 0x3FF00) == pgn &&
+            (pgn == J1939_PGN_TP_DT || captured[i].frame.data[0] == first_byte)) {
+            n++;
+        }
+    }
+    return n;
+}
+
+// Announcement and data packets of a broadcast from sa, as on the bus
+static int bam_prepare(struct can_frame *frames, uint8_t sa, uint32_t pgn, const uint8_t *data,
+                       uint16_t len) {
+    uint8_t packets = DIV_ROUND_UP(len, J1939_TP_PACKET_SIZE);
+    uint8_t cm[8] = {TP_CM_BAM, len & 0xFF, len >> 8, packets, 0xFF,
+                     pgn & 0xFF, (pgn >> 8) & 0xFF, pgn >> 16};
+
+    frames[0] = bam_frame(J1939_PGN_TP_CM, sa, cm);
+    for (int i = 0; i < packets; i++) {
+        uint8_t dt[8];
+        int n = MIN(J1939_TP_PACKET_SIZE, len - i * J1939_TP_PACKET_SIZE);
+
+        memset(dt, 0xFF, sizeof(dt));
+        dt[0] = i + 1;
+        memcpy(&dt[1], &data[i * J1939_TP_PACKET_SIZE], n);
+        frames[i + 1] = bam_frame(J1939_PGN_TP_DT, sa, dt);
+    }
+    return packets + 1;
+}
+
+static void *j1939_setup(void) {
+    const struct device *dev = test_can_bus_start(CAN_MODE_LOOPBACK);
+    struct can_filter filter = { .id = 0, .mask = 0, .flags = CAN_FILTER_IDE | CAN_FILTER_DATA };
+
+    for (int i = 0; i < sizeof(msg); i++) {
+        msg[i] = i * 7 + (i >> 8);
+    }
+
+    sender.can_dev = dev;
+    receiver.can_dev = dev;
+    zassert_equal(j1939_init(&sender), 0, "Sender init failed");
+    zassert_equal(j1939_init(&receiver), 0, "Receiver init failed");
+    zassert_equal(j1939_register_pgn_handler(TEST_PGN_A, handler_a), 0, "Register failed");
+    zassert_equal(j1939_register_pgn_handler(TEST_PGN_B, handler_b), 0, "Register failed");
+    zassert_equal(j1939_register_pgn_handler(TEST_PGN_C, handler_any), 0, "Register failed");
+    zassert_equal(j1939_register_pgn_handler_from(TEST_PGN_C, TEST_SA_PEER, handler_peer), 0,
+                  "Register failed");
+    test_can_bus_add_filter(&filter, capture_rx, NULL);
+    return NULL;
+}
+
+static void j1939_before(void *fixture) {
+    num_captured = 0;
+    route = false;
+    sender.dest_address = J1939_ADDR_GLOBAL;
+    receiver.tp_rx_window = 0;
+    memset(&sender.stats, 0, sizeof(sender.stats));
+    memset(&received_a, 0, sizeof(received_a));
+    memset(&received_b, 0, sizeof(received_b));
+    num_dispatched = 0;
+    memset(&receiver.stats, 0, sizeof(receiver.stats));
+    k_sem_reset(&tx_done);
+}
+
+ZTEST_SUITE(j1939_tests, NULL, j1939_setup, j1939_before, NULL, test_can_bus_teardown);
+
+ZTEST(j1939_tests, test_bam_tx_paced)
+{
+    uint32_t start = k_uptime_get_32();
+
+    zassert_equal(j1939_send_bam_async(&sender, TEST_PGN_A, msg, 100, tx_sent, NULL), 0,
+                  "Broadcast not started");
+    zassert_equal(j1939_send_bam_async(&sender, TEST_PGN_A, msg, 100, NULL, NULL), -EBUSY,
+                  "Second broadcast accepted");
+    zassert_true(k_uptime_get_32() - start < J1939_BAM_INTERVAL_MIN_MS, "Caller was blocked");
+
+    zassert_equal(k_sem_take(&tx_done, K_SECONDS(5)), 0, "Broadcast not finished");
+    zassert_equal(tx_result, 0, "Broadcast failed");
+
+    // Announcement to the global address and 15 data packets, 50 ms apart
+    zassert_equal(num_captured, 16, "Wrong number of frames");
+    zassert_equal((captured[0].frame.id >> 8) & 0x3FFFF, J1939_PGN_TP_CM | J1939_ADDR_GLOBAL,
+                  "Not a broadcast");
+    zassert_equal(captured[0].frame.data[0], TP_CM_BAM, "Not a BAM");
+    zassert_equal(captured[0].frame.data[3], 15, "Wrong packet count");
+    for (int i = 1; i < num_captured; i++) {
+        zassert_true(captured[i].time - captured[i - 1].time >= J1939_BAM_INTERVAL_MIN_MS,
+                     "Packet %d too early", i);
+    }
+    zassert_equal(captured[15].frame.data[3], 0xFF, "Last packet not padded");
+
+    for (int i = 0; i < num_captured; i++) {
+        j1939_process_message(&receiver, &captured[i].frame);
+    }
+    zassert_equal(received_a.count, 1, "Not received");
+    zassert_equal(received_a.len, 100, "Length mismatch");
+    zassert_mem_equal(received_a.data, msg, 100, "Payload mismatch");
+}
+
+ZTEST(j1939_tests, test_bam_rx_per_source)
+{
+    static struct can_frame frames_a[J1939_TP_MAX_SIZE / J1939_TP_PACKET_SIZE + 1];
+    static struct can_frame frames_b[J1939_TP_MAX_SIZE / J1939_TP_PACKET_SIZE + 1];
+    int num_a = bam_prepare(frames_a, 0x30, TEST_PGN_A, msg, J1939_TP_MAX_SIZE);
+    int num_b = bam_prepare(frames_b, 0x31, TEST_PGN_B, &msg[5], 40);
+
+    // Both sources broadcast at the same time
+    for (int i = 0; i < num_a; i++) {
+        j1939_process_message(&receiver, &frames_a[i]);
+        if (i < num_b) {
+            j1939_process_message(&receiver, &frames_b[i]);
+        }
+    }
+
+    zassert_equal(received_a.count, 1, "First source not received");
+    zassert_equal(received_a.len, J1939_TP_MAX_SIZE, "First source length");
+    zassert_mem_equal(received_a.data, msg, J1939_TP_MAX_SIZE, "First source payload");
+    zassert_equal(received_b.count, 1, "Second source not received");
+    zassert_mem_equal(received_b.data, &msg[5], 40, "Second source payload");
+    zassert_equal(receiver.stats.rx_done, 2, "Not counted");
+}
+
+ZTEST(j1939_tests, test_bam_rx_timeout)
+{
+    struct can_frame frames[4];
+
+    bam_prepare(frames, 0x40, TEST_PGN_A, msg, 20);
+    j1939_process_message(&receiver, &frames[0]);
+    j1939_process_message(&receiver, &frames[1]);
+
+    // Past T1 the rest of the transfer is dropped
+    k_sleep(K_MSEC(J1939_TP_T1_MS + 50));
+    j1939_process_message(&receiver, &frames[2]);
+    j1939_process_message(&receiver, &frames[3]);
+    zassert_equal(received_a.count, 0, "Stale transfer completed");
+    zassert_equal(receiver.stats.rx_timeouts, 1, "Timeout not counted");
+}
+
+ZTEST(j1939_tests, test_bam_rx_slots_full)
+{
+    struct can_frame frames[J1939_TP_POOL_BUFFERS + 1][3];
+
+    for (int i = 0; i <= J1939_TP_POOL_BUFFERS; i++) {
+        bam_prepare(frames[i], 0x50 + i, TEST_PGN_A, msg, 14);
+        j1939_process_message(&receiver, &frames[i][0]);
+    }
+    zassert_equal(receiver.stats.rx_dropped, 1, "Extra source not dropped");
+
+    for (int i = 0; i <= J1939_TP_POOL_BUFFERS; i++) {
+        j1939_process_message(&receiver, &frames[i][1]);
+        j1939_process_message(&receiver, &frames[i][2]);
+    }
+    zassert_equal(received_a.count, J1939_TP_POOL_BUFFERS, "Admitted sources not received");
+}
+
+ZTEST(j1939_tests, test_rts_cts_windowed)
+{
+    route = true;
+    sender.dest_address = TEST_SA_RX;
+    receiver.tp_rx_window = 16;
+
+    zassert_equal(j1939_send_tp_async(&sender, TEST_PGN_B, msg, J1939_TP_MAX_SIZE, tx_sent, NULL),
+                  0, "Transfer not started");
+    zassert_equal(k_sem_take(&tx_done, K_SECONDS(5)), 0, "Transfer not finished");
+    zassert_equal(tx_result, 0, "Transfer failed");
+
+    // 255 packets in windows of 16, each cleared by its own CTS
+    zassert_equal(count_frames(J1939_PGN_TP_CM, TP_CM_CTS), 16, "Wrong number of CTS");
+    zassert_equal(count_frames(J1939_PGN_TP_DT, 0), 255, "Packets repeated or lost");
+    zassert_equal(count_frames(J1939_PGN_TP_CM, TP_CM_EndOfMsgAck), 1, "No EOMA");
+    zassert_equal(received_b.count, 1, "Not received");
+    zassert_mem_equal(received_b.data, msg, J1939_TP_MAX_SIZE, "Payload mismatch");
+    zassert_equal(sender.stats.tx_done, 1, "Not counted");
+}
+
+ZTEST(j1939_tests, test_rts_cts_hold)
+{
+    sender.dest_address = TEST_SA_PEER;
+
+    zassert_equal(j1939_send_tp_async(&sender, TEST_PGN_A, msg, 35, tx_sent, NULL), 0,
+                  "Transfer not started");
+    k_sleep(K_MSEC(10));
+    zassert_equal(count_frames(J1939_PGN_TP_CM, TP_CM_RTS), 1, "No RTS");
+
+    // Exactly the packets cleared are sent
+    peer_cm(TP_CM_CTS, 2, 1, TEST_PGN_A);
+    k_sleep(K_MSEC(10));
+    zassert_equal(count_frames(J1939_PGN_TP_DT, 0), 2, "Window not respected");
+
+    // Hold, longer than T3 but within T4
+    peer_cm(TP_CM_CTS, 0, 0xFF, TEST_PGN_A);
+    k_sleep(K_MSEC(J1939_TP_T4_MS - 50));
+    zassert_equal(count_frames(J1939_PGN_TP_DT, 0), 2, "Sent while on hold");
+    zassert_equal(k_sem_take(&tx_done, K_NO_WAIT), -EBUSY, "Hold timed out");
+
+    // Ask for packet 2 again and the rest
+    peer_cm(TP_CM_CTS, 4, 2, TEST_PGN_A);
+    k_sleep(K_MSEC(10));
+    zassert_equal(count_frames(J1939_PGN_TP_DT, 0), 6, "Window not sent");
+    zassert_equal(captured[num_captured - 4].frame.data[0], 2, "Not resent from packet 2");
+
+    peer_cm(TP_CM_EndOfMsgAck, 35, 0, TEST_PGN_A);
+    zassert_equal(k_sem_take(&tx_done, K_MSEC(10)), 0, "Not finished");
+    zassert_equal(tx_result, 0, "Transfer failed");
+}
+
+ZTEST(j1939_tests, test_rts_no_cts)
+{
+    sender.dest_address = TEST_SA_PEER;
+
+    zassert_equal(j1939_send_tp_async(&sender, TEST_PGN_A, msg, 35, tx_sent, NULL), 0,
+                  "Transfer not started");
+    zassert_equal(j1939_send_tp_async(&sender, TEST_PGN_A, msg, 35, NULL, NULL), -EBUSY,
+                  "Second transfer accepted");
+
+    // T3 expires, the peer is told with an abort
+    zassert_equal(k_sem_take(&tx_done, K_MSEC(J1939_TP_T3_MS + 100)), 0, "No timeout");
+    zassert_equal(tx_result, -ETIMEDOUT, "Wrong result");
+    zassert_equal(count_frames(J1939_PGN_TP_CM, TP_CM_Abort), 1, "No abort sent");
+    zassert_equal(sender.stats.tx_timeouts, 1, "Not counted");
+}
+
+// Connection from a test peer to the receiver: RTS and all packets
+static int rts_prepare(struct can_frame *frames, uint8_t sa, uint32_t pgn, const uint8_t *data,
+                       uint16_t len) {
+    int num = bam_prepare(frames, sa, pgn, data, len);
+
+    frames[0].data[0] = TP_CM_RTS;
+    for (int i = 0; i < num; i++) {
+        frames[i].id = (frames[i].id & ~0xFF00) | (TEST_SA_RX << 8);
+    }
+    return num;
+}
+
+ZTEST(j1939_tests, test_rts_sessions_concurrent)
+{
+    struct can_frame frames[3][10];
+    static const uint32_t pgns[] = {TEST_PGN_A, TEST_PGN_B, TEST_PGN_B};
+    int num = 0;
+
+    // Three senders at once, each on its own session
+    for (int peer = 0; peer < 3; peer++) {
+        num = rts_prepare(frames[peer], 0x70 + peer, pgns[peer], &msg[peer], 50);
+    }
+    for (int i = 0; i < num; i++) {
+        for (int peer = 0; peer < 3; peer++) {
+            j1939_process_message(&receiver, &frames[peer][i]);
+        }
+    }
+    k_sleep(K_MSEC(10));
+
+    zassert_equal(receiver.stats.rx_done, 3, "Sessions not completed");
+    zassert_equal(received_a.count, 1, "First sender not received");
+    zassert_mem_equal(received_a.data, &msg[0], 50, "First sender payload");
+    zassert_equal(received_b.count, 2, "Other senders not received");
+    zassert_mem_equal(received_b.data, &msg[2], 50, "Last sender payload");
+    zassert_equal(count_frames(J1939_PGN_TP_CM, TP_CM_EndOfMsgAck), 3, "EOMA missing");
+}
+
+ZTEST(j1939_tests, test_rts_session_busy)
+{
+    struct can_frame frames[10];
+    struct can_frame other[10];
+    int num = rts_prepare(frames, 0x70, TEST_PGN_A, msg, 50);
+
+    // A second PGN from the same sender is refused, the first continues
+    rts_prepare(other, 0x70, TEST_PGN_B, msg, 50);
+    j1939_process_message(&receiver, &frames[0]);
+    j1939_process_message(&receiver, &other[0]);
+    for (int i = 1; i < num; i++) {
+        j1939_process_message(&receiver, &frames[i]);
+    }
+    k_sleep(K_MSEC(10));
+
+    zassert_equal(count_frames(J1939_PGN_TP_CM, TP_CM_Abort), 1, "Second RTS not refused");
+    zassert_equal(received_a.count, 1, "First transfer lost");
+    zassert_equal(received_b.count, 0, "Second transfer accepted");
+}
+
+ZTEST(j1939_tests, test_rts_session_timeout)
+{
+    struct can_frame frames[10];
+
+    rts_prepare(frames, 0x70, TEST_PGN_A, msg, 50);
+    j1939_process_message(&receiver, &frames[0]);
+    j1939_process_message(&receiver, &frames[1]);
+
+    // No more data within T1, the sender is told and the buffer returned
+    k_sleep(K_MSEC(J1939_TP_T1_MS + 50));
+    zassert_equal(count_frames(J1939_PGN_TP_CM, TP_CM_Abort), 1, "No abort sent");
+    zassert_equal(receiver.stats.rx_timeouts, 1, "Timeout not counted");
+
+    // All sessions and buffers are free again
+    for (int i = 0; i < J1939_TP_POOL_BUFFERS; i++) {
+        rts_prepare(frames, 0x70 + i, TEST_PGN_A, msg, 50);
+        j1939_process_message(&receiver, &frames[0]);
+    }
+    zassert_equal(receiver.stats.rx_dropped, 0, "Buffer leaked");
+    k_sleep(K_MSEC(J1939_TP_T2_MS + 50));
+    zassert_equal(receiver.stats.rx_timeouts, 1 + J1939_TP_POOL_BUFFERS, "T2 not enforced");
+}
+
+ZTEST(j1939_tests, test_dispatch_all_handlers)
+{
+    uint8_t data[8] = {0};
+    struct can_frame frame = tp_frame(TEST_PGN_C, TEST_SA_PEER, 0, data);
+
+    // Static handler first, then the registered ones in order
+    j1939_process_message(&receiver, &frame);
+    zassert_equal(num_dispatched, 3, "Not every handler called");
+    zassert_mem_equal(dispatched, "sap", 3, "Wrong order");
+    zassert_equal(last_sa, TEST_SA_PEER, "Source not passed");
+    zassert_equal(last_da, J1939_ADDR_GLOBAL, "PDU2 has no destination");
+    zassert_equal(received_a.count, 0, "Other PGN dispatched");
+}
+
+ZTEST(j1939_tests, test_dispatch_source_filter)
+{
+    uint8_t data[8] = {0};
+    struct can_frame frame = tp_frame(TEST_PGN_C, 0x42, 0, data);
+
+    j1939_process_message(&receiver, &frame);
+    zassert_equal(num_dispatched, 2, "Source filter ignored");
+    zassert_mem_equal(dispatched, "sa", 2, "Wrong handlers");
+
+    // PDU1 to us, the PS byte is not part of the PGN
+    num_dispatched = 0;
+    frame = tp_frame(TEST_PGN_REQ, 0x42, TEST_SA_RX, data);
+    j1939_process_message(&receiver, &frame);
+    zassert_equal(num_dispatched, 1, "Request not dispatched");
+    zassert_equal(last_da, TEST_SA_RX, "Destination not passed");
+
+    // Unregistered PGN
+    num_dispatched = 0;
+    frame = tp_frame(0xFEF2, 0x42, 0, data);
+    j1939_process_message(&receiver, &frame);
+    zassert_equal(num_dispatched, 0, "Unknown PGN dispatched");
+}
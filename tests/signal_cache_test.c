@@ -0,0 +1,92 @@
+#include <zephyr/ztest.h>
+
+// Built into this suite rather than listed in CMakeLists.txt: the tests
+// reach the entries to stall a writer, which on a single CPU never stops
+// mid-update
+#include "signal_cache.c"
+
+// Leaves the entry the way a writer on another CPU does between its
+// sequence increments
+static void stall_writer(signal_cache_id_t id) {
+    atomic_inc(&cache[id].seq);
+}
+
+static void release_writer(signal_cache_id_t id) {
+    atomic_inc(&cache[id].seq);
+}
+
+static void signal_cache_before(void *fixture) {
+    signal_cache_init();
+}
+
+ZTEST_SUITE(signal_cache_tests, NULL, NULL, signal_cache_before, NULL, NULL);
+
+ZTEST(signal_cache_tests, test_no_data)
+{
+    struct signal_sample sample;
+
+    zassert_equal(signal_cache_read(SIGNAL_VEHICLE_SPEED, &sample), -ENODATA, "Data too early");
+    zassert_equal(signal_cache_read(SIGNAL_CACHE_COUNT, &sample), -EINVAL, "Invalid ID read");
+    zassert_false(signal_cache_is_fresh(SIGNAL_VEHICLE_SPEED, SIGNAL_MAX_AGE_MS), "Fresh");
+    zassert_equal(get_current_speed(), 0.0f, "Speed without data");
+}
+
+ZTEST(signal_cache_tests, test_update)
+{
+    struct signal_sample sample;
+
+    signal_cache_update(SIGNAL_VEHICLE_SPEED, 72.0f);
+    signal_cache_update(SIGNAL_VEHICLE_SPEED, 90.0f);
+
+    zassert_equal(signal_cache_read(SIGNAL_VEHICLE_SPEED, &sample), 0, "Read failed");
+    zassert_equal(sample.value, 90.0f, "Not the latest value");
+    zassert_equal(sample.update_count, 2, "Update count");
+    zassert_within(get_current_speed(), 25.0f, 0.001f, "Not converted to m/s");
+    zassert_true(signal_cache_is_fresh(SIGNAL_VEHICLE_SPEED, SIGNAL_MAX_AGE_MS), "Not fresh");
+
+    k_msleep(SIGNAL_MAX_AGE_MS + 10);
+    zassert_false(signal_cache_is_fresh(SIGNAL_VEHICLE_SPEED, SIGNAL_MAX_AGE_MS), "Still fresh");
+}
+
+ZTEST(signal_cache_tests, test_stalled_writer)
+{
+    struct signal_sample sample;
+
+    signal_cache_update(SIGNAL_BRAKE_PRESSURE, 1500.0f);
+
+    // The reader gives up on the sequence after SIGNAL_CACHE_READ_RETRIES
+    // and reads under the writer's lock instead of spinning
+    stall_writer(SIGNAL_BRAKE_PRESSURE);
+    zassert_equal(signal_cache_read(SIGNAL_BRAKE_PRESSURE, &sample), 0, "Read failed");
+    zassert_equal(sample.value, 1500.0f, "Lock fallback value");
+    zassert_equal(sample.update_count, 1, "Lock fallback update count");
+    release_writer(SIGNAL_BRAKE_PRESSURE);
+
+    // Other entries are not affected by a stalled one
+    signal_cache_update(SIGNAL_TPMS_PRESSURE, 230.0f);
+    stall_writer(SIGNAL_BRAKE_PRESSURE);
+    zassert_equal(signal_cache_read(SIGNAL_TPMS_PRESSURE, &sample), 0, "Read failed");
+    zassert_equal(sample.value, 230.0f, "Wrong entry");
+    release_writer(SIGNAL_BRAKE_PRESSURE);
+
+    zassert_equal(signal_cache_read(SIGNAL_BRAKE_PRESSURE, &sample), 0, "Read failed");
+    zassert_equal(sample.value, 1500.0f, "Value after the writer finished");
+}
+
+ZTEST(signal_cache_tests, test_location_pair)
+{
+    struct vehicle_location location;
+
+    signal_cache_update(SIGNAL_GPS_LATITUDE, 48.1f);
+    signal_cache_update(SIGNAL_GPS_LONGITUDE, 11.5f);
+    location = get_current_location();
+    zassert_equal(location.latitude, 48.1f, "Latitude");
+    zassert_equal(location.longitude, 11.5f, "Longitude");
+
+    // A pair that never completes is returned after the retries, with the
+    // latitude of the newer frame
+    signal_cache_update(SIGNAL_GPS_LATITUDE, 48.2f);
+    location = get_current_location();
+    zassert_equal(location.latitude, 48.2f, "Newer latitude");
+    zassert_equal(location.longitude, 11.5f, "Older longitude");
+}
@@ -0,0 +1,48 @@
+#include <zephyr/ztest.h>
+#include <zephyr/sys/byteorder.h>
+#include "signal_codec.h"
+
+ZTEST_SUITE(signal_codec_tests, NULL, NULL, NULL, NULL, NULL);
+
+ZTEST(signal_codec_tests, test_temp_signed_round_trip)
+{
+    struct sig_temp msg = { .temperature = -1234 };
+    struct sig_temp out;
+    uint8_t data[SIG_TEMP_LEN];
+    float value;
+
+    sig_temp_pack(data, &msg);
+    zassert_equal(data[0], 0xFB, "MSB mismatch");
+    zassert_equal(data[1], 0x2E, "LSB mismatch");
+
+    sig_temp_unpack(data, &out);
+    zassert_equal(out.temperature, -1234, "Raw value mismatch");
+
+    zassert_equal(sig_temp_decode(data, &value), 1, "Unexpected signal count");
+    zassert_within(value, -12.34f, 0.001f, "Physical value mismatch");
+}
+
+ZTEST(signal_codec_tests, test_gps_big_endian_layout)
+{
+    struct sig_gps msg = {
+        .latitude = sig_gps_latitude_from_phys(48.1351f),
+        .longitude = sig_gps_longitude_from_phys(-11.582f),
+    };
+    uint8_t data[SIG_GPS_LEN];
+    float values[SIG_GPS_NUM_SIGNALS];
+
+    sig_gps_pack(data, &msg);
+    zassert_equal(sys_get_be32(&data[0]), (uint32_t)msg.latitude, "Latitude layout");
+    zassert_equal(sys_get_be32(&data[4]), (uint32_t)msg.longitude, "Longitude layout");
+
+    zassert_equal(sig_gps_decode(data, values), 2, "Unexpected signal count");
+    zassert_within(values[0], 48.1351f, 0.0001f, "Latitude mismatch");
+    zassert_within(values[1], -11.582f, 0.0001f, "Longitude mismatch");
+}
+
+ZTEST(signal_codec_tests, test_from_phys_clamps)
+{
+    zassert_equal(sig_temp_temperature_from_phys(300.0f), 12500, "Max not clamped");
+    zassert_equal(sig_temp_temperature_from_phys(-300.0f), -5500, "Min not clamped");
+    zassert_equal(sig_battery_voltage_from_phys(12.6f), 12600, "Scaling mismatch");
+}
@@ -0,0 +1,112 @@
+#include <zephyr/ztest.h>
+#include "telemetry_policy.h"
+
+// Speed: 1.0 deadband, 200 ms min interval, 5 s heartbeat
+#define SPEED_INTERVAL_MS   200
+#define SPEED_SILENCE_MS    5000
+
+static bool publish(signal_cache_id_t id, float value) {
+    return telemetry_should_publish(id, &value, 1);
+}
+
+static void telemetry_before(void *fixture) {
+    telemetry_policy_init();
+}
+
+ZTEST_SUITE(telemetry_policy_tests, NULL, NULL, telemetry_before, NULL, NULL);
+
+ZTEST(telemetry_policy_tests, test_first_sample)
+{
+    struct telemetry_stats st;
+
+    zassert_true(publish(SIGNAL_VEHICLE_SPEED, 50.0f), "First sample suppressed");
+    telemetry_get_stats(SIGNAL_VEHICLE_SPEED, &st);
+    zassert_equal(st.sent, 1, "Not counted as sent");
+    zassert_equal(st.suppressed, 0, "Counted as suppressed");
+}
+
+ZTEST(telemetry_policy_tests, test_min_interval)
+{
+    struct telemetry_stats st;
+
+    zassert_true(publish(SIGNAL_VEHICLE_SPEED, 50.0f), "First sample suppressed");
+
+    // A large change still waits for the interval
+    zassert_false(publish(SIGNAL_VEHICLE_SPEED, 80.0f), "Sent within min interval");
+    k_msleep(SPEED_INTERVAL_MS);
+    zassert_true(publish(SIGNAL_VEHICLE_SPEED, 80.0f), "Change suppressed after interval");
+
+    telemetry_get_stats(SIGNAL_VEHICLE_SPEED, &st);
+    zassert_equal(st.sent, 2, "Sent count");
+    zassert_equal(st.suppressed, 1, "Suppressed count");
+}
+
+ZTEST(telemetry_policy_tests, test_deadband)
+{
+    zassert_true(publish(SIGNAL_VEHICLE_SPEED, 50.0f), "First sample suppressed");
+    k_msleep(SPEED_INTERVAL_MS);
+
+    zassert_false(publish(SIGNAL_VEHICLE_SPEED, 50.8f), "Sent inside deadband");
+    zassert_true(publish(SIGNAL_VEHICLE_SPEED, 51.5f), "Suppressed outside deadband");
+
+    // The deadband follows the last published value, not the last sample
+    k_msleep(SPEED_INTERVAL_MS);
+    zassert_false(publish(SIGNAL_VEHICLE_SPEED, 52.2f), "Sent inside moved deadband");
+}
+
+ZTEST(telemetry_policy_tests, test_relative_deadband)
+{
+    // Brake: 20 absolute or 2 % of the last value, whichever is larger
+    zassert_true(publish(SIGNAL_BRAKE_PRESSURE, 2000.0f), "First sample suppressed");
+    k_msleep(SPEED_INTERVAL_MS);
+
+    zassert_false(publish(SIGNAL_BRAKE_PRESSURE, 2030.0f), "Sent inside 2 %");
+    zassert_true(publish(SIGNAL_BRAKE_PRESSURE, 2050.0f), "Suppressed outside 2 %");
+}
+
+ZTEST(telemetry_policy_tests, test_heartbeat)
+{
+    struct telemetry_stats st;
+
+    zassert_true(publish(SIGNAL_VEHICLE_SPEED, 50.0f), "First sample suppressed");
+    k_msleep(SPEED_SILENCE_MS / 2);
+    zassert_false(publish(SIGNAL_VEHICLE_SPEED, 50.0f), "Unchanged value sent");
+    k_msleep(SPEED_SILENCE_MS / 2);
+    zassert_true(publish(SIGNAL_VEHICLE_SPEED, 50.0f), "No heartbeat");
+
+    telemetry_get_stats(SIGNAL_VEHICLE_SPEED, &st);
+    zassert_equal(st.sent, 2, "Sent count");
+    zassert_equal(st.suppressed, 1, "Suppressed count");
+    zassert_equal(st.heartbeats, 1, "Heartbeat count");
+
+    // The heartbeat restarts the silence interval
+    k_msleep(SPEED_INTERVAL_MS);
+    zassert_false(publish(SIGNAL_VEHICLE_SPEED, 50.0f), "Heartbeat repeated");
+}
+
+ZTEST(telemetry_policy_tests, test_multi_signal_topic)
+{
+    float pos[2] = {48.13510f, 11.58200f};
+    struct telemetry_stats st;
+
+    zassert_true(telemetry_should_publish(SIGNAL_GPS_LATITUDE, pos, 2), "First fix suppressed");
+    k_msleep(1000);
+
+    // Any signal of the topic leaving its deadband publishes the topic
+    pos[1] += 0.0001f;
+    zassert_true(telemetry_should_publish(SIGNAL_GPS_LATITUDE, pos, 2), "Longitude ignored");
+
+    telemetry_get_stats(SIGNAL_GPS_LATITUDE, &st);
+    zassert_equal(st.sent, 2, "Not counted on the first signal");
+    telemetry_get_stats(SIGNAL_GPS_LONGITUDE, &st);
+    zassert_equal(st.sent, 0, "Counted on the second signal");
+}
+
+ZTEST(telemetry_policy_tests, test_out_of_range)
+{
+    float values[2] = {0};
+
+    // Unknown topics are never held back
+    zassert_true(telemetry_should_publish(SIGNAL_VEHICLE_SPEED, values, 2), "Suppressed");
+    zassert_true(telemetry_should_publish(SIGNAL_VEHICLE_SPEED, values, 2), "Suppressed");
+}
@@ -0,0 +1,39 @@
+// Host side of the replay tool, linked into the native simulator runner so
+// it can use the host C library.
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+int replay_host_load(const char *path, uint8_t **image, size_t *len) {
+    FILE *f = fopen(path, "rb");
+    long size;
+
+    if (f == NULL) {
+        return -1;
+    }
+
+    if (fseek(f, 0, SEEK_END) != 0 || (size = ftell(f)) <= 0) {
+        fclose(f);
+        return -1;
+    }
+    rewind(f);
+
+    *image = malloc(size);
+    if (*image == NULL || fread(*image, 1, size, f) != (size_t)size) {
+        free(*image);
+        fclose(f);
+        return -1;
+    }
+
+    fclose(f);
+    *len = size;
+    return 0;
+}
+
+uint64_t replay_host_time_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
@@ -0,0 +1,227 @@
+#include <zephyr/kernel.h>
+#include <zephyr/drivers/can.h>
+#include <zephyr/sys/byteorder.h>
+#include "cmdline.h"
+#include "posix_native_task.h"
+#include "posix_board_if.h"
+#include "can_ids.h"
+#include "can_capture.h"
+#include "can_rx_pipeline.h"
+#include "can_handler.h"
+#include "can_filters.h"
+#include "diag_transport.h"
+#include "signal_cache.h"
+#include "telemetry_policy.h"
+#include "latency_trace.h"
+#include "replay.h"
+
+// Replays a CAN capture through the VCU receive path on native_sim.
+//
+//   zephyr.exe --capture=can.bin [--speed=N] [--cost-us=N]
+//
+// Frames are pushed into the RX pipeline at their recorded time divided by
+// speed, or back to back with speed 0. Host processing time of each frame is
+// charged to simulated time (or a fixed --cost-us for deterministic runs), so
+// a slow consumer backs up the RX ring and drops frames like on target.
+
+#define HIST_BUCKETS 32
+
+struct replay_hist {
+    uint32_t count;
+    uint64_t sum_ns;
+    uint64_t max_ns;
+    uint32_t buckets[HIST_BUCKETS];
+};
+
+struct replay_counts {
+    uint32_t sensor;
+    uint32_t j1939;
+    uint32_t isotp;
+    uint32_t filtered;
+};
+
+struct replay_output_counts replay_outputs;
+
+static char *capture_path;
+static uint32_t speed = 1;
+static uint32_t cost_us;
+
+static struct replay_hist proc_hist;
+static struct replay_counts counts;
+
+static uint32_t prev_ts_us;
+static uint64_t elapsed_us;
+static uint64_t start_sim_us;
+static bool started;
+
+static void replay_add_options(void) {
+    static struct args_struct_t opts[] = {
+        { .option = "capture", .name = "file", .type = 's',
+          .dest = (void *)&capture_path, .descript = "CAN capture image to replay" },
+        { .option = "speed", .name = "factor", .type = 'u',
+          .dest = (void *)&speed, .descript = "Replay speed factor, 0 = as fast as possible" },
+        { .option = "cost-us", .name = "us", .type = 'u',
+          .dest = (void *)&cost_us,
+          .descript = "Fixed per-frame processing cost instead of measured host time" },
+        ARG_TABLE_ENDMARKER
+    };
+
+    native_add_command_line_opts(opts);
+}
+NATIVE_TASK(replay_add_options, PRE_BOOT_1, 1);
+
+static void hist_record(struct replay_hist *hist, uint64_t ns) {
+    uint8_t index = ns == 0 ? 0 : 64 - __builtin_clzll(ns);
+
+    hist->count++;
+    hist->sum_ns += ns;
+    hist->max_ns = MAX(hist->max_ns, ns);
+    hist->buckets[MIN(index, HIST_BUCKETS - 1)]++;
+}
+
+static uint64_t hist_percentile_ns(const struct replay_hist *hist, uint8_t percent) {
+    uint64_t target = ((uint64_t)hist->count * percent + 99) / 100;
+    uint64_t seen = 0;
+
+    for (int i = 0; i < HIST_BUCKETS - 1; i++) {
+        seen += hist->buckets[i];
+        if (seen >= target) {
+            return MIN(BIT64(i), hist->max_ns);
+        }
+    }
+    return hist->max_ns;
+}
+
+static bool is_isotp_id(uint32_t id) {
+    return id == CAN_ID_DIAG_FUNCTIONAL || id == CAN_ID_DIAG_VCU_REQ ||
+           (id & CAN_ID_DIAG_RESP_MASK) == CAN_ID_DIAG_VCU_RESP;
+}
+
+// Runs on the CAN RX pipeline thread in place of the VCU consumer
+static void replay_consumer(const struct can_frame *frame, uint32_t rx_us) {
+    uint64_t start = replay_host_time_ns();
+    uint64_t ns;
+
+    if (!vcu_can_filters_check(frame)) {
+        counts.filtered++;
+    } else {
+        // can_handler() hands extended frames to the VCU J1939 node
+        if (frame->flags & CAN_FRAME_IDE) {
+            counts.j1939++;
+        } else if (is_isotp_id(frame->id)) {
+            counts.isotp++;
+        } else {
+            counts.sensor++;
+        }
+        can_handler(frame, rx_us);
+    }
+
+    ns = replay_host_time_ns() - start;
+    hist_record(&proc_hist, ns);
+
+    // Charge the processing time to simulated time
+    k_busy_wait(cost_us ? cost_us : (uint32_t)(ns / 1000));
+}
+
+static void replay_frame(const struct can_frame *frame, uint32_t ts_us, void *user_data) {
+    struct can_frame copy = *frame;
+
+    if (!started) {
+        started = true;
+        prev_ts_us = ts_us;
+        start_sim_us = k_ticks_to_us_floor64(k_uptime_ticks());
+    }
+
+    elapsed_us += ts_us - prev_ts_us;
+    prev_ts_us = ts_us;
+
+    if (speed > 0) {
+        uint64_t due = start_sim_us + elapsed_us / speed;
+        uint64_t now = k_ticks_to_us_floor64(k_uptime_ticks());
+
+        if (due > now) {
+            k_usleep(due - now);
+        }
+    }
+
+    can_rx_pipeline_isr(NULL, &copy, NULL);
+}
+
+static void print_report(const uint8_t *image, int total, uint64_t wall_ns) {
+    struct can_rx_stats rx;
+    uint64_t sim_us = k_ticks_to_us_floor64(k_uptime_ticks()) - start_sim_us;
+
+    can_rx_pipeline_get_stats(&rx);
+
+    printk("\nReplayed %d frames from %s at speed %u\n", total, capture_path, speed);
+    printk("  lost by recorder  %u\n", sys_get_le32(&image[12]));
+    printk("  capture span      %llu us, simulated %llu us\n", elapsed_us, sim_us);
+    printk("  processed         %u (sensor %u, j1939 %u, isotp %u, filtered %u)\n",
+           rx.processed, counts.sensor, counts.j1939, counts.isotp, counts.filtered);
+    printk("  dropped           %u (ring high water %u/%u)\n",
+           rx.overflows, rx.high_water, CAN_RX_RING_SIZE);
+    printk("  outputs           mqtt %u, v2v %u, uds %u\n",
+           replay_outputs.mqtt_published, replay_outputs.v2v_sent,
+           replay_outputs.uds_requests);
+    printk("  per frame         avg %llu ns, p50 <= %llu ns, p99 <= %llu ns, max %llu ns\n",
+           proc_hist.count ? proc_hist.sum_ns / proc_hist.count : 0,
+           hist_percentile_ns(&proc_hist, 50), hist_percentile_ns(&proc_hist, 99),
+           proc_hist.max_ns);
+    printk("  throughput        %llu frames/s processing, %llu frames/s wall\n",
+           proc_hist.sum_ns ? (uint64_t)proc_hist.count * 1000000000ULL / proc_hist.sum_ns : 0,
+           wall_ns ? (uint64_t)rx.processed * 1000000000ULL / wall_ns : 0);
+}
+
+int main(void) {
+    const struct device *can_dev = DEVICE_DT_GET(DT_CHOSEN(zephyr_canbus));
+    struct can_rx_stats rx;
+    uint8_t *image;
+    size_t len;
+    uint64_t wall_start;
+    int total;
+
+    if (capture_path == NULL) {
+        printk("usage: --capture=<file> [--speed=<factor>] [--cost-us=<us>]\n");
+        posix_exit(1);
+    }
+
+    if (replay_host_load(capture_path, &image, &len) != 0) {
+        printk("Cannot read %s\n", capture_path);
+        posix_exit(1);
+    }
+
+    signal_cache_init();
+    telemetry_policy_init();
+    latency_trace_init();
+
+    // UDS responses and flow control go out on the loopback controller
+    diag_transport_init(can_dev);
+
+    // Installs the same filter plan as the VCU, frames are pushed directly
+    // into the pipeline so the loopback controller never delivers any
+    can_rx_pipeline_init(replay_consumer);
+    if (vcu_can_filters_init(can_dev, can_rx_pipeline_isr) != 0) {
+        posix_exit(1);
+    }
+
+    // Back to back replay: let every push drain before the next one
+    if (speed == 0) {
+        k_thread_priority_set(k_current_get(), CAN_RX_PRIORITY + 1);
+    }
+
+    wall_start = replay_host_time_ns();
+    total = can_capture_parse(image, len, replay_frame, NULL);
+    if (total < 0) {
+        printk("Invalid capture %s: %d\n", capture_path, total);
+        posix_exit(1);
+    }
+
+    do {
+        k_sleep(K_MSEC(1));
+        can_rx_pipeline_get_stats(&rx);
+    } while (rx.processed + rx.overflows < rx.received);
+
+    print_report(image, total, replay_host_time_ns() - wall_start);
+    posix_exit(0);
+    return 0;
+}
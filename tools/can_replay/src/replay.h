@@ -0,0 +1,18 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <zephyr/kernel.h>
+
+struct replay_output_counts {
+    uint32_t mqtt_published;
+    uint32_t v2v_sent;
+    uint32_t uds_requests;
+};
+
+extern struct replay_output_counts replay_outputs;
+
+// Provided by src/host_io.c on the host side of native_sim
+int replay_host_load(const char *path, uint8_t **image, size_t *len);
+uint64_t replay_host_time_ns(void);
+
+#endif /* REPLAY_H */
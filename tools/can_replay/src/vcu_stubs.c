@@ -0,0 +1,30 @@
+#include <zephyr/kernel.h>
+#include "mqtt_handler.h"
+#include "v2x_handler.h"
+#include "diag_service.h"
+#include "replay.h"
+
+// Outputs of the VCU data path are counted instead of sent
+
+void publish_sensor_data(const char *topic, float value) {
+    replay_outputs.mqtt_published++;
+}
+
+void publish_gps_data(const char *topic, float lat, float lon) {
+    replay_outputs.mqtt_published++;
+}
+
+int broadcast_v2v_data(uint8_t type, const uint8_t *data, uint16_t len) {
+    replay_outputs.v2v_sent++;
+    return 0;
+}
+
+int process_diagnostic_request_frags(const struct net_buf *frags, size_t len) {
+    replay_outputs.uds_requests++;
+    return DIAG_RESP_OK;
+}
+
+// Latency DIDs when CONFIG_CAN_LATENCY_TRACE is enabled
+int update_diagnostic_data(uint16_t did, const void *data, uint16_t len) {
+    return 0;
+}
@@ -0,0 +1,12 @@
+// Host side of the benchmarks, linked into the native simulator runner.
+// Simulated time does not advance while code runs, CPU cost is measured
+// on the host clock.
+#include <time.h>
+#include "host_clock.h"
+
+uint64_t bench_host_time_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
@@ -0,0 +1,11 @@
+#ifndef HOST_CLOCK_H
+#define HOST_CLOCK_H
+
+#include <stdint.h>
+
+// Monotonic host time in ns. Provided by host_clock.c, which the bench
+// links into the native_sim runner, since simulated time stands still
+// while code runs.
+uint64_t bench_host_time_ns(void);
+
+#endif /* HOST_CLOCK_H */
@@ -0,0 +1,169 @@
+#include <zephyr/kernel.h>
+#include <zephyr/drivers/can.h>
+#include <string.h>
+#include "posix_board_if.h"
+#include "can_ids.h"
+#include "isotp.h"
+
+// ISO-TP throughput for a 4 KB diagnostic payload over the loopback
+// controller, for a range of receiver flow control settings and classic
+// or CAN FD frames.
+//
+// Frames cross the loopback in zero simulated time, so the measured time is
+// the protocol pacing (STmin, flow control round trips). Bus time at
+// BENCH_BITRATE is added per frame, as the STmin timer only starts once a
+// frame has been sent.
+
+#define BENCH_PAYLOAD_LEN   4095
+#define BENCH_BITRATE       500000
+#define BENCH_DATA_BITRATE  2000000
+#define BENCH_RUNS          3
+
+// Classic frame with 11-bit ID incl. interframe space, without stuffing
+#define FRAME_BITS(len)     (47 + 8 * (len))
+#define FRAME_US(len)       (FRAME_BITS(len) * 1000000ULL / BENCH_BITRATE)
+
+// FD frame with bit rate switch: arbitration and end of frame at the
+// nominal rate, DLC, data and CRC (17 or 21 bits plus stuff count) at the
+// data rate
+#define FD_NOMINAL_BITS     (29 + 14)
+#define FD_DATA_BITS(len)   (5 + 8 * (len) + ((len) > 16 ? 26 : 22))
+#define FD_FRAME_US(len)    (FD_NOMINAL_BITS * 1000000ULL / BENCH_BITRATE + \
+                             FD_DATA_BITS(len) * 1000000ULL / BENCH_DATA_BITRATE)
+
+static const struct {
+    const char *name;
+    uint8_t bs;
+    uint8_t stmin;
+    uint8_t tx_dl;
+} settings[] = {
+    { "legacy (10 ms per CF)",  0,  10,   8 },
+    { "BS 8, STmin 10 ms",      8,  10,   8 },
+    { "BS 8, STmin 1 ms",       8,  1,    8 },
+    { "BS 8, STmin 500 us",     8,  0xF5, 8 },
+    { "BS 8, STmin 100 us",     8,  0xF1, 8 },
+    { "BS 8, STmin 0",          8,  0,    8 },
+    { "BS 0, STmin 0",          0,  0,    8 },
+    { "FD, BS 8, STmin 1 ms",   8,  1,    64 },
+    { "FD, BS 0, STmin 0",      0,  0,    64 },
+};
+
+static uint8_t payload[BENCH_PAYLOAD_LEN];
+static uint8_t server_buf[BENCH_PAYLOAD_LEN];
+
+static K_SEM_DEFINE(rx_done, 0, 1);
+static int rx_result;
+
+static void server_rx(struct isotp_ctx *ctx, const uint8_t *data, int len, void *user_data) {
+    rx_result = len;
+    if (len == BENCH_PAYLOAD_LEN && memcmp(data, payload, len) != 0) {
+        rx_result = -EBADMSG;
+    }
+    k_sem_give(&rx_done);
+}
+
+static struct isotp_ctx client = {
+    .rx_id = CAN_ID_DIAG_VCU_RESP,
+    .tx_id = CAN_ID_DIAG_VCU_REQ,
+};
+
+static struct isotp_ctx server = {
+    .rx_id = CAN_ID_DIAG_VCU_REQ,
+    .tx_id = CAN_ID_DIAG_VCU_RESP,
+    .buf = server_buf,
+    .buf_size = sizeof(server_buf),
+    .rx_cb = server_rx,
+};
+
+static uint64_t frame_us(uint8_t len, uint8_t tx_dl) {
+    if (tx_dl > ISOTP_CLASSIC_DL) {
+        return FD_FRAME_US(can_dlc_to_bytes(can_bytes_to_dlc(len)));
+    }
+    return FRAME_US(len);
+}
+
+// Bus time of one transfer: FF, CFs and the receiver's flow control frames
+static uint64_t bus_time_us(size_t len, uint8_t bs, uint8_t tx_dl) {
+    uint32_t ff_len = tx_dl - 2;
+    uint32_t cfs = DIV_ROUND_UP(len - ff_len, tx_dl - 1);
+    uint32_t last_len = len - ff_len - (cfs - 1) * (tx_dl - 1);
+    uint32_t fcs = bs ? DIV_ROUND_UP(cfs, bs) : 1;
+
+    return frame_us(tx_dl, tx_dl) + (cfs - 1) * frame_us(tx_dl, tx_dl) +
+           frame_us(last_len + 1, tx_dl) + fcs * frame_us(3, tx_dl);
+}
+
+static int run_transfer(uint64_t *pacing_us) {
+    int64_t start = k_uptime_ticks();
+    int ret;
+
+    k_sem_reset(&rx_done);
+    ret = isotp_send(&client, payload, sizeof(payload));
+    if (ret != 0) {
+        return ret;
+    }
+    if (k_sem_take(&rx_done, K_SECONDS(30)) != 0) {
+        return -ETIMEDOUT;
+    }
+    if (rx_result < 0) {
+        return rx_result;
+    }
+
+    *pacing_us = k_ticks_to_us_ceil64(k_uptime_ticks() - start);
+    return 0;
+}
+
+int main(void) {
+    const struct device *can_dev = DEVICE_DT_GET(DT_CHOSEN(zephyr_canbus));
+    uint64_t legacy_us = 0;
+
+    for (int i = 0; i < sizeof(payload); i++) {
+        payload[i] = i * 31;
+    }
+
+    client.can_dev = can_dev;
+    server.can_dev = can_dev;
+    if (can_set_mode(can_dev, CAN_MODE_LOOPBACK | CAN_MODE_FD) != 0 || can_start(can_dev) != 0 ||
+        isotp_init(&client) != 0 || isotp_init(&server) != 0) {
+        printk("CAN loopback setup failed\n");
+        posix_exit(1);
+    }
+
+    printk("ISO-TP %u byte transfer at %u bit/s\n", BENCH_PAYLOAD_LEN, BENCH_BITRATE);
+    printk("%-24s %10s %10s %10s %10s %8s\n", "receiver FC", "pacing ms", "bus ms",
+           "total ms", "B/s", "speedup");
+
+    for (int s = 0; s < ARRAY_SIZE(settings); s++) {
+        uint64_t pacing_us = 0;
+        uint64_t bus_us = bus_time_us(BENCH_PAYLOAD_LEN, settings[s].bs, settings[s].tx_dl);
+        uint64_t total_us;
+        int ret = 0;
+
+        server.rx_bs = settings[s].bs;
+        server.rx_stmin = settings[s].stmin;
+        client.tx_dl = settings[s].tx_dl;
+        server.tx_dl = settings[s].tx_dl;
+
+        // Simulated time is deterministic, repeat only to catch flakiness
+        for (int run = 0; run < BENCH_RUNS && ret == 0; run++) {
+            ret = run_transfer(&pacing_us);
+        }
+        if (ret != 0) {
+            printk("%-24s failed: %d\n", settings[s].name, ret);
+            continue;
+        }
+
+        total_us = pacing_us + bus_us;
+        if (s == 0) {
+            legacy_us = total_us;
+        }
+
+        printk("%-24s %10llu %10llu %10llu %10llu %7llux\n", settings[s].name,
+               pacing_us / 1000, bus_us / 1000,
+               total_us / 1000, BENCH_PAYLOAD_LEN * 1000000ULL / total_us,
+               legacy_us / total_us);
+    }
+
+    posix_exit(0);
+    return 0;
+}
@@ -0,0 +1,22 @@
+#ifndef J1939_BENCH_H
+#define J1939_BENCH_H
+
+#include <zephyr/device.h>
+#include <stdint.h>
+#include "host_clock.h"
+
+struct j1939_ctx;
+
+#define BENCH_BITRATE       500000
+
+// Classic frame with 29-bit ID incl. interframe space, without stuffing
+#define FRAME_BITS(len)     (67 + 8 * (len))
+#define FRAME_US(len)       (FRAME_BITS(len) * 1000000ULL / BENCH_BITRATE)
+
+// PGN dispatch cost per frame, needs free handler slots
+void dispatch_bench_run(const struct device *can_dev);
+
+// ETP throughput between two initialized contexts on the loopback bus
+void etp_bench_run(struct j1939_ctx *sender, struct j1939_ctx *receiver);
+
+#endif /* J1939_BENCH_H */
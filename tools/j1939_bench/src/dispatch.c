@@ -0,0 +1,104 @@
+#include <zephyr/kernel.h>
+#include <zephyr/drivers/can.h>
+#include "bench.h"
+#include "j1939.h"
+
+// Cost of handing a single frame to its PGN handlers with the handler
+// table full, against the former dispatch: a linear scan of the
+// registrations that stopped at the first match.
+
+#define DISPATCH_FRAMES     1000000
+#define DISPATCH_PGN_BASE   0xFF00      // Proprietary B, PDU2
+#define DISPATCH_PGN_NONE   0xFEFF      // Never registered
+#define DISPATCH_SA         0x42
+
+struct legacy_handler {
+    uint32_t pgn;
+    j1939_pgn_handler_t handler;
+};
+
+static struct legacy_handler legacy[J1939_MAX_PGN_HANDLERS];
+static int num_legacy;
+static volatile uint32_t hits;
+
+static struct j1939_ctx dispatch_ctx = {
+    .source_address = 0x80,
+    .dest_address = J1939_ADDR_GLOBAL,
+    .manual_rx = true,
+};
+
+static void count_handler(struct j1939_ctx *ctx, const uint8_t *data, uint16_t len) {
+    hits++;
+}
+
+J1939_PGN_HANDLER_DEFINE(dispatch_static_handler, DISPATCH_PGN_BASE, J1939_ADDR_GLOBAL,
+                         count_handler);
+
+// The replaced dispatch, with the same ID decoding as j1939_process_message()
+static void legacy_process(struct j1939_ctx *ctx, struct can_frame *frame) {
+    uint32_t pgn = (frame->id >> 8) & 0x3FFFF;
+
+    if (((pgn >> 8) & 0xFF) < 0xF0) {
+        if ((pgn & 0xFF) != ctx->source_address && (pgn & 0xFF) != J1939_ADDR_GLOBAL) {
+            return;
+        }
+        pgn &= 0x3FF00;
+    }
+    for (int i = 0; i < num_legacy; i++) {
+        if (legacy[i].pgn == pgn) {
+            legacy[i].handler(ctx, frame->data, frame->dlc);
+            break;
+        }
+    }
+}
+
+static uint64_t time_per_frame(void (*process)(struct j1939_ctx *, struct can_frame *),
+                               uint32_t pgn) {
+    struct can_frame frame = {
+        .id = (J1939_PRIORITY_LOW << 26) | (pgn << 8) | DISPATCH_SA,
+        .dlc = 8,
+        .flags = CAN_FRAME_IDE,
+    };
+    uint64_t start = bench_host_time_ns();
+
+    for (int i = 0; i < DISPATCH_FRAMES; i++) {
+        process(&dispatch_ctx, &frame);
+    }
+    return (bench_host_time_ns() - start) * 1000 / DISPATCH_FRAMES;
+}
+
+void dispatch_bench_run(const struct device *can_dev) {
+    uint32_t pgn = DISPATCH_PGN_BASE;
+    struct {
+        const char *name;
+        uint32_t pgn;
+    } cases[] = {
+        { "first registered", DISPATCH_PGN_BASE },
+        { "last registered", 0 },
+        { "no handler", DISPATCH_PGN_NONE },
+    };
+
+    // Fill the table, the legacy scan sees the handlers in the same order
+    legacy[num_legacy++] = (struct legacy_handler){ DISPATCH_PGN_BASE, count_handler };
+    while (j1939_register_pgn_handler(++pgn, count_handler) == 0) {
+        legacy[num_legacy++] = (struct legacy_handler){ pgn, count_handler };
+    }
+    cases[1].pgn = pgn - 1;
+
+    dispatch_ctx.can_dev = can_dev;
+    if (j1939_init(&dispatch_ctx) != 0) {
+        printk("Dispatch context init failed\n");
+        return;
+    }
+
+    printk("\nPGN dispatch, %d handlers, ns per frame on the host CPU\n",
+           J1939_MAX_PGN_HANDLERS);
+    printk("%-24s %10s %10s\n", "PGN", "index", "linear");
+    for (int c = 0; c < ARRAY_SIZE(cases); c++) {
+        uint64_t index_ps = time_per_frame(j1939_process_message, cases[c].pgn);
+        uint64_t linear_ps = time_per_frame(legacy_process, cases[c].pgn);
+
+        printk("%-24s %6llu.%03llu %6llu.%03llu\n", cases[c].name,
+               index_ps / 1000, index_ps % 1000, linear_ps / 1000, linear_ps % 1000);
+    }
+}
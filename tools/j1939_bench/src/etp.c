@@ -0,0 +1,133 @@
+#include <zephyr/kernel.h>
+#include "bench.h"
+#include "j1939_etp.h"
+
+// J1939 ETP throughput for a 256 KiB message streamed through the packet
+// callbacks, for a range of receiver CTS windows. Neither side holds the
+// message: the producer generates it and the consumer checks it in place.
+//
+// As for RTS/CTS, the measured simulated time is the protocol pacing and
+// bus time at BENCH_BITRATE is added per frame. The bus limit row is the
+// payload rate with no protocol overhead at all.
+
+#define ETP_SIZE            (256 * 1024)
+#define ETP_PGN             0xEF00      // Proprietary A
+#define ETP_RUNS            3
+
+static const uint8_t windows[] = { 16, 64, J1939_ETP_WINDOW_MAX };
+
+static struct j1939_etp sender_etp;
+static struct j1939_etp receiver_etp;
+
+static K_SEM_DEFINE(etp_done, 0, 1);
+static uint32_t rx_bytes;
+static int rx_errors;
+static int tx_result;
+
+static uint8_t etp_pattern(uint32_t offset) {
+    return offset * 31 + (offset >> 9);
+}
+
+static int producer_read(struct j1939_ctx *ctx, uint32_t offset, uint8_t *buf, uint8_t len,
+                         void *user_data) {
+    for (int i = 0; i < len; i++) {
+        buf[i] = etp_pattern(offset + i);
+    }
+    return 0;
+}
+
+static void sender_done(struct j1939_ctx *ctx, int result, void *user_data) {
+    tx_result = result;
+    k_sem_give(&etp_done);
+}
+
+static int consumer_data(struct j1939_ctx *ctx, uint32_t offset, const uint8_t *data,
+                         uint8_t len, void *user_data) {
+    if (offset != rx_bytes) {
+        rx_errors++;
+    }
+    for (int i = 0; i < len; i++) {
+        if (data[i] != etp_pattern(offset + i)) {
+            rx_errors++;
+        }
+    }
+    rx_bytes += len;
+    return 0;
+}
+
+static const struct j1939_etp_consumer consumer = {
+    .data = consumer_data,
+};
+
+// RTS, per window a CTS, a DPO and the packets, then the EOMA
+static uint64_t etp_bus_us(uint8_t window) {
+    uint32_t packets = DIV_ROUND_UP(ETP_SIZE, J1939_TP_PACKET_SIZE);
+    uint32_t windows = DIV_ROUND_UP(packets, window);
+
+    return (packets + 2 * windows + 2) * FRAME_US(8);
+}
+
+static int etp_transfer(struct j1939_ctx *sender, struct j1939_ctx *receiver,
+                        uint64_t *pacing_us) {
+    int64_t start = k_uptime_ticks();
+    int ret;
+
+    rx_bytes = 0;
+    rx_errors = 0;
+    k_sem_reset(&etp_done);
+    ret = j1939_etp_send_async(sender, ETP_PGN, receiver->source_address, ETP_SIZE,
+                               producer_read, sender_done, NULL);
+    if (ret != 0) {
+        return ret;
+    }
+    if (k_sem_take(&etp_done, K_SECONDS(60)) != 0) {
+        return -ETIMEDOUT;
+    }
+    if (tx_result != 0) {
+        return tx_result;
+    }
+    if (rx_bytes != ETP_SIZE || rx_errors != 0) {
+        return -EBADMSG;
+    }
+
+    *pacing_us = k_ticks_to_us_ceil64(k_uptime_ticks() - start);
+    return 0;
+}
+
+void etp_bench_run(struct j1939_ctx *sender, struct j1939_ctx *receiver) {
+    uint64_t limit_us = DIV_ROUND_UP(ETP_SIZE, J1939_TP_PACKET_SIZE) * FRAME_US(8);
+
+    receiver_etp.consumer = &consumer;
+    if (j1939_etp_init(sender, &sender_etp) != 0 ||
+        j1939_etp_init(receiver, &receiver_etp) != 0) {
+        printk("ETP init failed\n");
+        return;
+    }
+
+    printk("\nJ1939 ETP %u byte streamed transfer, computed bus time at %u bit/s\n", ETP_SIZE,
+           BENCH_BITRATE);
+    printk("%-24s %10s %10s %10s %10s\n", "receiver CTS", "pacing ms", "bus ms",
+           "total ms", "B/s");
+    printk("%-24s %10s %10llu %10llu %10llu\n", "bus limit", "-", limit_us / 1000,
+           limit_us / 1000, ETP_SIZE * 1000000ULL / limit_us);
+
+    for (int w = 0; w < ARRAY_SIZE(windows); w++) {
+        uint64_t pacing_us = 0;
+        uint64_t bus_us = etp_bus_us(windows[w]);
+        uint64_t total_us;
+        int ret = 0;
+
+        receiver_etp.rx_window = windows[w];
+        for (int run = 0; run < ETP_RUNS && ret == 0; run++) {
+            ret = etp_transfer(sender, receiver, &pacing_us);
+        }
+        if (ret != 0) {
+            printk("window %-17u failed: %d\n", windows[w], ret);
+            continue;
+        }
+
+        total_us = pacing_us + bus_us;
+        printk("window %-17u %10llu %10llu %10llu %10llu\n", windows[w], pacing_us / 1000,
+               bus_us / 1000, total_us / 1000, ETP_SIZE * 1000000ULL / total_us);
+    }
+}
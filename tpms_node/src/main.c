@@ -3,6 +3,7 @@
 #include <zephyr/drivers/spi.h>
 #include "sensor_common.h"
 #include "can_ids.h"
+#include "signal_codec.h"
 
 #define SP370_CS_PIN  2
 #define SP370_SDO_PIN 3
@@ -13,6 +14,8 @@ static const struct device *can_dev;
 
 static void tpms_thread(void *arg1, void *arg2, void *arg3) {
     uint8_t pressure_data;
+    uint8_t can_data[TPMS_MSG_LEN];
+    struct sig_tpms msg;
     struct spi_buf rx_buf = { .buf = &pressure_data, .len = 1 };
     struct spi_buf_set rx = { .buffers = &rx_buf, .count = 1 };
 
@@ -20,7 +23,9 @@ static void tpms_thread(void *arg1, void *arg2, void *arg3) {
         // Read pressure from SP370 sensor
         if (spi_read(spi_dev, &rx) == 0) {
             // Send pressure data over CAN
-            send_sensor_data(can_dev, CAN_ID_TPMS, &pressure_data, TPMS_MSG_LEN);
+            msg.pressure = pressure_data;
+            sig_tpms_pack(can_data, &msg);
+            send_sensor_data(can_dev, CAN_ID_TPMS, can_data, TPMS_MSG_LEN);
         }
         k_sleep(K_MSEC(1000));
     }
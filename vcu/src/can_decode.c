@@ -0,0 +1,207 @@
+#include <zephyr/kernel.h>
+#include <string.h>
+#include "can_decode.h"
+#include "mqtt_handler.h"
+#include "v2x_handler.h"
+#include "telemetry_policy.h"
+#include "signal_codec.h"
+#include "can_time_sync.h"
+#include "latency_trace.h"
+#include "j1939_spn.h"
+
+#define COLLISION_CRITICAL_CM   100
+#define TEMP_MAINTENANCE_LIMIT  90.0f
+
+static struct can_decode_stats decode_stats;
+
+static void on_temperature(const struct can_frame *frame, const struct can_signal_value *val) {
+    if (val->value[0] > TEMP_MAINTENANCE_LIMIT) {
+        publish_sensor_data(TOPIC_PREDICTIVE_MAINTENANCE, val->value[0]);
+    }
+}
+
+static void on_collision(const struct can_frame *frame, const struct can_signal_value *val) {
+    uint16_t distance = (uint16_t)val->value[0];
+
+    if (distance < COLLISION_CRITICAL_CM) {
+        char hazard_msg[64];
+        snprintf(hazard_msg, sizeof(hazard_msg),
+                 "Critical: Collision warning at %d cm", distance);
+        publish_sensor_data(TOPIC_HAZARD_NOTIFICATION, distance);
+        broadcast_v2v_data(V2V_HAZARD_DATA, (uint8_t *)hazard_msg, strlen(hazard_msg));
+    }
+}
+
+// What the VCU does with each message of CAN_SENSOR_MSG_LIST: cache slot,
+// MQTT topic, V2V type, post-decode hook. A message added to can_ids.h
+// does not build until it has a line here.
+#define DECODE_POLICY_TEMP      SIGNAL_TEMPERATURE,        TOPIC_TEMPERATURE, V2V_NONE,       on_temperature
+#define DECODE_POLICY_GPS       SIGNAL_GPS_LATITUDE,       TOPIC_GPS,         V2V_GPS_DATA,   NULL
+#define DECODE_POLICY_COLLISION SIGNAL_COLLISION_DISTANCE, TOPIC_COLLISION,   V2V_NONE,       on_collision
+#define DECODE_POLICY_BATTERY   SIGNAL_BATTERY_VOLTAGE,    TOPIC_BATTERY,     V2V_NONE,       NULL
+#define DECODE_POLICY_BRAKE     SIGNAL_BRAKE_PRESSURE,     TOPIC_BRAKE,       V2V_BRAKE_DATA, NULL
+#define DECODE_POLICY_TPMS      SIGNAL_TPMS_PRESSURE,      TOPIC_TPMS,        V2V_NONE,       NULL
+#define DECODE_POLICY_SPEED     SIGNAL_VEHICLE_SPEED,      TOPIC_SPEED,       V2V_SPEED_DATA, NULL
+
+#define CAN_DECODE_POLICY(sig, tpc, v2v, hook)                \
+        .v2v_type = (v2v),                                    \
+        .signal = (sig),                                      \
+        .topic = (tpc),                                       \
+        .on_value = (hook),
+// Expands the policy line into its four arguments first
+#define CAN_DECODE_POLICY_OF(policy) CAN_DECODE_POLICY(policy)
+
+// ID, length and generated decoder come from can_ids.h and signals.sdb
+#define CAN_DECODE(name, _id, _len)                           \
+    [(_id) - CAN_DECODE_ID_BASE] = {                          \
+        .id = (_id),                                          \
+        .len = (_len),                                        \
+        .decode = SIG_##name##_DECODE,                        \
+        CAN_DECODE_POLICY_OF(DECODE_POLICY_##name)            \
+    },
+
+static const struct can_msg_desc decode_table[CAN_DECODE_ID_SPAN] = {
+    CAN_SENSOR_MSG_LIST(CAN_DECODE)
+};
+
+// J1939 PGNs from third-party ECUs, decoded by their SPN tables into the
+// cache slots of the native sensors. A value the ECU reports as not
+// available or in error updates nothing.
+static uint8_t j1939_et1_decode(const uint8_t *data, float *values) {
+    struct j1939_et1 et1;
+    struct j1939_spn_status status;
+
+    j1939_spn_decode(&j1939_spns_et1, data, J1939_SPN_PGN_LEN, &et1, &status);
+    values[0] = et1.coolant_temp;
+    return (status.valid & J1939_SPN_BIT(struct j1939_et1, coolant_temp)) ? 1 : 0;
+}
+
+static uint8_t j1939_ccvs_decode(const uint8_t *data, float *values) {
+    struct j1939_ccvs ccvs;
+    struct j1939_spn_status status;
+
+    j1939_spn_decode(&j1939_spns_ccvs, data, J1939_SPN_PGN_LEN, &ccvs, &status);
+    values[0] = ccvs.wheel_speed;
+    return (status.valid & J1939_SPN_BIT(struct j1939_ccvs, wheel_speed)) ? 1 : 0;
+}
+
+static uint8_t j1939_vp_decode(const uint8_t *data, float *values) {
+    const uint32_t both = J1939_SPN_BIT(struct j1939_vp, latitude) |
+                          J1939_SPN_BIT(struct j1939_vp, longitude);
+    struct j1939_vp vp;
+    struct j1939_spn_status status;
+
+    j1939_spn_decode(&j1939_spns_vp, data, J1939_SPN_PGN_LEN, &vp, &status);
+    values[0] = vp.latitude;
+    values[1] = vp.longitude;
+    return (status.valid & both) == both ? 2 : 0;
+}
+
+// V2V forwards native payloads only, J1939 values stay off it
+#define J1939_DECODE(_pgn, dec, sig, tpc, hook)                 \
+    {                                                           \
+        .id = (_pgn),                                           \
+        .len = J1939_SPN_PGN_LEN,                               \
+        .v2v_type = V2V_NONE,                                   \
+        .signal = (sig),                                        \
+        .topic = (tpc),                                         \
+        .decode = (dec),                                        \
+        .on_value = (hook),                                     \
+    }
+
+static const struct can_msg_desc j1939_decode_table[] = {
+    J1939_DECODE(J1939_PGN_ENGINE_TEMP,      j1939_et1_decode,  SIGNAL_TEMPERATURE,   TOPIC_TEMPERATURE, on_temperature),
+    J1939_DECODE(J1939_PGN_VEHICLE_SPEED,    j1939_ccvs_decode, SIGNAL_VEHICLE_SPEED, TOPIC_SPEED,       NULL),
+    J1939_DECODE(J1939_PGN_VEHICLE_POSITION, j1939_vp_decode,   SIGNAL_GPS_LATITUDE,  TOPIC_GPS,         NULL),
+};
+
+// Every message in can_ids.h must fit the dense table
+#define CAN_DECODE_RANGE_CHECK(name, id, len)                                   \
+    BUILD_ASSERT((id) >= CAN_DECODE_ID_BASE &&                                  \
+                 (id) < CAN_DECODE_ID_BASE + CAN_DECODE_ID_SPAN,                \
+                 #name " ID outside CAN decode table");                         \
+    BUILD_ASSERT((len) <= CAN_MAX_DLEN, #name " length exceeds CAN frame");     \
+    BUILD_ASSERT(SIG_##name##_NUM_SIGNALS <= CAN_DECODE_MAX_VALUES,             \
+                 #name " has more signals than a decode result holds");
+CAN_SENSOR_MSG_LIST(CAN_DECODE_RANGE_CHECK)
+
+const struct can_msg_desc *can_decode_lookup(uint32_t id) {
+    uint32_t index = id - CAN_DECODE_ID_BASE;
+
+    // Unsigned wrap also rejects IDs below the base
+    if (index >= CAN_DECODE_ID_SPAN || decode_table[index].decode == NULL) {
+        return NULL;
+    }
+    return &decode_table[index];
+}
+
+const struct can_msg_desc *can_decode_lookup_j1939(uint32_t pgn) {
+    for (int i = 0; i < ARRAY_SIZE(j1939_decode_table); i++) {
+        if (j1939_decode_table[i].id == pgn) {
+            return &j1939_decode_table[i];
+        }
+    }
+    return NULL;
+}
+
+int can_decode_dispatch(const struct can_frame *frame, uint32_t rx_us) {
+    const struct can_msg_desc *desc = (frame->flags & CAN_FRAME_IDE) ?
+        can_decode_lookup_j1939(j1939_id_to_pgn(frame->id)) : can_decode_lookup(frame->id);
+    struct can_signal_value val;
+    uint32_t sample_us;
+    bool has_sample;
+
+    if (desc == NULL) {
+        decode_stats.unknown_id++;
+        return -ENOENT;
+    }
+
+    if (can_dlc_to_bytes(frame->dlc) < desc->len) {
+        decode_stats.bad_length++;
+        return -EMSGSIZE;
+    }
+
+    has_sample = can_sample_ts_get(frame->data, can_dlc_to_bytes(frame->dlc), desc->len,
+                                   &sample_us);
+    latency_trace_begin(desc->signal, rx_us, has_sample ? &sample_us : NULL);
+
+    val.count = desc->decode(frame->data, val.value);
+    decode_stats.decoded++;
+    latency_trace_mark(LATENCY_RX_TO_DECODE);
+
+    // Nothing available in the frame
+    if (val.count == 0) {
+        return 0;
+    }
+
+    for (int i = 0; i < val.count; i++) {
+        signal_cache_update(desc->signal + i, val.value[i]);
+    }
+
+    // Deadband/rate policy is checked before any payload formatting
+    if (telemetry_should_publish(desc->signal, val.value, val.count)) {
+        latency_trace_mark(LATENCY_RX_TO_PUBLISH_QUEUED);
+        if (val.count == 2) {
+            publish_gps_data(desc->topic, val.value[0], val.value[1]);
+        } else {
+            publish_sensor_data(desc->topic, val.value[0]);
+        }
+        latency_trace_mark(LATENCY_RX_TO_PUBLISH_SENT);
+    }
+
+    // Forward the signal payload only, not the sample timestamp
+    if (desc->v2v_type != V2V_NONE) {
+        broadcast_v2v_data(desc->v2v_type, frame->data, desc->len);
+        latency_trace_mark(LATENCY_RX_TO_V2V);
+    }
+
+    if (desc->on_value) {
+        desc->on_value(frame, &val);
+    }
+
+    return 0;
+}
+
+void can_decode_get_stats(struct can_decode_stats *stats) {
+    memcpy(stats, &decode_stats, sizeof(decode_stats));
+}
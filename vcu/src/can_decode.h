@@ -0,0 +1,49 @@
+#ifndef CAN_DECODE_H
+#define CAN_DECODE_H
+
+#include <zephyr/kernel.h>
+#include <zephyr/drivers/can.h>
+#include "can_ids.h"
+#include "signal_cache.h"
+
+// Dense decode table covers IDs [BASE, BASE + SPAN)
+#define CAN_DECODE_ID_BASE    0x50
+#define CAN_DECODE_ID_SPAN    0x30
+
+#define CAN_DECODE_MAX_VALUES 2
+#define V2V_NONE              0x00
+
+struct can_signal_value {
+    float value[CAN_DECODE_MAX_VALUES];
+    uint8_t count;
+};
+
+struct can_msg_desc {
+    uint32_t id;
+    uint8_t len;
+    uint8_t v2v_type;
+    signal_cache_id_t signal;   // First cache slot, one per decoded value
+    const char *topic;
+    uint8_t (*decode)(const uint8_t *data, float *values);  // Generated sig_<msg>_decode()
+    void (*on_value)(const struct can_frame *frame, const struct can_signal_value *val);
+};
+
+struct can_decode_stats {
+    uint32_t decoded;
+    uint32_t unknown_id;
+    uint32_t bad_length;
+};
+
+// O(1) lookup, returns NULL for IDs without a registered decoder
+const struct can_msg_desc *can_decode_lookup(uint32_t id);
+
+// Descriptor of a J1939 PGN decoded into the same signals, or NULL
+const struct can_msg_desc *can_decode_lookup_j1939(uint32_t pgn);
+
+// Decode, publish and forward a frame according to its descriptor.
+// rx_us is the reception time used for latency tracing.
+int can_decode_dispatch(const struct can_frame *frame, uint32_t rx_us);
+
+void can_decode_get_stats(struct can_decode_stats *stats);
+
+#endif /* CAN_DECODE_H */
@@ -0,0 +1,50 @@
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include "can_filters.h"
+#include "can_ids.h"
+#include "j1939.h"
+
+LOG_MODULE_REGISTER(can_filters, CONFIG_CAN_FILTERS_LOG_LEVEL);
+
+#define SENSOR_FILTER(n, i, l) { .id = (i), .mask = CAN_STD_ID_MASK, .flags = CAN_FILTER_DATA },
+
+// Everything the VCU consumes: sensor messages,
+// UDS over ISO-TP (requests to the VCU, responses from the nodes) and J1939 PGNs
+static const struct can_filter vcu_wanted_ids[] = {
+    CAN_SENSOR_MSG_LIST(SENSOR_FILTER)
+    { .id = CAN_ID_DIAG_FUNCTIONAL, .mask = CAN_STD_ID_MASK, .flags = CAN_FILTER_DATA },
+    { .id = CAN_ID_DIAG_VCU_REQ, .mask = CAN_STD_ID_MASK, .flags = CAN_FILTER_DATA },
+    { .id = CAN_ID_DIAG_VCU_RESP, .mask = CAN_ID_DIAG_RESP_MASK, .flags = CAN_FILTER_DATA },
+    J1939_PGN_FILTER(J1939_PGN_ENGINE_TEMP, J1939_PDU2_FILTER_MASK),
+    J1939_PGN_FILTER(J1939_PGN_VEHICLE_SPEED, J1939_PDU2_FILTER_MASK),
+    J1939_PGN_FILTER(J1939_PGN_VEHICLE_POSITION, J1939_PDU2_FILTER_MASK),
+#ifdef CONFIG_J1939_DM
+    // Requests for DM1/DM2 to the VCU node, and the CTS and EOMA when a
+    // DM2 answer goes out as an RTS/CTS transfer
+    J1939_PGN_FILTER(J1939_PGN_REQUEST, J1939_PDU1_FILTER_MASK),
+    J1939_PGN_FILTER(J1939_PGN_TP_CM, J1939_PDU1_FILTER_MASK),
+#endif
+};
+
+static struct can_filter_plan vcu_plan;
+
+int vcu_can_filters_init(const struct device *can_dev, can_rx_callback_t callback) {
+    int ret = can_filter_plan_install(can_dev, &vcu_plan, vcu_wanted_ids,
+                                      ARRAY_SIZE(vcu_wanted_ids), callback, NULL);
+    if (ret < 0) {
+        LOG_ERR("CAN filter plan failed: %d", ret);
+        return ret;
+    }
+
+    LOG_INF("%d wanted patterns in %d filters, %llu unwanted IDs accepted",
+            vcu_plan.num_wanted, vcu_plan.num_filters, vcu_plan.leaked_ids);
+    return 0;
+}
+
+bool vcu_can_filters_check(const struct can_frame *frame) {
+    return can_filter_plan_check(&vcu_plan, frame);
+}
+
+const struct can_filter_plan *vcu_can_filters_get_plan(void) {
+    return &vcu_plan;
+}
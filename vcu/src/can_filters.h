@@ -0,0 +1,15 @@
+#ifndef CAN_FILTERS_H
+#define CAN_FILTERS_H
+
+#include <zephyr/drivers/can.h>
+#include "can_filter_plan.h"
+
+// Program the acceptance filters for every ID the VCU consumes
+int vcu_can_filters_init(const struct device *can_dev, can_rx_callback_t callback);
+
+// Returns false for frames that leaked through a merged filter
+bool vcu_can_filters_check(const struct can_frame *frame);
+
+const struct can_filter_plan *vcu_can_filters_get_plan(void);
+
+#endif /* CAN_FILTERS_H */
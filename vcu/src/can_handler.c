@@ -0,0 +1,25 @@
+#include <zephyr/kernel.h>
+#include "can_handler.h"
+#include "can_ids.h"
+#include "can_decode.h"
+#include "can_filters.h"
+#include "diag_transport.h"
+#include "vcu_j1939.h"
+
+void can_handler(const struct can_frame *frame, uint32_t rx_us) {
+    if (!vcu_can_filters_check(frame)) {
+        return;
+    }
+
+    // UDS requests advance their ISO-TP session, nothing blocks here
+    if (diag_transport_rx(frame)) {
+        return;
+    }
+
+    // Requests and transport frames for the J1939 node, PGNs are decoded
+    if (frame->flags & CAN_FRAME_IDE) {
+        vcu_j1939_rx(frame);
+    }
+
+    can_decode_dispatch(frame, rx_us);
+}
@@ -0,0 +1,11 @@
+#ifndef CAN_HANDLER_H
+#define CAN_HANDLER_H
+
+#include <zephyr/kernel.h>
+#include <zephyr/drivers/can.h>
+
+// VCU CAN message handler, runs on the CAN RX pipeline thread. Also driven
+// directly by tools/can_replay.
+void can_handler(const struct can_frame *frame, uint32_t rx_us);
+
+#endif /* CAN_HANDLER_H */
@@ -0,0 +1,285 @@
+#include <zephyr/kernel.h>
+#include <zephyr/sys/byteorder.h>
+#include <string.h>
+#include "can_recorder.h"
+#include "mqtt_handler.h"
+#include "diag_service.h"
+
+#ifdef CONFIG_SHELL
+#include <zephyr/shell/shell.h>
+#endif
+
+#ifdef CONFIG_CAN_RECORDER
+
+// Ring of self-contained capture blocks. When the ring is full the oldest
+// block is dropped, so the image always holds the most recent traffic.
+static uint8_t rec_blocks[CAN_RECORDER_BLOCKS][CAN_CAPTURE_BLOCK_SIZE];
+static uint16_t rec_block_frames[CAN_RECORDER_BLOCKS];
+static struct can_capture_writer rec_writer;
+static uint16_t rec_head;
+static uint16_t rec_count;
+static uint32_t rec_frames;
+static uint32_t rec_overwritten;
+static bool rec_recording;
+static struct k_spinlock rec_lock;
+
+// Dump requested over UDS, published from the system work queue
+static void dump_work_handler(struct k_work *work);
+static K_WORK_DEFINE(dump_work, dump_work_handler);
+static uint32_t dump_published;
+static uint32_t dump_size;
+
+void can_recorder_init(void) {
+    can_recorder_clear();
+    can_recorder_start();
+}
+
+void can_recorder_start(void) {
+    k_spinlock_key_t key = k_spin_lock(&rec_lock);
+    rec_recording = true;
+    k_spin_unlock(&rec_lock, key);
+}
+
+void can_recorder_stop(void) {
+    k_spinlock_key_t key = k_spin_lock(&rec_lock);
+    rec_recording = false;
+    k_spin_unlock(&rec_lock, key);
+}
+
+void can_recorder_clear(void) {
+    k_spinlock_key_t key = k_spin_lock(&rec_lock);
+
+    rec_head = 0;
+    rec_count = 0;
+    rec_frames = 0;
+    rec_overwritten = 0;
+    memset(rec_block_frames, 0, sizeof(rec_block_frames));
+
+    k_spin_unlock(&rec_lock, key);
+}
+
+// Caller holds rec_lock
+static void next_block(uint32_t base_us) {
+    uint16_t index;
+
+    if (rec_count < CAN_RECORDER_BLOCKS) {
+        index = (rec_head + rec_count) % CAN_RECORDER_BLOCKS;
+        rec_count++;
+    } else {
+        index = rec_head;
+        rec_overwritten += rec_block_frames[index];
+        rec_frames -= rec_block_frames[index];
+        rec_head = (rec_head + 1) % CAN_RECORDER_BLOCKS;
+    }
+
+    rec_block_frames[index] = 0;
+    can_capture_block_start(&rec_writer, rec_blocks[index], base_us);
+}
+
+void can_recorder_capture(const struct can_frame *frame, uint32_t rx_us) {
+    k_spinlock_key_t key = k_spin_lock(&rec_lock);
+
+    if (!rec_recording) {
+        k_spin_unlock(&rec_lock, key);
+        return;
+    }
+
+    if (rec_count == 0 || can_capture_block_add(&rec_writer, frame, rx_us) != 0) {
+        next_block(rx_us);
+        can_capture_block_add(&rec_writer, frame, rx_us);
+    }
+
+    rec_block_frames[(rec_head + rec_count - 1) % CAN_RECORDER_BLOCKS]++;
+    rec_frames++;
+
+    k_spin_unlock(&rec_lock, key);
+}
+
+int can_recorder_image_size(void) {
+    if (rec_recording) {
+        return -EBUSY;
+    }
+    return CAN_CAPTURE_HDR_LEN + rec_count * CAN_CAPTURE_BLOCK_SIZE;
+}
+
+int can_recorder_read(uint32_t offset, uint8_t *buf, uint32_t len) {
+    uint8_t hdr[CAN_CAPTURE_HDR_LEN];
+    uint32_t size;
+    uint32_t copied = 0;
+
+    if (rec_recording) {
+        return -EBUSY;
+    }
+
+    size = CAN_CAPTURE_HDR_LEN + rec_count * CAN_CAPTURE_BLOCK_SIZE;
+    if (offset >= size) {
+        return 0;
+    }
+    len = MIN(len, size - offset);
+
+    can_capture_write_header(hdr, rec_count, rec_overwritten);
+
+    while (copied < len) {
+        uint32_t pos = offset + copied;
+        uint32_t n;
+
+        if (pos < CAN_CAPTURE_HDR_LEN) {
+            n = MIN(len - copied, CAN_CAPTURE_HDR_LEN - pos);
+            memcpy(&buf[copied], &hdr[pos], n);
+        } else {
+            uint32_t block = (pos - CAN_CAPTURE_HDR_LEN) / CAN_CAPTURE_BLOCK_SIZE;
+            uint32_t in_block = (pos - CAN_CAPTURE_HDR_LEN) % CAN_CAPTURE_BLOCK_SIZE;
+
+            n = MIN(len - copied, CAN_CAPTURE_BLOCK_SIZE - in_block);
+            memcpy(&buf[copied],
+                   &rec_blocks[(rec_head + block) % CAN_RECORDER_BLOCKS][in_block], n);
+        }
+        copied += n;
+    }
+
+    return copied;
+}
+
+int can_recorder_dump_mqtt(void) {
+    static uint8_t chunk[8 + CAN_RECORDER_CHUNK_LEN];
+    int size = can_recorder_image_size();
+
+    if (size < 0) {
+        return size;
+    }
+
+    for (uint32_t offset = 0; offset < size; offset += CAN_RECORDER_CHUNK_LEN) {
+        int n = can_recorder_read(offset, &chunk[8], CAN_RECORDER_CHUNK_LEN);
+        int ret;
+
+        if (n <= 0) {
+            return n;
+        }
+
+        sys_put_le32(offset, &chunk[0]);
+        sys_put_le32(size, &chunk[4]);
+        ret = publish_binary_data(TOPIC_CAN_CAPTURE, chunk, 8 + n);
+        if (ret < 0) {
+            return ret;
+        }
+        dump_published = offset + n;
+    }
+
+    return size;
+}
+
+static void dump_report(uint8_t state) {
+    uint8_t record[CAN_RECORDER_DUMP_RECORD_LEN];
+
+    record[0] = state;
+    sys_put_be32(dump_published, &record[1]);
+    sys_put_be32(dump_size, &record[5]);
+    diag_service_routine_update(ROUTINE_CAN_RECORDER, state == CAN_RECORDER_DUMP_RUNNING,
+                                record, sizeof(record));
+}
+
+// Reports progress after every chunk through the routine results
+static void dump_work_handler(struct k_work *work) {
+    int ret = can_recorder_dump_mqtt();
+
+    dump_report(ret < 0 ? CAN_RECORDER_DUMP_FAILED : CAN_RECORDER_DUMP_DONE);
+}
+
+void can_recorder_get_stats(struct can_recorder_stats *stats) {
+    k_spinlock_key_t key = k_spin_lock(&rec_lock);
+
+    stats->frames = rec_frames;
+    stats->overwritten = rec_overwritten;
+    stats->blocks = rec_count;
+    stats->recording = rec_recording;
+
+    k_spin_unlock(&rec_lock, key);
+}
+
+// Runs on the CAN RX pipeline thread, so the dump only gets queued here.
+// The routine stays running until the dump ends, which keeps the other
+// operations out meanwhile.
+int execute_can_recorder(const uint8_t *data, uint16_t len) {
+    int size;
+
+    if (len < 1) {
+        return DIAG_RESP_INCORRECT_LENGTH;
+    }
+
+    switch (data[0]) {
+        case CAN_RECORDER_OP_START:
+            can_recorder_start();
+            break;
+        case CAN_RECORDER_OP_STOP:
+            can_recorder_stop();
+            break;
+        case CAN_RECORDER_OP_DUMP:
+            size = can_recorder_image_size();
+            if (size < 0 || k_work_busy_get(&dump_work) != 0) {
+                return DIAG_RESP_CONDITIONS_NA;
+            }
+            dump_published = 0;
+            dump_size = size;
+            dump_report(CAN_RECORDER_DUMP_RUNNING);
+            k_work_submit(&dump_work);
+            return DIAG_RESP_OK;
+        case CAN_RECORDER_OP_CLEAR:
+            can_recorder_clear();
+            break;
+        default:
+            return DIAG_RESP_SUBFUNC_NA;
+    }
+
+    diag_service_routine_update(ROUTINE_CAN_RECORDER, false, NULL, 0);
+    return DIAG_RESP_OK;
+}
+
+#ifdef CONFIG_SHELL
+static int cmd_canrec_start(const struct shell *sh, size_t argc, char **argv) {
+    can_recorder_start();
+    return 0;
+}
+
+static int cmd_canrec_stop(const struct shell *sh, size_t argc, char **argv) {
+    can_recorder_stop();
+    return 0;
+}
+
+static int cmd_canrec_clear(const struct shell *sh, size_t argc, char **argv) {
+    can_recorder_clear();
+    return 0;
+}
+
+static int cmd_canrec_dump(const struct shell *sh, size_t argc, char **argv) {
+    int ret = can_recorder_dump_mqtt();
+
+    if (ret < 0) {
+        shell_error(sh, "Dump failed: %d (stop recording first)", ret);
+        return ret;
+    }
+    shell_print(sh, "Published %d bytes to %s", ret, TOPIC_CAN_CAPTURE);
+    return 0;
+}
+
+static int cmd_canrec_stats(const struct shell *sh, size_t argc, char **argv) {
+    struct can_recorder_stats stats;
+
+    can_recorder_get_stats(&stats);
+    shell_print(sh, "%s, %u frames in %u/%u blocks, %u overwritten",
+                stats.recording ? "recording" : "stopped", stats.frames, stats.blocks,
+                CAN_RECORDER_BLOCKS, stats.overwritten);
+    return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(canrec_cmds,
+    SHELL_CMD(start, NULL, "Start recording", cmd_canrec_start),
+    SHELL_CMD(stop, NULL, "Stop recording", cmd_canrec_stop),
+    SHELL_CMD(clear, NULL, "Discard the capture", cmd_canrec_clear),
+    SHELL_CMD(dump, NULL, "Publish the capture over MQTT", cmd_canrec_dump),
+    SHELL_CMD(stats, NULL, "Recorder status", cmd_canrec_stats),
+    SHELL_SUBCMD_SET_END
+);
+SHELL_CMD_REGISTER(canrec, &canrec_cmds, "CAN traffic recorder", NULL);
+#endif /* CONFIG_SHELL */
+
+#endif /* CONFIG_CAN_RECORDER */
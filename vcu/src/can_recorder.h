@@ -0,0 +1,67 @@
+#ifndef CAN_RECORDER_H
+#define CAN_RECORDER_H
+
+#include <zephyr/kernel.h>
+#include <zephyr/drivers/can.h>
+#include "can_capture.h"
+
+#ifdef CONFIG_CAN_RECORDER_BLOCKS
+#define CAN_RECORDER_BLOCKS     CONFIG_CAN_RECORDER_BLOCKS
+#else
+#define CAN_RECORDER_BLOCKS     32
+#endif
+
+#define CAN_RECORDER_IMAGE_SIZE (CAN_CAPTURE_HDR_LEN + CAN_RECORDER_BLOCKS * CAN_CAPTURE_BLOCK_SIZE)
+
+// Capture dump over MQTT: [offset u32][total u32] then image bytes
+#define TOPIC_CAN_CAPTURE       "/topic/can_capture"
+#define CAN_RECORDER_CHUNK_LEN  512
+
+// Sub-operations of UDS routine ROUTINE_CAN_RECORDER, first data byte
+#define CAN_RECORDER_OP_START   0x01
+#define CAN_RECORDER_OP_STOP    0x02
+#define CAN_RECORDER_OP_DUMP    0x03
+#define CAN_RECORDER_OP_CLEAR   0x04
+
+// requestRoutineResults of ROUTINE_CAN_RECORDER after CAN_RECORDER_OP_DUMP:
+// [state][bytes published u32][image size u32], big-endian
+#define CAN_RECORDER_DUMP_RUNNING   0x01
+#define CAN_RECORDER_DUMP_DONE      0x02
+#define CAN_RECORDER_DUMP_FAILED    0x03
+#define CAN_RECORDER_DUMP_RECORD_LEN 9
+
+struct can_recorder_stats {
+    uint32_t frames;            // Frames in the ring
+    uint32_t overwritten;       // Frames lost to ring wrap-around
+    uint16_t blocks;
+    bool recording;
+};
+
+#ifdef CONFIG_CAN_RECORDER
+
+void can_recorder_init(void);
+void can_recorder_start(void);
+void can_recorder_stop(void);
+void can_recorder_clear(void);
+
+// Called from the CAN RX callback with the reception time
+void can_recorder_capture(const struct can_frame *frame, uint32_t rx_us);
+
+// Size of the capture image, recording must be stopped
+int can_recorder_image_size(void);
+
+// Copy part of the capture image, recording must be stopped
+int can_recorder_read(uint32_t offset, uint8_t *buf, uint32_t len);
+
+// Publish the capture image to TOPIC_CAN_CAPTURE in chunks
+int can_recorder_dump_mqtt(void);
+
+void can_recorder_get_stats(struct can_recorder_stats *stats);
+
+#else
+
+static inline void can_recorder_init(void) {}
+
+#endif /* CONFIG_CAN_RECORDER */
+
+#endif /* CAN_RECORDER_H */
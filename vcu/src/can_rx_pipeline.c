@@ -0,0 +1,111 @@
+#include <zephyr/kernel.h>
+#include <string.h>
+#include "can_rx_pipeline.h"
+#include "can_time_sync.h"
+#ifdef CONFIG_CAN_RECORDER
+#include "can_recorder.h"
+#endif
+
+BUILD_ASSERT((CAN_RX_RING_SIZE & (CAN_RX_RING_SIZE - 1)) == 0,
+             "CAN_RX_RING_SIZE must be a power of two");
+
+#define CAN_RX_RING_MASK (CAN_RX_RING_SIZE - 1)
+
+// Single producer (CAN RX callback) / single consumer (rx thread) ring.
+// head is only written by the producer, tail only by the consumer.
+static struct can_frame rx_ring[CAN_RX_RING_SIZE];
+static uint32_t rx_ring_us[CAN_RX_RING_SIZE];
+static atomic_t rx_head = ATOMIC_INIT(0);
+static atomic_t rx_tail = ATOMIC_INIT(0);
+
+static struct can_rx_stats rx_stats;
+static can_rx_consumer_t rx_consumer;
+
+static K_SEM_DEFINE(rx_sem, 0, 1);
+
+K_THREAD_STACK_DEFINE(can_rx_stack, CAN_RX_STACK_SIZE);
+static struct k_thread can_rx_thread;
+
+void can_rx_pipeline_isr(const struct device *dev, struct can_frame *frame, void *user_data) {
+    uint32_t head = (uint32_t)atomic_get(&rx_head);
+    uint32_t used = head - (uint32_t)atomic_get(&rx_tail);
+    uint32_t rx_us = (IS_ENABLED(CONFIG_CAN_LATENCY_TRACE) || IS_ENABLED(CONFIG_CAN_RECORDER)) ?
+                     can_time_local_us() : 0;
+
+    rx_stats.received++;
+
+#ifdef CONFIG_CAN_RECORDER
+    // Record before the overflow check so the capture shows what was on the bus
+    can_recorder_capture(frame, rx_us);
+#endif
+
+    if (used >= CAN_RX_RING_SIZE) {
+        rx_stats.overflows++;
+        return;
+    }
+
+    memcpy(&rx_ring[head & CAN_RX_RING_MASK], frame, sizeof(struct can_frame));
+    rx_ring_us[head & CAN_RX_RING_MASK] = rx_us;
+    atomic_set(&rx_head, head + 1);
+
+    if (used + 1 > rx_stats.high_water) {
+        rx_stats.high_water = used + 1;
+    }
+
+    k_sem_give(&rx_sem);
+}
+
+static uint32_t drain_batch(void) {
+    uint32_t tail = (uint32_t)atomic_get(&rx_tail);
+    uint32_t avail = (uint32_t)atomic_get(&rx_head) - tail;
+    uint32_t count = MIN(avail, CAN_RX_BATCH_SIZE);
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t index = (tail + i) & CAN_RX_RING_MASK;
+
+        rx_consumer(&rx_ring[index], rx_ring_us[index]);
+    }
+
+    // Release the slots only after the consumer is done with them
+    atomic_set(&rx_tail, tail + count);
+    rx_stats.processed += count;
+
+    return count;
+}
+
+static void can_rx_thread_fn(void *p1, void *p2, void *p3) {
+    while (1) {
+        k_sem_take(&rx_sem, K_FOREVER);
+
+        while (drain_batch() == CAN_RX_BATCH_SIZE) {
+            rx_stats.batches++;
+            // Let equal priority work run between full batches
+            k_yield();
+        }
+        rx_stats.batches++;
+    }
+}
+
+void can_rx_pipeline_init(can_rx_consumer_t consumer) {
+    rx_consumer = consumer;
+    atomic_set(&rx_head, 0);
+    atomic_set(&rx_tail, 0);
+    memset(&rx_stats, 0, sizeof(rx_stats));
+
+    k_thread_create(&can_rx_thread, can_rx_stack,
+                    K_THREAD_STACK_SIZEOF(can_rx_stack),
+                    can_rx_thread_fn,
+                    NULL, NULL, NULL,
+                    CAN_RX_PRIORITY, 0, K_NO_WAIT);
+    k_thread_name_set(&can_rx_thread, "can_rx");
+}
+
+void can_rx_pipeline_get_stats(struct can_rx_stats *stats) {
+    memcpy(stats, &rx_stats, sizeof(rx_stats));
+}
+
+void can_rx_pipeline_reset_stats(void) {
+    unsigned int key = irq_lock();
+    memset(&rx_stats, 0, sizeof(rx_stats));
+    irq_unlock(key);
+}
@@ -0,0 +1,34 @@
+#ifndef CAN_RX_PIPELINE_H
+#define CAN_RX_PIPELINE_H
+
+#include <zephyr/kernel.h>
+#include <zephyr/drivers/can.h>
+
+// Ring size must be a power of two
+#define CAN_RX_RING_SIZE        64
+#define CAN_RX_BATCH_SIZE       8
+#define CAN_RX_STACK_SIZE       4096
+#define CAN_RX_PRIORITY         4
+
+struct can_rx_stats {
+    uint32_t received;
+    uint32_t processed;
+    uint32_t overflows;
+    uint32_t high_water;
+    uint32_t batches;
+};
+
+// rx_us is the reception time from can_time_local_us(), 0 without
+// CONFIG_CAN_LATENCY_TRACE or CONFIG_CAN_RECORDER
+typedef void (*can_rx_consumer_t)(const struct can_frame *frame, uint32_t rx_us);
+
+// Start the consumer thread; frames are handed to consumer in thread context
+void can_rx_pipeline_init(can_rx_consumer_t consumer);
+
+// CAN driver RX callback, only copies the frame into the ring
+void can_rx_pipeline_isr(const struct device *dev, struct can_frame *frame, void *user_data);
+
+void can_rx_pipeline_get_stats(struct can_rx_stats *stats);
+void can_rx_pipeline_reset_stats(void);
+
+#endif /* CAN_RX_PIPELINE_H */
@@ -0,0 +1,269 @@
+#include <zephyr/kernel.h>
+#include <zephyr/sys/byteorder.h>
+#include <string.h>
+#include "diag_transport.h"
+#include "diag_service.h"
+#include "can_ids.h"
+#include "isotp_mux.h"
+
+#ifdef CONFIG_SHELL
+#include <zephyr/shell/shell.h>
+#endif
+
+#define UDS_POSITIVE_RESPONSE   0x40
+#define UDS_NEGATIVE_RESPONSE   0x7F
+#define UDS_RESPONSE_MAX_LEN    16  // Room for a routine status record
+
+// Responses waiting per server channel, the first one is being sent
+#define DIAG_RESPONSE_QUEUE_LEN 4
+
+// RequestDownload lengthFormatIdentifier: 2 byte maxNumberOfBlockLength
+#define UDS_BLOCK_LEN_FORMAT    0x20
+
+NET_BUF_POOL_FIXED_DEFINE(diag_frag_pool, DIAG_TRANSPORT_FRAG_COUNT, DIAG_TRANSPORT_FRAG_SIZE,
+                          0, NULL);
+
+// A UDS server channel (physical or functional) and its responses. Each
+// has its own buffers, a response in flight is never overwritten by the
+// answer to the next request.
+struct diag_server {
+    int channel;
+    struct {
+        uint8_t data[UDS_RESPONSE_MAX_LEN];
+        uint8_t len;
+    } queue[DIAG_RESPONSE_QUEUE_LEN];
+    uint8_t head;
+    uint8_t count;
+    struct k_spinlock lock;
+};
+
+static struct isotp_mux diag_mux;
+static struct diag_server physical_server;
+static struct diag_server functional_server;
+static int tester_functional_channel;
+static int node_channels[CAN_DIAG_MAX_NODES];
+
+static diag_response_cb_t response_cb;
+static void *response_user_data;
+
+// SID + 0x40 and the parameters the tester needs to go on, returns the length
+static size_t positive_response(uint8_t sid, const struct net_buf *frags, uint8_t *resp) {
+    resp[0] = sid + UDS_POSITIVE_RESPONSE;
+
+    switch (sid) {
+    case UDS_REQUEST_DOWNLOAD:
+        // A block counts SID and counter, it has to fit one ISO-TP message
+        resp[1] = UDS_BLOCK_LEN_FORMAT;
+        sys_put_be16(DIAG_TRANSPORT_MAX_MSG_LEN, &resp[2]);
+        return 4;
+    case UDS_TRANSFER_DATA:
+        // Echo the blockSequenceCounter
+        net_buf_linearize(&resp[1], 1, frags, 1, 1);
+        return 2;
+    case UDS_ROUTINE_CONTROL: {
+        // Echo routine ID and control type, requestRoutineResults adds the
+        // status record
+        int record_len = 0;
+
+        net_buf_linearize(&resp[1], 3, frags, 1, 3);
+        if (resp[3] == ROUTINE_RESULT) {
+            record_len = diag_service_routine_result(sys_get_le16(&resp[1]), &resp[4],
+                                                     UDS_RESPONSE_MAX_LEN - 4);
+        }
+        return 4 + MAX(record_len, 0);
+    }
+    default:
+        return 1;
+    }
+}
+
+static void response_sent(struct isotp_ctx *ctx, int result, void *user_data);
+
+// Send the response at the head of the queue, dropping any that fail
+static void server_send_head(struct diag_server *server) {
+    struct isotp_ctx *ctx = isotp_mux_channel(&diag_mux, server->channel);
+    k_spinlock_key_t key;
+    bool more;
+
+    do {
+        if (isotp_send_async(ctx, server->queue[server->head].data,
+                             server->queue[server->head].len, response_sent, server) == 0) {
+            return;
+        }
+
+        key = k_spin_lock(&server->lock);
+        server->head = (server->head + 1) % DIAG_RESPONSE_QUEUE_LEN;
+        more = --server->count > 0;
+        k_spin_unlock(&server->lock, key);
+    } while (more);
+}
+
+static void response_sent(struct isotp_ctx *ctx, int result, void *user_data) {
+    struct diag_server *server = user_data;
+    k_spinlock_key_t key = k_spin_lock(&server->lock);
+    bool more;
+
+    server->head = (server->head + 1) % DIAG_RESPONSE_QUEUE_LEN;
+    more = --server->count > 0;
+    k_spin_unlock(&server->lock, key);
+
+    if (more) {
+        server_send_head(server);
+    }
+}
+
+// Queue a response, it goes out as soon as the ones before it are sent
+static void server_respond(struct diag_server *server, const uint8_t *resp, uint8_t len) {
+    k_spinlock_key_t key = k_spin_lock(&server->lock);
+    uint8_t slot = (server->head + server->count) % DIAG_RESPONSE_QUEUE_LEN;
+    bool idle = server->count == 0;
+
+    memcpy(server->queue[slot].data, resp, len);
+    server->queue[slot].len = len;
+    server->count++;
+    k_spin_unlock(&server->lock, key);
+
+    if (idle) {
+        server_send_head(server);
+    }
+}
+
+static void negative_response(struct diag_server *server, uint8_t sid, uint8_t nrc) {
+    uint8_t resp[3] = { UDS_NEGATIVE_RESPONSE, sid, nrc };
+
+    server_respond(server, resp, sizeof(resp));
+}
+
+// Runs on the CAN RX pipeline thread once a request is complete. Only
+// response_sent() frees queue slots meanwhile, so the check below holds.
+static void diag_request_received(struct isotp_ctx *ctx, struct net_buf *frags, int len,
+                                  void *user_data) {
+    struct diag_server *server = user_data;
+    uint8_t resp[UDS_RESPONSE_MAX_LEN];
+    k_spinlock_key_t key;
+    uint8_t free_slots;
+    uint8_t sid;
+    int ret;
+
+    if (len < 1) {
+        return;
+    }
+
+    sid = frags->data[0];
+    key = k_spin_lock(&server->lock);
+    free_slots = DIAG_RESPONSE_QUEUE_LEN - server->count;
+    k_spin_unlock(&server->lock, key);
+
+    // Responses are not going out: keep the last slot to tell the tester
+    // to repeat the request later, which is not executed
+    if (free_slots < 2) {
+        if (free_slots == 1) {
+            negative_response(server, sid, DIAG_RESP_BUSY);
+        }
+        return;
+    }
+
+    // Consumed in the receive fragments, TransferData is never copied
+    ret = process_diagnostic_request_frags(frags, len);
+
+    if (ret == DIAG_RESP_OK) {
+        server_respond(server, resp, positive_response(sid, frags, resp));
+    } else {
+        negative_response(server, sid, ret);
+    }
+}
+
+static void diag_response_received(struct isotp_ctx *ctx, struct net_buf *frags, int len,
+                                   void *user_data) {
+    if (response_cb) {
+        response_cb((uint8_t)(uintptr_t)user_data, frags, len, response_user_data);
+    }
+}
+
+int diag_transport_init(const struct device *can_dev) {
+    int ret;
+
+    isotp_mux_init(&diag_mux, can_dev, NULL, DIAG_TRANSPORT_MAX_MSG_LEN);
+    diag_mux.frag_pool = &diag_frag_pool;
+#ifdef CONFIG_DIAG_ISOTP_FD
+    diag_mux.tx_dl = CAN_MAX_DLEN;
+#endif
+
+    ret = isotp_mux_open_frags(&diag_mux, CAN_ID_DIAG_VCU_REQ, CAN_ID_DIAG_VCU_RESP, false,
+                               diag_request_received, &physical_server);
+    if (ret < 0) {
+        return ret;
+    }
+    physical_server.channel = ret;
+
+    ret = isotp_mux_open_frags(&diag_mux, CAN_ID_DIAG_FUNCTIONAL, CAN_ID_DIAG_VCU_RESP, true,
+                               diag_request_received, &functional_server);
+    if (ret < 0) {
+        return ret;
+    }
+    functional_server.channel = ret;
+
+    // Nodes answer functional requests on their own response IDs
+    ret = isotp_mux_open_frags(&diag_mux, 0, CAN_ID_DIAG_FUNCTIONAL, true, NULL, NULL);
+    if (ret < 0) {
+        return ret;
+    }
+    tester_functional_channel = ret;
+
+    for (int node = 0; node < CAN_DIAG_MAX_NODES; node++) {
+        ret = isotp_mux_open_frags(&diag_mux, CAN_ID_DIAG_NODE_RESP(node),
+                                   CAN_ID_DIAG_NODE_REQ(node), false, diag_response_received,
+                                   (void *)(uintptr_t)node);
+        if (ret < 0) {
+            return ret;
+        }
+        node_channels[node] = ret;
+    }
+
+    return 0;
+}
+
+void diag_transport_set_response_cb(diag_response_cb_t cb, void *user_data) {
+    response_user_data = user_data;
+    response_cb = cb;
+}
+
+int diag_transport_request(uint8_t node, const uint8_t *data, size_t len) {
+    if (node >= CAN_DIAG_MAX_NODES) {
+        return -EINVAL;
+    }
+    return isotp_send_async(isotp_mux_channel(&diag_mux, node_channels[node]), data, len,
+                            NULL, NULL);
+}
+
+int diag_transport_request_all(const uint8_t *data, size_t len) {
+    return isotp_send_async(isotp_mux_channel(&diag_mux, tester_functional_channel), data, len,
+                            NULL, NULL);
+}
+
+bool diag_transport_rx(const struct can_frame *frame) {
+    return isotp_mux_process_frame(&diag_mux, frame) != -ENOENT;
+}
+
+#ifdef CONFIG_SHELL
+static int cmd_isotp_stats(const struct shell *sh, size_t argc, char **argv) {
+    shell_print(sh, "%-5s %-5s %8s %8s %8s %8s %8s", "rx", "tx", "rx done", "rx err",
+                "rx ovfl", "tx done", "tx err");
+
+    for (int i = 0; i < diag_mux.num_channels; i++) {
+        const struct isotp_ctx *ctx = &diag_mux.channels[i];
+
+        shell_print(sh, "0x%03x 0x%03x %8u %8u %8u %8u %8u", ctx->rx_id, ctx->tx_id,
+                    ctx->stats.rx_done, ctx->stats.rx_errors, ctx->stats.rx_overflow,
+                    ctx->stats.tx_done, ctx->stats.tx_errors);
+    }
+#ifdef CONFIG_NET_BUF_POOL_USAGE
+    shell_print(sh, "%ld/%u fragments free", atomic_get(&diag_frag_pool.avail_count),
+                DIAG_TRANSPORT_FRAG_COUNT);
+#endif
+    shell_print(sh, "%u frames for unknown IDs", diag_mux.unknown_ids);
+    return 0;
+}
+
+SHELL_CMD_REGISTER(isotp, NULL, "ISO-TP channel statistics", cmd_isotp_stats);
+#endif /* CONFIG_SHELL */
@@ -0,0 +1,37 @@
+#ifndef DIAG_TRANSPORT_H
+#define DIAG_TRANSPORT_H
+
+#include <zephyr/kernel.h>
+#include <zephyr/drivers/can.h>
+#include <zephyr/net/buf.h>
+
+// Messages are reassembled into fragments shared by all channels, RAM is
+// only taken for the data actually in flight
+#define DIAG_TRANSPORT_MAX_MSG_LEN  4095
+#define DIAG_TRANSPORT_FRAG_SIZE    128
+#define DIAG_TRANSPORT_FRAG_COUNT   64
+
+// Response from sensor node `node` in a fragment chain, or NULL and a
+// negative errno if the transfer failed. frags is only valid during the
+// call, which runs on the CAN RX pipeline thread.
+typedef void (*diag_response_cb_t)(uint8_t node, struct net_buf *frags, int len,
+                                   void *user_data);
+
+// UDS over ISO-TP. The VCU serves requests on CAN_ID_DIAG_VCU_REQ and the
+// functional ID, and acts as tester for every sensor node at once.
+int diag_transport_init(const struct device *can_dev);
+
+void diag_transport_set_response_cb(diag_response_cb_t cb, void *user_data);
+
+// Send a request to one node, data must stay valid until the response
+// arrives. -EBUSY while a request to this node is still being sent.
+int diag_transport_request(uint8_t node, const uint8_t *data, size_t len);
+
+// Single frame request to all nodes on the functional ID
+int diag_transport_request_all(const uint8_t *data, size_t len);
+
+// Feed a frame from the CAN RX pipeline, returns true if it was a
+// diagnostic frame
+bool diag_transport_rx(const struct can_frame *frame);
+
+#endif /* DIAG_TRANSPORT_H */
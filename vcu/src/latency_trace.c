@@ -0,0 +1,212 @@
+#include <zephyr/kernel.h>
+#include <zephyr/sys/byteorder.h>
+#include <string.h>
+#include "latency_trace.h"
+#include "can_time_sync.h"
+#include "diag_service.h"
+
+#ifdef CONFIG_SHELL
+#include <zephyr/shell/shell.h>
+#endif
+
+// Per stage in the DID record: count, average, p99, max (BE32 each)
+#define LATENCY_DID_STAGE_LEN   16
+#define LATENCY_DID_LEN         (LATENCY_STAGE_COUNT * LATENCY_DID_STAGE_LEN)
+
+BUILD_ASSERT(LATENCY_DID_LEN <= DIAG_DID_MAX_LEN, "Latency DID does not fit the DID store");
+
+static const char *const stage_names[LATENCY_STAGE_COUNT] = {
+    [LATENCY_SAMPLE_TO_RX]          = "sample->rx",
+    [LATENCY_RX_TO_DECODE]          = "rx->decode",
+    [LATENCY_RX_TO_PUBLISH_QUEUED]  = "rx->pub_queued",
+    [LATENCY_RX_TO_PUBLISH_SENT]    = "rx->pub_sent",
+    [LATENCY_RX_TO_V2V]             = "rx->v2v",
+    [LATENCY_SAMPLE_TO_PUBLISH]     = "sample->pub_sent",
+    [LATENCY_SAMPLE_TO_V2V]         = "sample->v2v",
+};
+
+static struct latency_hist hists[SIGNAL_CACHE_COUNT][LATENCY_STAGE_COUNT];
+static struct k_spinlock hist_lock;
+
+// Frame currently being processed on the CAN RX thread
+static struct {
+    signal_cache_id_t signal;
+    uint32_t rx_us;
+    uint32_t sample_us;
+    bool has_sample;
+} current = { .signal = SIGNAL_NONE };
+
+static void did_work_handler(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(did_work, did_work_handler);
+
+static inline uint8_t bucket_index(uint32_t us) {
+    uint8_t index = us == 0 ? 0 : 32 - __builtin_clz(us);
+
+    return MIN(index, LATENCY_HIST_BUCKETS - 1);
+}
+
+static void record(signal_cache_id_t signal, enum latency_stage stage, uint32_t us) {
+    struct latency_hist *hist = &hists[signal][stage];
+    k_spinlock_key_t key = k_spin_lock(&hist_lock);
+
+    hist->count++;
+    hist->sum_us += us;
+    if (us > hist->max_us) {
+        hist->max_us = us;
+    }
+    hist->buckets[bucket_index(us)]++;
+
+    k_spin_unlock(&hist_lock, key);
+}
+
+void latency_trace_begin(signal_cache_id_t signal, uint32_t rx_us, const uint32_t *sample_us) {
+    current.signal = signal < SIGNAL_CACHE_COUNT ? signal : SIGNAL_NONE;
+    current.rx_us = rx_us;
+    current.has_sample = sample_us != NULL;
+    current.sample_us = sample_us ? *sample_us : 0;
+
+    if (current.signal != SIGNAL_NONE && current.has_sample) {
+        record(current.signal, LATENCY_SAMPLE_TO_RX, rx_us - current.sample_us);
+    }
+}
+
+void latency_trace_mark(enum latency_stage stage) {
+    uint32_t now;
+
+    if (current.signal == SIGNAL_NONE || stage >= LATENCY_STAGE_COUNT) {
+        return;
+    }
+
+    now = can_time_local_us();
+    record(current.signal, stage, now - current.rx_us);
+
+    if (!current.has_sample) {
+        return;
+    }
+    if (stage == LATENCY_RX_TO_PUBLISH_SENT) {
+        record(current.signal, LATENCY_SAMPLE_TO_PUBLISH, now - current.sample_us);
+    } else if (stage == LATENCY_RX_TO_V2V) {
+        record(current.signal, LATENCY_SAMPLE_TO_V2V, now - current.sample_us);
+    }
+}
+
+int latency_trace_get(signal_cache_id_t signal, enum latency_stage stage,
+                      struct latency_hist *hist) {
+    if (signal >= SIGNAL_CACHE_COUNT || stage >= LATENCY_STAGE_COUNT) {
+        return -EINVAL;
+    }
+
+    k_spinlock_key_t key = k_spin_lock(&hist_lock);
+    memcpy(hist, &hists[signal][stage], sizeof(*hist));
+    k_spin_unlock(&hist_lock, key);
+
+    return 0;
+}
+
+void latency_trace_reset(void) {
+    k_spinlock_key_t key = k_spin_lock(&hist_lock);
+    memset(hists, 0, sizeof(hists));
+    k_spin_unlock(&hist_lock, key);
+}
+
+uint32_t latency_hist_percentile_us(const struct latency_hist *hist, uint8_t percent) {
+    uint64_t target = ((uint64_t)hist->count * percent + 99) / 100;
+    uint64_t seen = 0;
+
+    if (hist->count == 0) {
+        return 0;
+    }
+
+    for (int i = 0; i < LATENCY_HIST_BUCKETS - 1; i++) {
+        seen += hist->buckets[i];
+        if (seen >= target) {
+            return MIN(BIT(i), hist->max_us);
+        }
+    }
+    return hist->max_us;
+}
+
+static uint32_t hist_avg_us(const struct latency_hist *hist) {
+    return hist->count ? (uint32_t)(hist->sum_us / hist->count) : 0;
+}
+
+// Publish the per-signal summaries as UDS DIDs
+static void did_work_handler(struct k_work *work) {
+    uint8_t record_buf[LATENCY_DID_LEN];
+    struct latency_hist hist;
+
+    for (int sig = 0; sig < SIGNAL_CACHE_COUNT; sig++) {
+        for (int stage = 0; stage < LATENCY_STAGE_COUNT; stage++) {
+            uint8_t *rec = &record_buf[stage * LATENCY_DID_STAGE_LEN];
+
+            latency_trace_get(sig, stage, &hist);
+            sys_put_be32(hist.count, &rec[0]);
+            sys_put_be32(hist_avg_us(&hist), &rec[4]);
+            sys_put_be32(latency_hist_percentile_us(&hist, 99), &rec[8]);
+            sys_put_be32(hist.max_us, &rec[12]);
+        }
+        update_diagnostic_data(DID_LATENCY_BASE + sig, record_buf, sizeof(record_buf));
+    }
+
+    k_work_schedule(&did_work, K_MSEC(LATENCY_DID_PERIOD_MS));
+}
+
+void latency_trace_init(void) {
+    latency_trace_reset();
+    k_work_schedule(&did_work, K_MSEC(LATENCY_DID_PERIOD_MS));
+}
+
+#ifdef CONFIG_SHELL
+static void print_hist(const struct shell *sh, const char *name, const struct latency_hist *hist) {
+    shell_print(sh, "  %-17s n=%-8u avg=%-7u p50<=%-7u p99<=%-7u max=%u us", name,
+                hist->count, hist_avg_us(hist), latency_hist_percentile_us(hist, 50),
+                latency_hist_percentile_us(hist, 99), hist->max_us);
+}
+
+static int cmd_latency_show(const struct shell *sh, size_t argc, char **argv) {
+    struct latency_hist hist;
+
+    for (int sig = 0; sig < SIGNAL_CACHE_COUNT; sig++) {
+        if (argc > 1 && strcmp(argv[1], signal_cache_name(sig)) != 0) {
+            continue;
+        }
+
+        shell_print(sh, "%s (DID 0x%04X)", signal_cache_name(sig), DID_LATENCY_BASE + sig);
+        for (int stage = 0; stage < LATENCY_STAGE_COUNT; stage++) {
+            latency_trace_get(sig, stage, &hist);
+            if (hist.count == 0) {
+                continue;
+            }
+            print_hist(sh, stage_names[stage], &hist);
+
+            // Full histogram only for a single signal
+            if (argc > 1) {
+                for (int b = 0; b < LATENCY_HIST_BUCKETS; b++) {
+                    if (hist.buckets[b] == 0) {
+                        continue;
+                    }
+                    if (b == LATENCY_HIST_BUCKETS - 1) {
+                        shell_print(sh, "    >=%-7lu %u", BIT(b - 1), hist.buckets[b]);
+                    } else {
+                        shell_print(sh, "    <%-8lu %u", BIT(b), hist.buckets[b]);
+                    }
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+static int cmd_latency_reset(const struct shell *sh, size_t argc, char **argv) {
+    latency_trace_reset();
+    shell_print(sh, "Latency histograms cleared");
+    return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(latency_cmds,
+    SHELL_CMD_ARG(show, NULL, "Latency summary [signal]", cmd_latency_show, 1, 1),
+    SHELL_CMD(reset, NULL, "Clear latency histograms", cmd_latency_reset),
+    SHELL_SUBCMD_SET_END
+);
+SHELL_CMD_REGISTER(latency, &latency_cmds, "CAN end-to-end latency", NULL);
+#endif /* CONFIG_SHELL */
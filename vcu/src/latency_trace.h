@@ -0,0 +1,61 @@
+#ifndef LATENCY_TRACE_H
+#define LATENCY_TRACE_H
+
+#include <zephyr/kernel.h>
+#include "signal_cache.h"
+
+// Power-of-two microsecond buckets: bucket 0 is < 1 us, bucket n is
+// [2^(n-1), 2^n) us, the last bucket also holds everything above. The
+// last one starts at ~4.2 s, beyond MQTT publish and end-to-end delays.
+#define LATENCY_HIST_BUCKETS    24
+
+// UDS DIDs with the per-signal summary, DID = base + signal_cache_id_t
+#define DID_LATENCY_BASE        0xFD00
+#define LATENCY_DID_PERIOD_MS   1000
+
+enum latency_stage {
+    LATENCY_SAMPLE_TO_RX = 0,       // Node sample time to VCU reception
+    LATENCY_RX_TO_DECODE,
+    LATENCY_RX_TO_PUBLISH_QUEUED,   // Passed the telemetry policy
+    LATENCY_RX_TO_PUBLISH_SENT,     // Handed to the MQTT client
+    LATENCY_RX_TO_V2V,              // V2V broadcast advertised
+    LATENCY_SAMPLE_TO_PUBLISH,      // End to end, timestamped samples only
+    LATENCY_SAMPLE_TO_V2V,
+    LATENCY_STAGE_COUNT
+};
+
+struct latency_hist {
+    uint32_t count;
+    uint32_t max_us;
+    uint64_t sum_us;
+    uint32_t buckets[LATENCY_HIST_BUCKETS];
+};
+
+#ifdef CONFIG_CAN_LATENCY_TRACE
+
+void latency_trace_init(void);
+
+// Start tracing a frame for signal. sample_us is the node timestamp or
+// NULL. Only called from the CAN RX thread, one frame at a time.
+void latency_trace_begin(signal_cache_id_t signal, uint32_t rx_us, const uint32_t *sample_us);
+
+// Record the time from reception (and sample, if known) to stage
+void latency_trace_mark(enum latency_stage stage);
+
+int latency_trace_get(signal_cache_id_t signal, enum latency_stage stage,
+                      struct latency_hist *hist);
+void latency_trace_reset(void);
+
+// Upper bound of the bucket holding the given percentile
+uint32_t latency_hist_percentile_us(const struct latency_hist *hist, uint8_t percent);
+
+#else
+
+static inline void latency_trace_init(void) {}
+static inline void latency_trace_begin(signal_cache_id_t signal, uint32_t rx_us,
+                                       const uint32_t *sample_us) {}
+static inline void latency_trace_mark(enum latency_stage stage) {}
+
+#endif /* CONFIG_CAN_LATENCY_TRACE */
+
+#endif /* LATENCY_TRACE_H */
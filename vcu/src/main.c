@@ -4,6 +4,16 @@
 #include <zephyr/bluetooth/gatt.h>
 #include <zephyr/drivers/can.h>
 #include "can_ids.h"
+#include "can_rx_pipeline.h"
+#include "can_handler.h"
+#include "diag_transport.h"
+#include "can_filters.h"
+#include "can_recorder.h"
+#include "signal_cache.h"
+#include "telemetry_policy.h"
+#include "can_time_sync.h"
+#include "latency_trace.h"
+#include "vcu_j1939.h"
 
 // BLE UUIDs for WiFi configuration
 #define WIFI_CONFIG_UUID BT_UUID_DECLARE_16(0x00FF)
@@ -71,67 +81,6 @@ static ssize_t wifi_pass_write(struct bt_conn *conn,
     return len;
 }
 
-// CAN message handler with complete switch case
-static void can_handler(const struct device *dev, struct can_frame *frame, void *user_data) {
-    switch(frame->id) {
-        case CAN_ID_TEMP: {
-            float temp;
-            memcpy(&temp, frame->data, sizeof(float));
-            publish_sensor_data(TOPIC_TEMPERATURE, temp);
-            if (temp > 90.0f) {
-                publish_sensor_data(TOPIC_PREDICTIVE_MAINTENANCE, temp);
-            }
-            break;
-        }
-        case CAN_ID_GPS: {
-            float lat, lon;
-            memcpy(&lat, frame->data, sizeof(float));
-            memcpy(&lon, frame->data + sizeof(float), sizeof(float));
-            publish_gps_data(TOPIC_GPS, lat, lon);
-            broadcast_v2v_data(V2V_GPS_DATA, frame->data, frame->dlc);
-            break;
-        }
-        case CAN_ID_COLLISION: {
-            uint16_t distance;
-            distance = (frame->data[0] << 8) | frame->data[1];
-            publish_sensor_data(TOPIC_COLLISION, (float)distance);
-            if (distance < 100) { // Less than 1 meter
-                char hazard_msg[64];
-                snprintf(hazard_msg, sizeof(hazard_msg), 
-                         "Critical: Collision warning at %d cm", distance);
-                publish_sensor_data(TOPIC_HAZARD_NOTIFICATION, distance);
-                broadcast_v2v_data(V2V_HAZARD_DATA, (uint8_t*)hazard_msg, strlen(hazard_msg));
-            }
-            break;
-        }
-        case CAN_ID_BATTERY: {
-            float voltage;
-            memcpy(&voltage, frame->data, sizeof(float));
-            publish_sensor_data(TOPIC_BATTERY, voltage);
-            break;
-        }
-        case CAN_ID_BRAKE: {
-            uint16_t pressure;
-            pressure = (frame->data[0] << 8) | frame->data[1];
-            publish_sensor_data(TOPIC_BRAKE, (float)pressure);
-            broadcast_v2v_data(V2V_BRAKE_DATA, frame->data, frame->dlc);
-            break;
-        }
-        case CAN_ID_TPMS: {
-            uint8_t pressure = frame->data[0];
-            publish_sensor_data(TOPIC_TPMS, (float)pressure);
-            break;
-        }
-        case CAN_ID_SPEED: {
-            uint16_t speed;
-            speed = (frame->data[0] << 8) | frame->data[1];
-            publish_sensor_data(TOPIC_SPEED, (float)speed);
-            broadcast_v2v_data(V2V_SPEED_DATA, frame->data, frame->dlc);
-            break;
-        }
-    }
-}
-
 // MQTT Connection callback
 static void mqtt_event_cb(struct mqtt_client *client,
                          struct mqtt_evt *evt) {
@@ -174,13 +123,31 @@ void main(void) {
         return;
     }
 
-    // Set up CAN filter to receive all sensor messages
-    struct can_filter filter = {
-        .id = 0,
-        .mask = 0,
-        .flags = CAN_FILTER_DATA
-    };
-    can_add_rx_filter(can_dev, can_handler, NULL, &filter);
+    // Frames are queued from the driver callback and decoded on the RX thread
+    signal_cache_init();
+    telemetry_policy_init();
+    latency_trace_init();
+    can_recorder_init();
+    can_rx_pipeline_init(can_handler);
+
+    // Program hardware filters for the IDs we consume
+    if (vcu_can_filters_init(can_dev, can_rx_pipeline_isr) != 0) {
+        handle_error(ERROR_CAN_BUS_OFF);
+        return;
+    }
+
+    // UDS requests arrive through the RX pipeline
+    diag_transport_init(can_dev);
+
+    // DM1 broadcast of the faults reported to the error handler
+    if (vcu_j1939_init(can_dev) != 0) {
+        handle_error(ERROR_CAN_BUS_OFF);
+    }
+
+#ifdef CONFIG_CAN_TIME_SYNC
+    // Reference clock for node sample timestamps
+    can_time_sync_master_start(can_dev);
+#endif
 
     // Initialize MQTT
     mqtt_client_init(&mqtt_client);
@@ -108,6 +108,22 @@ void publish_to_topic(const char *topic, const char *payload)
     mqtt_publish(mqtt_client, &param);
 }
 
+int publish_binary_data(const char *topic, const uint8_t *data, size_t len)
+{
+    struct mqtt_publish_param param = {
+        .message.topic.qos = 1,
+        .message.topic.topic.utf8 = topic,
+        .message.topic.topic.size = strlen(topic),
+        .message.payload.data = (uint8_t *)data,
+        .message.payload.len = len,
+        .message_id = sys_rand32_get(),
+        .dup_flag = 0,
+        .retain_flag = 0
+    };
+
+    return mqtt_publish(mqtt_client, &param);
+}
+
 void subscribe_to_topics(void)
 {
     static struct mqtt_topic_list topics = {
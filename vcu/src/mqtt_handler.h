@@ -3,9 +3,24 @@
 
 #include <zephyr/net/mqtt.h>
 
+// Sensor topics, one per CAN message
+#define TOPIC_TEMPERATURE               "/topic/temperature"
+#define TOPIC_GPS                       "/topic/gps"
+#define TOPIC_COLLISION                 "/topic/collision"
+#define TOPIC_BATTERY                   "/topic/battery"
+#define TOPIC_BRAKE                     "/topic/brake"
+#define TOPIC_TPMS                      "/topic/tpms"
+#define TOPIC_SPEED                     "/topic/speed"
+
+#define TOPIC_HAZARD_NOTIFICATION       "/topic/hazard_notification"
+#define TOPIC_PREDICTIVE_MAINTENANCE    "/topic/predictive_maintenance"
+#define TOPIC_TRAFFIC_UPDATE            "/topic/traffic_update"
+#define TOPIC_V2I                       "/topic/v2i"
+
 void mqtt_client_init(struct mqtt_client *client);
 void publish_sensor_data(const char *topic, float value);
 void publish_gps_data(const char *topic, float lat, float lon);
+int publish_binary_data(const char *topic, const uint8_t *data, size_t len);
 void subscribe_to_topics(void);
 void mqtt_connect_work_handler(struct k_work *work);
 
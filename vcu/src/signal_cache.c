@@ -0,0 +1,153 @@
+#include <zephyr/kernel.h>
+#include <zephyr/sys/barrier.h>
+#include <string.h>
+#include "signal_cache.h"
+
+#define KMH_TO_MS(v) ((v) / 3.6f)
+
+// Lock-free attempts before a reader takes the writer's lock
+#define SIGNAL_CACHE_READ_RETRIES   4
+
+// Seqlock protected entry: seq is odd while the writer is updating
+struct signal_cache_entry {
+    atomic_t seq;
+    float value;
+    uint32_t timestamp_ms;
+    uint32_t update_count;
+};
+
+static struct signal_cache_entry cache[SIGNAL_CACHE_COUNT];
+
+static const char *const signal_names[SIGNAL_CACHE_COUNT] = {
+    [SIGNAL_TEMPERATURE]        = "temperature",
+    [SIGNAL_GPS_LATITUDE]       = "gps_lat",
+    [SIGNAL_GPS_LONGITUDE]      = "gps_lon",
+    [SIGNAL_COLLISION_DISTANCE] = "collision",
+    [SIGNAL_BATTERY_VOLTAGE]    = "battery",
+    [SIGNAL_BRAKE_PRESSURE]     = "brake",
+    [SIGNAL_TPMS_PRESSURE]      = "tpms",
+    [SIGNAL_VEHICLE_SPEED]      = "speed",
+};
+
+// Held by the writer for the few stores of an update, so a reader can
+// never preempt it mid-update on the same CPU. Readers only take it after
+// SIGNAL_CACHE_READ_RETRIES failed attempts.
+static struct k_spinlock write_lock;
+
+void signal_cache_init(void) {
+    memset(cache, 0, sizeof(cache));
+}
+
+void signal_cache_update(signal_cache_id_t id, float value) {
+    struct signal_cache_entry *entry;
+    k_spinlock_key_t key;
+    atomic_val_t seq;
+
+    if (id >= SIGNAL_CACHE_COUNT) {
+        return;
+    }
+
+    entry = &cache[id];
+    key = k_spin_lock(&write_lock);
+    seq = atomic_get(&entry->seq);
+
+    atomic_set(&entry->seq, seq + 1);
+    barrier_dmem_fence_full();
+
+    entry->value = value;
+    entry->timestamp_ms = k_uptime_get_32();
+    entry->update_count++;
+
+    barrier_dmem_fence_full();
+    atomic_set(&entry->seq, seq + 2);
+    k_spin_unlock(&write_lock, key);
+}
+
+int signal_cache_read(signal_cache_id_t id, struct signal_sample *sample) {
+    const struct signal_cache_entry *entry;
+    atomic_val_t seq_start, seq_end;
+    int retries = 0;
+
+    if (id >= SIGNAL_CACHE_COUNT) {
+        return -EINVAL;
+    }
+
+    entry = &cache[id];
+
+    do {
+        if (retries++ == SIGNAL_CACHE_READ_RETRIES) {
+            // Writer keeps getting in the way (another CPU), wait for it
+            k_spinlock_key_t key = k_spin_lock(&write_lock);
+
+            sample->value = entry->value;
+            sample->timestamp_ms = entry->timestamp_ms;
+            sample->update_count = entry->update_count;
+            k_spin_unlock(&write_lock, key);
+            break;
+        }
+
+        seq_start = atomic_get(&entry->seq);
+        if (seq_start & 1) {
+            // Writer is mid-update, retry
+            continue;
+        }
+        barrier_dmem_fence_full();
+
+        sample->value = entry->value;
+        sample->timestamp_ms = entry->timestamp_ms;
+        sample->update_count = entry->update_count;
+
+        barrier_dmem_fence_full();
+        seq_end = atomic_get(&entry->seq);
+    } while ((seq_start & 1) || seq_start != seq_end);
+
+    if (sample->update_count == 0) {
+        return -ENODATA;
+    }
+
+    sample->age_ms = k_uptime_get_32() - sample->timestamp_ms;
+    return 0;
+}
+
+bool signal_cache_is_fresh(signal_cache_id_t id, uint32_t max_age_ms) {
+    struct signal_sample sample;
+
+    if (signal_cache_read(id, &sample) != 0) {
+        return false;
+    }
+    return sample.age_ms <= max_age_ms;
+}
+
+const char *signal_cache_name(signal_cache_id_t id) {
+    return id < SIGNAL_CACHE_COUNT ? signal_names[id] : "unknown";
+}
+
+float get_current_speed(void) {
+    struct signal_sample sample;
+
+    if (signal_cache_read(SIGNAL_VEHICLE_SPEED, &sample) != 0) {
+        return 0.0f;
+    }
+    return KMH_TO_MS(sample.value);
+}
+
+struct vehicle_location get_current_location(void) {
+    struct vehicle_location location = {0};
+    struct signal_sample lat, lon;
+    int retries = 0;
+
+    // Latitude and longitude are written as a pair; retry until both
+    // samples come from the same GPS frame. A reader that preempted the
+    // writer between the two would wait forever, after a few attempts the
+    // pair may come from two consecutive frames.
+    do {
+        if (signal_cache_read(SIGNAL_GPS_LATITUDE, &lat) != 0 ||
+            signal_cache_read(SIGNAL_GPS_LONGITUDE, &lon) != 0) {
+            return location;
+        }
+    } while (lat.update_count != lon.update_count && ++retries < SIGNAL_CACHE_READ_RETRIES);
+
+    location.latitude = lat.value;
+    location.longitude = lon.value;
+    return location;
+}
@@ -0,0 +1,52 @@
+#ifndef SIGNAL_CACHE_H
+#define SIGNAL_CACHE_H
+
+#include <zephyr/kernel.h>
+
+// Latest decoded value of each CAN signal
+typedef enum {
+    SIGNAL_TEMPERATURE = 0,
+    SIGNAL_GPS_LATITUDE,
+    SIGNAL_GPS_LONGITUDE,
+    SIGNAL_COLLISION_DISTANCE,
+    SIGNAL_BATTERY_VOLTAGE,
+    SIGNAL_BRAKE_PRESSURE,
+    SIGNAL_TPMS_PRESSURE,
+    SIGNAL_VEHICLE_SPEED,
+    SIGNAL_CACHE_COUNT
+} signal_cache_id_t;
+
+#define SIGNAL_NONE         SIGNAL_CACHE_COUNT
+#define SIGNAL_MAX_AGE_MS   500
+
+struct signal_sample {
+    float value;
+    uint32_t timestamp_ms;
+    uint32_t age_ms;
+    uint32_t update_count;
+};
+
+struct vehicle_location {
+    float latitude;
+    float longitude;
+};
+
+void signal_cache_init(void);
+
+// Single writer: only the CAN ingest path updates the cache
+void signal_cache_update(signal_cache_id_t id, float value);
+
+// Lock-free read. After a few attempts that raced the writer it takes the
+// writer's lock, held for one update at most. Returns -ENODATA before the
+// first update.
+int signal_cache_read(signal_cache_id_t id, struct signal_sample *sample);
+bool signal_cache_is_fresh(signal_cache_id_t id, uint32_t max_age_ms);
+
+// Short name for shell commands and logs
+const char *signal_cache_name(signal_cache_id_t id);
+
+// Convenience accessors for V2I/V2X consumers
+float get_current_speed(void);      // m/s
+struct vehicle_location get_current_location(void);
+
+#endif /* SIGNAL_CACHE_H */
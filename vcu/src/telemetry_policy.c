@@ -0,0 +1,130 @@
+#include <zephyr/kernel.h>
+#include <math.h>
+#include <string.h>
+#include "telemetry_policy.h"
+
+#ifdef CONFIG_SHELL
+#include <zephyr/shell/shell.h>
+#endif
+
+struct telemetry_state {
+    float last_value;
+    uint32_t last_sent_ms;
+    bool sent_once;
+};
+
+static const struct telemetry_policy policies[SIGNAL_CACHE_COUNT] = {
+    [SIGNAL_TEMPERATURE]        = { .abs_deadband = 0.5f,     .min_interval_ms = 1000, .max_silence_ms = 30000 },
+    [SIGNAL_GPS_LATITUDE]       = { .abs_deadband = 0.00005f, .min_interval_ms = 1000, .max_silence_ms = 10000 },
+    [SIGNAL_GPS_LONGITUDE]      = { .abs_deadband = 0.00005f, .min_interval_ms = 1000, .max_silence_ms = 10000 },
+    [SIGNAL_COLLISION_DISTANCE] = { .abs_deadband = 10.0f,    .min_interval_ms = 100,  .max_silence_ms = 5000 },
+    [SIGNAL_BATTERY_VOLTAGE]    = { .abs_deadband = 0.05f,    .min_interval_ms = 1000, .max_silence_ms = 30000 },
+    [SIGNAL_BRAKE_PRESSURE]     = { .abs_deadband = 20.0f, .rel_deadband = 0.02f,
+                                    .min_interval_ms = 100,  .max_silence_ms = 5000 },
+    [SIGNAL_TPMS_PRESSURE]      = { .abs_deadband = 1.0f,     .min_interval_ms = 5000, .max_silence_ms = 60000 },
+    [SIGNAL_VEHICLE_SPEED]      = { .abs_deadband = 1.0f,     .min_interval_ms = 200,  .max_silence_ms = 5000 },
+};
+
+static struct telemetry_state states[SIGNAL_CACHE_COUNT];
+static struct telemetry_stats stats[SIGNAL_CACHE_COUNT];
+
+void telemetry_policy_init(void) {
+    memset(states, 0, sizeof(states));
+    memset(stats, 0, sizeof(stats));
+}
+
+static bool outside_deadband(const struct telemetry_policy *policy,
+                             const struct telemetry_state *state, float value) {
+    float threshold = MAX(policy->abs_deadband, policy->rel_deadband * fabsf(state->last_value));
+
+    return fabsf(value - state->last_value) > threshold;
+}
+
+bool telemetry_should_publish(signal_cache_id_t first, const float *values, uint8_t count) {
+    const struct telemetry_policy *policy;
+    struct telemetry_state *state;
+    uint32_t now = k_uptime_get_32();
+    bool changed = false;
+    bool heartbeat = false;
+
+    if (first + count > SIGNAL_CACHE_COUNT) {
+        return true;
+    }
+
+    // Rate limit and heartbeat are tracked on the first signal of the topic
+    policy = &policies[first];
+    state = &states[first];
+
+    if (state->sent_once) {
+        uint32_t elapsed = now - state->last_sent_ms;
+
+        if (elapsed < policy->min_interval_ms) {
+            stats[first].suppressed++;
+            return false;
+        }
+        heartbeat = policy->max_silence_ms != 0 && elapsed >= policy->max_silence_ms;
+
+        for (int i = 0; i < count && !changed; i++) {
+            changed = outside_deadband(&policies[first + i], &states[first + i], values[i]);
+        }
+
+        if (!changed && !heartbeat) {
+            stats[first].suppressed++;
+            return false;
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        states[first + i].last_value = values[i];
+        states[first + i].last_sent_ms = now;
+        states[first + i].sent_once = true;
+    }
+
+    stats[first].sent++;
+    if (heartbeat && !changed) {
+        stats[first].heartbeats++;
+    }
+    return true;
+}
+
+void telemetry_get_stats(signal_cache_id_t id, struct telemetry_stats *out) {
+    if (id >= SIGNAL_CACHE_COUNT) {
+        memset(out, 0, sizeof(*out));
+        return;
+    }
+    memcpy(out, &stats[id], sizeof(*out));
+}
+
+void telemetry_reset_stats(void) {
+    memset(stats, 0, sizeof(stats));
+}
+
+#ifdef CONFIG_SHELL
+static int cmd_telemetry_show(const struct shell *sh, size_t argc, char **argv) {
+    struct telemetry_stats st;
+
+    // Counted on the first signal of each topic
+    for (int sig = 0; sig < SIGNAL_CACHE_COUNT; sig++) {
+        telemetry_get_stats(sig, &st);
+        if (st.sent == 0 && st.suppressed == 0) {
+            continue;
+        }
+        shell_print(sh, "%-12s sent=%-8u suppressed=%-8u heartbeats=%u",
+                    signal_cache_name(sig), st.sent, st.suppressed, st.heartbeats);
+    }
+    return 0;
+}
+
+static int cmd_telemetry_reset(const struct shell *sh, size_t argc, char **argv) {
+    telemetry_reset_stats();
+    shell_print(sh, "Telemetry counters cleared");
+    return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(telemetry_cmds,
+    SHELL_CMD(show, NULL, "Published and suppressed samples per topic", cmd_telemetry_show),
+    SHELL_CMD(reset, NULL, "Clear telemetry counters", cmd_telemetry_reset),
+    SHELL_SUBCMD_SET_END
+);
+SHELL_CMD_REGISTER(telemetry, &telemetry_cmds, "MQTT publish policy", NULL);
+#endif /* CONFIG_SHELL */
@@ -0,0 +1,32 @@
+#ifndef TELEMETRY_POLICY_H
+#define TELEMETRY_POLICY_H
+
+#include <zephyr/kernel.h>
+#include "signal_cache.h"
+
+// Per-signal MQTT publish policy. A value is published when it moved
+// outside the deadband and min_interval_ms has passed, or when nothing
+// was sent for max_silence_ms (heartbeat). Zero disables a limit.
+struct telemetry_policy {
+    float abs_deadband;
+    float rel_deadband;
+    uint32_t min_interval_ms;
+    uint32_t max_silence_ms;
+};
+
+struct telemetry_stats {
+    uint32_t sent;
+    uint32_t suppressed;
+    uint32_t heartbeats;
+};
+
+void telemetry_policy_init(void);
+
+// Decide whether a topic carrying count consecutive signals starting at
+// first should be published. Call before any payload formatting.
+bool telemetry_should_publish(signal_cache_id_t first, const float *values, uint8_t count);
+
+void telemetry_get_stats(signal_cache_id_t id, struct telemetry_stats *stats);
+void telemetry_reset_stats(void);
+
+#endif /* TELEMETRY_POLICY_H */
@@ -1,11 +1,13 @@
 #include "v2i_handler.h"
 #include "mqtt_handler.h"
+#include "signal_cache.h"
 #include <zephyr/data/json.h>
 
 static struct v2i_context {
     bool traffic_light_state;
     uint8_t road_condition;
     uint16_t traffic_flow;
+    uint32_t stale_speed;   // Yellow lights skipped without a fresh speed
 } v2i_ctx;
 
 void v2i_init(void) {
@@ -59,6 +61,13 @@ static void handle_traffic_light_data(const struct json_obj_token *token) {
 }
 
 static void calculate_stopping_distance(float distance) {
+    // Without a recent speed sample the stopping distance is unknown, and
+    // warning anyway would raise a false alarm whenever speed frames stop
+    if (!signal_cache_is_fresh(SIGNAL_VEHICLE_SPEED, SIGNAL_MAX_AGE_MS)) {
+        v2i_ctx.stale_speed++;
+        return;
+    }
+
     float current_speed = get_current_speed();
     float brake_distance = (current_speed * current_speed) / (2 * BRAKE_DECELERATION);
     
@@ -0,0 +1,29 @@
+#include <zephyr/kernel.h>
+#include "vcu_j1939.h"
+#include "j1939.h"
+#include "j1939_dm.h"
+
+// Frames arrive through the RX pipeline, the PGN handlers run on its thread
+static struct j1939_ctx vcu_j1939 = {
+    .source_address = VCU_J1939_ADDR,
+    .dest_address = J1939_ADDR_GLOBAL,
+    .manual_rx = true,
+};
+
+int vcu_j1939_init(const struct device *can_dev) {
+    int ret;
+
+    vcu_j1939.can_dev = can_dev;
+    ret = j1939_init(&vcu_j1939);
+    if (ret != 0) {
+        return ret;
+    }
+    return j1939_dm_init(&vcu_j1939);
+}
+
+// j1939_process_message() takes a writable frame
+void vcu_j1939_rx(const struct can_frame *frame) {
+    struct can_frame copy = *frame;
+
+    j1939_process_message(&vcu_j1939, &copy);
+}
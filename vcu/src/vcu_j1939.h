@@ -0,0 +1,23 @@
+#ifndef VCU_J1939_H
+#define VCU_J1939_H
+
+#include <zephyr/device.h>
+#include <zephyr/drivers/can.h>
+
+#define VCU_J1939_ADDR      0x27    // Preferred address of management computer #1
+
+#ifdef CONFIG_J1939_DM
+
+// VCU J1939 node: broadcasts the error handler DTCs in DM1 and answers
+// Requests for DM1/DM2
+int vcu_j1939_init(const struct device *can_dev);
+
+// Extended frames from the CAN RX pipeline thread
+void vcu_j1939_rx(const struct can_frame *frame);
+
+#else
+static inline int vcu_j1939_init(const struct device *can_dev) { return 0; }
+static inline void vcu_j1939_rx(const struct can_frame *frame) {}
+#endif
+
+#endif /* VCU_J1939_H */